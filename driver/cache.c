@@ -0,0 +1,446 @@
+/*
+ * Copyright (c) 2016 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include "config.h"
+
+/*
+ * The compile cache keeps the output of past compiles in the directory
+ * named by the IVERILOG_CACHE environment variable. An entry is found
+ * by a key that is a hash of everything the driver passes to the
+ * compiler: the configuration, the defines, the parameter overrides
+ * and the list of source files. Each entry also lists the files that
+ * the compile read (the dependency file that ivlpp and ivl write in
+ * "all" mode) with a hash of their contents, and is only used if all
+ * of those files are still the same. The key also has the listings of
+ * the library and include directories, so that a new file that would
+ * be found before one the cached compile used (or found instead of a
+ * missing one) makes a new key.
+ *
+ * The cache works on the whole compile. If any of the files has
+ * changed the whole design is preprocessed, parsed and elaborated
+ * again, so it saves the compile time for a design that has not
+ * changed, but not for a design with a few changed modules.
+ *
+ * An entry is three files, <key>.out with the compiler output,
+ * <key>.err with the messages that the compile wrote to stderr, and
+ * <key>.dep with the list of "<hash> <path>" lines.
+ */
+
+# include  <stdio.h>
+# include  <stdlib.h>
+# include  <string.h>
+# include  <fcntl.h>
+# include  <sys/types.h>
+# include  <sys/stat.h>
+# include  <unistd.h>
+# include  <dirent.h>
+# include  "globals.h"
+# include  "ivl_alloc.h"
+
+#ifdef __MINGW32__
+# define CACHE_SEP '\\'
+#else
+# define CACHE_SEP '/'
+#endif
+
+typedef unsigned long long cache_hash_t;
+
+# define FNV_OFFSET 0xcbf29ce484222325ULL
+# define FNV_PRIME  0x100000001b3ULL
+
+static cache_hash_t cache_key = FNV_OFFSET;
+
+static cache_hash_t hash_bytes(cache_hash_t hash, const void*data, size_t len)
+{
+      const unsigned char*cp = (const unsigned char*)data;
+      while (len > 0) {
+	    hash ^= *cp++;
+	    hash *= FNV_PRIME;
+	    len -= 1;
+      }
+      return hash;
+}
+
+/*
+ * Hash the contents of the file. Return 0 if the file cannot be read.
+ */
+static int hash_file(const char*path, cache_hash_t*hash)
+{
+      char buf[8192];
+      size_t len;
+      FILE*fd = fopen(path, "rb");
+      if (fd == 0)
+	    return 0;
+
+      *hash = FNV_OFFSET;
+      while ((len = fread(buf, 1, sizeof buf, fd)) > 0)
+	    *hash = hash_bytes(*hash, buf, len);
+
+      fclose(fd);
+      return 1;
+}
+
+void cache_key_string(const char*str)
+{
+	/* Include the terminating nul so that the strings "ab","c"
+	   and "a","bc" give different keys. */
+      cache_key = hash_bytes(cache_key, str, strlen(str)+1);
+}
+
+void cache_key_file(const char*path, const char*const*skip)
+{
+      char buf[4096];
+      FILE*fd = fopen(path, "r");
+      if (fd == 0) {
+	    cache_key_string("");
+	    return;
+      }
+
+      while (fgets(buf, sizeof buf, fd)) {
+	    const char*const*cur;
+	    for (cur = skip ; cur && *cur ; cur += 1) {
+		  if (strncmp(buf, *cur, strlen(*cur)) == 0)
+			break;
+	    }
+	    if (cur && *cur)
+		  continue;
+	    cache_key_string(buf);
+      }
+
+      fclose(fd);
+}
+
+static int compare_names(const void*a, const void*b)
+{
+      return strcmp(*(const char*const*)a, *(const char*const*)b);
+}
+
+/*
+ * Add the sorted names of the files in the directory to the key. The
+ * contents of the files that the compile reads are checked by the
+ * dependency list of the entry.
+ */
+static void cache_key_dir(const char*path)
+{
+      struct dirent*ent;
+      char**names = 0;
+      unsigned count = 0, cap = 0, idx;
+      DIR*dir;
+
+      cache_key_string(path);
+      dir = opendir(path);
+      if (dir == 0)
+	    return;
+
+      while ((ent = readdir(dir)) != 0) {
+	    if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+		  continue;
+	    if (count == cap) {
+		  cap = cap ? 2*cap : 64;
+		  names = realloc(names, cap * sizeof(char*));
+	    }
+	    names[count++] = strdup(ent->d_name);
+      }
+      closedir(dir);
+
+      qsort(names, count, sizeof(char*), compare_names);
+      for (idx = 0 ; idx < count ; idx += 1) {
+	    cache_key_string(names[idx]);
+	    free(names[idx]);
+      }
+      free(names);
+}
+
+void cache_key_dirs(const char*path, const char*const*prefixes)
+{
+      char buf[4096];
+      FILE*fd = fopen(path, "r");
+      if (fd == 0)
+	    return;
+
+      while (fgets(buf, sizeof buf, fd)) {
+	    const char*const*cur;
+	    char*cp = strchr(buf, '\n');
+	    if (cp) *cp = 0;
+	    for (cur = prefixes ; *cur ; cur += 1) {
+		  size_t len = strlen(*cur);
+		  if (strncmp(buf, *cur, len) == 0) {
+			cache_key_dir(buf + len);
+			break;
+		  }
+	    }
+      }
+
+      fclose(fd);
+}
+
+void cache_key_stat(const char*path)
+{
+      struct stat sb;
+      char buf[64];
+
+      cache_key_string(path);
+      if (stat(path, &sb) != 0)
+	    return;
+
+      snprintf(buf, sizeof buf, "%llu %llu",
+	       (unsigned long long)sb.st_size,
+	       (unsigned long long)sb.st_mtime);
+      cache_key_string(buf);
+}
+
+static char*entry_path(const char*suffix)
+{
+      size_t len = strlen(cache_dir) + 32;
+      char*path = malloc(len);
+      snprintf(path, len, "%s%c%016llx.%s", cache_dir, CACHE_SEP,
+	       cache_key, suffix);
+      return path;
+}
+
+static int copy_file(const char*src, const char*dst)
+{
+      char buf[8192];
+      size_t len;
+      int rc = 1;
+      FILE*ifd;
+      FILE*ofd;
+      struct stat sb;
+
+      ifd = fopen(src, "rb");
+      if (ifd == 0)
+	    return 0;
+      ofd = fopen(dst, "wb");
+      if (ofd == 0) {
+	    fclose(ifd);
+	    return 0;
+      }
+
+      while ((len = fread(buf, 1, sizeof buf, ifd)) > 0) {
+	    if (fwrite(buf, 1, len, ofd) != len) {
+		  rc = 0;
+		  break;
+	    }
+      }
+      if (ferror(ifd))
+	    rc = 0;
+
+      fclose(ifd);
+      if (fclose(ofd) != 0)
+	    rc = 0;
+
+	/* Keep the mode so that an executable output stays that way. */
+      if (rc && stat(src, &sb) == 0)
+	    chmod(dst, sb.st_mode & 0777);
+
+      return rc;
+}
+
+static void print_file(const char*path)
+{
+      char buf[8192];
+      size_t len;
+      FILE*fd = fopen(path, "rb");
+      if (fd == 0)
+	    return;
+
+      while ((len = fread(buf, 1, sizeof buf, fd)) > 0)
+	    fwrite(buf, 1, len, stderr);
+      fflush(stderr);
+
+      fclose(fd);
+}
+
+int cache_fetch(const char*out)
+{
+      char line[8192];
+      char*dep_path = entry_path("dep");
+      char*out_path;
+      FILE*fd = fopen(dep_path, "r");
+      int hit = fd != 0;
+      free(dep_path);
+
+      while (hit && fgets(line, sizeof line, fd)) {
+	    cache_hash_t want, have;
+	    char*path;
+	    char*cp = strchr(line, '\n');
+	    if (cp) *cp = 0;
+
+	    want = strtoull(line, &path, 16);
+	    if (*path != ' ') {
+		  hit = 0;
+		  break;
+	    }
+	    path += 1;
+
+	    if (! hash_file(path, &have) || have != want)
+		  hit = 0;
+      }
+      if (fd) fclose(fd);
+
+      if (! hit)
+	    return 0;
+
+      out_path = entry_path("out");
+      hit = copy_file(out_path, out);
+      free(out_path);
+
+	/* Print the warnings of the cached compile again, so that a
+	   cache hit looks the same as a compile. */
+      if (hit) {
+	    char*err_path = entry_path("err");
+	    print_file(err_path);
+	    free(err_path);
+      }
+      return hit;
+}
+
+/*
+ * Run the compile with its stderr sent to the log file, so that the
+ * messages can be saved with the entry, then print them. The messages
+ * therefore appear when the compile is done instead of as they are
+ * written.
+ */
+int cache_system(const char*cmd, const char*log)
+{
+      int rc;
+      int save_fd;
+      int log_fd;
+
+      fflush(stderr);
+      log_fd = open(log, O_WRONLY|O_CREAT|O_TRUNC, 0600);
+      if (log_fd < 0)
+	    return system(cmd);
+
+      save_fd = dup(2);
+      dup2(log_fd, 2);
+      close(log_fd);
+
+      rc = system(cmd);
+
+      dup2(save_fd, 2);
+      close(save_fd);
+
+      print_file(log);
+      return rc;
+}
+
+static char*temp_path(const char*path)
+{
+      size_t len = strlen(path) + 32;
+      char*tmp_path = malloc(len);
+      snprintf(tmp_path, len, "%s.%ld", path, (long)getpid());
+      return tmp_path;
+}
+
+/*
+ * Entries are written to a temporary name in the cache directory and
+ * then renamed, so that a concurrent compile never sees a partial
+ * entry.
+ */
+static int rename_file(const char*src, const char*dst)
+{
+#ifdef __MINGW32__
+      remove(dst);
+#endif
+      if (rename(src, dst) == 0)
+	    return 1;
+      remove(src);
+      return 0;
+}
+
+/*
+ * Copy the file to a temporary name next to the entry file and then
+ * rename it into place. Return true if the entry file is installed.
+ */
+static int install_file(const char*src, const char*suffix)
+{
+      int rc;
+      char*path = entry_path(suffix);
+      char*tmp = temp_path(path);
+      if (copy_file(src, tmp)) {
+	    rc = rename_file(tmp, path);
+      } else {
+	    remove(tmp);
+	    rc = 0;
+      }
+
+      free(tmp);
+      free(path);
+      return rc;
+}
+
+void cache_store(const char*out, const char*depends, const char*log)
+{
+      char line[8192];
+      char*dep_path;
+      char*dep_tmp;
+      FILE*ifd;
+      FILE*ofd;
+      unsigned count = 0;
+      int rc = 1;
+
+      ifd = fopen(depends, "r");
+      if (ifd == 0)
+	    return;
+
+      dep_path = entry_path("dep");
+      dep_tmp = temp_path(dep_path);
+      ofd = fopen(dep_tmp, "w");
+      if (ofd == 0) {
+	    fclose(ifd);
+	    free(dep_tmp);
+	    free(dep_path);
+	    return;
+      }
+
+      while (rc && fgets(line, sizeof line, ifd)) {
+	    cache_hash_t hash;
+	    char*cp = strchr(line, '\n');
+	    if (cp) *cp = 0;
+	    if (line[0] == 0)
+		  continue;
+
+	      /* A file that cannot be read now cannot be checked
+		 later, so the compile is not cached. */
+	    if (! hash_file(line, &hash)) {
+		  rc = 0;
+		  break;
+	    }
+	    fprintf(ofd, "%016llx %s\n", hash, line);
+	    count += 1;
+      }
+      fclose(ifd);
+      if (fclose(ofd) != 0 || count == 0)
+	    rc = 0;
+
+	/* Install the output and messages before the dependency list,
+	   because the list is what makes the entry visible. */
+      if (rc)
+	    rc = install_file(out, "out");
+      if (rc)
+	    rc = install_file(log, "err");
+      if (rc)
+	    rename_file(dep_tmp, dep_path);
+      else
+	    remove(dep_tmp);
+
+      free(dep_tmp);
+      free(dep_path);
+}
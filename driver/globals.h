@@ -1,7 +1,7 @@
 #ifndef IVL_globals_H
 #define IVL_globals_H
 /*
- * Copyright (c) 2000-2014 Stephen Williams (steve@icarus.com)
+ * Copyright (c) 2000-2016 Stephen Williams (steve@icarus.com)
  *
  *    This source code is free software; you can redistribute it
  *    and/or modify it in source code form under the terms of the GNU
@@ -54,4 +54,25 @@ extern void process_parameter(const char*name);
   /* Set the default timescale for the simulator. */
 extern void process_timescale(const char*ts_string);
 
+  /* The compile cache directory, or nil if the cache is not used. */
+extern const char*cache_dir;
+
+  /* Add to the cache key of this compile. */
+extern void cache_key_string(const char*str);
+extern void cache_key_file(const char*path, const char*const*skip);
+extern void cache_key_stat(const char*path);
+  /* Add the listing of each directory that the file gives on a line
+     that starts with one of the prefixes. */
+extern void cache_key_dirs(const char*path, const char*const*prefixes);
+
+  /* Copy the cached output to the file, print the cached messages,
+     and return true if the cache has an up to date entry for the key. */
+extern int cache_fetch(const char*out);
+
+  /* Run the compile command with its messages kept in the log file. */
+extern int cache_system(const char*cmd, const char*log);
+
+  /* Save the output of the compile, its messages and its dependencies. */
+extern void cache_store(const char*out, const char*depends, const char*log);
+
 #endif /* IVL_globals_H */
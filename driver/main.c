@@ -114,6 +114,7 @@ const char*opath = "a.out";
 const char*npath = 0;
 const char*targ  = "vvp";
 const char*depfile = 0;
+const char*cache_dir = 0;
 
 const char**vhdlpp_libdir = 0;
 unsigned vhdlpp_libdir_cnt = 0;
@@ -162,6 +163,9 @@ FILE*iconfig_file = 0;
 
 char*compiled_defines_path = 0;
 
+char*cache_depfile_path = 0;
+char*cache_log_path = 0;
+
 static char iconfig_common_path[4096] = "";
 
 int synth_flag = 0;
@@ -457,8 +461,44 @@ static int t_compile(void)
       if (verbose_flag)
 	    printf("translate: %s\n", cmd);
 
+      if (cache_dir) {
+	    static const char*const iconfig_skip[] = {
+		  "out:", "depfile:", "depmode:", "ivlpp:", 0 };
+	    static const char*const defines_skip[] = { "Ma:", 0 };
+	    static const char*const library_dirs[] = { "-y:", "-yl:", 0 };
+	    static const char*const include_dirs[] = { "I:", 0 };
+
+	    cache_key_string(VERSION " (" VERSION_TAG ")");
+	    snprintf(tmp, sizeof tmp, "%s%civl", base, sep);
+	    cache_key_stat(tmp);
+	    snprintf(tmp, sizeof tmp, "%s%civlpp", ivlpp_dir, sep);
+	    cache_key_stat(tmp);
+	    snprintf(tmp, sizeof tmp, "%s%c%s.tgt", base, sep, targ);
+	    cache_key_stat(tmp);
+	    cache_key_file(iconfig_path, iconfig_skip);
+	    cache_key_file(iconfig_common_path, 0);
+	    cache_key_file(defines_path, defines_skip);
+	    cache_key_file(source_path, 0);
+	    cache_key_dirs(iconfig_path, library_dirs);
+	    cache_key_dirs(defines_path, include_dirs);
+      }
 
-      rc = system(cmd);
+      if (cache_dir && cache_fetch(opath)) {
+	    rc = 0;
+      } else if (cache_dir) {
+	    rc = cache_system(cmd, cache_log_path);
+	    if (rc == 0)
+		  cache_store(opath, cache_depfile_path, cache_log_path);
+      } else {
+	    rc = system(cmd);
+      }
+
+      if (cache_depfile_path) {
+	    remove(cache_depfile_path);
+	    free(cache_depfile_path);
+	    remove(cache_log_path);
+	    free(cache_log_path);
+      }
       if ( ! getenv("IVERILOG_ICONFIG")) {
 	    remove(source_path);
 	    free(source_path);
@@ -1168,6 +1208,29 @@ int main(int argc, char **argv)
 	    fprintf(iconfig_file, "module:v2009\n");
       }
 
+	/* The compile cache needs a complete dependency list of its
+	   own, so it is only used for plain compiles with no
+	   dependency file of the user's. */
+      cache_dir = getenv("IVERILOG_CACHE");
+      if (cache_dir && (*cache_dir == 0 || depfile || npath
+			|| verbose_flag || version_flag || e_flag
+			|| strcmp(targ, "vvp") != 0))
+	    cache_dir = 0;
+      if (cache_dir) {
+	    FILE*tmp_file = 0;
+	    cache_depfile_path = strdup(my_tempfile("ivrlc", &tmp_file));
+	    if (tmp_file) {
+		  fclose(tmp_file);
+	    }
+	    tmp_file = 0;
+	    cache_log_path = strdup(my_tempfile("ivrle", &tmp_file));
+	    if (tmp_file) {
+		  fclose(tmp_file);
+	    }
+	    depfile = cache_depfile_path;
+	    depmode = 'a';
+      }
+
       if (mtm != 0) fprintf(iconfig_file, "-T:%s\n", mtm);
       fprintf(iconfig_file, "generation:%s\n", generation);
       fprintf(iconfig_file, "generation:%s\n", gen_specify);
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2016 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * This is a benchmark for the delivery of values to nets with a very
+ * large fan-out. A clock is buffered into BRANCHES branch clocks, and
+ * each branch clock drives LEAVES flip-flops, so with the default
+ * parameters a clock edge reaches about a million flip-flops through
+ * nets that each have 4096 receivers. Compile and run it with:
+ *
+ *    iverilog -oclock_tree.vvp clock_tree.v
+ *    vvp -v clock_tree.vvp
+ *
+ * The flip-flops are instances of a module so that each has its own
+ * event, and the clock nets really have one receiver per flip-flop.
+ * The flip-flops of a branch are spread over all the branches in the
+ * order they are made, so the receivers of a branch clock are not
+ * next to each other in memory, as in a real design. Use smaller
+ * parameters for a quicker run, for example:
+ *
+ *    iverilog -Pclock_tree.BRANCHES=16 -oclock_tree.vvp clock_tree.v
+ */
+
+module clock_tree_dff(input wire clk, input wire d, output reg q);
+
+   always @(posedge clk) q <= d;
+
+endmodule
+
+module clock_tree;
+
+   parameter BRANCHES = 256;
+   parameter LEAVES = 4096;
+   parameter CYCLES = 200;
+
+   reg clk = 0;
+   reg [BRANCHES-1:0] d = 0;
+   wire [BRANCHES-1:0] bclk;
+   wire [BRANCHES*LEAVES-1:0] q;
+
+   genvar idx;
+   generate
+      for (idx = 0 ; idx < BRANCHES ; idx = idx + 1) begin : branch
+	 buf drv (bclk[idx], clk);
+      end
+	/* Flip-flop idx is on branch idx%BRANCHES, so consecutive
+	   flip-flops are on different branches. */
+      for (idx = 0 ; idx < BRANCHES*LEAVES ; idx = idx + 1) begin : leaf
+	 clock_tree_dff ff (.clk(bclk[idx % BRANCHES]),
+			    .d(d[idx % BRANCHES]),
+			    .q(q[idx]));
+      end
+   endgenerate
+
+   integer cycle;
+   initial begin
+      for (cycle = 0 ; cycle < CYCLES ; cycle = cycle + 1) begin
+	 d = {BRANCHES{cycle[0]}};
+	 #5 clk = 1;
+	 #5 clk = 0;
+      end
+      $display("q[0] = %b after %0d cycles", q[0], CYCLES);
+      $finish;
+   end
+
+endmodule
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2016 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include "version_base.h"
+# include "version_tag.h"
+# include "config.h"
+# include "cxx_priv.h"
+# include <cstdarg>
+# include <cstdlib>
+# include <cstring>
+
+/*
+ * This is the cxx code generator. It writes the design as a C++
+ * program that simulates the design when it is compiled and run, for
+ * example:
+ *
+ *    iverilog -tcxx -omodel.cc design.v
+ *    c++ -O2 -o model model.cc
+ *    ./model
+ *
+ * The program models the vectors with machine words, so it handles a
+ * subset of Verilog: vectors and arrays of vectors of at most 64 bits,
+ * continuous logic without delays, and processes without fork/join,
+ * tasks, disable or force. README-CXX.txt lists the subset. The
+ * vectors of 2-state types (bit, int and so on) use plain 64 bit
+ * words, and the -ptwo_state=1 flag makes all the vectors 2-state,
+ * which is faster but reads x and z as 0.
+ */
+
+static const char*version_string =
+"Icarus Verilog CXX Code Generator " VERSION " (" VERSION_TAG ")\n\n"
+"Copyright (c) 2016 Stephen Williams (steve@icarus.com)\n\n"
+"  This program is free software; you can redistribute it and/or modify\n"
+"  it under the terms of the GNU General Public License as published by\n"
+"  the Free Software Foundation; either version 2 of the License, or\n"
+"  (at your option) any later version.\n"
+"\n"
+"  This program is distributed in the hope that it will be useful,\n"
+"  but WITHOUT ANY WARRANTY; without even the implied warranty of\n"
+"  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the\n"
+"  GNU General Public License for more details.\n"
+"\n"
+"  You should have received a copy of the GNU General Public License along\n"
+"  with this program; if not, write to the Free Software Foundation, Inc.,\n"
+"  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.\n"
+;
+
+/* The text of cxx_runtime.h, which the Makefile makes into a string. */
+static const char runtime_text[] =
+# include "cxx_runtime.inc"
+;
+
+int cxx_errors = 0;
+bool cxx_two_state = false;
+int cxx_precision = 0;
+
+void cxx_sorry(const char*file, unsigned lineno, const char*fmt, ...)
+{
+      va_list ap;
+      va_start(ap, fmt);
+      fprintf(stderr, "%s:%u: cxx sorry: ", file, lineno);
+      vfprintf(stderr, fmt, ap);
+      fprintf(stderr, "\n");
+      va_end(ap);
+      cxx_errors += 1;
+}
+
+std::string cxx_printf(const char*fmt, ...)
+{
+      char buf[256];
+      va_list ap;
+      va_start(ap, fmt);
+      int len = vsnprintf(buf, sizeof buf, fmt, ap);
+      va_end(ap);
+      if (len < (int)sizeof buf)
+	    return buf;
+
+      std::string res (len + 1, 0);
+      va_start(ap, fmt);
+      vsnprintf(&res[0], len + 1, fmt, ap);
+      va_end(ap);
+      res.resize(len);
+      return res;
+}
+
+std::string cxx_literal(unsigned long long val)
+{
+      if (val < 10)
+	    return cxx_printf("%llu", val);
+      return cxx_printf("0x%llxULL", val);
+}
+
+/*
+ * This is called by the ivl core to get version information from the
+ * loadable code generator.
+ */
+const char* target_query(const char*key)
+{
+      if (strcmp(key,"version") == 0)
+	    return version_string;
+
+      return 0;
+}
+
+/*
+ * This is the main entry point from the IVL core.
+ */
+int target_design(ivl_design_t des)
+{
+      const char*path = ivl_design_flag(des, "-o");
+      if (path == 0 || path[0] == 0) {
+	    fprintf(stderr, "cxx error: No output file given.\n");
+	    return 1;
+      }
+
+      const char*two_state = ivl_design_flag(des, "two_state");
+      cxx_two_state = two_state && strcmp(two_state, "") != 0
+	    && strcmp(two_state, "0") != 0;
+      cxx_precision = ivl_design_time_precision(des);
+
+	/* Scan the nets first, so that the processes know which
+	   vectors are watched. */
+      scan_design(des);
+      emit_processes(des);
+
+      if (cxx_errors > 0) {
+	    fprintf(stderr, "cxx: %d error(s), no output written.\n", cxx_errors);
+	    return cxx_errors;
+      }
+
+      FILE*out = fopen(path, "w");
+      if (out == 0) {
+	    perror(path);
+	    return 1;
+      }
+
+      fprintf(out, "/* Generated by Icarus Verilog " VERSION " (" VERSION_TAG ")"
+	      " cxx code generator. */\n\n");
+      fputs(runtime_text, out);
+
+      fprintf(out, "\n/* The nets of the design. */\n\n");
+      emit_nets_decl(out);
+      emit_code_decl(out);
+      emit_nets_eval(out);
+
+      emit_code(out);
+
+      fprintf(out, "\nint main(void)\n{\n");
+      emit_nets_start(out);
+      emit_code_start(out);
+      fprintf(out, "      return cxx_rt::run();\n}\n");
+
+      if (fclose(out) != 0) {
+	    perror(path);
+	    return 1;
+      }
+      return 0;
+}
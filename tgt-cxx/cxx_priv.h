@@ -0,0 +1,106 @@
+#ifndef IVL_cxx_priv_H
+#define IVL_cxx_priv_H
+/*
+ * Copyright (c) 2016 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "ivl_target.h"
+# include  <string>
+# include  <cstdio>
+
+/*
+ * The cxx code generator writes the design as a single C++ source
+ * file. The run time (cxx_runtime.h) is copied into the head of that
+ * file, and the rest is the model of the design that uses it.
+ */
+
+extern int cxx_errors;
+
+/* Set by -ptwo_state=1 to model all the vectors with 2-state values. */
+extern bool cxx_two_state;
+
+/* The time precision of the design, which is the unit of a tick. */
+extern int cxx_precision;
+
+/*
+ * Report a construct that the code generator does not handle. The
+ * code generator keeps going so that all the problems are reported,
+ * but the design is not written.
+ */
+extern void cxx_sorry(const char*file, unsigned lineno, const char*fmt, ...)
+      __attribute__((format (printf,3,4)));
+
+extern std::string cxx_printf(const char*fmt, ...)
+      __attribute__((format (printf,1,2)));
+
+/* A C++ literal for the value, with a ULL suffix. */
+extern std::string cxx_literal(unsigned long long val);
+
+/*
+ * The storage of a signal. A vector is a u64 or a vec4 named by name,
+ * or if it is watched, a sig2 or sig4 with the value in name.val. An
+ * array is a C array of count words that nothing watches.
+ */
+struct cxx_var {
+      std::string name;
+      unsigned wid;
+      unsigned count;
+      bool two_state;
+      bool watched;
+};
+
+/* nets.cc */
+extern void scan_design(ivl_design_t des);
+extern bool signal_var(ivl_signal_t sig, cxx_var&var,
+		       const char*file, unsigned lineno);
+extern unsigned event_id(ivl_event_t evt);
+extern void emit_nets_decl(FILE*out);
+extern void emit_nets_eval(FILE*out);
+extern void emit_nets_start(FILE*out);
+
+/* The value of a vector (not an array), converted to want2. */
+extern std::string var_value(const cxx_var&var, bool want2);
+extern std::string var_store(const cxx_var&var, const std::string&val);
+
+/* expr.cc */
+extern bool expr_is2(ivl_expr_t expr);
+extern std::string emit_expr(ivl_expr_t expr, bool want2);
+extern std::string emit_expr_pad(ivl_expr_t expr, unsigned wid, bool want2);
+extern std::string emit_index(ivl_expr_t expr);
+extern std::string emit_binary_op(char op, const std::string&lval,
+				  const std::string&rval, unsigned wid,
+				  bool sgn, bool is2);
+extern std::string string_text(ivl_expr_t expr);
+extern bool number_value(ivl_expr_t expr, unsigned long long&val);
+
+/*
+ * The scope that the statements being written are in, for $time and
+ * the %m format.
+ */
+extern ivl_scope_t cxx_scope;
+
+/* stmt.cc */
+extern void emit_processes(ivl_design_t des);
+extern void emit_code_decl(FILE*out);
+extern void emit_code(FILE*out);
+extern void emit_code_start(FILE*out);
+
+/* The name of the C++ function for a Verilog function. */
+extern std::string function_name(ivl_scope_t func);
+
+#endif /* IVL_cxx_priv_H */
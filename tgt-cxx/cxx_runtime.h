@@ -0,0 +1,1135 @@
+#ifndef IVL_cxx_runtime_H
+#define IVL_cxx_runtime_H
+/*
+ * Copyright (c) 2016 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * This is the run time of the C++ models that the cxx code generator
+ * writes. The code generator copies this file into the head of every
+ * model, so a model is a single C++ source file that needs nothing
+ * but a C++ compiler.
+ *
+ * Vectors are at most 64 bits wide. A 2-state vector is a u64, and a
+ * 4-state vector is a vec4 with the same encoding that vvp uses:
+ *
+ *     a b
+ *     0 0  -- 0
+ *     1 0  -- 1
+ *     1 1  -- x
+ *     0 1  -- z
+ *
+ * The bits above the width of a vector are always 0. The functions
+ * that may set those bits take the width as an argument.
+ */
+
+# include  <stdint.h>
+# include  <cstdio>
+# include  <string>
+# include  <vector>
+# include  <deque>
+# include  <map>
+
+namespace cxx_rt {
+
+typedef uint64_t u64;
+typedef int64_t  s64;
+
+struct vec4 {
+      u64 a, b;
+};
+
+inline u64 mask(unsigned wid)
+{
+      return wid >= 64? ~(u64)0 : ((u64)1 << wid) - 1;
+}
+
+inline vec4 v4(u64 a, u64 b =0)
+{
+      vec4 res;
+      res.a = a;
+      res.b = b;
+      return res;
+}
+
+inline vec4 x4(unsigned wid) { return v4(mask(wid), mask(wid)); }
+
+inline bool operator == (const vec4&l, const vec4&r)
+{ return l.a == r.a && l.b == r.b; }
+
+inline bool operator != (const vec4&l, const vec4&r)
+{ return l.a != r.a || l.b != r.b; }
+
+/* The 2-state value of a 4-state vector, with x and z read as 0. */
+inline u64 to2(const vec4&v) { return v.a & ~v.b; }
+
+inline u64 sext(u64 v, unsigned wid)
+{
+      if (wid == 0 || wid >= 64)
+	    return v;
+      u64 sign = (u64)1 << (wid-1);
+      return ((v & mask(wid)) ^ sign) - sign;
+}
+
+inline u64 pad2(u64 v, unsigned from, unsigned to, bool sgn)
+{
+      if (sgn) v = sext(v, from);
+      return v & mask(to);
+}
+
+inline vec4 pad4(const vec4&v, unsigned from, unsigned to, bool sgn)
+{
+      return v4(pad2(v.a, from, to, sgn), pad2(v.b, from, to, sgn));
+}
+
+/*
+ * Shift down by off bits, or up if off is negative, dropping the
+ * bits that leave the 64 bit word.
+ */
+inline u64 shift_down(u64 v, s64 off)
+{
+      if (off >= 64 || off <= -64)
+	    return 0;
+      return off >= 0? v >> off : v << -off;
+}
+
+/* The mask of bits lo to hi-1, clipped to the 64 bit word. */
+inline u64 bits_mask(s64 lo, s64 hi)
+{
+      if (lo < 0) lo = 0;
+      if (hi > 64) hi = 64;
+      if (lo >= hi)
+	    return 0;
+      return mask((unsigned)(hi - lo)) << lo;
+}
+
+/*
+ * Bitwise operators. These follow the usual truth tables, where a 0
+ * wins over an x for the AND, a 1 wins over an x for the OR and any x
+ * or z makes an x of the XOR.
+ */
+inline vec4 and4(const vec4&l, const vec4&r)
+{
+      u64 zero = (~l.a & ~l.b) | (~r.a & ~r.b);
+      u64 unk  = (l.b | r.b) & ~zero;
+      return v4((l.a & r.a & ~l.b & ~r.b) | unk, unk);
+}
+
+inline vec4 or4(const vec4&l, const vec4&r)
+{
+      u64 one = (l.a & ~l.b) | (r.a & ~r.b);
+      u64 unk = (l.b | r.b) & ~one;
+      return v4(one | unk, unk);
+}
+
+inline vec4 xor4(const vec4&l, const vec4&r)
+{
+      u64 unk = l.b | r.b;
+      return v4((l.a ^ r.a) | unk, unk);
+}
+
+inline vec4 not4(const vec4&v, unsigned wid)
+{
+      return v4((~v.a & mask(wid)) | v.b, v.b);
+}
+
+/* A buf gate passes the 0, 1 and x bits and turns z into x. */
+inline vec4 buf4(const vec4&v) { return v4(v.a | v.b, v.b); }
+
+/*
+ * The bufif and notif gates drive z when the enable is off, and x
+ * when the enable is x or z.
+ */
+inline vec4 bufif4(const vec4&d, const vec4&en, bool on, unsigned wid)
+{
+      if (en.b & 1) return x4(wid);
+      if ((en.a & 1) != (on? 1U : 0U)) return v4(0, mask(wid));
+      return buf4(d);
+}
+
+/*
+ * Arithmetic operators. Any x or z in the operands makes the whole
+ * result x.
+ */
+inline vec4 add4(const vec4&l, const vec4&r, unsigned wid)
+{
+      if (l.b | r.b) return x4(wid);
+      return v4((l.a + r.a) & mask(wid));
+}
+
+inline vec4 sub4(const vec4&l, const vec4&r, unsigned wid)
+{
+      if (l.b | r.b) return x4(wid);
+      return v4((l.a - r.a) & mask(wid));
+}
+
+inline vec4 mul4(const vec4&l, const vec4&r, unsigned wid)
+{
+      if (l.b | r.b) return x4(wid);
+      return v4((l.a * r.a) & mask(wid));
+}
+
+inline vec4 neg4(const vec4&v, unsigned wid)
+{
+      if (v.b) return x4(wid);
+      return v4((0 - v.a) & mask(wid));
+}
+
+inline u64 abs2(u64 v, unsigned wid)
+{
+      if (wid > 0 && ((v >> (wid-1)) & 1))
+	    return (0 - v) & mask(wid);
+      return v;
+}
+
+inline vec4 abs4(const vec4&v, unsigned wid)
+{
+      if (v.b) return x4(wid);
+      return v4(abs2(v.a, wid));
+}
+
+/* A 2-state divide or modulus by 0 gives 0. */
+inline u64 div2(u64 l, u64 r, unsigned wid, bool sgn)
+{
+      if (r == 0)
+	    return 0;
+      if (! sgn)
+	    return (l / r) & mask(wid);
+      s64 ls = (s64)sext(l, wid);
+      s64 rs = (s64)sext(r, wid);
+      if (rs == -1)
+	    return (0 - l) & mask(wid);
+      return (u64)(ls / rs) & mask(wid);
+}
+
+inline u64 mod2(u64 l, u64 r, unsigned wid, bool sgn)
+{
+      if (r == 0)
+	    return 0;
+      if (! sgn)
+	    return (l % r) & mask(wid);
+      s64 ls = (s64)sext(l, wid);
+      s64 rs = (s64)sext(r, wid);
+      if (rs == -1)
+	    return 0;
+      return (u64)(ls % rs) & mask(wid);
+}
+
+inline vec4 div4(const vec4&l, const vec4&r, unsigned wid, bool sgn)
+{
+      if ((l.b | r.b) || r.a == 0) return x4(wid);
+      return v4(div2(l.a, r.a, wid, sgn));
+}
+
+inline vec4 mod4(const vec4&l, const vec4&r, unsigned wid, bool sgn)
+{
+      if ((l.b | r.b) || r.a == 0) return x4(wid);
+      return v4(mod2(l.a, r.a, wid, sgn));
+}
+
+/*
+ * The power operator. A negative exponent gives 0 except for the
+ * bases 1 and -1, and 0 to a negative power is x (0 in 2-state).
+ */
+inline u64 pow2(u64 l, u64 r, unsigned lwid, unsigned rwid, unsigned wid,
+		bool lsgn, bool rsgn)
+{
+      if (rsgn && (s64)sext(r, rwid) < 0) {
+	    s64 base = lsgn? (s64)sext(l, lwid) : (s64)l;
+	    if (base == 1)
+		  return 1;
+	    if (base == -1)
+		  return ((r & 1)? (u64)-1 : 1) & mask(wid);
+	    return 0;
+      }
+      if (lsgn) l = sext(l, lwid);
+      u64 res = 1;
+      while (r != 0) {
+	    if (r & 1) res *= l;
+	    l *= l;
+	    r >>= 1;
+      }
+      return res & mask(wid);
+}
+
+inline vec4 pow4(const vec4&l, const vec4&r, unsigned lwid, unsigned rwid,
+		 unsigned wid, bool lsgn, bool rsgn)
+{
+      if (l.b | r.b) return x4(wid);
+      if (l.a == 0 && rsgn && (s64)sext(r.a, rwid) < 0) return x4(wid);
+      return v4(pow2(l.a, r.a, lwid, rwid, wid, lsgn, rsgn));
+}
+
+/*
+ * The comparisons return 1 bit vectors. The == and != compares are x
+ * if the result depends on an x or z bit.
+ */
+inline vec4 eq4(const vec4&l, const vec4&r)
+{
+      u64 unk = l.b | r.b;
+      if ((l.a ^ r.a) & ~unk) return v4(0);
+      if (unk) return v4(1, 1);
+      return v4(1);
+}
+
+inline vec4 ne4(const vec4&l, const vec4&r)
+{
+      u64 unk = l.b | r.b;
+      if ((l.a ^ r.a) & ~unk) return v4(1);
+      if (unk) return v4(1, 1);
+      return v4(0);
+}
+
+/* The ==? compare, where the x and z bits of r match any bit. */
+inline vec4 weq4(const vec4&l, const vec4&r)
+{
+      u64 unk = l.b & ~r.b;
+      if ((l.a ^ r.a) & ~r.b & ~unk) return v4(0);
+      if (unk) return v4(1, 1);
+      return v4(1);
+}
+
+inline bool lt2(u64 l, u64 r, unsigned wid, bool sgn)
+{
+      if (sgn) return (s64)sext(l, wid) < (s64)sext(r, wid);
+      return l < r;
+}
+
+inline vec4 lt4(const vec4&l, const vec4&r, unsigned wid, bool sgn)
+{
+      if (l.b | r.b) return v4(1, 1);
+      return v4(lt2(l.a, r.a, wid, sgn));
+}
+
+inline vec4 le4(const vec4&l, const vec4&r, unsigned wid, bool sgn)
+{
+      if (l.b | r.b) return v4(1, 1);
+      return v4(! lt2(r.a, l.a, wid, sgn));
+}
+
+/*
+ * The truth of a vector as a 1 bit vector: 1 if any bit is 1, 0 if
+ * all the bits are 0 and x otherwise. This is also the OR reduction.
+ */
+inline vec4 truth4(const vec4&v)
+{
+      if (v.a & ~v.b) return v4(1);
+      if (v.b) return v4(1, 1);
+      return v4(0);
+}
+
+/* The conditions of if and while statements are true only for 1. */
+inline bool test4(const vec4&v) { return (v.a & ~v.b) != 0; }
+
+inline vec4 lnot4(const vec4&v)
+{
+      vec4 tmp = truth4(v);
+      return v4(tmp.a ^ (tmp.b ^ 1), tmp.b);
+}
+
+inline vec4 land4(const vec4&l, const vec4&r)
+{
+      vec4 lt = truth4(l), rt = truth4(r);
+      if ((lt.a == 0) || (rt.a == 0)) return v4(0);
+      return v4(1, lt.b | rt.b);
+}
+
+inline vec4 lor4(const vec4&l, const vec4&r)
+{
+      vec4 lt = truth4(l), rt = truth4(r);
+      if ((lt.a & ~lt.b) || (rt.a & ~rt.b)) return v4(1);
+      return v4(lt.a | rt.a, lt.b | rt.b);
+}
+
+inline vec4 rand4(const vec4&v, unsigned wid)
+{
+      if (~v.a & ~v.b & mask(wid)) return v4(0);
+      if (v.b) return v4(1, 1);
+      return v4(1);
+}
+
+inline bool parity(u64 v)
+{
+      v ^= v >> 32;
+      v ^= v >> 16;
+      v ^= v >> 8;
+      v ^= v >> 4;
+      v ^= v >> 2;
+      v ^= v >> 1;
+      return (v & 1) != 0;
+}
+
+inline vec4 rxor4(const vec4&v)
+{
+      if (v.b) return v4(1, 1);
+      return v4(parity(v.a));
+}
+
+/*
+ * Shifts. The shift amount is unsigned, and an x or z in the amount
+ * makes the whole result x.
+ */
+inline u64 shl2(u64 v, u64 n, unsigned wid)
+{
+      if (n >= wid) return 0;
+      return (v << n) & mask(wid);
+}
+
+inline u64 shr2(u64 v, u64 n)
+{
+      if (n >= 64) return 0;
+      return v >> n;
+}
+
+inline u64 ashr2(u64 v, u64 n, unsigned wid)
+{
+      if (n >= 64) n = 63;
+      return (u64)((s64)sext(v, wid) >> n) & mask(wid);
+}
+
+inline vec4 shl4(const vec4&v, const vec4&n, unsigned wid)
+{
+      if (n.b) return x4(wid);
+      return v4(shl2(v.a, n.a, wid), shl2(v.b, n.a, wid));
+}
+
+inline vec4 shr4(const vec4&v, const vec4&n, unsigned wid)
+{
+      if (n.b) return x4(wid);
+      return v4(shr2(v.a, n.a), shr2(v.b, n.a));
+}
+
+inline vec4 ashr4(const vec4&v, const vec4&n, unsigned wid)
+{
+      if (n.b) return x4(wid);
+      return v4(ashr2(v.a, n.a, wid), ashr2(v.b, n.a, wid));
+}
+
+/*
+ * Select wid bits starting at bit off of a vector that is vwid bits
+ * wide. The bits outside the vector read as x (0 in 2-state).
+ */
+inline u64 part2(u64 v, unsigned vwid, s64 off, unsigned wid)
+{
+      u64 valid = bits_mask(-off, (s64)vwid - off) & mask(wid);
+      return shift_down(v, off) & valid;
+}
+
+inline vec4 part4(const vec4&v, unsigned vwid, s64 off, unsigned wid)
+{
+      u64 valid = bits_mask(-off, (s64)vwid - off) & mask(wid);
+      u64 inv = mask(wid) & ~valid;
+      return v4((shift_down(v.a, off) & valid) | inv,
+		(shift_down(v.b, off) & valid) | inv);
+}
+
+/*
+ * Convert an index or part select base to an integer. An index with
+ * x or z bits is BAD_INDEX, which is outside of every vector.
+ */
+const s64 BAD_INDEX = -((s64)1 << 62);
+
+inline s64 index2(u64 v, unsigned wid, bool sgn)
+{
+      return sgn? (s64)sext(v, wid) : (s64)v;
+}
+
+inline s64 index4(const vec4&v, unsigned wid, bool sgn)
+{
+      if (v.b) return BAD_INDEX;
+      return index2(v.a, wid, sgn);
+}
+
+/*
+ * Read a word of an array. The words outside the array read as x
+ * (0 in 2-state).
+ */
+inline u64 word2(const u64*arr, unsigned count, s64 idx)
+{
+      if (idx < 0 || idx >= (s64)count) return 0;
+      return arr[idx];
+}
+
+inline vec4 word4(const vec4*arr, unsigned count, s64 idx, unsigned wid)
+{
+      if (idx < 0 || idx >= (s64)count) return x4(wid);
+      return arr[idx];
+}
+
+/* Write val into wid bits at off of a vector that is vwid bits wide. */
+inline u64 merge2(u64 old, u64 val, s64 off, unsigned wid, unsigned vwid)
+{
+      u64 sel = bits_mask(off, off + (s64)wid) & mask(vwid);
+      return (old & ~sel) | (shift_down(val, -off) & sel);
+}
+
+inline vec4 merge4(const vec4&old, const vec4&val, s64 off, unsigned wid,
+		   unsigned vwid)
+{
+      return v4(merge2(old.a, val.a, off, wid, vwid),
+		merge2(old.b, val.b, off, wid, vwid));
+}
+
+inline vec4 cat4(const vec4&hi, const vec4&lo, unsigned lwid)
+{
+      return v4(shift_down(hi.a, -(s64)lwid) | lo.a,
+		shift_down(hi.b, -(s64)lwid) | lo.b);
+}
+
+inline u64 repeat2(u64 v, unsigned wid, unsigned count)
+{
+      u64 res = 0;
+      for (unsigned idx = 0 ; idx < count ; idx += 1)
+	    res = shift_down(res, -(s64)wid) | v;
+      return res;
+}
+
+inline vec4 repeat4(const vec4&v, unsigned wid, unsigned count)
+{
+      return v4(repeat2(v.a, wid, count), repeat2(v.b, wid, count));
+}
+
+/*
+ * The ?: operator with a condition that is x or z merges the two
+ * values, with x for the bits that differ.
+ */
+inline vec4 mux4(const vec4&cond, const vec4&t, const vec4&f)
+{
+      vec4 sel = truth4(cond);
+      if (sel.b == 0)
+	    return sel.a? t : f;
+      u64 diff = (t.a ^ f.a) | (t.b ^ f.b);
+      return v4(t.a | diff, t.b | diff);
+}
+
+/*
+ * Case item compares. A casez ignores the z bits of either value and
+ * a casex ignores the x and z bits.
+ */
+inline bool casez_eq(const vec4&l, const vec4&r)
+{
+      u64 dont = (l.b & ~l.a) | (r.b & ~r.a);
+      return (((l.a ^ r.a) | (l.b ^ r.b)) & ~dont) == 0;
+}
+
+inline bool casex_eq(const vec4&l, const vec4&r)
+{
+      u64 dont = l.b | r.b;
+      return ((l.a ^ r.a) & ~dont) == 0;
+}
+
+/*
+ * A process is a function that resumes at the case label in pc each
+ * time the scheduler runs it, and returns when the process waits or
+ * ends. The gen is incremented each time the process is woken, so
+ * that the other events that it was waiting for ignore it.
+ */
+struct proc_s {
+      explicit proc_s(void (*fn)(proc_s*)) : run(fn), pc(0), gen(0) { }
+      void (*run)(proc_s*);
+      unsigned pc;
+      unsigned long gen;
+};
+
+struct waiter_s {
+      proc_s*proc;
+      unsigned long gen;
+};
+
+struct event_s {
+      event_s() : purge(16) { }
+      std::vector<waiter_s> waiters;
+      size_t purge;
+};
+
+/*
+ * A node is a piece of continuous logic that computes the value of a
+ * net. When an input of a node changes, the node is queued at its
+ * level, and the queued nodes are evaluated lowest level first.
+ */
+struct node_s {
+      void (*eval)(void);
+      unsigned level;
+      bool queued;
+};
+
+enum edge_t { ANYEDGE = 0, POSEDGE = 1, NEGEDGE = 2 };
+
+struct probe_s {
+      event_s*event;
+      edge_t edge;
+};
+
+/*
+ * The events and nodes that watch a vector. Both lists end with a
+ * nil entry.
+ */
+struct watch_s {
+      const probe_s*probes;
+      node_s*const*nodes;
+};
+
+/* The vectors that have watchers carry them along with the value. */
+struct sig2 {
+      u64 val;
+      const watch_s*watch;
+};
+
+struct sig4 {
+      vec4 val;
+      const watch_s*watch;
+};
+
+/*
+ * A non-blocking assignment waiting for its time. The apply function
+ * knows the type of the destination.
+ */
+struct nba_s {
+      void (*apply)(const nba_s&);
+      void*dst;
+      vec4 val;
+      s64 off;
+      unsigned wid, vwid;
+};
+
+struct slot_s {
+      std::vector<proc_s*> procs;
+      std::vector<nba_s> nbas;
+};
+
+/*
+ * The scheduler state. The model is a single source file, so these
+ * are defined right here.
+ */
+static u64 sim_time = 0;
+static bool sim_finished = false;
+static std::deque<proc_s*> sched_active;
+static std::vector<proc_s*> sched_inactive;
+static std::vector<nba_s> sched_nba;
+static std::map<u64,slot_s> sched_time;
+static std::vector<void (*)(void)> sched_strobe;
+static std::vector<proc_s*> sched_final;
+static std::vector<std::vector<node_s*> > node_queue;
+static size_t node_count = 0;
+static unsigned node_low = 0;
+
+inline void queue_node(node_s*node)
+{
+      if (node->queued)
+	    return;
+      node->queued = true;
+      if (node->level >= node_queue.size())
+	    node_queue.resize(node->level + 1);
+      node_queue[node->level].push_back(node);
+      if (node_count == 0 || node->level < node_low)
+	    node_low = node->level;
+      node_count += 1;
+}
+
+inline void settle(void)
+{
+      while (node_count > 0) {
+	    while (node_queue[node_low].empty())
+		  node_low += 1;
+	    node_s*node = node_queue[node_low].back();
+	    node_queue[node_low].pop_back();
+	    node_count -= 1;
+	    node->queued = false;
+	    node->eval();
+      }
+}
+
+/*
+ * The simulation time in units that are scale ticks, rounded to the
+ * nearest unit as the $time function does.
+ */
+inline u64 scaled_time(u64 scale)
+{
+      return (sim_time + scale/2) / scale;
+}
+
+inline void activate(proc_s*proc)
+{
+      sched_active.push_back(proc);
+}
+
+inline void delay(proc_s*proc, u64 dly)
+{
+      if (dly == 0)
+	    sched_inactive.push_back(proc);
+      else
+	    sched_time[sim_time + dly].procs.push_back(proc);
+}
+
+inline void wait(proc_s*proc, event_s*evt)
+{
+	/* Drop the waiters that other events already woke, so that
+	   an event that never triggers does not grow forever. */
+      if (evt->waiters.size() >= evt->purge) {
+	    size_t keep = 0;
+	    for (size_t idx = 0 ; idx < evt->waiters.size() ; idx += 1) {
+		  if (evt->waiters[idx].gen == evt->waiters[idx].proc->gen)
+			evt->waiters[keep++] = evt->waiters[idx];
+	    }
+	    evt->waiters.resize(keep);
+	    evt->purge = 2*keep + 16;
+      }
+
+      waiter_s cur;
+      cur.proc = proc;
+      cur.gen = proc->gen;
+      evt->waiters.push_back(cur);
+}
+
+inline void trigger(event_s*evt)
+{
+      for (size_t idx = 0 ; idx < evt->waiters.size() ; idx += 1) {
+	    proc_s*proc = evt->waiters[idx].proc;
+	    if (evt->waiters[idx].gen != proc->gen)
+		  continue;
+	    proc->gen += 1;
+	    sched_active.push_back(proc);
+      }
+      evt->waiters.clear();
+}
+
+/*
+ * The least significant bit of a vector as 0, 1, 2 (x) or 3 (z),
+ * for the edge detection.
+ */
+inline unsigned lsb4(const vec4&v)
+{
+      return (unsigned)(((v.b & 1) << 1) | ((v.a ^ v.b) & 1));
+}
+
+inline void notify(const watch_s*watch, unsigned obit, unsigned nbit)
+{
+      for (const probe_s*cur = watch->probes ; cur->event ; cur += 1) {
+	    switch (cur->edge) {
+		case ANYEDGE:
+		  break;
+		case POSEDGE:
+		  if ((obit == 0 && nbit != 0) || (obit >= 2 && nbit == 1))
+			break;
+		  continue;
+		case NEGEDGE:
+		  if ((obit == 1 && nbit != 1) || (obit >= 2 && nbit == 0))
+			break;
+		  continue;
+	    }
+	    trigger(cur->event);
+      }
+      for (node_s*const*cur = watch->nodes ; *cur ; cur += 1)
+	    queue_node(*cur);
+}
+
+inline void set(sig2&sig, u64 val)
+{
+      if (sig.val == val)
+	    return;
+      unsigned obit = (unsigned)(sig.val & 1);
+      sig.val = val;
+      notify(sig.watch, obit, (unsigned)(val & 1));
+}
+
+inline void set(sig4&sig, const vec4&val)
+{
+      if (sig.val == val)
+	    return;
+      unsigned obit = lsb4(sig.val);
+      sig.val = val;
+      notify(sig.watch, obit, lsb4(val));
+}
+
+inline void apply_var2(const nba_s&nba)
+{
+      u64*dst = static_cast<u64*>(nba.dst);
+      *dst = merge2(*dst, nba.val.a, nba.off, nba.wid, nba.vwid);
+}
+
+inline void apply_var4(const nba_s&nba)
+{
+      vec4*dst = static_cast<vec4*>(nba.dst);
+      *dst = merge4(*dst, nba.val, nba.off, nba.wid, nba.vwid);
+}
+
+inline void apply_sig2(const nba_s&nba)
+{
+      sig2*dst = static_cast<sig2*>(nba.dst);
+      set(*dst, merge2(dst->val, nba.val.a, nba.off, nba.wid, nba.vwid));
+}
+
+inline void apply_sig4(const nba_s&nba)
+{
+      sig4*dst = static_cast<sig4*>(nba.dst);
+      set(*dst, merge4(dst->val, nba.val, nba.off, nba.wid, nba.vwid));
+}
+
+inline void queue_nba(void (*fn)(const nba_s&), void*dst, const vec4&val,
+		      s64 off, unsigned wid, unsigned vwid, u64 dly)
+{
+      nba_s nba;
+      nba.apply = fn;
+      nba.dst = dst;
+      nba.val = val;
+      nba.off = off;
+      nba.wid = wid;
+      nba.vwid = vwid;
+      if (dly == 0)
+	    sched_nba.push_back(nba);
+      else
+	    sched_time[sim_time + dly].nbas.push_back(nba);
+}
+
+/*
+ * Schedule a non-blocking assignment of wid bits at off of the vwid
+ * bit vector dst. The whole vector is off 0 and wid vwid.
+ */
+inline void assign_nb(u64*dst, u64 val, s64 off, unsigned wid,
+		      unsigned vwid, u64 dly)
+{
+      queue_nba(&apply_var2, dst, v4(val), off, wid, vwid, dly);
+}
+
+inline void assign_nb(vec4*dst, const vec4&val, s64 off, unsigned wid,
+		      unsigned vwid, u64 dly)
+{
+      queue_nba(&apply_var4, dst, val, off, wid, vwid, dly);
+}
+
+inline void assign_nb(sig2*dst, u64 val, s64 off, unsigned wid,
+		      unsigned vwid, u64 dly)
+{
+      queue_nba(&apply_sig2, dst, v4(val), off, wid, vwid, dly);
+}
+
+inline void assign_nb(sig4*dst, const vec4&val, s64 off, unsigned wid,
+		      unsigned vwid, u64 dly)
+{
+      queue_nba(&apply_sig4, dst, val, off, wid, vwid, dly);
+}
+
+inline void strobe(void (*fn)(void))
+{
+      sched_strobe.push_back(fn);
+}
+
+inline void finish(void)
+{
+      sim_finished = true;
+}
+
+inline void add_final(proc_s*proc)
+{
+      sched_final.push_back(proc);
+}
+
+/*
+ * Run the simulation until there is nothing left to do or $finish
+ * is called, then run the final blocks.
+ */
+inline int run(void)
+{
+      while (! sim_finished) {
+	    for (;;) {
+		  if (node_count > 0) {
+			settle();
+
+		  } else if (! sched_active.empty()) {
+			proc_s*proc = sched_active.front();
+			sched_active.pop_front();
+			proc->run(proc);
+			if (sim_finished)
+			      break;
+
+		  } else if (! sched_inactive.empty()) {
+			sched_active.insert(sched_active.end(),
+					    sched_inactive.begin(),
+					    sched_inactive.end());
+			sched_inactive.clear();
+
+		  } else if (! sched_nba.empty()) {
+			std::vector<nba_s> list;
+			list.swap(sched_nba);
+			for (size_t idx = 0 ; idx < list.size() ; idx += 1)
+			      list[idx].apply(list[idx]);
+
+		  } else {
+			break;
+		  }
+	    }
+
+	    if (sim_finished)
+		  break;
+
+	    if (! sched_strobe.empty()) {
+		  std::vector<void (*)(void)> list;
+		  list.swap(sched_strobe);
+		  for (size_t idx = 0 ; idx < list.size() ; idx += 1)
+			(list[idx])();
+	    }
+
+	    if (sched_time.empty())
+		  break;
+
+	    std::map<u64,slot_s>::iterator cur = sched_time.begin();
+	    sim_time = cur->first;
+	    sched_active.insert(sched_active.end(), cur->second.procs.begin(),
+				cur->second.procs.end());
+	    sched_nba.swap(cur->second.nbas);
+	    sched_time.erase(cur);
+      }
+
+      sim_finished = false;
+      for (size_t idx = 0 ; idx < sched_final.size() ; idx += 1) {
+	    sched_final[idx]->run(sched_final[idx]);
+	    if (sim_finished)
+		  break;
+      }
+
+      return 0;
+}
+
+/*
+ * $random without a seed argument keeps its seed here. This is the
+ * uniform distribution of IEEE1364-2001, as in the vvp run time.
+ */
+static long random_seed = 0;
+
+inline long random32(long&seed)
+{
+      unsigned long oldseed = (unsigned long)seed;
+      if (oldseed == 0)
+	    oldseed = 259341593;
+      unsigned long newseed = (69069 * oldseed + 1) & 4294967295UL;
+      seed = (long)newseed;
+
+      double a = -2147483648.0;
+      double b = 2147483647.0;
+      double c = 1.0 + (newseed >> 9) * 0.00000011920928955078125;
+      c = c + (c * 0.00000011920928955078125);
+      c = ((b - a) * (c - 1.0)) + a;
+
+      double r = (c + 2147483648.0) / 4294967295.0;
+      r = r * 4294967296.0 - 2147483648.0;
+      if (r >= 0)
+	    return (long)(unsigned long)r;
+      return -(long)(unsigned long)(-(r - 1));
+}
+
+inline u64 random2(void)
+{
+      return (u64)random32(random_seed) & mask(32);
+}
+
+/* $random with a seed variable writes the new seed back to it. */
+inline u64 random2(u64*seed, unsigned wid)
+{
+      long tmp = (long)sext(*seed, wid);
+      u64 res = (u64)random32(tmp) & mask(32);
+      *seed = (u64)tmp & mask(wid);
+      return res;
+}
+
+inline u64 random2(vec4*seed, unsigned wid)
+{
+      long tmp = (long)sext(to2(*seed), wid);
+      u64 res = (u64)random32(tmp) & mask(32);
+      *seed = v4((u64)tmp & mask(wid));
+      return res;
+}
+
+inline u64 random2(sig2*seed, unsigned wid)
+{
+      long tmp = (long)sext(seed->val, wid);
+      u64 res = (u64)random32(tmp) & mask(32);
+      set(*seed, (u64)tmp & mask(wid));
+      return res;
+}
+
+inline u64 random2(sig4*seed, unsigned wid)
+{
+      long tmp = (long)sext(to2(seed->val), wid);
+      u64 res = (u64)random32(tmp) & mask(32);
+      set(*seed, v4((u64)tmp & mask(wid)));
+      return res;
+}
+
+/*
+ * Formatting for the $display tasks. The code generator parses the
+ * format strings, so these only convert single values. The width is
+ * -1 if the format did not give one, and zero is true if the format
+ * starts with a 0, as in %0d.
+ */
+inline void justify(std::string&out, const std::string&text, int width,
+		    bool left)
+{
+      if (! left && (int)text.size() < width)
+	    out.append(width - text.size(), ' ');
+      out += text;
+      if (left && (int)text.size() < width)
+	    out.append(width - text.size(), ' ');
+}
+
+/*
+ * The digit for bits lo to lo+cnt-1 of a vector, with x and z for
+ * all x or z bits and X or Z for some.
+ */
+inline char digit4(const vec4&v, unsigned lo, unsigned cnt)
+{
+      u64 sel = mask(cnt);
+      u64 a = (v.a >> lo) & sel;
+      u64 b = (v.b >> lo) & sel;
+      u64 xb = a & b;
+      u64 zb = ~a & b & sel;
+      if (zb == sel) return 'z';
+      if (xb == sel) return 'x';
+      if (xb) return 'X';
+      if (zb) return 'Z';
+      return "0123456789abcdef"[a];
+}
+
+inline void format_radix(std::string&out, const vec4&v, unsigned wid,
+			 unsigned bits, int width, bool zero, bool left)
+{
+      std::string text;
+      unsigned cnt = (wid + bits - 1) / bits;
+      for (unsigned idx = cnt ; idx > 0 ; idx -= 1) {
+	    unsigned lo = (idx-1) * bits;
+	    unsigned use = wid - lo < bits? wid - lo : bits;
+	    text += digit4(v, lo, use);
+      }
+
+      if (zero) {
+	    if (width == -1) {
+		  size_t skip = 0;
+		  while (skip+1 < text.size() && text[skip] == '0')
+			skip += 1;
+		  text.erase(0, skip);
+	    } else if (! left && (int)text.size() < width) {
+		  text.insert(0, width - text.size(), '0');
+	    } else if (left) {
+		  size_t skip = 0;
+		  while (skip+1 < text.size() && text[skip] == '0')
+			skip += 1;
+		  text.erase(0, skip);
+	    }
+      }
+      justify(out, text, width, left);
+}
+
+/* The default width of a decimal value, as the vvp $display uses. */
+inline int dec_size(unsigned wid, bool sgn)
+{
+      if (sgn) wid -= 1;
+      int res = (int)((wid * 146L + 484) / 485);
+      if (sgn) res += 1;
+      return res;
+}
+
+inline void format_dec(std::string&out, const vec4&v, unsigned wid, bool sgn,
+		       int width, bool zero, bool left)
+{
+      std::string text;
+      u64 sel = mask(wid);
+      u64 xb = v.a & v.b;
+      u64 zb = ~v.a & v.b & sel;
+      if (xb == sel && wid > 0) {
+	    text = "x";
+      } else if (xb) {
+	    text = "X";
+      } else if (zb == sel && wid > 0) {
+	    text = "z";
+      } else if (zb) {
+	    text = "Z";
+      } else {
+	    u64 val = v.a;
+	    bool neg = false;
+	    if (sgn && wid > 0 && ((val >> (wid-1)) & 1)) {
+		  neg = true;
+		  val = (~sext(val, wid)) + 1;
+	    }
+	    char buf[24];
+	    int pos = sizeof buf;
+	    buf[--pos] = 0;
+	    do {
+		  buf[--pos] = '0' + (char)(val % 10);
+		  val /= 10;
+	    } while (val != 0);
+	    text = buf + pos;
+	    if (zero && ! left && (int)text.size() + (neg? 1 : 0) < width)
+		  text.insert(0, width - text.size() - (neg? 1 : 0), '0');
+	    if (neg)
+		  text.insert(0, 1, '-');
+      }
+
+      if (width == -1)
+	    width = zero? 0 : dec_size(wid, sgn);
+      justify(out, text, width, left);
+}
+
+inline void format_char(std::string&out, const vec4&v, int width, bool left)
+{
+      std::string text (1, (char)(to2(v) & 0xff));
+      justify(out, text, width, left);
+}
+
+inline void format_str(std::string&out, const vec4&v, unsigned wid,
+		       int width, bool zero, bool left)
+{
+      std::string text;
+      u64 val = to2(v);
+      for (unsigned idx = (wid + 7) / 8 ; idx > 0 ; idx -= 1) {
+	    char ch = (char)((val >> (8*(idx-1))) & 0xff);
+	    if (ch != 0)
+		  text += ch;
+      }
+      if (width == -1)
+	    width = zero? 0 : (int)(wid + 7) / 8;
+      justify(out, text, width, left);
+}
+
+/*
+ * The %t format of a time in the units of the calling scope. The
+ * shift is the number of digits between those units and the units
+ * of the format, which are the precision of the design.
+ */
+inline void format_time(std::string&out, const vec4&v, unsigned wid,
+			unsigned shift, int width, bool zero, bool left)
+{
+      std::string text;
+      format_dec(text, v, wid, false, 0, false, false);
+      if (text != "0" && v.b == 0)
+	    text.append(shift, '0');
+      if (zero && width == -1)
+	    width = 0;
+      else if (zero && ! left && (int)text.size() < width)
+	    text.insert(0, width - text.size(), '0');
+      if (width == -1)
+	    width = 20;
+      justify(out, text, width, left);
+}
+
+inline void print(const std::string&text)
+{
+      fwrite(text.data(), 1, text.size(), stdout);
+}
+
+}
+
+#endif /* IVL_cxx_runtime_H */
@@ -0,0 +1,46 @@
+/*
+ * A small clocked design for the cxx target: an 8 bit LFSR feeds an
+ * accumulator and a 64 bit rotating mixer. Generate, compile and run
+ * the model with:
+ *
+ *    iverilog -tcxx -olfsr.cc lfsr.v
+ *    c++ -O2 -o lfsr lfsr.cc
+ *    ./lfsr
+ *
+ * and the output should match lfsr.gold.
+ */
+module top;
+
+   reg clk;
+   reg [7:0] lfsr;
+   reg [15:0] acc;
+   reg [63:0] mix;
+
+   wire fb = lfsr[7] ^ lfsr[5] ^ lfsr[4] ^ lfsr[3];
+   wire [15:0] sum = acc + {8'h00, lfsr};
+
+   initial begin
+      clk = 0;
+      lfsr = 8'h01;
+      acc = 0;
+      mix = 64'h0123456789abcdef;
+   end
+
+   always #5 clk = ~clk;
+
+   always @(posedge clk) begin
+      lfsr <= {lfsr[6:0], fb};
+      acc <= sum;
+      mix <= {mix[62:0], mix[63]} ^ {56'd0, lfsr};
+   end
+
+   initial begin
+      #10;
+      repeat (8) begin
+	 $display("%0t: lfsr=%h acc=%0d mix=%h", $time, lfsr, acc, mix);
+	 #10;
+      end
+      $finish;
+   end
+
+endmodule
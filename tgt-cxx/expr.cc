@@ -0,0 +1,747 @@
+/*
+ * Copyright (c) 2016 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "config.h"
+# include  "cxx_priv.h"
+# include  <cstring>
+
+/*
+ * Expressions are written as C++ expressions. An expression that can
+ * only have 2-state values (all its leaves are 2-state) is computed
+ * with u64 values, and the others with vec4 values. The value of an
+ * expression always has the width of the expression, with the bits
+ * above that width 0.
+ */
+
+static unsigned long long mask_of(unsigned wid)
+{
+      return wid >= 64? ~0ULL : (1ULL << wid) - 1;
+}
+
+static bool number_has_xz(ivl_expr_t expr)
+{
+      const char*bits = ivl_expr_bits(expr);
+      for (unsigned idx = 0 ; idx < ivl_expr_width(expr) ; idx += 1) {
+	    if (bits[idx] != '0' && bits[idx] != '1')
+		  return true;
+      }
+      return false;
+}
+
+bool number_value(ivl_expr_t expr, unsigned long long&val)
+{
+      switch (ivl_expr_type(expr)) {
+	  case IVL_EX_NUMBER: {
+		if (number_has_xz(expr) || ivl_expr_width(expr) > 64)
+		      return false;
+		const char*bits = ivl_expr_bits(expr);
+		val = 0;
+		for (unsigned idx = 0 ; idx < ivl_expr_width(expr) ; idx += 1) {
+		      if (bits[idx] == '1')
+			    val |= 1ULL << idx;
+		}
+		return true;
+	  }
+	  case IVL_EX_ULONG:
+	    val = ivl_expr_uvalue(expr);
+	    return true;
+	  case IVL_EX_DELAY:
+	    val = ivl_expr_delay_val(expr);
+	    return true;
+	  default:
+	    return false;
+      }
+}
+
+/*
+ * The compiler writes the characters of a string that are not
+ * printable as \ooo octal escapes.
+ */
+std::string string_text(ivl_expr_t expr)
+{
+      const char*cp = ivl_expr_string(expr);
+      std::string res;
+      while (*cp) {
+	    if (cp[0] == '\\' && cp[1] && cp[2] && cp[3]) {
+		  res += (char)((cp[1]-'0')*64 + (cp[2]-'0')*8 + (cp[3]-'0'));
+		  cp += 4;
+	    } else {
+		  res += *cp;
+		  cp += 1;
+	    }
+      }
+      return res;
+}
+
+bool expr_is2(ivl_expr_t expr)
+{
+      switch (ivl_expr_type(expr)) {
+	  case IVL_EX_NUMBER:
+	    return cxx_two_state || ! number_has_xz(expr);
+	  case IVL_EX_STRING:
+	  case IVL_EX_ULONG:
+	  case IVL_EX_DELAY:
+	  case IVL_EX_SFUNC:
+	    return true;
+
+	  case IVL_EX_SIGNAL: {
+		ivl_signal_t sig = ivl_expr_signal(expr);
+		if (ivl_signal_dimensions(sig) > 0 && ivl_expr_oper1(expr)
+		    && ! expr_is2(ivl_expr_oper1(expr)))
+		      return false;
+		return cxx_two_state || ivl_signal_data_type(sig) == IVL_VT_BOOL;
+	  }
+
+	  case IVL_EX_SELECT:
+	    if (ivl_expr_oper2(expr) && ! expr_is2(ivl_expr_oper2(expr)))
+		  return false;
+	    return expr_is2(ivl_expr_oper1(expr));
+
+	  case IVL_EX_BINARY:
+	      /* The 4-state divide by zero is x. */
+	    if (! cxx_two_state && (ivl_expr_opcode(expr) == '/'
+				    || ivl_expr_opcode(expr) == '%'
+				    || ivl_expr_opcode(expr) == 'p'))
+		  return false;
+	    return expr_is2(ivl_expr_oper1(expr)) && expr_is2(ivl_expr_oper2(expr));
+
+	  case IVL_EX_UNARY:
+	    if (ivl_expr_opcode(expr) == '2')
+		  return true;
+	    return expr_is2(ivl_expr_oper1(expr));
+
+	  case IVL_EX_TERNARY:
+	    return expr_is2(ivl_expr_oper1(expr)) && expr_is2(ivl_expr_oper2(expr))
+		  && expr_is2(ivl_expr_oper3(expr));
+
+	  case IVL_EX_CONCAT:
+	    for (unsigned idx = 0 ; idx < ivl_expr_parms(expr) ; idx += 1) {
+		  if (! expr_is2(ivl_expr_parm(expr, idx)))
+			return false;
+	    }
+	    return true;
+
+	  case IVL_EX_UFUNC: {
+		ivl_scope_t def = ivl_expr_def(expr);
+		return cxx_two_state || ivl_signal_data_type(ivl_scope_port(def, 0))
+		      == IVL_VT_BOOL;
+	  }
+
+	  default:
+	    return false;
+      }
+}
+
+static std::string expr2(ivl_expr_t expr);
+static std::string expr4(ivl_expr_t expr);
+
+std::string emit_expr(ivl_expr_t expr, bool want2)
+{
+      if (ivl_expr_width(expr) > 64) {
+	    cxx_sorry(ivl_expr_file(expr), ivl_expr_lineno(expr),
+		      "Expressions wider than 64 bits are not supported.");
+	    return want2? "0" : "cxx_rt::v4(0)";
+      }
+      switch (ivl_expr_value(expr)) {
+	  case IVL_VT_BOOL:
+	  case IVL_VT_LOGIC:
+	    break;
+	  default:
+	    cxx_sorry(ivl_expr_file(expr), ivl_expr_lineno(expr),
+		      "Expressions that are not vectors are not supported.");
+	    return want2? "0" : "cxx_rt::v4(0)";
+      }
+
+      if (expr_is2(expr)) {
+	    if (want2) return expr2(expr);
+	    return "cxx_rt::v4(" + expr2(expr) + ")";
+      }
+      if (want2) return "cxx_rt::to2(" + expr4(expr) + ")";
+      return expr4(expr);
+}
+
+/*
+ * Resize the value of the expression to wid bits, with a sign
+ * extension if sext is true.
+ */
+static std::string pad_to(ivl_expr_t expr, unsigned wid, bool sext, bool want2)
+{
+      unsigned ewid = ivl_expr_width(expr);
+      std::string val = emit_expr(expr, want2);
+      if (ewid == wid || (ewid < wid && ! sext))
+	    return val;
+      return cxx_printf("cxx_rt::pad%c(%s, %u, %u, %s)", want2? '2' : '4',
+			val.c_str(), ewid, wid, sext? "true" : "false");
+}
+
+std::string emit_expr_pad(ivl_expr_t expr, unsigned wid, bool want2)
+{
+      return pad_to(expr, wid, ivl_expr_signed(expr) != 0, want2);
+}
+
+/*
+ * An index or part select base as an s64, which is BAD_INDEX if the
+ * value has x or z bits.
+ */
+std::string emit_index(ivl_expr_t expr)
+{
+      unsigned long long val;
+      unsigned wid = ivl_expr_width(expr);
+      bool sgn = ivl_expr_signed(expr) != 0;
+      if (wid <= 64 && number_value(expr, val)) {
+	    long long off = sgn && wid < 64 && ((val >> (wid-1)) & 1)
+		  ? (long long)(val | ~mask_of(wid)) : (long long)val;
+	    return cxx_printf("%lldLL", off);
+      }
+
+      if (expr_is2(expr))
+	    return cxx_printf("cxx_rt::index2(%s, %u, %s)",
+			      emit_expr(expr, true).c_str(), wid,
+			      sgn? "true" : "false");
+      return cxx_printf("cxx_rt::index4(%s, %u, %s)", emit_expr(expr, false).c_str(),
+			wid, sgn? "true" : "false");
+}
+
+std::string emit_binary_op(char op, const std::string&lval, const std::string&rval,
+			   unsigned wid, bool sgn, bool is2)
+{
+      const char*l = lval.c_str();
+      const char*r = rval.c_str();
+      const char*s = sgn? "true" : "false";
+      std::string mask = cxx_literal(mask_of(wid));
+      const char*m = mask.c_str();
+
+      if (is2) switch (op) {
+	  case '+':
+	  case '-':
+	  case '*':
+	    if (wid >= 64)
+		  return cxx_printf("(%s %c %s)", l, op, r);
+	    return cxx_printf("((%s %c %s) & %s)", l, op, r, m);
+	  case '/':
+	    return cxx_printf("cxx_rt::div2(%s, %s, %u, %s)", l, r, wid, s);
+	  case '%':
+	    return cxx_printf("cxx_rt::mod2(%s, %s, %u, %s)", l, r, wid, s);
+	  case '&':
+	  case '|':
+	  case '^':
+	    return cxx_printf("(%s %c %s)", l, op, r);
+	  case 'A':
+	    return cxx_printf("(~(%s & %s) & %s)", l, r, m);
+	  case 'O':
+	    return cxx_printf("(~(%s | %s) & %s)", l, r, m);
+	  case 'X':
+	    return cxx_printf("(~(%s ^ %s) & %s)", l, r, m);
+	  case 'e':
+	  case 'E':
+	  case 'w':
+	    return cxx_printf("(cxx_rt::u64)(%s == %s)", l, r);
+	  case 'n':
+	  case 'N':
+	  case 'W':
+	    return cxx_printf("(cxx_rt::u64)(%s != %s)", l, r);
+	  case '<':
+	    return cxx_printf("(cxx_rt::u64)cxx_rt::lt2(%s, %s, %u, %s)", l, r, wid, s);
+	  case '>':
+	    return cxx_printf("(cxx_rt::u64)cxx_rt::lt2(%s, %s, %u, %s)", r, l, wid, s);
+	  case 'L':
+	    return cxx_printf("(cxx_rt::u64)!cxx_rt::lt2(%s, %s, %u, %s)", r, l, wid, s);
+	  case 'G':
+	    return cxx_printf("(cxx_rt::u64)!cxx_rt::lt2(%s, %s, %u, %s)", l, r, wid, s);
+	  case 'a':
+	    return cxx_printf("(cxx_rt::u64)(%s != 0 && %s != 0)", l, r);
+	  case 'o':
+	    return cxx_printf("(cxx_rt::u64)(%s != 0 || %s != 0)", l, r);
+	  case 'l':
+	    return cxx_printf("cxx_rt::shl2(%s, %s, %u)", l, r, wid);
+	  case 'r':
+	    return cxx_printf("cxx_rt::shr2(%s, %s)", l, r);
+	  case 'R':
+	    return cxx_printf("cxx_rt::ashr2(%s, %s, %u)", l, r, wid);
+	  default:
+	    return "";
+      }
+
+      switch (op) {
+	  case '+':
+	    return cxx_printf("cxx_rt::add4(%s, %s, %u)", l, r, wid);
+	  case '-':
+	    return cxx_printf("cxx_rt::sub4(%s, %s, %u)", l, r, wid);
+	  case '*':
+	    return cxx_printf("cxx_rt::mul4(%s, %s, %u)", l, r, wid);
+	  case '/':
+	    return cxx_printf("cxx_rt::div4(%s, %s, %u, %s)", l, r, wid, s);
+	  case '%':
+	    return cxx_printf("cxx_rt::mod4(%s, %s, %u, %s)", l, r, wid, s);
+	  case '&':
+	    return cxx_printf("cxx_rt::and4(%s, %s)", l, r);
+	  case '|':
+	    return cxx_printf("cxx_rt::or4(%s, %s)", l, r);
+	  case '^':
+	    return cxx_printf("cxx_rt::xor4(%s, %s)", l, r);
+	  case 'A':
+	    return cxx_printf("cxx_rt::not4(cxx_rt::and4(%s, %s), %u)", l, r, wid);
+	  case 'O':
+	    return cxx_printf("cxx_rt::not4(cxx_rt::or4(%s, %s), %u)", l, r, wid);
+	  case 'X':
+	    return cxx_printf("cxx_rt::not4(cxx_rt::xor4(%s, %s), %u)", l, r, wid);
+	  case 'e':
+	    return cxx_printf("cxx_rt::eq4(%s, %s)", l, r);
+	  case 'n':
+	    return cxx_printf("cxx_rt::ne4(%s, %s)", l, r);
+	  case 'E':
+	    return cxx_printf("cxx_rt::v4(%s == %s)", l, r);
+	  case 'N':
+	    return cxx_printf("cxx_rt::v4(%s != %s)", l, r);
+	  case 'w':
+	    return cxx_printf("cxx_rt::weq4(%s, %s)", l, r);
+	  case 'W':
+	    return cxx_printf("cxx_rt::not4(cxx_rt::weq4(%s, %s), 1)", l, r);
+	  case '<':
+	    return cxx_printf("cxx_rt::lt4(%s, %s, %u, %s)", l, r, wid, s);
+	  case '>':
+	    return cxx_printf("cxx_rt::lt4(%s, %s, %u, %s)", r, l, wid, s);
+	  case 'L':
+	    return cxx_printf("cxx_rt::le4(%s, %s, %u, %s)", l, r, wid, s);
+	  case 'G':
+	    return cxx_printf("cxx_rt::le4(%s, %s, %u, %s)", r, l, wid, s);
+	  case 'a':
+	    return cxx_printf("cxx_rt::land4(%s, %s)", l, r);
+	  case 'o':
+	    return cxx_printf("cxx_rt::lor4(%s, %s)", l, r);
+	  case 'l':
+	    return cxx_printf("cxx_rt::shl4(%s, %s, %u)", l, r, wid);
+	  case 'r':
+	    return cxx_printf("cxx_rt::shr4(%s, %s, %u)", l, r, wid);
+	  case 'R':
+	    return cxx_printf("cxx_rt::ashr4(%s, %s, %u)", l, r, wid);
+	  default:
+	    return "";
+      }
+}
+
+static std::string emit_binary(ivl_expr_t expr, bool is2)
+{
+      ivl_expr_t le = ivl_expr_oper1(expr);
+      ivl_expr_t re = ivl_expr_oper2(expr);
+      unsigned wid = ivl_expr_width(expr);
+      bool sgn = ivl_expr_signed(expr) != 0;
+      char op = ivl_expr_opcode(expr);
+
+      switch (op) {
+	  case 'e':
+	  case 'n':
+	  case 'E':
+	  case 'N':
+	  case 'w':
+	  case 'W':
+	  case '<':
+	  case '>':
+	  case 'L':
+	  case 'G': {
+		unsigned cwid = ivl_expr_width(le);
+		if (ivl_expr_width(re) > cwid)
+		      cwid = ivl_expr_width(re);
+		bool csgn = ivl_expr_signed(le) && ivl_expr_signed(re);
+		return emit_binary_op(op, pad_to(le, cwid, csgn, is2),
+				      pad_to(re, cwid, csgn, is2), cwid, csgn, is2);
+	  }
+
+	  case 'a':
+	  case 'o':
+	    return emit_binary_op(op, emit_expr(le, is2), emit_expr(re, is2),
+				  wid, sgn, is2);
+
+	  case 'l':
+	  case 'r':
+	  case 'R':
+	    if (op == 'R' && ! sgn)
+		  op = 'r';
+	    return emit_binary_op(op, emit_expr_pad(le, wid, is2),
+				  emit_expr(re, is2), wid, sgn, is2);
+
+	  case 'p':
+	    return cxx_printf("cxx_rt::pow%c(%s, %s, %u, %u, %u, %s, %s)",
+			      is2? '2' : '4', emit_expr_pad(le, wid, is2).c_str(),
+			      emit_expr(re, is2).c_str(), wid, ivl_expr_width(re),
+			      wid, ivl_expr_signed(le)? "true" : "false",
+			      ivl_expr_signed(re)? "true" : "false");
+
+	  case '+':
+	  case '-':
+	  case '*':
+	  case '/':
+	  case '%':
+	  case '&':
+	  case '|':
+	  case '^':
+	  case 'A':
+	  case 'O':
+	  case 'X':
+	    return emit_binary_op(op, emit_expr_pad(le, wid, is2),
+				  emit_expr_pad(re, wid, is2), wid, sgn, is2);
+
+	  default:
+	    cxx_sorry(ivl_expr_file(expr), ivl_expr_lineno(expr),
+		      "Binary operator %c is not supported.", op);
+	    return is2? "0" : "cxx_rt::v4(0)";
+      }
+}
+
+static std::string emit_unary(ivl_expr_t expr, bool is2)
+{
+      ivl_expr_t sub = ivl_expr_oper1(expr);
+      unsigned wid = ivl_expr_width(expr);
+      unsigned swid = ivl_expr_width(sub);
+      std::string mask = cxx_literal(mask_of(wid));
+      std::string smask = cxx_literal(mask_of(swid));
+      char op = ivl_expr_opcode(expr);
+
+      if (op == '2') {
+	    std::string val = pad_to(sub, wid, ivl_expr_signed(sub) != 0, true);
+	    return is2? val : "cxx_rt::v4(" + val + ")";
+      }
+
+      if (is2) switch (op) {
+	  case '~':
+	    return "(~" + emit_expr_pad(sub, wid, true) + " & " + mask + ")";
+	  case '-':
+	    return "((0 - " + emit_expr_pad(sub, wid, true) + ") & " + mask + ")";
+	  case 'm':
+	    return cxx_printf("cxx_rt::abs2(%s, %u)",
+			      emit_expr_pad(sub, wid, true).c_str(), wid);
+	  case '!':
+	  case 'N':
+	    return "(cxx_rt::u64)(" + emit_expr(sub, true) + " == 0)";
+	  case '|':
+	    return "(cxx_rt::u64)(" + emit_expr(sub, true) + " != 0)";
+	  case '&':
+	    return "(cxx_rt::u64)(" + emit_expr(sub, true) + " == " + smask + ")";
+	  case 'A':
+	    return "(cxx_rt::u64)(" + emit_expr(sub, true) + " != " + smask + ")";
+	  case '^':
+	    return "(cxx_rt::u64)cxx_rt::parity(" + emit_expr(sub, true) + ")";
+	  case 'X':
+	    return "(cxx_rt::u64)!cxx_rt::parity(" + emit_expr(sub, true) + ")";
+	  default:
+	    break;
+
+      } else switch (op) {
+	  case '~':
+	    return cxx_printf("cxx_rt::not4(%s, %u)",
+			      emit_expr_pad(sub, wid, false).c_str(), wid);
+	  case '-':
+	    return cxx_printf("cxx_rt::neg4(%s, %u)",
+			      emit_expr_pad(sub, wid, false).c_str(), wid);
+	  case 'm':
+	    return cxx_printf("cxx_rt::abs4(%s, %u)",
+			      emit_expr_pad(sub, wid, false).c_str(), wid);
+	  case '!':
+	  case 'N':
+	    return "cxx_rt::lnot4(" + emit_expr(sub, false) + ")";
+	  case '|':
+	    return "cxx_rt::truth4(" + emit_expr(sub, false) + ")";
+	  case '&':
+	    return cxx_printf("cxx_rt::rand4(%s, %u)", emit_expr(sub, false).c_str(),
+			      swid);
+	  case 'A':
+	    return cxx_printf("cxx_rt::not4(cxx_rt::rand4(%s, %u), 1)",
+			      emit_expr(sub, false).c_str(), swid);
+	  case '^':
+	    return "cxx_rt::rxor4(" + emit_expr(sub, false) + ")";
+	  case 'X':
+	    return "cxx_rt::not4(cxx_rt::rxor4(" + emit_expr(sub, false) + "), 1)";
+	  default:
+	    break;
+      }
+
+      cxx_sorry(ivl_expr_file(expr), ivl_expr_lineno(expr),
+		"Unary operator %c is not supported.", op);
+      return is2? "0" : "cxx_rt::v4(0)";
+}
+
+static std::string emit_signal(ivl_expr_t expr, bool is2)
+{
+      cxx_var var;
+      if (! signal_var(ivl_expr_signal(expr), var, ivl_expr_file(expr),
+		       ivl_expr_lineno(expr)))
+	    return is2? "0" : "cxx_rt::v4(0)";
+
+      if (var.count == 0)
+	    return var_value(var, is2);
+
+      std::string word;
+      if (var.two_state)
+	    word = cxx_printf("cxx_rt::word2(%s, %u, %s)", var.name.c_str(),
+			      var.count, emit_index(ivl_expr_oper1(expr)).c_str());
+      else
+	    word = cxx_printf("cxx_rt::word4(%s, %u, %s, %u)", var.name.c_str(),
+			      var.count, emit_index(ivl_expr_oper1(expr)).c_str(),
+			      var.wid);
+      if (is2 && ! var.two_state)
+	    return "cxx_rt::to2(" + word + ")";
+      if (! is2 && var.two_state)
+	    return "cxx_rt::v4(" + word + ")";
+      return word;
+}
+
+/*
+ * A select with no base is a pad or truncate of the value, and the
+ * others are part selects that may be out of range.
+ */
+static std::string emit_select(ivl_expr_t expr, bool is2)
+{
+      ivl_expr_t sub = ivl_expr_oper1(expr);
+      ivl_expr_t base = ivl_expr_oper2(expr);
+      unsigned wid = ivl_expr_width(expr);
+      unsigned swid = ivl_expr_width(sub);
+
+      if (base == 0)
+	    return pad_to(sub, wid, ivl_expr_signed(expr) != 0, is2);
+
+      std::string val = emit_expr(sub, is2);
+      std::string off = emit_index(base);
+      unsigned long long cval;
+      if (is2 && number_value(base, cval) && cval + wid <= swid) {
+	    if (cval == 0 && wid == swid)
+		  return val;
+	    return cxx_printf("((%s >> %llu) & %s)", val.c_str(), cval,
+			      cxx_literal(mask_of(wid)).c_str());
+      }
+      return cxx_printf("cxx_rt::part%c(%s, %u, %s, %u)", is2? '2' : '4',
+			val.c_str(), swid, off.c_str(), wid);
+}
+
+static std::string emit_concat(ivl_expr_t expr, bool is2)
+{
+      std::string res;
+      unsigned wid = 0;
+      for (unsigned idx = 0 ; idx < ivl_expr_parms(expr) ; idx += 1) {
+	    ivl_expr_t sub = ivl_expr_parm(expr, idx);
+	    unsigned swid = ivl_expr_width(sub);
+	    if (swid == 0)
+		  continue;
+	    std::string val = emit_expr(sub, is2);
+	    if (wid == 0)
+		  res = val;
+	    else if (is2)
+		  res = cxx_printf("((%s << %u) | %s)", res.c_str(), swid, val.c_str());
+	    else
+		  res = cxx_printf("cxx_rt::cat4(%s, %s, %u)", res.c_str(),
+				   val.c_str(), swid);
+	    wid += swid;
+      }
+
+      if (wid == 0)
+	    return is2? "0" : "cxx_rt::v4(0)";
+      unsigned repeat = ivl_expr_repeat(expr);
+      if (repeat != 1)
+	    res = cxx_printf("cxx_rt::repeat%c(%s, %u, %u)", is2? '2' : '4',
+			     res.c_str(), wid, repeat);
+      return res;
+}
+
+static std::string emit_number(ivl_expr_t expr, bool is2)
+{
+      const char*bits = ivl_expr_bits(expr);
+      unsigned long long a = 0, b = 0;
+      for (unsigned idx = 0 ; idx < ivl_expr_width(expr) ; idx += 1) {
+	    switch (bits[idx]) {
+		case '1': a |= 1ULL << idx; break;
+		case 'x': a |= 1ULL << idx; b |= 1ULL << idx; break;
+		case 'z': b |= 1ULL << idx; break;
+		default: break;
+	    }
+      }
+      if (is2)
+	    return cxx_literal(a & ~b);
+      if (b == 0)
+	    return "cxx_rt::v4(" + cxx_literal(a) + ")";
+      return "cxx_rt::v4(" + cxx_literal(a) + ", " + cxx_literal(b) + ")";
+}
+
+static std::string emit_string(ivl_expr_t expr)
+{
+      std::string text = string_text(expr);
+      if (text.size() > 8) {
+	    cxx_sorry(ivl_expr_file(expr), ivl_expr_lineno(expr),
+		      "Strings longer than 8 characters are only supported "
+		      "as formats.");
+	    return "0";
+      }
+      unsigned long long val = 0;
+      for (size_t idx = 0 ; idx < text.size() ; idx += 1)
+	    val = (val << 8) | (unsigned char)text[idx];
+      return cxx_literal(val);
+}
+
+static unsigned long long time_scale(void)
+{
+      unsigned long long scale = 1;
+      for (int idx = ivl_scope_time_units(cxx_scope) ; idx > cxx_precision ; idx -= 1)
+	    scale *= 10;
+      return scale;
+}
+
+static std::string emit_sfunc(ivl_expr_t expr)
+{
+      const char*name = ivl_expr_name(expr);
+      unsigned nparms = ivl_expr_parms(expr);
+
+      if (strcmp(name, "$time") == 0 && nparms == 0)
+	    return cxx_printf("cxx_rt::scaled_time(%s)",
+			      cxx_literal(time_scale()).c_str());
+      if (strcmp(name, "$stime") == 0 && nparms == 0)
+	    return cxx_printf("(cxx_rt::scaled_time(%s) & 0xffffffffULL)",
+			      cxx_literal(time_scale()).c_str());
+      if (strcmp(name, "$simtime") == 0 && nparms == 0)
+	    return "cxx_rt::sim_time";
+
+      if (strcmp(name, "$random") == 0 && nparms == 0)
+	    return "cxx_rt::random2()";
+      if (strcmp(name, "$random") == 0 && nparms == 1) {
+	    ivl_expr_t seed = ivl_expr_parm(expr, 0);
+	    cxx_var var;
+	    if (ivl_expr_type(seed) == IVL_EX_SIGNAL
+		&& signal_var(ivl_expr_signal(seed), var, ivl_expr_file(expr),
+			      ivl_expr_lineno(expr))
+		&& var.count == 0) {
+		  return cxx_printf("cxx_rt::random2(&%s, %u)", var.name.c_str(),
+				    var.wid);
+	    }
+	    cxx_sorry(ivl_expr_file(expr), ivl_expr_lineno(expr),
+		      "The $random seed must be a variable.");
+	    return "0";
+      }
+
+      cxx_sorry(ivl_expr_file(expr), ivl_expr_lineno(expr),
+		"System function %s is not supported.", name);
+      return "0";
+}
+
+/*
+ * A function call writes the arguments to the input ports of the
+ * function, calls it and then reads the return value.
+ */
+static std::string emit_ufunc(ivl_expr_t expr, bool is2)
+{
+      ivl_scope_t def = ivl_expr_def(expr);
+      const char*file = ivl_expr_file(expr);
+      unsigned lineno = ivl_expr_lineno(expr);
+      std::string res = "(";
+
+      if (ivl_scope_is_auto(def)) {
+	    cxx_sorry(file, lineno, "Automatic functions are not supported.");
+	    return is2? "0" : "cxx_rt::v4(0)";
+      }
+
+      for (unsigned idx = 0 ; idx < ivl_expr_parms(expr) ; idx += 1) {
+	    cxx_var port;
+	    if (! signal_var(ivl_scope_port(def, idx+1), port, file, lineno))
+		  return is2? "0" : "cxx_rt::v4(0)";
+	    std::string val = emit_expr_pad(ivl_expr_parm(expr, idx), port.wid,
+					    port.two_state);
+	    res += var_store(port, val) + ", ";
+      }
+
+      cxx_var ret;
+      if (! signal_var(ivl_scope_port(def, 0), ret, file, lineno))
+	    return is2? "0" : "cxx_rt::v4(0)";
+      res += function_name(def) + "(), " + var_value(ret, is2) + ")";
+      return res;
+}
+
+static std::string expr2(ivl_expr_t expr)
+{
+      switch (ivl_expr_type(expr)) {
+	  case IVL_EX_NUMBER:
+	    return emit_number(expr, true);
+	  case IVL_EX_STRING:
+	    return emit_string(expr);
+	  case IVL_EX_ULONG:
+	    return cxx_literal(ivl_expr_uvalue(expr));
+	  case IVL_EX_DELAY:
+	    return cxx_literal(ivl_expr_delay_val(expr));
+	  case IVL_EX_SIGNAL:
+	    return emit_signal(expr, true);
+	  case IVL_EX_SELECT:
+	    return emit_select(expr, true);
+	  case IVL_EX_BINARY:
+	    return emit_binary(expr, true);
+	  case IVL_EX_UNARY:
+	    return emit_unary(expr, true);
+	  case IVL_EX_CONCAT:
+	    return emit_concat(expr, true);
+	  case IVL_EX_SFUNC:
+	    return emit_sfunc(expr);
+	  case IVL_EX_UFUNC:
+	    return emit_ufunc(expr, true);
+	  case IVL_EX_TERNARY: {
+		unsigned wid = ivl_expr_width(expr);
+		return cxx_printf("(%s != 0? %s : %s)",
+				  emit_expr(ivl_expr_oper1(expr), true).c_str(),
+				  emit_expr_pad(ivl_expr_oper2(expr), wid, true).c_str(),
+				  emit_expr_pad(ivl_expr_oper3(expr), wid, true).c_str());
+	  }
+	  default:
+	    cxx_sorry(ivl_expr_file(expr), ivl_expr_lineno(expr),
+		      "Expression type %d is not supported.",
+		      (int)ivl_expr_type(expr));
+	    return "0";
+      }
+}
+
+static std::string expr4(ivl_expr_t expr)
+{
+      switch (ivl_expr_type(expr)) {
+	  case IVL_EX_NUMBER:
+	    return emit_number(expr, false);
+	  case IVL_EX_SIGNAL:
+	    return emit_signal(expr, false);
+	  case IVL_EX_SELECT:
+	    return emit_select(expr, false);
+	  case IVL_EX_BINARY:
+	    return emit_binary(expr, false);
+	  case IVL_EX_UNARY:
+	    return emit_unary(expr, false);
+	  case IVL_EX_CONCAT:
+	    return emit_concat(expr, false);
+	  case IVL_EX_UFUNC:
+	    return emit_ufunc(expr, false);
+	  case IVL_EX_TERNARY: {
+		ivl_expr_t cond = ivl_expr_oper1(expr);
+		unsigned wid = ivl_expr_width(expr);
+		std::string tval = emit_expr_pad(ivl_expr_oper2(expr), wid, false);
+		std::string fval = emit_expr_pad(ivl_expr_oper3(expr), wid, false);
+		  /* Only a condition that may be x needs both values. */
+		if (expr_is2(cond))
+		      return cxx_printf("(%s != 0? %s : %s)",
+					emit_expr(cond, true).c_str(),
+					tval.c_str(), fval.c_str());
+		return cxx_printf("cxx_rt::mux4(%s, %s, %s)",
+				  emit_expr(cond, false).c_str(),
+				  tval.c_str(), fval.c_str());
+	  }
+	  default:
+	    cxx_sorry(ivl_expr_file(expr), ivl_expr_lineno(expr),
+		      "Expression type %d is not supported.",
+		      (int)ivl_expr_type(expr));
+	    return "cxx_rt::v4(0)";
+      }
+}
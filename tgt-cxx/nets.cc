@@ -0,0 +1,1058 @@
+/*
+ * Copyright (c) 2016 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "config.h"
+# include  "cxx_priv.h"
+# include  <map>
+# include  <vector>
+# include  <cassert>
+
+/*
+ * The structural part of the design is modeled with holders and
+ * nodes. A holder is the value of a nexus, so all the signals that are
+ * connected together share one holder. A node is a gate or an LPM
+ * device that drives a holder, and is evaluated again each time one
+ * of the holders that it reads changes.
+ *
+ * The nodes are given levels so that the run time evaluates a node
+ * after the nodes that drive it, and the nodes that are in a loop get
+ * levels above all the others.
+ */
+
+struct cxx_node;
+
+struct cxx_holder {
+      unsigned id;
+      unsigned wid;
+      bool two_state;
+	// The bits of a constant driver, LSB first, or empty.
+      std::string init;
+	// The value of a net that nothing drives: z, 0 or 1.
+      char undriven;
+      bool is_var;
+      cxx_node*driver;
+      std::vector<cxx_node*> readers;
+      std::vector<std::pair<unsigned,const char*> > probes;
+
+      bool watched() const { return !readers.empty() || !probes.empty(); }
+};
+
+struct cxx_node {
+      unsigned id;
+      ivl_net_logic_t log;
+      ivl_lpm_t lpm;
+	// The PART_PV devices that together drive the output.
+      std::vector<ivl_lpm_t> parts;
+      cxx_holder*out;
+      std::vector<cxx_holder*> in;
+      unsigned level;
+};
+
+struct cxx_array {
+      unsigned id;
+      unsigned wid;
+      unsigned count;
+      bool two_state;
+};
+
+static std::vector<cxx_holder*> holders;
+static std::vector<cxx_node*> nodes;
+static std::map<ivl_signal_t,cxx_array*> arrays;
+static std::map<ivl_event_t,unsigned> events;
+
+static bool supported_type(ivl_variable_type_t type)
+{
+      return type == IVL_VT_BOOL || type == IVL_VT_LOGIC;
+}
+
+static unsigned lpm_q_width(ivl_lpm_t lpm)
+{
+      switch (ivl_lpm_type(lpm)) {
+	  case IVL_LPM_CMP_EEQ:
+	  case IVL_LPM_CMP_EQ:
+	  case IVL_LPM_CMP_EQX:
+	  case IVL_LPM_CMP_EQZ:
+	  case IVL_LPM_CMP_GE:
+	  case IVL_LPM_CMP_GT:
+	  case IVL_LPM_CMP_NE:
+	  case IVL_LPM_CMP_NEE:
+	  case IVL_LPM_RE_AND:
+	  case IVL_LPM_RE_NAND:
+	  case IVL_LPM_RE_NOR:
+	  case IVL_LPM_RE_OR:
+	  case IVL_LPM_RE_XNOR:
+	  case IVL_LPM_RE_XOR:
+	    return 1;
+	  default:
+	    return ivl_lpm_width(lpm);
+      }
+}
+
+/*
+ * The width of a nexus that has no signals, from the constant, gate
+ * or LPM that drives it.
+ */
+static unsigned driver_width(ivl_nexus_t nex)
+{
+      for (unsigned idx = 0 ; idx < ivl_nexus_ptrs(nex) ; idx += 1) {
+	    ivl_nexus_ptr_t ptr = ivl_nexus_ptr(nex, idx);
+	    if (ivl_net_const_t con = ivl_nexus_ptr_con(ptr))
+		  return ivl_const_width(con);
+	    if (ivl_nexus_ptr_pin(ptr) != 0)
+		  continue;
+	    if (ivl_net_logic_t log = ivl_nexus_ptr_log(ptr))
+		  return ivl_logic_width(log);
+	    if (ivl_lpm_t lpm = ivl_nexus_ptr_lpm(ptr))
+		  return lpm_q_width(lpm);
+      }
+      return 0;
+}
+
+static void holder_drivers(cxx_holder*hold, ivl_nexus_t nex)
+{
+      for (unsigned idx = 0 ; idx < ivl_nexus_ptrs(nex) ; idx += 1) {
+	    ivl_nexus_ptr_t ptr = ivl_nexus_ptr(nex, idx);
+	    ivl_net_const_t con = ivl_nexus_ptr_con(ptr);
+	    if (con == 0)
+		  continue;
+
+	    if (! supported_type(ivl_const_type(con))
+		|| ivl_const_width(con) != hold->wid) {
+		  cxx_sorry(ivl_const_file(con), ivl_const_lineno(con),
+			    "Constant driver is not a vector of the net width.");
+		  continue;
+	    }
+	    if (! hold->init.empty()) {
+		  cxx_sorry(ivl_const_file(con), ivl_const_lineno(con),
+			    "Net has more than one constant driver.");
+		  continue;
+	    }
+	    hold->init.assign(ivl_const_bits(con), hold->wid);
+      }
+}
+
+/*
+ * Get the holder for the nexus, making it the first time. The width
+ * comes from the signals of the nexus, or from wid if there are none.
+ * Return nil if the nexus cannot be modeled, for example because it
+ * is a word of an array or too wide.
+ */
+static cxx_holder* holder_of_nexus(ivl_nexus_t nex, unsigned wid,
+				   const char*file, unsigned lineno)
+{
+      if (cxx_holder*hold = static_cast<cxx_holder*>(ivl_nexus_get_private(nex)))
+	    return hold;
+
+      bool two_state = true;
+      bool is_var = false;
+      bool have_sig = false;
+      char undriven = 'z';
+      for (unsigned idx = 0 ; idx < ivl_nexus_ptrs(nex) ; idx += 1) {
+	    ivl_signal_t sig = ivl_nexus_ptr_sig(ivl_nexus_ptr(nex, idx));
+	    if (sig == 0)
+		  continue;
+
+	    if (ivl_signal_dimensions(sig) > 0) {
+		  cxx_sorry(file, lineno, "Array word %s is connected to a net.",
+			    ivl_signal_basename(sig));
+		  return 0;
+	    }
+	    if (! supported_type(ivl_signal_data_type(sig))) {
+		  cxx_sorry(file, lineno, "Signal %s is not a 2-state or "
+			    "4-state vector.", ivl_signal_basename(sig));
+		  return 0;
+	    }
+	    if (! have_sig)
+		  wid = ivl_signal_width(sig);
+	    have_sig = true;
+	    if (ivl_signal_data_type(sig) != IVL_VT_BOOL)
+		  two_state = false;
+	    switch (ivl_signal_type(sig)) {
+		case IVL_SIT_REG:
+		  is_var = true;
+		  break;
+		case IVL_SIT_TRI0:
+		  undriven = '0';
+		  break;
+		case IVL_SIT_TRI1:
+		  undriven = '1';
+		  break;
+		default:
+		  break;
+	    }
+      }
+
+      if (! have_sig && wid == 0)
+	    wid = driver_width(nex);
+      if (wid == 0 || wid > 64) {
+	    cxx_sorry(file, lineno, "Vectors wider than 64 bits are not "
+		      "supported.");
+	    return 0;
+      }
+
+      cxx_holder*hold = new cxx_holder;
+      hold->id = holders.size();
+      hold->wid = wid;
+      hold->two_state = two_state || cxx_two_state;
+      hold->undriven = undriven;
+      hold->is_var = is_var;
+      hold->driver = 0;
+      holders.push_back(hold);
+      ivl_nexus_set_private(nex, hold);
+
+      holder_drivers(hold, nex);
+      return hold;
+}
+
+static cxx_array* array_of_signal(ivl_signal_t sig, const char*file,
+				  unsigned lineno)
+{
+      std::map<ivl_signal_t,cxx_array*>::const_iterator cur = arrays.find(sig);
+      if (cur != arrays.end())
+	    return cur->second;
+
+      if (ivl_signal_dimensions(sig) > 1) {
+	    cxx_sorry(file, lineno, "Array %s has more than one dimension.",
+		      ivl_signal_basename(sig));
+	    return 0;
+      }
+
+      cxx_array*arr = new cxx_array;
+      arr->id = arrays.size();
+      arr->wid = ivl_signal_width(sig);
+      arr->count = ivl_signal_array_count(sig);
+      arr->two_state = ivl_signal_data_type(sig) == IVL_VT_BOOL || cxx_two_state;
+      arrays[sig] = arr;
+      return arr;
+}
+
+bool signal_var(ivl_signal_t sig, cxx_var&var, const char*file, unsigned lineno)
+{
+      if (! supported_type(ivl_signal_data_type(sig))) {
+	    cxx_sorry(file, lineno, "Signal %s is not a 2-state or 4-state "
+		      "vector.", ivl_signal_basename(sig));
+	    return false;
+      }
+      if (ivl_signal_width(sig) > 64) {
+	    cxx_sorry(file, lineno, "Signal %s is wider than 64 bits.",
+		      ivl_signal_basename(sig));
+	    return false;
+      }
+
+      if (ivl_signal_dimensions(sig) > 0) {
+	    cxx_array*arr = array_of_signal(sig, file, lineno);
+	    if (arr == 0)
+		  return false;
+	    var.name = cxx_printf("A%u", arr->id);
+	    var.wid = arr->wid;
+	    var.count = arr->count;
+	    var.two_state = arr->two_state;
+	    var.watched = false;
+	    return true;
+      }
+
+      cxx_holder*hold = holder_of_nexus(ivl_signal_nex(sig, 0), 0, file, lineno);
+      if (hold == 0)
+	    return false;
+      var.name = cxx_printf("H%u", hold->id);
+      var.wid = hold->wid;
+      var.count = 0;
+      var.two_state = hold->two_state;
+      var.watched = hold->watched();
+      return true;
+}
+
+std::string var_value(const cxx_var&var, bool want2)
+{
+      std::string val = var.watched? var.name + ".val" : var.name;
+      if (want2 && ! var.two_state)
+	    return "cxx_rt::to2(" + val + ")";
+      if (! want2 && var.two_state)
+	    return "cxx_rt::v4(" + val + ")";
+      return val;
+}
+
+std::string var_store(const cxx_var&var, const std::string&val)
+{
+      if (var.watched)
+	    return "cxx_rt::set(" + var.name + ", " + val + ")";
+      return var.name + " = " + val;
+}
+
+unsigned event_id(ivl_event_t evt)
+{
+      std::map<ivl_event_t,unsigned>::const_iterator cur = events.find(evt);
+      if (cur != events.end())
+	    return cur->second;
+      unsigned id = events.size();
+      events[evt] = id;
+      return id;
+}
+
+static cxx_node* make_node(cxx_holder*out, const char*file, unsigned lineno)
+{
+      if (out->driver) {
+	    cxx_sorry(file, lineno, "Net has more than one driver.");
+	    return 0;
+      }
+      if (! out->init.empty()) {
+	    cxx_sorry(file, lineno, "Net has a constant and another driver.");
+	    return 0;
+      }
+
+      cxx_node*node = new cxx_node;
+      node->id = nodes.size();
+      node->log = 0;
+      node->lpm = 0;
+      node->out = out;
+      node->level = 0;
+      out->driver = node;
+      nodes.push_back(node);
+      return node;
+}
+
+static bool node_input(cxx_node*node, ivl_nexus_t nex, unsigned wid,
+		       const char*file, unsigned lineno)
+{
+      cxx_holder*hold = holder_of_nexus(nex, wid, file, lineno);
+      if (hold == 0)
+	    return false;
+      node->in.push_back(hold);
+      hold->readers.push_back(node);
+      return true;
+}
+
+static bool zero_delay(ivl_expr_t dly)
+{
+      if (dly == 0)
+	    return true;
+      unsigned long long val;
+      return number_value(dly, val) && val == 0;
+}
+
+static void scan_logic(ivl_net_logic_t log)
+{
+      const char*file = ivl_logic_file(log);
+      unsigned lineno = ivl_logic_lineno(log);
+      unsigned wid = ivl_logic_width(log);
+
+      switch (ivl_logic_type(log)) {
+	  case IVL_LO_AND:
+	  case IVL_LO_NAND:
+	  case IVL_LO_OR:
+	  case IVL_LO_NOR:
+	  case IVL_LO_XOR:
+	  case IVL_LO_XNOR:
+	  case IVL_LO_NOT:
+	  case IVL_LO_BUF:
+	  case IVL_LO_BUFZ:
+	  case IVL_LO_BUFT:
+	  case IVL_LO_BUFIF0:
+	  case IVL_LO_BUFIF1:
+	  case IVL_LO_NOTIF0:
+	  case IVL_LO_NOTIF1:
+	  case IVL_LO_PULLUP:
+	  case IVL_LO_PULLDOWN:
+	    break;
+	  default:
+	    cxx_sorry(file, lineno, "Gate type %d is not supported.",
+		      (int)ivl_logic_type(log));
+	    return;
+      }
+
+      if (! zero_delay(ivl_logic_delay(log, 0))) {
+	    cxx_sorry(file, lineno, "Gate delays are not supported.");
+	    return;
+      }
+
+      cxx_holder*out = holder_of_nexus(ivl_logic_pin(log, 0), wid, file, lineno);
+      if (out == 0)
+	    return;
+      cxx_node*node = make_node(out, file, lineno);
+      if (node == 0)
+	    return;
+      node->log = log;
+      for (unsigned idx = 1 ; idx < ivl_logic_pins(log) ; idx += 1)
+	    node_input(node, ivl_logic_pin(log, idx), wid, file, lineno);
+}
+
+static void scan_lpm(ivl_lpm_t lpm)
+{
+      const char*file = ivl_lpm_file(lpm);
+      unsigned lineno = ivl_lpm_lineno(lpm);
+      unsigned ndata = 0;
+
+      switch (ivl_lpm_type(lpm)) {
+	  case IVL_LPM_ABS:
+	  case IVL_LPM_CAST_INT2:
+	  case IVL_LPM_PART_VP:
+	  case IVL_LPM_PART_PV:
+	  case IVL_LPM_REPEAT:
+	  case IVL_LPM_RE_AND:
+	  case IVL_LPM_RE_NAND:
+	  case IVL_LPM_RE_NOR:
+	  case IVL_LPM_RE_OR:
+	  case IVL_LPM_RE_XNOR:
+	  case IVL_LPM_RE_XOR:
+	  case IVL_LPM_SIGN_EXT:
+	    ndata = 1;
+	    break;
+	  case IVL_LPM_ADD:
+	  case IVL_LPM_SUB:
+	  case IVL_LPM_MULT:
+	  case IVL_LPM_DIVIDE:
+	  case IVL_LPM_MOD:
+	  case IVL_LPM_POW:
+	  case IVL_LPM_CMP_EEQ:
+	  case IVL_LPM_CMP_EQ:
+	  case IVL_LPM_CMP_EQZ:
+	  case IVL_LPM_CMP_GE:
+	  case IVL_LPM_CMP_GT:
+	  case IVL_LPM_CMP_NE:
+	  case IVL_LPM_CMP_NEE:
+	  case IVL_LPM_SHIFTL:
+	  case IVL_LPM_SHIFTR:
+	  case IVL_LPM_SUBSTITUTE:
+	    ndata = 2;
+	    break;
+	  case IVL_LPM_CONCAT:
+	  case IVL_LPM_CONCATZ:
+	  case IVL_LPM_MUX:
+	  case IVL_LPM_UFUNC:
+	    ndata = ivl_lpm_size(lpm);
+	    break;
+	  default:
+	    cxx_sorry(file, lineno, "LPM type %d is not supported.",
+		      (int)ivl_lpm_type(lpm));
+	    return;
+      }
+
+      if (! zero_delay(ivl_lpm_delay(lpm, 0))) {
+	    cxx_sorry(file, lineno, "Net delays are not supported.");
+	    return;
+      }
+
+      cxx_holder*out = holder_of_nexus(ivl_lpm_q(lpm), lpm_q_width(lpm),
+				       file, lineno);
+      if (out == 0)
+	    return;
+
+	/* The parts of a vector are collected in a single node. */
+      cxx_node*node;
+      if (ivl_lpm_type(lpm) == IVL_LPM_PART_PV && out->driver
+	  && ! out->driver->parts.empty()) {
+	    node = out->driver;
+      } else {
+	    node = make_node(out, file, lineno);
+	    if (node == 0)
+		  return;
+      }
+      if (ivl_lpm_type(lpm) == IVL_LPM_PART_PV)
+	    node->parts.push_back(lpm);
+      else
+	    node->lpm = lpm;
+
+      for (unsigned idx = 0 ; idx < ndata ; idx += 1)
+	    node_input(node, ivl_lpm_data(lpm, idx), 0, file, lineno);
+      if (ivl_lpm_type(lpm) == IVL_LPM_MUX)
+	    node_input(node, ivl_lpm_select(lpm), 0, file, lineno);
+}
+
+static void scan_event(ivl_event_t evt)
+{
+      unsigned id = event_id(evt);
+      const char*file = ivl_event_file(evt);
+      unsigned lineno = ivl_event_lineno(evt);
+
+      for (unsigned idx = 0 ; idx < ivl_event_nany(evt) ; idx += 1) {
+	    cxx_holder*hold = holder_of_nexus(ivl_event_any(evt, idx), 0, file, lineno);
+	    if (hold) hold->probes.push_back(std::make_pair(id, "ANYEDGE"));
+      }
+      for (unsigned idx = 0 ; idx < ivl_event_npos(evt) ; idx += 1) {
+	    cxx_holder*hold = holder_of_nexus(ivl_event_pos(evt, idx), 0, file, lineno);
+	    if (hold) hold->probes.push_back(std::make_pair(id, "POSEDGE"));
+      }
+      for (unsigned idx = 0 ; idx < ivl_event_nneg(evt) ; idx += 1) {
+	    cxx_holder*hold = holder_of_nexus(ivl_event_neg(evt, idx), 0, file, lineno);
+	    if (hold) hold->probes.push_back(std::make_pair(id, "NEGEDGE"));
+      }
+}
+
+static int scan_scope(ivl_scope_t scope, void*)
+{
+	/* Make the holders for the signals first, so that they get
+	   their widths and types from the signals. */
+      for (unsigned idx = 0 ; idx < ivl_scope_sigs(scope) ; idx += 1) {
+	    ivl_signal_t sig = ivl_scope_sig(scope, idx);
+	    if (ivl_signal_dimensions(sig) > 0)
+		  continue;
+	    if (! supported_type(ivl_signal_data_type(sig)))
+		  continue;
+	    if (ivl_signal_width(sig) > 64)
+		  continue;
+	    holder_of_nexus(ivl_signal_nex(sig, 0), 0, ivl_signal_file(sig),
+			    ivl_signal_lineno(sig));
+      }
+
+      for (unsigned idx = 0 ; idx < ivl_scope_logs(scope) ; idx += 1)
+	    scan_logic(ivl_scope_log(scope, idx));
+      for (unsigned idx = 0 ; idx < ivl_scope_lpms(scope) ; idx += 1)
+	    scan_lpm(ivl_scope_lpm(scope, idx));
+      for (unsigned idx = 0 ; idx < ivl_scope_events(scope) ; idx += 1)
+	    scan_event(ivl_scope_event(scope, idx));
+      if (ivl_scope_switches(scope) > 0)
+	    cxx_sorry(ivl_scope_file(scope), ivl_scope_lineno(scope),
+		      "Switches (tran and MOS) are not supported.");
+
+      return ivl_scope_children(scope, &scan_scope, 0);
+}
+
+/*
+ * Give the nodes levels by their longest path from a node that reads
+ * only holders that nodes do not drive. The nodes that are left over
+ * are in loops, and they get the next level.
+ */
+static void levelize(void)
+{
+      std::vector<unsigned> pending (nodes.size(), 0);
+      for (size_t idx = 0 ; idx < nodes.size() ; idx += 1) {
+	    cxx_node*node = nodes[idx];
+	    for (size_t pin = 0 ; pin < node->in.size() ; pin += 1) {
+		  if (node->in[pin]->driver)
+			pending[idx] += 1;
+	    }
+      }
+
+      std::vector<cxx_node*> ready;
+      for (size_t idx = 0 ; idx < nodes.size() ; idx += 1) {
+	    if (pending[idx] == 0)
+		  ready.push_back(nodes[idx]);
+      }
+
+      unsigned max_level = 0;
+      size_t done = 0;
+      while (! ready.empty()) {
+	    cxx_node*node = ready.back();
+	    ready.pop_back();
+	    done += 1;
+	    if (node->level > max_level)
+		  max_level = node->level;
+
+	    const std::vector<cxx_node*>&readers = node->out->readers;
+	    for (size_t idx = 0 ; idx < readers.size() ; idx += 1) {
+		  cxx_node*dst = readers[idx];
+		  if (dst->level <= node->level)
+			dst->level = node->level + 1;
+		  pending[dst->id] -= 1;
+		  if (pending[dst->id] == 0)
+			ready.push_back(dst);
+	    }
+      }
+
+      if (done == nodes.size())
+	    return;
+      for (size_t idx = 0 ; idx < nodes.size() ; idx += 1) {
+	    if (pending[idx] != 0)
+		  nodes[idx]->level = max_level + 1;
+      }
+}
+
+void scan_design(ivl_design_t des)
+{
+      ivl_scope_t*roots;
+      unsigned nroots;
+      ivl_design_roots(des, &roots, &nroots);
+      for (unsigned idx = 0 ; idx < nroots ; idx += 1)
+	    scan_scope(roots[idx], 0);
+
+      levelize();
+}
+
+static unsigned long long mask_of(unsigned wid)
+{
+      return wid >= 64? ~0ULL : (1ULL << wid) - 1;
+}
+
+static std::string holder_value(const cxx_holder*hold, bool want2)
+{
+      cxx_var var;
+      var.name = cxx_printf("H%u", hold->id);
+      var.wid = hold->wid;
+      var.count = 0;
+      var.two_state = hold->two_state;
+      var.watched = hold->watched();
+      return var_value(var, want2);
+}
+
+/*
+ * The value of an input of a node, resized to wid bits. Values that
+ * are narrower are padded with zeros, or with the sign bit if sgn is
+ * true.
+ */
+static std::string input_value(const cxx_holder*hold, unsigned wid, bool sgn,
+			       bool want2)
+{
+      std::string val = holder_value(hold, want2);
+      if (hold->wid == wid || (hold->wid < wid && ! sgn))
+	    return val;
+      return cxx_printf("cxx_rt::pad%c(%s, %u, %u, %s)", want2? '2' : '4',
+			val.c_str(), hold->wid, wid, sgn? "true" : "false");
+}
+
+static std::string emit_logic(const cxx_node*node, bool is2)
+{
+      ivl_net_logic_t log = node->log;
+      unsigned wid = ivl_logic_width(log);
+      std::string mask = cxx_literal(mask_of(wid));
+      std::vector<std::string> in;
+      for (size_t idx = 0 ; idx < node->in.size() ; idx += 1)
+	    in.push_back(input_value(node->in[idx], wid, false, is2));
+
+      const char*op2 = 0;
+      const char*op4 = 0;
+      bool invert = false;
+      switch (ivl_logic_type(log)) {
+	  case IVL_LO_NAND:
+	    invert = true;
+	      /* fallthrough */
+	  case IVL_LO_AND:
+	    op2 = " & ";
+	    op4 = "and4";
+	    break;
+	  case IVL_LO_NOR:
+	    invert = true;
+	      /* fallthrough */
+	  case IVL_LO_OR:
+	    op2 = " | ";
+	    op4 = "or4";
+	    break;
+	  case IVL_LO_XNOR:
+	    invert = true;
+	      /* fallthrough */
+	  case IVL_LO_XOR:
+	    op2 = " ^ ";
+	    op4 = "xor4";
+	    break;
+
+	  case IVL_LO_NOT:
+	    if (is2) return "(~" + in[0] + " & " + mask + ")";
+	    return cxx_printf("cxx_rt::not4(%s, %u)", in[0].c_str(), wid);
+	  case IVL_LO_BUF:
+	    if (is2) return in[0];
+	    return "cxx_rt::buf4(" + in[0] + ")";
+	  case IVL_LO_BUFZ:
+	  case IVL_LO_BUFT:
+	    return in[0];
+
+	  case IVL_LO_BUFIF0:
+	  case IVL_LO_BUFIF1:
+	  case IVL_LO_NOTIF0:
+	  case IVL_LO_NOTIF1: {
+		bool on = ivl_logic_type(log) == IVL_LO_BUFIF1
+		      || ivl_logic_type(log) == IVL_LO_NOTIF1;
+		bool inv = ivl_logic_type(log) == IVL_LO_NOTIF0
+		      || ivl_logic_type(log) == IVL_LO_NOTIF1;
+		std::string data = in[0];
+		if (is2) {
+		      if (inv) data = "(~" + data + " & " + mask + ")";
+		      return cxx_printf("((%s & 1) != %s? %s : 0)", in[1].c_str(),
+					on? "0" : "1", data.c_str());
+		}
+		if (inv) data = cxx_printf("cxx_rt::not4(%s, %u)", data.c_str(), wid);
+		return cxx_printf("cxx_rt::bufif4(%s, %s, %s, %u)", data.c_str(),
+				  in[1].c_str(), on? "true" : "false", wid);
+	  }
+
+	  case IVL_LO_PULLUP:
+	    return is2? mask : "cxx_rt::v4(" + mask + ")";
+	  case IVL_LO_PULLDOWN:
+	    return is2? "0" : "cxx_rt::v4(0)";
+
+	  default:
+	    assert(0);
+	    return "";
+      }
+
+      std::string res = in[0];
+      for (size_t idx = 1 ; idx < in.size() ; idx += 1) {
+	    if (is2)
+		  res = "(" + res + op2 + in[idx] + ")";
+	    else
+		  res = cxx_printf("cxx_rt::%s(%s, %s)", op4, res.c_str(),
+				   in[idx].c_str());
+      }
+      if (invert) {
+	    if (is2)
+		  res = "(~" + res + " & " + mask + ")";
+	    else
+		  res = cxx_printf("cxx_rt::not4(%s, %u)", res.c_str(), wid);
+      }
+      return res;
+}
+
+/*
+ * Call a function from a net. The inputs are written to the input
+ * ports of the function, and then the value is read from the return
+ * value port.
+ */
+static std::string emit_ufunc(const cxx_node*node, bool is2)
+{
+      ivl_lpm_t lpm = node->lpm;
+      ivl_scope_t def = ivl_lpm_define(lpm);
+      const char*file = ivl_lpm_file(lpm);
+      unsigned lineno = ivl_lpm_lineno(lpm);
+      std::string res = "(";
+
+      for (size_t idx = 0 ; idx < node->in.size() ; idx += 1) {
+	    cxx_var port;
+	    if (! signal_var(ivl_scope_port(def, idx+1), port, file, lineno))
+		  return "0";
+	    std::string val = input_value(node->in[idx], port.wid, false,
+					  port.two_state);
+	    res += var_store(port, val) + ", ";
+      }
+
+      cxx_var ret;
+      if (! signal_var(ivl_scope_port(def, 0), ret, file, lineno))
+	    return "0";
+      res += function_name(def) + "(), " + var_value(ret, is2) + ")";
+      return res;
+}
+
+static std::string emit_lpm(const cxx_node*node, bool is2)
+{
+      ivl_lpm_t lpm = node->lpm;
+      unsigned wid = ivl_lpm_width(lpm);
+      bool sgn = ivl_lpm_signed(lpm) != 0;
+      const char*sgn_txt = sgn? "true" : "false";
+      std::string mask = cxx_literal(mask_of(wid));
+      const std::vector<cxx_holder*>&in = node->in;
+
+      switch (ivl_lpm_type(lpm)) {
+	  case IVL_LPM_ADD:
+	  case IVL_LPM_SUB:
+	  case IVL_LPM_MULT:
+	  case IVL_LPM_DIVIDE:
+	  case IVL_LPM_MOD: {
+		char op = "+-*/%"[ivl_lpm_type(lpm) == IVL_LPM_ADD? 0
+				  : ivl_lpm_type(lpm) == IVL_LPM_SUB? 1
+				  : ivl_lpm_type(lpm) == IVL_LPM_MULT? 2
+				  : ivl_lpm_type(lpm) == IVL_LPM_DIVIDE? 3 : 4];
+		return emit_binary_op(op, input_value(in[0], wid, sgn, is2),
+				      input_value(in[1], wid, sgn, is2),
+				      wid, sgn, is2);
+	  }
+
+	  case IVL_LPM_POW:
+	    return cxx_printf("cxx_rt::pow%c(%s, %s, %u, %u, %u, %s, %s)",
+			      is2? '2' : '4',
+			      input_value(in[0], wid, sgn, is2).c_str(),
+			      holder_value(in[1], is2).c_str(), wid, in[1]->wid,
+			      wid, sgn_txt, sgn_txt);
+
+	  case IVL_LPM_SHIFTL:
+	    return emit_binary_op('l', input_value(in[0], wid, sgn, is2),
+				  holder_value(in[1], is2), wid, sgn, is2);
+	  case IVL_LPM_SHIFTR:
+	    return emit_binary_op(sgn? 'R' : 'r', input_value(in[0], wid, sgn, is2),
+				  holder_value(in[1], is2), wid, sgn, is2);
+
+	  case IVL_LPM_CMP_EQ:
+	  case IVL_LPM_CMP_NE:
+	  case IVL_LPM_CMP_EEQ:
+	  case IVL_LPM_CMP_NEE:
+	  case IVL_LPM_CMP_GE:
+	  case IVL_LPM_CMP_GT: {
+		char op = 0;
+		switch (ivl_lpm_type(lpm)) {
+		    case IVL_LPM_CMP_EQ:  op = 'e'; break;
+		    case IVL_LPM_CMP_NE:  op = 'n'; break;
+		    case IVL_LPM_CMP_EEQ: op = 'E'; break;
+		    case IVL_LPM_CMP_NEE: op = 'N'; break;
+		    case IVL_LPM_CMP_GE:  op = 'G'; break;
+		    default:              op = '>'; break;
+		}
+		return emit_binary_op(op, input_value(in[0], wid, sgn, is2),
+				      input_value(in[1], wid, sgn, is2),
+				      wid, sgn, is2);
+	  }
+
+	  case IVL_LPM_CMP_EQZ: {
+		std::string res = cxx_printf("cxx_rt::casez_eq(%s, %s)",
+					     input_value(in[0], wid, false, false).c_str(),
+					     input_value(in[1], wid, false, false).c_str());
+		return is2? "(cxx_rt::u64)" + res : "cxx_rt::v4(" + res + ")";
+	  }
+
+	  case IVL_LPM_RE_AND:
+	  case IVL_LPM_RE_NAND:
+	  case IVL_LPM_RE_OR:
+	  case IVL_LPM_RE_NOR:
+	  case IVL_LPM_RE_XOR:
+	  case IVL_LPM_RE_XNOR: {
+		char op = 0;
+		switch (ivl_lpm_type(lpm)) {
+		    case IVL_LPM_RE_AND:  op = '&'; break;
+		    case IVL_LPM_RE_NAND: op = 'A'; break;
+		    case IVL_LPM_RE_OR:   op = '|'; break;
+		    case IVL_LPM_RE_NOR:  op = 'N'; break;
+		    case IVL_LPM_RE_XOR:  op = '^'; break;
+		    default:              op = 'X'; break;
+		}
+		std::string val = holder_value(in[0], is2);
+		unsigned vwid = in[0]->wid;
+		std::string vmask = cxx_literal(mask_of(vwid));
+		if (is2) switch (op) {
+		    case '&': return "(cxx_rt::u64)(" + val + " == " + vmask + ")";
+		    case 'A': return "(cxx_rt::u64)(" + val + " != " + vmask + ")";
+		    case '|': return "(cxx_rt::u64)(" + val + " != 0)";
+		    case 'N': return "(cxx_rt::u64)(" + val + " == 0)";
+		    case '^': return "(cxx_rt::u64)cxx_rt::parity(" + val + ")";
+		    default:  return "(cxx_rt::u64)!cxx_rt::parity(" + val + ")";
+		}
+		switch (op) {
+		    case '&': return cxx_printf("cxx_rt::rand4(%s, %u)", val.c_str(), vwid);
+		    case 'A': return cxx_printf("cxx_rt::not4(cxx_rt::rand4(%s, %u), 1)",
+						val.c_str(), vwid);
+		    case '|': return "cxx_rt::truth4(" + val + ")";
+		    case 'N': return "cxx_rt::lnot4(" + val + ")";
+		    case '^': return "cxx_rt::rxor4(" + val + ")";
+		    default:  return "cxx_rt::not4(cxx_rt::rxor4(" + val + "), 1)";
+		}
+	  }
+
+	  case IVL_LPM_ABS:
+	    return cxx_printf("cxx_rt::abs%c(%s, %u)", is2? '2' : '4',
+			      input_value(in[0], wid, true, is2).c_str(), wid);
+
+	  case IVL_LPM_CAST_INT2:
+	    if (is2) return input_value(in[0], wid, sgn, true);
+	    return "cxx_rt::v4(" + input_value(in[0], wid, sgn, true) + ")";
+
+	  case IVL_LPM_SIGN_EXT:
+	    return input_value(in[0], wid, true, is2);
+
+	  case IVL_LPM_PART_VP:
+	    if (ivl_lpm_base(lpm) + wid <= in[0]->wid) {
+		  std::string val = holder_value(in[0], is2);
+		  if (is2)
+			return cxx_printf("((%s >> %u) & %s)", val.c_str(),
+					  ivl_lpm_base(lpm), mask.c_str());
+		  return cxx_printf("cxx_rt::v4((%s.a >> %u) & %s, (%s.b >> %u) & %s)",
+				    val.c_str(), ivl_lpm_base(lpm), mask.c_str(),
+				    val.c_str(), ivl_lpm_base(lpm), mask.c_str());
+	    }
+	    return cxx_printf("cxx_rt::part%c(%s, %u, %u, %u)", is2? '2' : '4',
+			      holder_value(in[0], is2).c_str(), in[0]->wid,
+			      ivl_lpm_base(lpm), wid);
+
+	  case IVL_LPM_SUBSTITUTE:
+	    return cxx_printf("cxx_rt::merge%c(%s, %s, %u, %u, %u)", is2? '2' : '4',
+			      holder_value(in[0], is2).c_str(),
+			      holder_value(in[1], is2).c_str(),
+			      ivl_lpm_base(lpm), in[1]->wid, wid);
+
+	  case IVL_LPM_CONCAT:
+	  case IVL_LPM_CONCATZ: {
+		  /* The data(0) input is the least significant part. */
+		std::string res;
+		unsigned off = 0;
+		for (size_t idx = 0 ; idx < in.size() ; idx += 1) {
+		      std::string val = holder_value(in[idx], is2);
+		      if (idx == 0)
+			    res = val;
+		      else if (is2)
+			    res = cxx_printf("(%s << %u) | %s", val.c_str(), off,
+					     res.c_str());
+		      else
+			    res = cxx_printf("cxx_rt::cat4(%s, %s, %u)", val.c_str(),
+					     res.c_str(), off);
+		      off += in[idx]->wid;
+		}
+		return is2? "(" + res + ")" : res;
+	  }
+
+	  case IVL_LPM_REPEAT:
+	    return cxx_printf("cxx_rt::repeat%c(%s, %u, %u)", is2? '2' : '4',
+			      holder_value(in[0], is2).c_str(), in[0]->wid,
+			      ivl_lpm_size(lpm));
+
+	  case IVL_LPM_MUX: {
+		unsigned size = ivl_lpm_size(lpm);
+		const cxx_holder*sel = in[size];
+		if (size == 2 && ! is2)
+		      return cxx_printf("cxx_rt::mux4(%s, %s, %s)",
+					holder_value(sel, false).c_str(),
+					input_value(in[1], wid, false, false).c_str(),
+					input_value(in[0], wid, false, false).c_str());
+
+		  /* A select that is x or out of range gives x. */
+		std::string idx_txt = sel->two_state
+		      ? cxx_printf("(cxx_rt::s64)%s", holder_value(sel, true).c_str())
+		      : cxx_printf("cxx_rt::index4(%s, %u, false)",
+				   holder_value(sel, false).c_str(), sel->wid);
+		std::string res = is2? "0" : cxx_printf("cxx_rt::x4(%u)", wid);
+		for (unsigned idx = size ; idx > 0 ; idx -= 1) {
+		      res = cxx_printf("(%s == %u? %s : %s)", idx_txt.c_str(), idx-1,
+				       input_value(in[idx-1], wid, false, is2).c_str(),
+				       res.c_str());
+		}
+		return res;
+	  }
+
+	  case IVL_LPM_UFUNC:
+	    return emit_ufunc(node, is2);
+
+	  default:
+	    assert(0);
+	    return "";
+      }
+}
+
+/*
+ * The parts of a vector are merged into a vector that is z (0 in
+ * 2-state) where no part drives it.
+ */
+static std::string emit_parts(const cxx_node*node, bool is2)
+{
+      unsigned wid = node->out->wid;
+      std::string res = is2? "0" : cxx_printf("cxx_rt::v4(0, %s)",
+					      cxx_literal(mask_of(wid)).c_str());
+      for (size_t idx = 0 ; idx < node->parts.size() ; idx += 1) {
+	    const cxx_holder*part = node->in[idx];
+	    res = cxx_printf("cxx_rt::merge%c(%s, %s, %u, %u, %u)", is2? '2' : '4',
+			     res.c_str(), holder_value(part, is2).c_str(),
+			     ivl_lpm_base(node->parts[idx]), part->wid, wid);
+      }
+      return res;
+}
+
+static std::string holder_init(const cxx_holder*hold)
+{
+      unsigned long long a = 0, b = 0;
+      if (! hold->init.empty()) {
+	    for (unsigned idx = 0 ; idx < hold->wid ; idx += 1) {
+		  switch (hold->init[idx]) {
+		      case '1': a |= 1ULL << idx; break;
+		      case 'x': a |= 1ULL << idx; b |= 1ULL << idx; break;
+		      case 'z': b |= 1ULL << idx; break;
+		      default: break;
+		  }
+	    }
+      } else if (hold->is_var || hold->driver) {
+	    a = b = mask_of(hold->wid);
+      } else if (hold->undriven == '1') {
+	    a = mask_of(hold->wid);
+      } else if (hold->undriven == 'z') {
+	    b = mask_of(hold->wid);
+      }
+
+      if (hold->two_state)
+	    return cxx_literal(a & ~b);
+      return "{" + cxx_literal(a) + ", " + cxx_literal(b) + "}";
+}
+
+void emit_nets_decl(FILE*out)
+{
+      for (std::map<ivl_event_t,unsigned>::const_iterator cur = events.begin()
+		 ; cur != events.end() ; ++ cur) {
+	    fprintf(out, "static cxx_rt::event_s E%u;\n", cur->second);
+      }
+
+      for (unsigned idx = 0 ; idx < nodes.size() ; idx += 1) {
+	    fprintf(out, "static void eval_N%u(void);\n", idx);
+	    fprintf(out, "static cxx_rt::node_s N%u = { &eval_N%u, %u, false };\n",
+		    idx, idx, nodes[idx]->level);
+      }
+
+      for (unsigned idx = 0 ; idx < holders.size() ; idx += 1) {
+	    const cxx_holder*hold = holders[idx];
+	    const char*type = hold->two_state? "u64" : "vec4";
+	    if (! hold->watched()) {
+		  fprintf(out, "static cxx_rt::%s H%u = %s;\n", type, idx,
+			  holder_init(hold).c_str());
+		  continue;
+	    }
+
+	    fprintf(out, "static const cxx_rt::probe_s H%u_probes[] = {", idx);
+	    for (unsigned pdx = 0 ; pdx < hold->probes.size() ; pdx += 1)
+		  fprintf(out, " {&E%u, cxx_rt::%s},", hold->probes[pdx].first,
+			  hold->probes[pdx].second);
+	    fprintf(out, " {0, cxx_rt::ANYEDGE} };\n");
+	    fprintf(out, "static cxx_rt::node_s*const H%u_readers[] = {", idx);
+	    for (unsigned rdx = 0 ; rdx < hold->readers.size() ; rdx += 1)
+		  fprintf(out, " &N%u,", hold->readers[rdx]->id);
+	    fprintf(out, " 0 };\n");
+	    fprintf(out, "static const cxx_rt::watch_s H%u_watch = "
+		    "{ H%u_probes, H%u_readers };\n", idx, idx, idx);
+	    fprintf(out, "static cxx_rt::sig%c H%u = { %s, &H%u_watch };\n",
+		    hold->two_state? '2' : '4', idx, holder_init(hold).c_str(), idx);
+      }
+
+      for (std::map<ivl_signal_t,cxx_array*>::const_iterator cur = arrays.begin()
+		 ; cur != arrays.end() ; ++ cur) {
+	    const cxx_array*arr = cur->second;
+	    fprintf(out, "static cxx_rt::%s A%u[%u];\n", arr->two_state? "u64" : "vec4",
+		    arr->id, arr->count);
+      }
+}
+
+void emit_nets_eval(FILE*out)
+{
+      for (unsigned idx = 0 ; idx < nodes.size() ; idx += 1) {
+	    const cxx_node*node = nodes[idx];
+	    bool is2 = node->out->two_state;
+	    std::string val;
+	    if (! node->parts.empty())
+		  val = emit_parts(node, is2);
+	    else if (node->log)
+		  val = emit_logic(node, is2);
+	    else
+		  val = emit_lpm(node, is2);
+
+	    cxx_var var;
+	    var.name = cxx_printf("H%u", node->out->id);
+	    var.wid = node->out->wid;
+	    var.count = 0;
+	    var.two_state = is2;
+	    var.watched = node->out->watched();
+
+	    fprintf(out, "\nstatic void eval_N%u(void)\n{\n", idx);
+	    fprintf(out, "      %s;\n}\n", var_store(var, val).c_str());
+      }
+}
+
+/*
+ * Start the model with the arrays at x and all the nodes queued, so
+ * that the nets get their values before the processes start.
+ */
+void emit_nets_start(FILE*out)
+{
+      for (std::map<ivl_signal_t,cxx_array*>::const_iterator cur = arrays.begin()
+		 ; cur != arrays.end() ; ++ cur) {
+	    const cxx_array*arr = cur->second;
+	    if (arr->two_state)
+		  continue;
+	    fprintf(out, "      for (unsigned idx = 0 ; idx < %u ; idx += 1)\n", arr->count);
+	    fprintf(out, "\t    A%u[idx] = cxx_rt::x4(%u);\n", arr->id, arr->wid);
+      }
+
+      for (unsigned idx = 0 ; idx < nodes.size() ; idx += 1)
+	    fprintf(out, "      cxx_rt::queue_node(&N%u);\n", idx);
+}
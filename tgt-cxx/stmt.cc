@@ -0,0 +1,839 @@
+/*
+ * Copyright (c) 2016 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "config.h"
+# include  "cxx_priv.h"
+# include  <map>
+# include  <vector>
+# include  <cstring>
+
+/*
+ * A process is written as a function that the run time calls each
+ * time the process resumes. The function is a switch on the pc of the
+ * process, with a case label after each place where the process
+ * waits, so the code of the process reads as straight line code:
+ *
+ *     self->pc = 2; cxx_rt::delay(self, 10); return; case 2:;
+ *
+ * Values that must live across a wait are members of the process.
+ * Functions cannot wait, so they are plain C++ functions that keep
+ * their temporaries in static variables, as the functions of a
+ * Verilog module are static.
+ */
+
+ivl_scope_t cxx_scope = 0;
+
+struct code_s {
+      std::string text;
+      std::vector<std::string> temps;
+      unsigned indent;
+      unsigned next_pc;
+      bool in_proc;
+};
+
+static void line(code_s&code, const std::string&txt)
+{
+      code.text.append(4*code.indent, ' ');
+      code.text += txt;
+      code.text += "\n";
+}
+
+static std::string temp(code_s&code, const char*type)
+{
+      unsigned id = code.temps.size();
+      code.temps.push_back(cxx_printf("%s t%u;", type, id));
+      return cxx_printf(code.in_proc? "self->t%u" : "t%u", id);
+}
+
+/* Leave the process, and come back here when the scheduler runs it. */
+static void suspend(code_s&code, const std::string&sched)
+{
+      unsigned pc = ++code.next_pc;
+      line(code, cxx_printf("self->pc = %u;", pc));
+      if (! sched.empty())
+	    line(code, sched);
+      line(code, "return;");
+      line(code, cxx_printf("case %u:;", pc));
+}
+
+static bool need_proc(code_s&code, ivl_statement_t net, const char*what)
+{
+      if (code.in_proc)
+	    return true;
+      cxx_sorry(ivl_stmt_file(net), ivl_stmt_lineno(net),
+		"%s in a function.", what);
+      return false;
+}
+
+/*
+ * The functions that the design calls, in the order they were first
+ * called. The bodies are written after the processes, and may add
+ * more functions to the list.
+ */
+static std::map<ivl_scope_t,unsigned> func_ids;
+static std::vector<ivl_scope_t> func_list;
+
+std::string function_name(ivl_scope_t func)
+{
+      std::map<ivl_scope_t,unsigned>::const_iterator cur = func_ids.find(func);
+      if (cur != func_ids.end())
+	    return cxx_printf("func_F%u", cur->second);
+
+      unsigned id = func_list.size();
+      func_ids[func] = id;
+      func_list.push_back(func);
+      return cxx_printf("func_F%u", id);
+}
+
+static std::vector<std::string> strobe_defs;
+static std::vector<std::string> proc_defs;
+static std::vector<std::string> func_defs;
+static std::vector<std::string> proc_start;
+
+static std::string cond_text(ivl_expr_t expr)
+{
+      if (expr_is2(expr))
+	    return "(" + emit_expr(expr, true) + " != 0)";
+      return "cxx_rt::test4(" + emit_expr(expr, false) + ")";
+}
+
+static std::string quote(const std::string&str)
+{
+      std::string res = "\"";
+      for (size_t idx = 0 ; idx < str.size() ; idx += 1) {
+	    unsigned char ch = str[idx];
+	    if (ch == '"' || ch == '\\') {
+		  res += '\\';
+		  res += ch;
+	    } else if (ch < ' ' || ch >= 0x7f) {
+		  res += cxx_printf("\\%03o", ch);
+	    } else {
+		  res += ch;
+	    }
+      }
+      return res + "\"";
+}
+
+static void emit_stmt(code_s&code, ivl_statement_t net);
+
+/*
+ * Store a value that has the width of the l-value. The value is a u64
+ * if is2 is true or a vec4 otherwise. The non-blocking assignments
+ * pass the delay in dly.
+ */
+static void emit_store(code_s&code, ivl_statement_t net, ivl_lval_t lval,
+		       std::string val, bool is2, const char*dly)
+{
+      const char*file = ivl_stmt_file(net);
+      unsigned lineno = ivl_stmt_lineno(net);
+      ivl_signal_t sig = ivl_lval_sig(lval);
+      if (sig == 0 || ivl_lval_nest(lval)) {
+	    cxx_sorry(file, lineno, "Assignments to class properties are not "
+		      "supported.");
+	    return;
+      }
+
+      cxx_var var;
+      if (! signal_var(sig, var, file, lineno))
+	    return;
+      if (var.two_state && ! is2)
+	    val = "cxx_rt::to2(" + val + ")";
+      else if (! var.two_state && is2)
+	    val = "cxx_rt::v4(" + val + ")";
+
+      unsigned wid = ivl_lval_width(lval);
+      ivl_expr_t part = ivl_lval_part_off(lval);
+      std::string off = part? emit_index(part) : "0";
+      bool whole = part == 0 && wid == var.wid;
+      char kind = var.two_state? '2' : '4';
+
+      if (var.count > 0) {
+	    ivl_expr_t idx = ivl_lval_idx(lval);
+	    std::string word = var.name + "[word]";
+	    line(code, "{");
+	    code.indent += 1;
+	    line(code, "cxx_rt::s64 word = " + emit_index(idx) + ";");
+	    line(code, cxx_printf("if (word >= 0 && word < %u)", var.count));
+	    if (dly)
+		  line(code, cxx_printf("    cxx_rt::assign_nb(&%s, %s, %s, %u, %u, %s);",
+					word.c_str(), val.c_str(), off.c_str(),
+					wid, var.wid, dly));
+	    else if (whole)
+		  line(code, "    " + word + " = " + val + ";");
+	    else
+		  line(code, cxx_printf("    %s = cxx_rt::merge%c(%s, %s, %s, %u, %u);",
+					word.c_str(), kind, word.c_str(), val.c_str(),
+					off.c_str(), wid, var.wid));
+	    code.indent -= 1;
+	    line(code, "}");
+	    return;
+      }
+
+      if (dly)
+	    line(code, cxx_printf("cxx_rt::assign_nb(&%s, %s, %s, %u, %u, %s);",
+				  var.name.c_str(), val.c_str(), off.c_str(),
+				  wid, var.wid, dly));
+      else if (whole)
+	    line(code, var_store(var, val) + ";");
+      else
+	    line(code, var_store(var, cxx_printf("cxx_rt::merge%c(%s, %s, %s, %u, %u)",
+						 kind, var_value(var, var.two_state).c_str(),
+						 val.c_str(), off.c_str(), wid,
+						 var.wid)) + ";");
+}
+
+static void emit_assign(code_s&code, ivl_statement_t net, bool nb)
+{
+      const char*file = ivl_stmt_file(net);
+      unsigned lineno = ivl_stmt_lineno(net);
+      ivl_expr_t rval = ivl_stmt_rval(net);
+      unsigned nlval = ivl_stmt_lvals(net);
+      unsigned wid = ivl_stmt_lwidth(net);
+
+	/* Compute in 2-state if all the l-values are 2-state. */
+      bool is2 = true;
+      for (unsigned idx = 0 ; idx < nlval ; idx += 1) {
+	    ivl_signal_t sig = ivl_lval_sig(ivl_stmt_lval(net, idx));
+	    if (sig && ! cxx_two_state && ivl_signal_data_type(sig) != IVL_VT_BOOL)
+		  is2 = false;
+      }
+
+      std::string dly_txt;
+      const char*dly = 0;
+      if (nb) {
+	    if (ivl_stmt_nevent(net) > 0) {
+		  cxx_sorry(file, lineno, "Event controls in non-blocking "
+			    "assignments are not supported.");
+		  return;
+	    }
+	    ivl_expr_t dexp = ivl_stmt_delay_expr(net);
+	    unsigned long long dval;
+	    if (dexp == 0)
+		  dly_txt = "0";
+	    else if (number_value(dexp, dval))
+		  dly_txt = cxx_literal(dval);
+	    else
+		  dly_txt = emit_expr(dexp, true);
+	    dly = dly_txt.c_str();
+      }
+
+      std::string val = emit_expr_pad(rval, wid, is2);
+
+      if (char op = ivl_stmt_opcode(net)) {
+	    ivl_lval_t lval = ivl_stmt_lval(net, 0);
+	    cxx_var var;
+	    if (nlval != 1 || ivl_lval_part_off(lval) || ivl_lval_sig(lval) == 0
+		|| ! signal_var(ivl_lval_sig(lval), var, file, lineno)
+		|| var.count > 0) {
+		  cxx_sorry(file, lineno, "Compressed assignments are only "
+			    "supported to whole vectors.");
+		  return;
+	    }
+	    bool sgn = ivl_expr_signed(rval) != 0;
+	    if (op == 'l' || op == 'r' || op == 'R') {
+		  if (op == 'R' && ! ivl_signal_signed(ivl_lval_sig(lval)))
+			op = 'r';
+		  val = emit_expr(rval, is2);
+	    }
+	    std::string res = emit_binary_op(op, var_value(var, is2), val, wid,
+					     sgn, is2);
+	    if (res.empty()) {
+		  cxx_sorry(file, lineno, "Compressed assignment %c= is not "
+			    "supported.", op);
+		  return;
+	    }
+	    val = res;
+      }
+
+      if (nlval == 1) {
+	    emit_store(code, net, ivl_stmt_lval(net, 0), val, is2, dly);
+	    return;
+      }
+
+	/* The first l-value gets the least significant bits. */
+      line(code, "{");
+      code.indent += 1;
+      line(code, cxx_printf("const cxx_rt::%s val = %s;", is2? "u64" : "vec4",
+			    val.c_str()));
+      unsigned off = 0;
+      for (unsigned idx = 0 ; idx < nlval ; idx += 1) {
+	    ivl_lval_t lval = ivl_stmt_lval(net, idx);
+	    unsigned lwid = ivl_lval_width(lval);
+	    std::string piece = cxx_printf("cxx_rt::part%c(val, %u, %u, %u)",
+					   is2? '2' : '4', wid, off, lwid);
+	    emit_store(code, net, lval, piece, is2, dly);
+	    off += lwid;
+      }
+      code.indent -= 1;
+      line(code, "}");
+}
+
+/*
+ * The case items are compared with the === operator, or with the
+ * casex and casez rules, in order, and the default is last.
+ */
+static void emit_case(code_s&code, ivl_statement_t net)
+{
+      ivl_expr_t cond = ivl_stmt_cond_expr(net);
+      unsigned count = ivl_stmt_case_count(net);
+      bool is2 = ivl_statement_type(net) == IVL_ST_CASE && expr_is2(cond);
+      unsigned wid = ivl_expr_width(cond);
+      for (unsigned idx = 0 ; idx < count ; idx += 1) {
+	    ivl_expr_t cex = ivl_stmt_case_expr(net, idx);
+	    if (cex == 0)
+		  continue;
+	    if (ivl_expr_width(cex) > wid)
+		  wid = ivl_expr_width(cex);
+	    if (! expr_is2(cex))
+		  is2 = false;
+      }
+
+      std::string sel = temp(code, is2? "cxx_rt::u64" : "cxx_rt::vec4");
+      line(code, sel + " = " + emit_expr_pad(cond, wid, is2) + ";");
+
+      ivl_statement_t dflt = 0;
+      bool first = true;
+      for (unsigned idx = 0 ; idx < count ; idx += 1) {
+	    ivl_expr_t cex = ivl_stmt_case_expr(net, idx);
+	    if (cex == 0) {
+		  dflt = ivl_stmt_case_stmt(net, idx);
+		  continue;
+	    }
+
+	    std::string val = emit_expr_pad(cex, wid, is2);
+	    std::string test;
+	    switch (ivl_statement_type(net)) {
+		case IVL_ST_CASEX:
+		  test = "cxx_rt::casex_eq(" + sel + ", " + val + ")";
+		  break;
+		case IVL_ST_CASEZ:
+		  test = "cxx_rt::casez_eq(" + sel + ", " + val + ")";
+		  break;
+		default:
+		  test = sel + " == " + val;
+		  break;
+	    }
+	    line(code, (first? "if (" : "} else if (") + test + ") {");
+	    first = false;
+	    code.indent += 1;
+	    emit_stmt(code, ivl_stmt_case_stmt(net, idx));
+	    code.indent -= 1;
+      }
+
+      if (dflt) {
+	    if (first) {
+		  emit_stmt(code, dflt);
+		  return;
+	    }
+	    line(code, "} else {");
+	    code.indent += 1;
+	    emit_stmt(code, dflt);
+	    code.indent -= 1;
+      }
+      if (! first)
+	    line(code, "}");
+}
+
+/*
+ * The $display tasks. A string argument is a format for the
+ * arguments that follow it, and the other arguments are written in
+ * the default radix of the task. The code builds the text in a
+ * string and writes it all at once.
+ */
+static void emit_format_arg(code_s&code, ivl_statement_t net, ivl_expr_t arg,
+			    char conv, int width, bool zero, bool left)
+{
+      const char*file = ivl_stmt_file(net);
+      unsigned lineno = ivl_stmt_lineno(net);
+      const char*zero_txt = zero? "true" : "false";
+      const char*left_txt = left? "true" : "false";
+
+      if (arg == 0) {
+	    cxx_sorry(file, lineno, "Missing argument for format %%%c.", conv);
+	    return;
+      }
+
+      if (conv == 's' && ivl_expr_type(arg) == IVL_EX_STRING) {
+	    line(code, cxx_printf("cxx_rt::justify(text, %s, %d, %s);",
+				  quote(string_text(arg)).c_str(), width, left_txt));
+	    return;
+      }
+
+      std::string val = emit_expr(arg, false);
+      unsigned wid = ivl_expr_width(arg);
+      switch (conv) {
+	  case 'b':
+	  case 'o':
+	  case 'h':
+	    line(code, cxx_printf("cxx_rt::format_radix(text, %s, %u, %u, %d, %s, %s);",
+				  val.c_str(), wid, conv == 'b'? 1 : conv == 'o'? 3 : 4,
+				  width, zero_txt, left_txt));
+	    break;
+	  case 'd':
+	    line(code, cxx_printf("cxx_rt::format_dec(text, %s, %u, %s, %d, %s, %s);",
+				  val.c_str(), wid, ivl_expr_signed(arg)? "true" : "false",
+				  width, zero_txt, left_txt));
+	    break;
+	  case 'c':
+	    line(code, cxx_printf("cxx_rt::format_char(text, %s, %d, %s);",
+				  val.c_str(), width, left_txt));
+	    break;
+	  case 's':
+	    line(code, cxx_printf("cxx_rt::format_str(text, %s, %u, %d, %s, %s);",
+				  val.c_str(), wid, width, zero_txt, left_txt));
+	    break;
+	  case 't': {
+		int shift = ivl_scope_time_units(cxx_scope) - cxx_precision;
+		line(code, cxx_printf("cxx_rt::format_time(text, %s, %u, %d, %d, %s, %s);",
+				      val.c_str(), wid, shift > 0? shift : 0,
+				      width, zero_txt, left_txt));
+		break;
+	  }
+      }
+}
+
+static void emit_display(code_s&code, ivl_statement_t net, char radix,
+			 bool newline)
+{
+      const char*file = ivl_stmt_file(net);
+      unsigned lineno = ivl_stmt_lineno(net);
+      unsigned nparms = ivl_stmt_parm_count(net);
+
+      line(code, "{");
+      code.indent += 1;
+      line(code, "std::string text;");
+
+      unsigned idx = 0;
+      while (idx < nparms) {
+	    ivl_expr_t arg = ivl_stmt_parm(net, idx);
+	    idx += 1;
+
+	    if (arg == 0) {
+		  line(code, "text += ' ';");
+		  continue;
+	    }
+
+	    if (ivl_expr_type(arg) != IVL_EX_STRING) {
+		  emit_format_arg(code, net, arg, radix, -1, false, false);
+		  continue;
+	    }
+
+	    std::string fmt = string_text(arg);
+	    std::string lit;
+	    for (size_t pos = 0 ; pos < fmt.size() ; pos += 1) {
+		  if (fmt[pos] != '%' || pos+1 == fmt.size()) {
+			lit += fmt[pos];
+			continue;
+		  }
+
+		  pos += 1;
+		  bool left = false, zero = false;
+		  int width = -1;
+		  if (fmt[pos] == '-') {
+			left = true;
+			pos += 1;
+		  }
+		  if (fmt[pos] == '0') {
+			zero = true;
+			pos += 1;
+		  }
+		  while (pos < fmt.size() && fmt[pos] >= '0' && fmt[pos] <= '9') {
+			width = (width == -1? 0 : width*10) + (fmt[pos] - '0');
+			pos += 1;
+		  }
+		  if (pos == fmt.size())
+			break;
+
+		  char conv = fmt[pos];
+		  if (conv >= 'A' && conv <= 'Z')
+			conv += 'a' - 'A';
+		  if (conv == 'x')
+			conv = 'h';
+
+		  if (conv == '%') {
+			lit += '%';
+			continue;
+		  }
+
+		  if (! lit.empty()) {
+			line(code, cxx_printf("text.append(%s, %u);", quote(lit).c_str(),
+					      (unsigned)lit.size()));
+			lit.clear();
+		  }
+
+		  if (conv == 'm') {
+			line(code, cxx_printf("cxx_rt::justify(text, %s, %d, %s);",
+					      quote(ivl_scope_name(cxx_scope)).c_str(),
+					      width, left? "true" : "false"));
+			continue;
+		  }
+
+		  if (strchr("bohdcst", conv) == 0) {
+			cxx_sorry(file, lineno, "Format %%%c is not supported.",
+				  fmt[pos]);
+			continue;
+		  }
+
+		  ivl_expr_t val = idx < nparms? ivl_stmt_parm(net, idx) : 0;
+		  idx += 1;
+		  emit_format_arg(code, net, val, conv, width, zero, left);
+	    }
+
+	    if (! lit.empty())
+		  line(code, cxx_printf("text.append(%s, %u);", quote(lit).c_str(),
+					(unsigned)lit.size()));
+      }
+
+      if (newline)
+	    line(code, "text += '\\n';");
+      line(code, "cxx_rt::print(text);");
+      code.indent -= 1;
+      line(code, "}");
+}
+
+static void emit_stask(code_s&code, ivl_statement_t net)
+{
+      const char*name = ivl_stmt_name(net);
+      static const struct {
+	    const char*name;
+	    char radix;
+	    bool newline;
+      } display_tasks[] = {
+	    { "$display",  'd', true  },
+	    { "$displayb", 'b', true  },
+	    { "$displayh", 'h', true  },
+	    { "$displayo", 'o', true  },
+	    { "$write",    'd', false },
+	    { "$writeb",   'b', false },
+	    { "$writeh",   'h', false },
+	    { "$writeo",   'o', false },
+	    { "$strobe",   'd', true  },
+	    { "$strobeb",  'b', true  },
+	    { "$strobeh",  'h', true  },
+	    { "$strobeo",  'o', true  },
+	    { 0, 0, false }
+      };
+
+      for (unsigned idx = 0 ; display_tasks[idx].name ; idx += 1) {
+	    if (strcmp(name, display_tasks[idx].name) != 0)
+		  continue;
+
+	    if (strncmp(name, "$strobe", 7) != 0) {
+		  emit_display(code, net, display_tasks[idx].radix,
+			       display_tasks[idx].newline);
+		  return;
+	    }
+
+	      /* A strobe displays the values at the end of the time
+		 step, so its display is a function of its own. */
+	    code_s strobe;
+	    strobe.indent = 1;
+	    strobe.next_pc = 0;
+	    strobe.in_proc = false;
+	    emit_display(strobe, net, display_tasks[idx].radix, true);
+	    unsigned id = strobe_defs.size();
+	    strobe_defs.push_back(cxx_printf("\nstatic void strobe_S%u(void)\n{\n%s}\n",
+					     id, strobe.text.c_str()));
+	    line(code, cxx_printf("cxx_rt::strobe(&strobe_S%u);", id));
+	    return;
+      }
+
+      if (strcmp(name, "$finish") == 0 || strcmp(name, "$stop") == 0) {
+	    line(code, "cxx_rt::finish();");
+	    if (code.in_proc)
+		  suspend(code, "");
+	    return;
+      }
+
+      if (strncmp(name, "$dump", 5) == 0)
+	    return;
+
+      cxx_sorry(ivl_stmt_file(net), ivl_stmt_lineno(net),
+		"System task %s is not supported.", name);
+}
+
+static void emit_sub(code_s&code, ivl_statement_t net)
+{
+      code.indent += 1;
+      if (net)
+	    emit_stmt(code, net);
+      code.indent -= 1;
+}
+
+static void emit_stmt(code_s&code, ivl_statement_t net)
+{
+      const char*file = ivl_stmt_file(net);
+      unsigned lineno = ivl_stmt_lineno(net);
+
+      switch (ivl_statement_type(net)) {
+	  case IVL_ST_NOOP:
+	    break;
+
+	  case IVL_ST_BLOCK: {
+		ivl_scope_t save = cxx_scope;
+		if (ivl_scope_t scope = ivl_stmt_block_scope(net)) {
+		      if (ivl_scope_is_auto(scope))
+			    cxx_sorry(file, lineno, "Automatic blocks are not "
+				      "supported.");
+		      cxx_scope = scope;
+		}
+		for (unsigned idx = 0 ; idx < ivl_stmt_block_count(net) ; idx += 1)
+		      emit_stmt(code, ivl_stmt_block_stmt(net, idx));
+		cxx_scope = save;
+		break;
+	  }
+
+	  case IVL_ST_ASSIGN:
+	    emit_assign(code, net, false);
+	    break;
+
+	  case IVL_ST_ASSIGN_NB:
+	    emit_assign(code, net, true);
+	    break;
+
+	  case IVL_ST_CONDIT:
+	    line(code, "if (" + cond_text(ivl_stmt_cond_expr(net)) + ") {");
+	    emit_sub(code, ivl_stmt_cond_true(net));
+	    if (ivl_stmt_cond_false(net)) {
+		  line(code, "} else {");
+		  emit_sub(code, ivl_stmt_cond_false(net));
+	    }
+	    line(code, "}");
+	    break;
+
+	  case IVL_ST_CASE:
+	  case IVL_ST_CASEX:
+	  case IVL_ST_CASEZ:
+	    emit_case(code, net);
+	    break;
+
+	  case IVL_ST_DELAY:
+	    if (! need_proc(code, net, "Delay"))
+		  break;
+	    suspend(code, "cxx_rt::delay(self, " +
+		    cxx_literal(ivl_stmt_delay_val(net)) + ");");
+	    emit_stmt(code, ivl_stmt_sub_stmt(net));
+	    break;
+
+	  case IVL_ST_DELAYX:
+	    if (! need_proc(code, net, "Delay"))
+		  break;
+	    suspend(code, "cxx_rt::delay(self, " +
+		    emit_expr(ivl_stmt_delay_expr(net), true) + ");");
+	    emit_stmt(code, ivl_stmt_sub_stmt(net));
+	    break;
+
+	  case IVL_ST_WAIT: {
+		if (! need_proc(code, net, "Event control"))
+		      break;
+		std::string sched;
+		for (unsigned idx = 0 ; idx < ivl_stmt_nevent(net) ; idx += 1) {
+		      ivl_event_t evt = ivl_stmt_events(net, idx);
+		      if (evt == 0) {
+			    cxx_sorry(file, lineno, "Wait fork is not supported.");
+			    continue;
+		      }
+		      if (idx > 0) sched += " ";
+		      sched += cxx_printf("cxx_rt::wait(self, &E%u);", event_id(evt));
+		}
+		suspend(code, sched);
+		emit_stmt(code, ivl_stmt_sub_stmt(net));
+		break;
+	  }
+
+	  case IVL_ST_TRIGGER:
+	    line(code, cxx_printf("cxx_rt::trigger(&E%u);",
+				  event_id(ivl_stmt_events(net, 0))));
+	    break;
+
+	  case IVL_ST_WHILE:
+	    line(code, "while (" + cond_text(ivl_stmt_cond_expr(net)) + ") {");
+	    emit_sub(code, ivl_stmt_sub_stmt(net));
+	    line(code, "}");
+	    break;
+
+	  case IVL_ST_DO_WHILE:
+	    line(code, "do {");
+	    emit_sub(code, ivl_stmt_sub_stmt(net));
+	    line(code, "} while (" + cond_text(ivl_stmt_cond_expr(net)) + ");");
+	    break;
+
+	  case IVL_ST_REPEAT: {
+		std::string cnt = temp(code, "cxx_rt::s64");
+		line(code, cxx_printf("for (%s = %s ; %s > 0 ; %s -= 1) {", cnt.c_str(),
+				      emit_index(ivl_stmt_cond_expr(net)).c_str(),
+				      cnt.c_str(), cnt.c_str()));
+		emit_sub(code, ivl_stmt_sub_stmt(net));
+		line(code, "}");
+		break;
+	  }
+
+	  case IVL_ST_FOREVER:
+	    line(code, "for (;;) {");
+	    emit_sub(code, ivl_stmt_sub_stmt(net));
+	    line(code, "}");
+	    break;
+
+	  case IVL_ST_STASK:
+	    emit_stask(code, net);
+	    break;
+
+	  case IVL_ST_FORK:
+	  case IVL_ST_FORK_JOIN_ANY:
+	  case IVL_ST_FORK_JOIN_NONE:
+	    cxx_sorry(file, lineno, "fork/join is not supported.");
+	    break;
+
+	  case IVL_ST_UTASK:
+	    cxx_sorry(file, lineno, "Task calls are not supported.");
+	    break;
+
+	  case IVL_ST_DISABLE:
+	    cxx_sorry(file, lineno, "disable is not supported.");
+	    break;
+
+	  case IVL_ST_FORCE:
+	  case IVL_ST_RELEASE:
+	    cxx_sorry(file, lineno, "force and release are not supported.");
+	    break;
+
+	  case IVL_ST_CASSIGN:
+	  case IVL_ST_DEASSIGN:
+	    cxx_sorry(file, lineno, "Procedural assign and deassign are not "
+		      "supported.");
+	    break;
+
+	  case IVL_ST_CASER:
+	    cxx_sorry(file, lineno, "Case statements with real values are "
+		      "not supported.");
+	    break;
+
+	  default:
+	    cxx_sorry(file, lineno, "Statement type %d is not supported.",
+		      (int)ivl_statement_type(net));
+	    break;
+      }
+}
+
+static int emit_process(ivl_process_t net, void*)
+{
+      static unsigned proc_count = 0;
+      unsigned id = proc_count++;
+      ivl_scope_t scope = ivl_process_scope(net);
+
+      if (ivl_process_analog(net)) {
+	    cxx_sorry(ivl_process_file(net), ivl_process_lineno(net),
+		      "Analog processes are not supported.");
+	    return 0;
+      }
+
+      code_s code;
+      code.indent = 2;
+      code.next_pc = 0;
+      code.in_proc = true;
+      cxx_scope = scope;
+
+      bool is_always = ivl_process_type(net) == IVL_PR_ALWAYS;
+      if (is_always) {
+	    line(code, "for (;;) {");
+	    code.indent += 1;
+      }
+      emit_stmt(code, ivl_process_stmt(net));
+      if (is_always) {
+	    code.indent -= 1;
+	    line(code, "}");
+      }
+
+      std::string def;
+      def += cxx_printf("\n/* %s:%u in %s */\n", ivl_process_file(net),
+			ivl_process_lineno(net), ivl_scope_name(scope));
+      def += cxx_printf("static void run_P%u(cxx_rt::proc_s*proc);\n\n", id);
+      def += cxx_printf("struct proc_P%u : cxx_rt::proc_s {\n", id);
+      def += cxx_printf("      proc_P%u() : cxx_rt::proc_s(&run_P%u) { }\n", id, id);
+      for (size_t idx = 0 ; idx < code.temps.size() ; idx += 1)
+	    def += "      " + code.temps[idx] + "\n";
+      def += cxx_printf("};\n\nstatic proc_P%u P%u;\n\n", id, id);
+      def += cxx_printf("static void run_P%u(cxx_rt::proc_s*proc)\n{\n", id);
+      def += cxx_printf("      proc_P%u*self = static_cast<proc_P%u*>(proc);\n", id, id);
+      def += "      switch (self->pc) {\n";
+      def += "        case 0:;\n";
+      def += code.text;
+      def += "      }\n}\n";
+      proc_defs.push_back(def);
+
+      if (ivl_process_type(net) == IVL_PR_FINAL)
+	    proc_start.push_back(cxx_printf("      cxx_rt::add_final(&P%u);\n", id));
+      else
+	    proc_start.push_back(cxx_printf("      cxx_rt::activate(&P%u);\n", id));
+      return 0;
+}
+
+static void emit_function(ivl_scope_t func, unsigned id)
+{
+      code_s code;
+      code.indent = 1;
+      code.next_pc = 0;
+      code.in_proc = false;
+      cxx_scope = func;
+
+      if (ivl_scope_is_auto(func))
+	    cxx_sorry(ivl_scope_file(func), ivl_scope_lineno(func),
+		      "Automatic functions are not supported.");
+      emit_stmt(code, ivl_scope_def(func));
+
+      std::string def;
+      def += cxx_printf("\n/* function %s */\n", ivl_scope_name(func));
+      def += cxx_printf("static void func_F%u(void)\n{\n", id);
+      for (size_t idx = 0 ; idx < code.temps.size() ; idx += 1)
+	    def += "      static " + code.temps[idx] + "\n";
+      def += code.text;
+      def += "}\n";
+      func_defs.push_back(def);
+}
+
+void emit_processes(ivl_design_t des)
+{
+      ivl_design_process(des, &emit_process, 0);
+
+	/* Writing a function may call for more functions. */
+      for (size_t idx = 0 ; idx < func_list.size() ; idx += 1)
+	    emit_function(func_list[idx], idx);
+}
+
+void emit_code_decl(FILE*out)
+{
+      for (size_t idx = 0 ; idx < func_list.size() ; idx += 1)
+	    fprintf(out, "static void func_F%u(void);\n", (unsigned)idx);
+}
+
+void emit_code(FILE*out)
+{
+      for (size_t idx = 0 ; idx < func_defs.size() ; idx += 1)
+	    fputs(func_defs[idx].c_str(), out);
+      for (size_t idx = 0 ; idx < strobe_defs.size() ; idx += 1)
+	    fputs(strobe_defs[idx].c_str(), out);
+      for (size_t idx = 0 ; idx < proc_defs.size() ; idx += 1)
+	    fputs(proc_defs[idx].c_str(), out);
+}
+
+void emit_code_start(FILE*out)
+{
+      for (size_t idx = 0 ; idx < proc_start.size() ; idx += 1)
+	    fputs(proc_start[idx].c_str(), out);
+}
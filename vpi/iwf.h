@@ -0,0 +1,78 @@
+#ifndef IVL_iwf_H
+#define IVL_iwf_H
+/*
+ * Copyright (c) 2016 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * The IWF (Icarus Waveform Format) file keeps the value changes of
+ * each signal together in chunks, and has an index of the chunks at
+ * the end of the file, so that a reader can get a few signals over a
+ * time window by reading the index and only the chunks that overlap
+ * the window. All numbers are little endian.
+ *
+ *    header:  "IWF\0", u32 version, s32 time precision
+ *    records: 'S' u16 name length, name (the full hierarchical name),
+ *                 u8 type, u32 width, u32 alias
+ *             'C' u32 signal, u32 bytes, u32 changes,
+ *                 u64 first time, u64 last time, then the changes
+ *    index:   'I' u32 signal count, then for each signal
+ *               u16 name length, name, u8 type, u32 width, u32 alias,
+ *               u32 chunk count, then for each chunk
+ *                 u64 file offset, u32 bytes, u32 changes,
+ *                 u64 first time, u64 last time
+ *             u64 end time
+ *    trailer: u64 index offset (after the 'I'), "IWFI"
+ *
+ * The index and the trailer are only written when the dump is closed.
+ * The signal and chunk records hold the same information, so a reader
+ * can rebuild the index by scanning the records of a file that has no
+ * trailer because the simulation did not finish. The chunk offsets in
+ * the index point at the changes, after the record head.
+ *
+ * A signal with an alias (the index of another signal) has no chunks
+ * of its own. The chunks of a signal are in time order. A chunk is a
+ * list of changes, each a varint of (time - previous time) << 1 | xz,
+ * where the previous time of the first change is the first time of
+ * the chunk, followed by the value:
+ *
+ *    IWF_VECTOR: (width+7)/8 bytes of the aval bits, then if xz is
+ *                set the same number of bytes of the bval bits
+ *    IWF_REAL:   the 8 bytes of the double
+ *    IWF_EVENT:  nothing
+ */
+
+# define IWF_VERSION 2
+
+# define IWF_VECTOR 0
+# define IWF_REAL   1
+# define IWF_EVENT  2
+
+# define IWF_NO_ALIAS 0xffffffffU
+
+# define IWF_SIGNAL_TAG 'S'
+# define IWF_CHUNK_TAG  'C'
+# define IWF_INDEX_TAG  'I'
+
+  /* The size of the header, of the trailer and of a chunk record
+     head (the tag and the chunk description). */
+# define IWF_HEADER_BYTES 12
+# define IWF_TRAILER_BYTES 12
+# define IWF_CHUNK_HEAD_BYTES 29
+
+#endif /* IVL_iwf_H */
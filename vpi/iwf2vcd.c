@@ -0,0 +1,346 @@
+/*
+ * Copyright (c) 2016 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * iwf2vcd extracts some signals of an IWF file over a time window and
+ * writes them to the standard output as VCD. Only the chunks of the
+ * selected signals that overlap the window are read.
+ *
+ *    iwf2vcd [-l] [-b <begin>] [-e <end>] <file> [<signal>...]
+ *
+ * The signals are given by their full names, and all the signals are
+ * extracted if none are given. The -l flag lists the signals instead.
+ */
+
+# include  "iwf_read.h"
+# include  <stdio.h>
+# include  <stdlib.h>
+# include  <string.h>
+# include  "ivl_alloc.h"
+
+struct change_s {
+      uint64_t time;
+      uint32_t sel;
+      uint32_t seq;
+      char*value;
+};
+
+struct changes_s {
+      struct change_s*list;
+      size_t count;
+      size_t cap;
+      uint32_t sel;
+};
+
+static void collect_change(void*user, uint32_t sig, uint64_t time,
+                           const char*value)
+{
+      struct changes_s*chg = (struct changes_s*)user;
+      struct change_s*cur;
+      (void)sig; /* Parameter is not used. */
+
+      if (chg->count == chg->cap) {
+	    chg->cap = chg->cap ? 2*chg->cap : 1024;
+	    chg->list = realloc(chg->list, chg->cap * sizeof(*chg->list));
+      }
+
+      cur = chg->list + chg->count;
+      cur->time = time;
+      cur->sel = chg->sel;
+      cur->seq = chg->count;
+      cur->value = strdup(value);
+      chg->count += 1;
+}
+
+static int compare_changes(const void*a, const void*b)
+{
+      const struct change_s*ca = (const struct change_s*)a;
+      const struct change_s*cb = (const struct change_s*)b;
+      if (ca->time != cb->time)
+	    return ca->time < cb->time ? -1 : 1;
+      if (ca->seq != cb->seq)
+	    return ca->seq < cb->seq ? -1 : 1;
+      return 0;
+}
+
+/*
+ * The selected signals, sorted by name so that the scopes can be
+ * written in one pass.
+ */
+struct select_s {
+      uint32_t sig;
+      const char*name;
+      char ident[8];
+};
+
+static int compare_names(const void*a, const void*b)
+{
+      return strcmp(((const struct select_s*)a)->name,
+                    ((const struct select_s*)b)->name);
+}
+
+static void make_ident(char*buf, unsigned idx)
+{
+      do {
+	    *buf++ = '!' + idx % 94;
+	    idx /= 94;
+      } while (idx > 0);
+      *buf = 0;
+}
+
+/*
+ * Return the length of the first component of the hierarchical name,
+ * which is an escaped name up to and including a space, or a plain
+ * name up to a dot.
+ */
+static size_t name_component(const char*name)
+{
+      const char*cp = name;
+      if (*cp == '\\') {
+	    while (*cp && *cp != ' ')
+		  cp += 1;
+	    if (*cp == ' ')
+		  cp += 1;
+	    return cp - name;
+      }
+      while (*cp && *cp != '.')
+	    cp += 1;
+      return cp - name;
+}
+
+static void draw_header(const struct iwf_reader*rd,
+                        const struct select_s*sel, uint32_t nsel)
+{
+      static const char*units[] = { "s", "ms", "us", "ns", "ps", "fs" };
+      const char*prev = "";
+      size_t prev_depth = 0;
+      int prec = iwf_reader_precision(rd);
+      unsigned scale = 1;
+      unsigned udx = 0;
+      uint32_t idx;
+
+      while (prec < 0 && udx < 5) {
+	    udx += 1;
+	    prec += 3;
+      }
+      while (prec > 0) {
+	    scale *= 10;
+	    prec -= 1;
+      }
+
+      printf("$comment Extracted by iwf2vcd $end\n");
+      printf("$timescale %u%s $end\n", scale, units[udx]);
+
+      for (idx = 0 ; idx < nsel ; idx += 1) {
+	    const char*name = sel[idx].name;
+	    const char*pp = prev;
+	    const char*np = name;
+	    size_t depth = 0;
+	    size_t len;
+	    unsigned wid;
+
+	      /* Find how many scopes this name has in common with the
+		 previous name, and close the rest of the previous
+		 scopes. */
+	    for (;;) {
+		  size_t nlen = name_component(np);
+		  size_t plen = name_component(pp);
+		  if (np[nlen] == 0 || pp[plen] == 0 || nlen != plen
+		      || strncmp(np, pp, nlen) != 0)
+			break;
+		  np += nlen + 1;
+		  pp += plen + 1;
+		  depth += 1;
+	    }
+	    for ( ; prev_depth > depth ; prev_depth -= 1)
+		  printf("$upscope $end\n");
+
+	      /* Open the scopes that are new to this name. */
+	    while (np[(len = name_component(np))] != 0) {
+		  printf("$scope module %.*s $end\n", (int)len, np);
+		  np += len + 1;
+		  prev_depth += 1;
+	    }
+
+	    wid = iwf_reader_width(rd, sel[idx].sig);
+	    switch (iwf_reader_type(rd, sel[idx].sig)) {
+		case IWF_REAL:
+		  printf("$var real 1 %s %s $end\n", sel[idx].ident, np);
+		  break;
+		case IWF_EVENT:
+		  printf("$var event 1 %s %s $end\n", sel[idx].ident, np);
+		  break;
+		default:
+		  printf("$var reg %u %s %s $end\n", wid, sel[idx].ident, np);
+		  break;
+	    }
+
+	    prev = name;
+      }
+      for ( ; prev_depth > 0 ; prev_depth -= 1)
+	    printf("$upscope $end\n");
+
+      printf("$enddefinitions $end\n");
+}
+
+static void draw_value(const struct iwf_reader*rd, const struct select_s*sel,
+                       const char*value)
+{
+      switch (iwf_reader_type(rd, sel->sig)) {
+	  case IWF_REAL:
+	    printf("r%s %s\n", value, sel->ident);
+	    break;
+	  case IWF_EVENT:
+	    printf("1%s\n", sel->ident);
+	    break;
+	  default:
+	    if (iwf_reader_width(rd, sel->sig) == 1)
+		  printf("%s%s\n", value, sel->ident);
+	    else
+		  printf("b%s %s\n", value, sel->ident);
+	    break;
+      }
+}
+
+static void usage(void)
+{
+      fprintf(stderr, "usage: iwf2vcd [-l] [-b <begin>] [-e <end>] "
+	      "<file> [<signal>...]\n");
+}
+
+int main(int argc, char*argv[])
+{
+      struct iwf_reader*rd;
+      struct select_s*sel;
+      struct changes_s chg;
+      uint64_t begin = 0;
+      uint64_t end = UINT64_MAX;
+      int list_flag = 0;
+      uint32_t nsel, idx;
+      size_t cdx;
+      int have_time = 0;
+      uint64_t cur_time = 0;
+      int arg;
+
+      for (arg = 1 ; arg < argc && argv[arg][0] == '-' ; arg += 1) {
+	    if (strcmp(argv[arg], "-l") == 0) {
+		  list_flag = 1;
+	    } else if (strcmp(argv[arg], "-b") == 0 && arg+1 < argc) {
+		  begin = strtoull(argv[++arg], 0, 10);
+	    } else if (strcmp(argv[arg], "-e") == 0 && arg+1 < argc) {
+		  end = strtoull(argv[++arg], 0, 10);
+	    } else {
+		  usage();
+		  return 1;
+	    }
+      }
+      if (arg >= argc) {
+	    usage();
+	    return 1;
+      }
+
+      rd = iwf_reader_open(argv[arg]);
+      if (rd == 0) {
+	    fprintf(stderr, "%s: Unable to read IWF file.\n", argv[arg]);
+	    return 1;
+      }
+      if (iwf_reader_scanned(rd))
+	    fprintf(stderr, "%s: Warning: The file has no index (the "
+	            "simulation did not finish), the changes after the "
+	            "last complete chunk are missing.\n", argv[arg]);
+      arg += 1;
+
+      if (list_flag) {
+	    static const char*types[] = { "vector", "real", "event" };
+	    for (idx = 0 ; idx < iwf_reader_signals(rd) ; idx += 1) {
+		  unsigned type = iwf_reader_type(rd, idx);
+		  printf("%s %s %u\n", iwf_reader_name(rd, idx),
+		         type <= IWF_EVENT ? types[type] : "?",
+		         iwf_reader_width(rd, idx));
+	    }
+	    iwf_reader_close(rd);
+	    return 0;
+      }
+
+      if (arg < argc) {
+	    nsel = argc - arg;
+	    sel = calloc(nsel, sizeof(*sel));
+	    for (idx = 0 ; idx < nsel ; idx += 1) {
+		  int32_t sig = iwf_reader_find(rd, argv[arg+idx]);
+		  if (sig < 0) {
+			fprintf(stderr, "%s: No such signal.\n", argv[arg+idx]);
+			free(sel);
+			iwf_reader_close(rd);
+			return 1;
+		  }
+		  sel[idx].sig = sig;
+	    }
+      } else {
+	    nsel = iwf_reader_signals(rd);
+	    sel = calloc(nsel ? nsel : 1, sizeof(*sel));
+	    for (idx = 0 ; idx < nsel ; idx += 1)
+		  sel[idx].sig = idx;
+      }
+
+      for (idx = 0 ; idx < nsel ; idx += 1)
+	    sel[idx].name = iwf_reader_name(rd, sel[idx].sig);
+      qsort(sel, nsel, sizeof(*sel), compare_names);
+      for (idx = 0 ; idx < nsel ; idx += 1)
+	    make_ident(sel[idx].ident, idx);
+
+      memset(&chg, 0, sizeof chg);
+      for (idx = 0 ; idx < nsel ; idx += 1) {
+	    chg.sel = idx;
+	    if (iwf_reader_window(rd, sel[idx].sig, begin, end,
+	                          collect_change, &chg) < 0) {
+		  fprintf(stderr, "%s: Unable to read the changes.\n",
+		          sel[idx].name);
+		  break;
+	    }
+      }
+
+	/* The changes of each signal are in time order, so sorting on
+	   the time and then the order of collection keeps the changes
+	   of a signal at the same time in order. */
+      qsort(chg.list, chg.count, sizeof(*chg.list), compare_changes);
+
+      draw_header(rd, sel, nsel);
+
+      for (cdx = 0 ; cdx < chg.count ; cdx += 1) {
+	    struct change_s*cur = chg.list + cdx;
+	    if (!have_time || cur->time != cur_time) {
+		  if (have_time && cur_time == begin)
+			printf("$end\n");
+		  printf("#%llu\n", (unsigned long long)cur->time);
+		  if (cur->time == begin)
+			printf("$dumpvars\n");
+		  have_time = 1;
+		  cur_time = cur->time;
+	    }
+	    draw_value(rd, sel + cur->sel, cur->value);
+	    free(cur->value);
+      }
+      if (have_time && cur_time == begin)
+	    printf("$end\n");
+
+      free(chg.list);
+      free(sel);
+      iwf_reader_close(rd);
+      return 0;
+}
@@ -0,0 +1,555 @@
+/*
+ * Copyright (c) 2016 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  <config.h>
+# include  "iwf_read.h"
+# include  <stdio.h>
+# include  <stdlib.h>
+# include  <string.h>
+# include  "ivl_alloc.h"
+
+#ifndef HAVE_FSEEKO
+# define fseeko fseek
+# define ftello ftell
+#endif
+
+struct iwf_rchunk {
+      uint64_t offset;
+      uint32_t bytes;
+      uint32_t count;
+      uint64_t first;
+      uint64_t last;
+};
+
+struct iwf_rsignal {
+      char*name;
+      unsigned type;
+      unsigned width;
+      uint32_t alias;
+      uint32_t nchunks;
+      uint32_t chunk_cap;
+      struct iwf_rchunk*chunks;
+};
+
+struct iwf_reader {
+      FILE*fd;
+      int precision;
+	/* Set if the index was rebuilt by scanning the records. */
+      int scanned;
+      uint64_t end_time;
+      uint32_t nsigs;
+      struct iwf_rsignal*sigs;
+	/* Scratch space for a chunk and for a formatted value. */
+      unsigned char*buf;
+      size_t buf_size;
+      char*val;
+      size_t val_size;
+};
+
+/*
+ * The index is read from memory with these, which return 0 when the
+ * data runs out.
+ */
+struct iwf_cursor {
+      const unsigned char*cur;
+      const unsigned char*end;
+};
+
+static int get_bytes(struct iwf_cursor*cp, size_t cnt, const unsigned char**res)
+{
+      if ((size_t)(cp->end - cp->cur) < cnt)
+	    return 0;
+      *res = cp->cur;
+      cp->cur += cnt;
+      return 1;
+}
+
+static uint64_t decode_le(const unsigned char*bp, unsigned cnt)
+{
+      uint64_t res = 0;
+      while (cnt > 0) {
+	    cnt -= 1;
+	    res = (res << 8) | bp[cnt];
+      }
+      return res;
+}
+
+static int get_u32(struct iwf_cursor*cp, uint32_t*res)
+{
+      const unsigned char*bp;
+      if (!get_bytes(cp, 4, &bp))
+	    return 0;
+      *res = (uint32_t)decode_le(bp, 4);
+      return 1;
+}
+
+static int get_u64(struct iwf_cursor*cp, uint64_t*res)
+{
+      const unsigned char*bp;
+      if (!get_bytes(cp, 8, &bp))
+	    return 0;
+      *res = decode_le(bp, 8);
+      return 1;
+}
+
+static int read_at(FILE*fd, uint64_t offset, void*buf, size_t cnt)
+{
+      if (fseeko(fd, offset, SEEK_SET) != 0)
+	    return 0;
+      return fread(buf, 1, cnt, fd) == cnt;
+}
+
+static int read_index(struct iwf_reader*rd, struct iwf_cursor*cp)
+{
+      uint32_t idx, cdx;
+
+      if (!get_u32(cp, &rd->nsigs))
+	    return 0;
+      if (rd->nsigs > (uint32_t)(cp->end - cp->cur))
+	    return 0;
+      rd->sigs = calloc(rd->nsigs ? rd->nsigs : 1, sizeof(*rd->sigs));
+
+      for (idx = 0 ; idx < rd->nsigs ; idx += 1) {
+	    struct iwf_rsignal*sig = rd->sigs + idx;
+	    const unsigned char*bp;
+	    unsigned len;
+
+	    if (!get_bytes(cp, 2, &bp))
+		  return 0;
+	    len = decode_le(bp, 2);
+	    if (!get_bytes(cp, len, &bp))
+		  return 0;
+	    sig->name = malloc(len + 1);
+	    memcpy(sig->name, bp, len);
+	    sig->name[len] = 0;
+
+	    if (!get_bytes(cp, 1, &bp))
+		  return 0;
+	    sig->type = bp[0];
+	    if (!get_u32(cp, &sig->width) || !get_u32(cp, &sig->alias)
+	        || !get_u32(cp, &sig->nchunks))
+		  return 0;
+	    if (sig->nchunks > (uint32_t)(cp->end - cp->cur) / 32)
+		  return 0;
+
+	    sig->chunks = malloc((sig->nchunks ? sig->nchunks : 1)
+	                         * sizeof(*sig->chunks));
+	    for (cdx = 0 ; cdx < sig->nchunks ; cdx += 1) {
+		  struct iwf_rchunk*chunk = sig->chunks + cdx;
+		  if (!get_u64(cp, &chunk->offset) || !get_u32(cp, &chunk->bytes)
+		      || !get_u32(cp, &chunk->count) || !get_u64(cp, &chunk->first)
+		      || !get_u64(cp, &chunk->last))
+			return 0;
+	    }
+      }
+
+      for (idx = 0 ; idx < rd->nsigs ; idx += 1) {
+	    uint32_t alias = rd->sigs[idx].alias;
+	    if (alias != IWF_NO_ALIAS &&
+	        (alias >= rd->nsigs || rd->sigs[alias].alias != IWF_NO_ALIAS))
+		  return 0;
+      }
+
+      return get_u64(cp, &rd->end_time);
+}
+
+static void free_signals(struct iwf_reader*rd)
+{
+      uint32_t idx;
+
+      if (rd->sigs) {
+	    for (idx = 0 ; idx < rd->nsigs ; idx += 1) {
+		  free(rd->sigs[idx].name);
+		  free(rd->sigs[idx].chunks);
+	    }
+      }
+      free(rd->sigs);
+      rd->sigs = 0;
+      rd->nsigs = 0;
+}
+
+/*
+ * Find the index from the trailer and read it. Return 0 if the file
+ * has no (valid) index.
+ */
+static int read_trailer_index(struct iwf_reader*rd, uint64_t file_size)
+{
+      unsigned char tail[IWF_TRAILER_BYTES];
+      struct iwf_cursor cur;
+      unsigned char*index;
+      uint64_t index_offset, index_end;
+      int ok;
+
+      if (file_size < IWF_HEADER_BYTES + IWF_TRAILER_BYTES)
+	    return 0;
+      index_end = file_size - IWF_TRAILER_BYTES;
+      if (!read_at(rd->fd, index_end, tail, sizeof tail)
+          || memcmp(tail+8, "IWFI", 4) != 0)
+	    return 0;
+
+      index_offset = decode_le(tail, 8);
+      if (index_offset < IWF_HEADER_BYTES || index_offset > index_end)
+	    return 0;
+
+      index = malloc(index_end - index_offset + 1);
+      if (!read_at(rd->fd, index_offset, index, index_end - index_offset)) {
+	    free(index);
+	    return 0;
+      }
+
+      cur.cur = index;
+      cur.end = index + (index_end - index_offset);
+      ok = read_index(rd, &cur);
+      free(index);
+
+      if (!ok)
+	    free_signals(rd);
+      return ok;
+}
+
+/*
+ * Rebuild the index from the signal and chunk records of a file that
+ * was not closed. The scan stops at the index or at the first record
+ * that is not complete, so the changes that were still buffered when
+ * the simulation stopped are lost. The end time is the time of the
+ * last change.
+ */
+static void scan_records(struct iwf_reader*rd, uint64_t file_size)
+{
+      uint64_t pos = IWF_HEADER_BYTES;
+      uint32_t sig_cap = 0;
+
+      rd->end_time = 0;
+      while (pos < file_size) {
+	    unsigned char head[IWF_CHUNK_HEAD_BYTES];
+
+	    if (!read_at(rd->fd, pos, head, 1))
+		  break;
+
+	    if (head[0] == IWF_SIGNAL_TAG) {
+		  struct iwf_rsignal*sig;
+		  unsigned char tail[9];
+		  uint32_t alias;
+		  unsigned len;
+		  char*name;
+
+		  if (!read_at(rd->fd, pos+1, head+1, 2))
+			break;
+		  len = decode_le(head+1, 2);
+		  name = malloc(len + 1);
+		  if (!read_at(rd->fd, pos+3, name, len)
+		      || !read_at(rd->fd, pos+3+len, tail, sizeof tail)) {
+			free(name);
+			break;
+		  }
+		  name[len] = 0;
+
+		  alias = (uint32_t)decode_le(tail+5, 4);
+		  if (alias != IWF_NO_ALIAS && (alias >= rd->nsigs
+		      || rd->sigs[alias].alias != IWF_NO_ALIAS)) {
+			free(name);
+			break;
+		  }
+
+		  if (rd->nsigs == sig_cap) {
+			sig_cap = sig_cap ? 2*sig_cap : 64;
+			rd->sigs = realloc(rd->sigs, sig_cap * sizeof(*rd->sigs));
+		  }
+		  sig = rd->sigs + rd->nsigs++;
+		  memset(sig, 0, sizeof(*sig));
+		  sig->name = name;
+		  sig->type = tail[0];
+		  sig->width = (uint32_t)decode_le(tail+1, 4);
+		  sig->alias = alias;
+
+		  pos += 3 + len + sizeof tail;
+
+	    } else if (head[0] == IWF_CHUNK_TAG) {
+		  struct iwf_rsignal*sig;
+		  struct iwf_rchunk*chunk;
+		  uint32_t idx, bytes;
+
+		  if (!read_at(rd->fd, pos, head, sizeof head))
+			break;
+		  idx = (uint32_t)decode_le(head+1, 4);
+		  bytes = (uint32_t)decode_le(head+5, 4);
+		  if (idx >= rd->nsigs || rd->sigs[idx].alias != IWF_NO_ALIAS
+		      || pos + sizeof head + bytes > file_size)
+			break;
+
+		  sig = rd->sigs + idx;
+		  if (sig->nchunks == sig->chunk_cap) {
+			sig->chunk_cap = sig->chunk_cap ? 2*sig->chunk_cap : 4;
+			sig->chunks = realloc(sig->chunks,
+			                      sig->chunk_cap * sizeof(*sig->chunks));
+		  }
+		  chunk = sig->chunks + sig->nchunks++;
+		  chunk->offset = pos + sizeof head;
+		  chunk->bytes = bytes;
+		  chunk->count = (uint32_t)decode_le(head+9, 4);
+		  chunk->first = decode_le(head+13, 8);
+		  chunk->last = decode_le(head+21, 8);
+		  if (chunk->last > rd->end_time)
+			rd->end_time = chunk->last;
+
+		  pos = chunk->offset + bytes;
+
+	    } else {
+		    /* The index, or a record that was not finished. */
+		  break;
+	    }
+      }
+}
+
+struct iwf_reader*iwf_reader_open(const char*path)
+{
+      struct iwf_reader*rd;
+      unsigned char head[IWF_HEADER_BYTES];
+      uint64_t file_size;
+      FILE*fd = fopen(path, "rb");
+      if (fd == 0)
+	    return 0;
+
+      if (fread(head, 1, sizeof head, fd) != sizeof head
+          || memcmp(head, "IWF", 4) != 0
+          || decode_le(head+4, 4) != IWF_VERSION
+          || fseeko(fd, 0, SEEK_END) != 0) {
+	    fclose(fd);
+	    return 0;
+      }
+      file_size = ftello(fd);
+
+      rd = calloc(1, sizeof(*rd));
+      rd->fd = fd;
+      rd->precision = (int32_t)decode_le(head+8, 4);
+
+	/* A file without an index is rebuilt from its records. */
+      if (!read_trailer_index(rd, file_size)) {
+	    scan_records(rd, file_size);
+	    rd->scanned = 1;
+      }
+
+      return rd;
+}
+
+void iwf_reader_close(struct iwf_reader*rd)
+{
+      free_signals(rd);
+      free(rd->buf);
+      free(rd->val);
+      fclose(rd->fd);
+      free(rd);
+}
+
+int iwf_reader_scanned(const struct iwf_reader*rd)
+{
+      return rd->scanned;
+}
+
+int iwf_reader_precision(const struct iwf_reader*rd)
+{
+      return rd->precision;
+}
+
+uint64_t iwf_reader_end_time(const struct iwf_reader*rd)
+{
+      return rd->end_time;
+}
+
+uint32_t iwf_reader_signals(const struct iwf_reader*rd)
+{
+      return rd->nsigs;
+}
+
+const char*iwf_reader_name(const struct iwf_reader*rd, uint32_t sig)
+{
+      return rd->sigs[sig].name;
+}
+
+unsigned iwf_reader_type(const struct iwf_reader*rd, uint32_t sig)
+{
+      return rd->sigs[sig].type;
+}
+
+unsigned iwf_reader_width(const struct iwf_reader*rd, uint32_t sig)
+{
+      return rd->sigs[sig].width;
+}
+
+int32_t iwf_reader_find(const struct iwf_reader*rd, const char*name)
+{
+      uint32_t idx;
+
+      for (idx = 0 ; idx < rd->nsigs ; idx += 1) {
+	    if (strcmp(rd->sigs[idx].name, name) == 0)
+		  return idx;
+      }
+
+      return -1;
+}
+
+/*
+ * Format the value of a change into the value buffer of the reader.
+ */
+static const char*format_value(struct iwf_reader*rd,
+                               const struct iwf_rsignal*sig,
+                               const unsigned char*bp, int xz)
+{
+      static const char bit_chars[4] = { '0', '1', 'z', 'x' };
+      size_t need = sig->type == IWF_VECTOR ? sig->width + 1 : 32;
+      unsigned nbytes = (sig->width + 7) / 8;
+      unsigned idx;
+      uint64_t bits;
+      double val;
+
+      if (need > rd->val_size) {
+	    rd->val_size = need;
+	    rd->val = realloc(rd->val, need);
+      }
+
+      switch (sig->type) {
+	  case IWF_VECTOR:
+	    for (idx = 0 ; idx < sig->width ; idx += 1) {
+		  unsigned bit = (bp[idx/8] >> (idx%8)) & 1;
+		  if (xz)
+			bit |= ((bp[nbytes + idx/8] >> (idx%8)) & 1) << 1;
+		  rd->val[sig->width-idx-1] = bit_chars[bit];
+	    }
+	    rd->val[sig->width] = 0;
+	    break;
+	  case IWF_REAL:
+	    bits = decode_le(bp, 8);
+	    memcpy(&val, &bits, sizeof val);
+	    snprintf(rd->val, rd->val_size, "%.16g", val);
+	    break;
+	  default:
+	    strcpy(rd->val, "1");
+	    break;
+      }
+
+      return rd->val;
+}
+
+static size_t value_bytes(const struct iwf_rsignal*sig, int xz)
+{
+      switch (sig->type) {
+	  case IWF_VECTOR:
+	    return (xz ? 2 : 1) * ((sig->width + 7) / 8);
+	  case IWF_REAL:
+	    return 8;
+	  default:
+	    return 0;
+      }
+}
+
+int iwf_reader_window(struct iwf_reader*rd, uint32_t idx,
+                      uint64_t begin, uint64_t end,
+                      iwf_change_f fun, void*user)
+{
+      const struct iwf_rsignal*sig = rd->sigs + idx;
+      const unsigned char*prev = 0;
+      uint64_t prev_time = 0;
+      int prev_xz = 0;
+      uint32_t lo, hi, cdx;
+
+      if (sig->alias != IWF_NO_ALIAS)
+	    sig = rd->sigs + sig->alias;
+
+	/* Find the first chunk that ends at or after the beginning of
+	   the window. If it starts after the beginning, then the value
+	   at the beginning is the last change of the chunk before. */
+      lo = 0;
+      hi = sig->nchunks;
+      while (lo < hi) {
+	    uint32_t mid = lo + (hi - lo) / 2;
+	    if (sig->chunks[mid].last < begin)
+		  lo = mid + 1;
+	    else
+		  hi = mid;
+      }
+      if (lo > 0 && (lo == sig->nchunks || sig->chunks[lo].first > begin))
+	    lo -= 1;
+
+      for (cdx = lo ; cdx < sig->nchunks ; cdx += 1) {
+	    const struct iwf_rchunk*chunk = sig->chunks + cdx;
+	    struct iwf_cursor cur;
+	    uint64_t now = chunk->first;
+	    uint32_t cnt;
+
+	    if (chunk->first > end)
+		  break;
+
+	    if (chunk->bytes > rd->buf_size) {
+		  rd->buf_size = chunk->bytes;
+		  rd->buf = realloc(rd->buf, rd->buf_size);
+	    }
+	    if (!read_at(rd->fd, chunk->offset, rd->buf, chunk->bytes))
+		  return -1;
+
+	    cur.cur = rd->buf;
+	    cur.end = rd->buf + chunk->bytes;
+	    for (cnt = 0 ; cnt < chunk->count ; cnt += 1) {
+		  uint64_t delta = 0;
+		  unsigned shift = 0;
+		  const unsigned char*bp;
+		  int xz;
+
+		  do {
+			if (!get_bytes(&cur, 1, &bp) || shift > 63)
+			      return -1;
+			delta |= (uint64_t)(*bp & 0x7f) << shift;
+			shift += 7;
+		  } while (*bp & 0x80);
+
+		  xz = delta & 1;
+		  now += delta >> 1;
+		  if (!get_bytes(&cur, value_bytes(sig, xz), &bp))
+			return -1;
+
+		  if (now > end)
+			break;
+
+		  if (now <= begin) {
+			prev = bp;
+			prev_time = now;
+			prev_xz = xz;
+			continue;
+		  }
+
+		    /* The first change inside the window. Report the
+		       value at the beginning first. Events have no value
+		       between changes. */
+		  if (prev && (sig->type != IWF_EVENT || prev_time == begin))
+			fun(user, idx, begin, format_value(rd, sig, prev, prev_xz));
+		  prev = 0;
+
+		  fun(user, idx, now, format_value(rd, sig, bp, xz));
+	    }
+
+	      /* The value at the beginning may be in this chunk, which
+		 is about to be reused, so report it now. */
+	    if (prev) {
+		  if (sig->type != IWF_EVENT || prev_time == begin)
+			fun(user, idx, begin, format_value(rd, sig, prev, prev_xz));
+		  prev = 0;
+	    }
+      }
+
+      return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef IVL_iwf_read_H
+#define IVL_iwf_read_H
+/*
+ * Copyright (c) 2016 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "iwf.h"
+# include  <inttypes.h>
+
+/*
+ * The IWF reader reads the index of the file when it is opened. The
+ * value changes are only read for the signals and the time window
+ * that are asked for. If the file has no index, because the dump was
+ * not closed, the index is rebuilt by scanning the file and
+ * iwf_reader_scanned() returns true.
+ */
+struct iwf_reader;
+
+extern struct iwf_reader*iwf_reader_open(const char*path);
+extern void iwf_reader_close(struct iwf_reader*rd);
+extern int iwf_reader_scanned(const struct iwf_reader*rd);
+
+extern int iwf_reader_precision(const struct iwf_reader*rd);
+extern uint64_t iwf_reader_end_time(const struct iwf_reader*rd);
+
+extern uint32_t iwf_reader_signals(const struct iwf_reader*rd);
+extern const char*iwf_reader_name(const struct iwf_reader*rd, uint32_t sig);
+extern unsigned iwf_reader_type(const struct iwf_reader*rd, uint32_t sig);
+extern unsigned iwf_reader_width(const struct iwf_reader*rd, uint32_t sig);
+
+  /* Return the signal with the given full name, or -1. */
+extern int32_t iwf_reader_find(const struct iwf_reader*rd, const char*name);
+
+/*
+ * Call the function for the value of the signal at the time begin, if
+ * it has one then, and for each change of the signal after begin up
+ * to and including end. Vector values are given as strings of 0, 1, x
+ * and z, most significant bit first, real values as printed with
+ * %.16g, and events as "1". Return 0, or -1 if the file could not be
+ * read.
+ */
+typedef void (*iwf_change_f)(void*user, uint32_t sig, uint64_t time,
+                             const char*value);
+
+extern int iwf_reader_window(struct iwf_reader*rd, uint32_t sig,
+                             uint64_t begin, uint64_t end,
+                             iwf_change_f fun, void*user);
+
+#endif /* IVL_iwf_read_H */
@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2016 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "iwf_write.h"
+# include  <stdio.h>
+# include  <stdlib.h>
+# include  <string.h>
+# include  <assert.h>
+# include  "ivl_alloc.h"
+
+  /* A signal buffer is written as a chunk when it reaches this size. */
+# define IWF_CHUNK_BYTES (16*1024)
+  /* All the buffers are written when together they reach this size. */
+# define IWF_BUFFER_LIMIT (64*1024*1024)
+
+struct iwf_chunk {
+      uint64_t offset;
+      uint32_t bytes;
+      uint32_t count;
+      uint64_t first;
+      uint64_t last;
+};
+
+struct iwf_signal {
+      char*name;
+      unsigned type;
+      unsigned width;
+      uint32_t alias;
+	/* The changes not yet written, and the times of the first and
+	   the last of them. */
+      unsigned char*buf;
+      size_t used;
+      size_t size;
+      uint32_t count;
+      uint64_t first;
+      uint64_t last;
+	/* The chunks already written. */
+      struct iwf_chunk*chunks;
+      uint32_t nchunks;
+      uint32_t chunk_cap;
+};
+
+struct iwf_writer {
+      FILE*fd;
+      uint64_t offset;
+      uint64_t now;
+      struct iwf_signal*sigs;
+      uint32_t nsigs;
+      uint32_t sig_cap;
+      size_t buffered;
+};
+
+static void put_u8(FILE*fd, unsigned val)
+{
+      fputc(val & 0xff, fd);
+}
+
+static void put_u16(FILE*fd, unsigned val)
+{
+      put_u8(fd, val);
+      put_u8(fd, val >> 8);
+}
+
+static void put_u32(FILE*fd, uint32_t val)
+{
+      put_u16(fd, val);
+      put_u16(fd, val >> 16);
+}
+
+static void put_u64(FILE*fd, uint64_t val)
+{
+      put_u32(fd, (uint32_t)val);
+      put_u32(fd, (uint32_t)(val >> 32));
+}
+
+struct iwf_writer*iwf_writer_create(const char*path, int precision)
+{
+      struct iwf_writer*wr;
+      FILE*fd = fopen(path, "wb");
+      if (fd == 0)
+	    return 0;
+
+      wr = calloc(1, sizeof(*wr));
+      wr->fd = fd;
+
+      fwrite("IWF", 1, 4, fd);
+      put_u32(fd, IWF_VERSION);
+      put_u32(fd, (uint32_t)precision);
+      wr->offset = IWF_HEADER_BYTES;
+
+      return wr;
+}
+
+uint32_t iwf_writer_add_signal(struct iwf_writer*wr, const char*name,
+                               unsigned type, unsigned width, uint32_t alias)
+{
+      struct iwf_signal*sig;
+      size_t len;
+
+      if (wr->nsigs == wr->sig_cap) {
+	    wr->sig_cap = wr->sig_cap ? 2*wr->sig_cap : 64;
+	    wr->sigs = realloc(wr->sigs, wr->sig_cap * sizeof(*wr->sigs));
+      }
+
+      sig = wr->sigs + wr->nsigs;
+      memset(sig, 0, sizeof(*sig));
+      sig->name = strdup(name);
+      sig->type = type;
+      sig->width = width;
+      sig->alias = alias;
+
+	/* The signal record lets a reader rebuild the index if the
+	   file is never closed. */
+      len = strlen(name);
+      if (len > 0xffff)
+	    len = 0xffff;
+      put_u8(wr->fd, IWF_SIGNAL_TAG);
+      put_u16(wr->fd, len);
+      fwrite(name, 1, len, wr->fd);
+      put_u8(wr->fd, type);
+      put_u32(wr->fd, width);
+      put_u32(wr->fd, alias);
+      wr->offset += 1 + 2 + len + 1 + 4 + 4;
+
+      return wr->nsigs++;
+}
+
+void iwf_writer_set_time(struct iwf_writer*wr, uint64_t now)
+{
+      assert(now >= wr->now);
+      wr->now = now;
+}
+
+static void write_chunk(struct iwf_writer*wr, struct iwf_signal*sig)
+{
+      struct iwf_chunk*chunk;
+
+      if (sig->used == 0)
+	    return;
+
+      if (sig->nchunks == sig->chunk_cap) {
+	    sig->chunk_cap = sig->chunk_cap ? 2*sig->chunk_cap : 4;
+	    sig->chunks = realloc(sig->chunks,
+	                          sig->chunk_cap * sizeof(*sig->chunks));
+      }
+
+      chunk = sig->chunks + sig->nchunks++;
+      chunk->offset = wr->offset + IWF_CHUNK_HEAD_BYTES;
+      chunk->bytes = sig->used;
+      chunk->count = sig->count;
+      chunk->first = sig->first;
+      chunk->last = sig->last;
+
+      put_u8(wr->fd, IWF_CHUNK_TAG);
+      put_u32(wr->fd, sig - wr->sigs);
+      put_u32(wr->fd, chunk->bytes);
+      put_u32(wr->fd, chunk->count);
+      put_u64(wr->fd, chunk->first);
+      put_u64(wr->fd, chunk->last);
+      fwrite(sig->buf, 1, sig->used, wr->fd);
+      wr->offset += IWF_CHUNK_HEAD_BYTES + sig->used;
+      wr->buffered -= sig->used;
+      sig->used = 0;
+      sig->count = 0;
+}
+
+void iwf_writer_flush(struct iwf_writer*wr)
+{
+      uint32_t idx;
+
+      for (idx = 0 ; idx < wr->nsigs ; idx += 1)
+	    write_chunk(wr, wr->sigs + idx);
+      fflush(wr->fd);
+}
+
+/*
+ * Start a change of the signal, with room for the given number of
+ * value bytes, and return a pointer to where the value goes.
+ */
+static unsigned char*start_change(struct iwf_writer*wr, struct iwf_signal*sig,
+                                  int xz, size_t val_bytes)
+{
+      uint64_t delta;
+      unsigned char*cp;
+
+      assert(sig->alias == IWF_NO_ALIAS);
+
+      if (sig->used + 10 + val_bytes > sig->size) {
+	    size_t need = sig->used + 10 + val_bytes;
+	    size_t size = sig->size ? 2*sig->size : 64;
+	    while (size < need)
+		  size *= 2;
+	    sig->buf = realloc(sig->buf, size);
+	    sig->size = size;
+      }
+
+      if (sig->count == 0)
+	    sig->first = wr->now;
+      delta = ((wr->now - (sig->count ? sig->last : sig->first)) << 1) | (xz != 0);
+      sig->last = wr->now;
+      sig->count += 1;
+
+      cp = sig->buf + sig->used;
+      while (delta >= 0x80) {
+	    *cp++ = (delta & 0x7f) | 0x80;
+	    delta >>= 7;
+      }
+      *cp++ = delta;
+
+      wr->buffered += (cp - (sig->buf + sig->used)) + val_bytes;
+      sig->used = (cp - sig->buf) + val_bytes;
+      return cp;
+}
+
+static void finish_change(struct iwf_writer*wr, struct iwf_signal*sig)
+{
+      if (sig->used >= IWF_CHUNK_BYTES)
+	    write_chunk(wr, sig);
+      if (wr->buffered >= IWF_BUFFER_LIMIT)
+	    iwf_writer_flush(wr);
+}
+
+void iwf_writer_emit_vector(struct iwf_writer*wr, uint32_t idx,
+                            const uint32_t*vals)
+{
+      struct iwf_signal*sig = wr->sigs + idx;
+      unsigned nbytes = (sig->width + 7) / 8;
+      unsigned nwords = (sig->width + 31) / 32;
+      unsigned char*cp;
+      unsigned bdx;
+      int xz = 0;
+
+      for (bdx = 0 ; bdx < nwords ; bdx += 1) {
+	    if (vals[2*bdx+1]) {
+		  xz = 1;
+		  break;
+	    }
+      }
+
+      cp = start_change(wr, sig, xz, xz ? 2*nbytes : nbytes);
+      for (bdx = 0 ; bdx < nbytes ; bdx += 1)
+	    cp[bdx] = vals[2*(bdx/4)] >> (8*(bdx%4));
+      if (xz) {
+	    for (bdx = 0 ; bdx < nbytes ; bdx += 1)
+		  cp[nbytes+bdx] = vals[2*(bdx/4)+1] >> (8*(bdx%4));
+      }
+
+      finish_change(wr, sig);
+}
+
+void iwf_writer_emit_x(struct iwf_writer*wr, uint32_t idx)
+{
+      struct iwf_signal*sig = wr->sigs + idx;
+      unsigned nbytes = (sig->width + 7) / 8;
+      unsigned char*cp;
+
+      cp = start_change(wr, sig, 1, 2*nbytes);
+      memset(cp, 0xff, 2*nbytes);
+	/* Keep the bits above the width clear. */
+      if (sig->width % 8) {
+	    cp[nbytes-1] = (1 << (sig->width % 8)) - 1;
+	    cp[2*nbytes-1] = cp[nbytes-1];
+      }
+
+      finish_change(wr, sig);
+}
+
+void iwf_writer_emit_real(struct iwf_writer*wr, uint32_t idx, double val)
+{
+      struct iwf_signal*sig = wr->sigs + idx;
+      unsigned char*cp;
+      uint64_t bits;
+      unsigned bdx;
+
+      memcpy(&bits, &val, sizeof bits);
+      cp = start_change(wr, sig, 0, 8);
+      for (bdx = 0 ; bdx < 8 ; bdx += 1)
+	    cp[bdx] = bits >> (8*bdx);
+
+      finish_change(wr, sig);
+}
+
+void iwf_writer_emit_event(struct iwf_writer*wr, uint32_t idx)
+{
+      struct iwf_signal*sig = wr->sigs + idx;
+
+      start_change(wr, sig, 0, 0);
+      finish_change(wr, sig);
+}
+
+uint64_t iwf_writer_size(const struct iwf_writer*wr)
+{
+      return wr->offset;
+}
+
+void iwf_writer_close(struct iwf_writer*wr)
+{
+      uint64_t index_offset;
+      uint32_t idx, cdx;
+
+      iwf_writer_flush(wr);
+
+      put_u8(wr->fd, IWF_INDEX_TAG);
+      index_offset = wr->offset + 1;
+      put_u32(wr->fd, wr->nsigs);
+      for (idx = 0 ; idx < wr->nsigs ; idx += 1) {
+	    struct iwf_signal*sig = wr->sigs + idx;
+	    size_t len = strlen(sig->name);
+	    if (len > 0xffff)
+		  len = 0xffff;
+	    put_u16(wr->fd, len);
+	    fwrite(sig->name, 1, len, wr->fd);
+	    put_u8(wr->fd, sig->type);
+	    put_u32(wr->fd, sig->width);
+	    put_u32(wr->fd, sig->alias);
+	    put_u32(wr->fd, sig->nchunks);
+	    for (cdx = 0 ; cdx < sig->nchunks ; cdx += 1) {
+		  struct iwf_chunk*chunk = sig->chunks + cdx;
+		  put_u64(wr->fd, chunk->offset);
+		  put_u32(wr->fd, chunk->bytes);
+		  put_u32(wr->fd, chunk->count);
+		  put_u64(wr->fd, chunk->first);
+		  put_u64(wr->fd, chunk->last);
+	    }
+
+	    free(sig->name);
+	    free(sig->buf);
+	    free(sig->chunks);
+      }
+      put_u64(wr->fd, wr->now);
+
+      put_u64(wr->fd, index_offset);
+      fwrite("IWFI", 1, 4, wr->fd);
+
+      fclose(wr->fd);
+      free(wr->sigs);
+      free(wr);
+}
@@ -0,0 +1,62 @@
+#ifndef IVL_iwf_write_H
+#define IVL_iwf_write_H
+/*
+ * Copyright (c) 2016 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "iwf.h"
+# include  <inttypes.h>
+
+/*
+ * The IWF writer collects the value changes of each signal in a
+ * buffer of its own, and writes the buffer out as a chunk when it is
+ * full. Each signal and chunk is also described by a record in
+ * front of it, so a reader can do without the index, which is only
+ * written when the file is closed.
+ */
+struct iwf_writer;
+
+extern struct iwf_writer*iwf_writer_create(const char*path, int precision);
+
+  /* Add a signal and return its handle. The alias is the handle of a
+     signal with the same value, or IWF_NO_ALIAS. */
+extern uint32_t iwf_writer_add_signal(struct iwf_writer*wr,
+                                      const char*name, unsigned type,
+                                      unsigned width, uint32_t alias);
+
+  /* Set the time of the following changes. The time only increases. */
+extern void iwf_writer_set_time(struct iwf_writer*wr, uint64_t now);
+
+  /* The vector value is given as (width+31)/32 pairs of aval/bval
+     words, the same as a vpiVectorVal. */
+extern void iwf_writer_emit_vector(struct iwf_writer*wr, uint32_t sig,
+                                   const uint32_t*vals);
+extern void iwf_writer_emit_x(struct iwf_writer*wr, uint32_t sig);
+extern void iwf_writer_emit_real(struct iwf_writer*wr, uint32_t sig,
+                                 double val);
+extern void iwf_writer_emit_event(struct iwf_writer*wr, uint32_t sig);
+
+  /* Write out all the buffered changes. */
+extern void iwf_writer_flush(struct iwf_writer*wr);
+
+  /* Return the bytes written so far, not counting buffered changes. */
+extern uint64_t iwf_writer_size(const struct iwf_writer*wr);
+
+extern void iwf_writer_close(struct iwf_writer*wr);
+
+#endif /* IVL_iwf_write_H */
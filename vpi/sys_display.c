@@ -84,6 +84,27 @@ static void my_mcd_rawwrite(PLI_UINT32 mcd, const char*buf, size_t count)
 
 struct timeformat_info_s timeformat_info = { 0, 0, 0, 20 };
 
+/*
+ * A format string is compiled into a list of operations: the literal
+ * text between the conversions, and the conversions with their flags.
+ * The format strings that are fixed for a call site are compiled once
+ * by the compiletf routine, so that they are not parsed for each call.
+ */
+struct format_op_s {
+	/* The literal text, or 0 if this is a conversion. */
+      const char*text;
+      unsigned len;
+      int ljust, plus, ld_zero, width, prec;
+      char fmt;
+};
+
+struct format_s {
+	/* The copy of the format string that the literal ops point into. */
+      char*text;
+      unsigned nops;
+      struct format_op_s*ops;
+};
+
 struct strobe_cb_info {
       const char*name;
       char*filename;
@@ -91,10 +112,58 @@ struct strobe_cb_info {
       int default_format;
       vpiHandle scope;
       vpiHandle*items;
+	/* The vpiType of each item, and the compiled format of the items
+	 * that are constant strings. These do not change between calls. */
+      PLI_INT32*types;
+      struct format_s**formats;
       unsigned nitems;
       unsigned fd_mcd;
+	/* The file/MC descriptor argument of a $fdisplay call site. */
+      vpiHandle fd_item;
+	/* The call sites are listed so they can be freed at the end. */
+      struct strobe_cb_info*next;
 };
 
+/*
+ * The formatted text is collected in a growable buffer. The text is
+ * always terminated with a '\0', but because %u and %z may put
+ * embedded NULL characters into it, len is the real size.
+ */
+struct display_buf_s {
+      char*text;
+      unsigned int len;
+      unsigned int size;
+};
+
+static struct display_buf_s display_result = { 0, 0, 0 };
+
+static char*buf_reserve(struct display_buf_s*buf, unsigned int cnt)
+{
+      if (buf->len + cnt + 1 > buf->size) {
+	    unsigned int size = buf->size? buf->size : 256;
+	    while (buf->len + cnt + 1 > size) size *= 2;
+	    buf->text = realloc(buf->text, size);
+	    buf->size = size;
+      }
+      return buf->text + buf->len;
+}
+
+static void buf_append(struct display_buf_s*buf, const char*text,
+                       unsigned int cnt)
+{
+      char*cp = buf_reserve(buf, cnt);
+      memcpy(cp, text, cnt);
+      buf->len += cnt;
+      buf->text[buf->len] = 0;
+}
+
+static void buf_reset(struct display_buf_s*buf)
+{
+      buf_reserve(buf, 0);
+      buf->len = 0;
+      buf->text[0] = 0;
+}
+
 /*
  * The number of decimal digits needed to represent a
  * nr_bits binary number is floor(nr_bits*log_10(2))+1,
@@ -135,6 +204,87 @@ static int vpi_get_dec_size(vpiHandle item)
 	);
 }
 
+/*
+ * The text of a string literal or parameter never changes, so it is
+ * fetched once and kept with the call site. The strings on the thread
+ * stack (e.g. {"a",s} or the result of a string function) are also
+ * vpiStringConst constants, but have a new value for every call.
+ */
+static int is_fixed_string(vpiHandle item, PLI_INT32 type)
+{
+      if (type != vpiConstant && type != vpiParameter) return 0;
+      if (vpi_get(vpiConstType, item) != vpiStringConst) return 0;
+#ifdef BR916_STOPGAP_FIX
+      return vpi_get(_vpiFromThr, item) == _vpiNoThr;
+#else
+      return type == vpiParameter;
+#endif
+}
+
+static struct format_s*compile_format(const char*fmt)
+{
+      struct format_s*res = malloc(sizeof(struct format_s));
+      char*cp;
+
+      res->text = strdup(fmt);
+      res->nops = 0;
+      res->ops = 0;
+
+      cp = res->text;
+      while (*cp) {
+	    size_t cnt = strcspn(cp, "%");
+	    struct format_op_s*op;
+
+	    res->ops = realloc(res->ops,
+	                       (res->nops+1)*sizeof(struct format_op_s));
+	    op = res->ops + res->nops;
+	    res->nops += 1;
+
+	    if (cnt > 0) {
+		  op->text = cp;
+		  op->len = cnt;
+		  cp += cnt;
+		  continue;
+	    }
+
+	    op->text = 0;
+	    op->len = 0;
+	    op->ljust = 0;
+	    op->plus = 0;
+	    op->ld_zero = 0;
+	    op->width = -1;
+	    op->prec = -1;
+
+	    cp += 1;
+	    while ((*cp == '-') || (*cp == '+')) {
+		  if (*cp == '-') op->ljust = 1;
+		  else op->plus = 1;
+		  cp += 1;
+	    }
+	    if (*cp == '0') {
+		  op->ld_zero = 1;
+		  cp += 1;
+	    }
+	    if (isdigit((int)*cp)) op->width = strtoul(cp, &cp, 10);
+	    if (*cp == '.') {
+		  cp += 1;
+		  op->prec = strtoul(cp, &cp, 10);
+	    }
+	    op->fmt = *cp;
+	    if (*cp) cp += 1;
+      }
+
+      return res;
+}
+
+static void free_format(struct format_s*fmt)
+{
+      if (fmt == 0) return;
+      free(fmt->text);
+      free(fmt->ops);
+      free(fmt);
+}
+
 static void array_from_iterator(struct strobe_cb_info*info, vpiHandle argv)
 {
       if (argv) {
@@ -157,13 +307,41 @@ static void array_from_iterator(struct strobe_cb_info*info, vpiHandle argv)
 
 	    info->nitems = nitems;
 	    info->items = items;
+	    info->types = malloc(nitems*sizeof(PLI_INT32));
+	    info->formats = calloc(nitems, sizeof(struct format_s*));
+	    for (nitems = 0 ;  nitems < info->nitems ;  nitems += 1) {
+		  PLI_INT32 type = vpi_get(vpiType, items[nitems]);
+		  info->types[nitems] = type;
+		  if (is_fixed_string(items[nitems], type)) {
+			s_vpi_value value;
+			value.format = vpiStringVal;
+			vpi_get_value(items[nitems], &value);
+			info->formats[nitems] = compile_format(value.value.str);
+		  }
+	    }
 
       } else {
 	    info->nitems = 0;
 	    info->items = 0;
+	    info->types = 0;
+	    info->formats = 0;
       }
 }
 
+static void free_item_array(struct strobe_cb_info*info)
+{
+      unsigned idx;
+      for (idx = 0 ;  idx < info->nitems ;  idx += 1)
+	    free_format(info->formats[idx]);
+      free(info->items);
+      free(info->types);
+      free(info->formats);
+      info->items = 0;
+      info->types = 0;
+      info->formats = 0;
+      info->nitems = 0;
+}
+
 static int get_default_format(const char *name)
 {
     int default_format;
@@ -628,7 +806,7 @@ static unsigned int get_format_char(char **rtn, int ljust, int plus,
         PLI_INT32 type;
 
         /* Get the argument type and value. */
-        type = vpi_get(vpiType, info->items[*idx]);
+        type = info->types[*idx];
         if (((type == vpiConstant || type == vpiParameter) &&
              vpi_get(vpiConstType, info->items[*idx]) == vpiRealConst) ||
             type == vpiRealVar || (type == vpiSysFuncCall &&
@@ -880,58 +1058,41 @@ static unsigned int get_format_char(char **rtn, int ljust, int plus,
   return size - 1;
 }
 
-/* We can't use the normal str functions on the return value since
- * %u and %z can insert NULL characters into the stream. */
-static unsigned int get_format(char **rtn, char *fmt,
-                               const struct strobe_cb_info *info, unsigned int *idx)
+/* We can't use the normal str functions on the result since %u and
+ * %z can insert NULL characters into the stream. */
+static void run_format(struct display_buf_s*buf, const struct format_s*fmt,
+                       const struct strobe_cb_info *info, unsigned int *idx)
 {
-  char *cp = fmt;
-  unsigned int size;
+      unsigned op_idx;
 
-  *rtn = strdup("");
-  size = 1;
-  while (*cp) {
-    size_t cnt = strcspn(cp, "%");
+      for (op_idx = 0 ;  op_idx < fmt->nops ;  op_idx += 1) {
+	    const struct format_op_s*op = fmt->ops + op_idx;
+	    char *result;
+	    unsigned int cnt;
 
-    if (cnt > 0) {
-      *rtn = realloc(*rtn, (size+cnt)*sizeof(char));
-      memcpy(*rtn+size-1, cp, cnt);
-      size += cnt;
-      cp += cnt;
-    } else {
-      int ljust = 0, plus = 0, ld_zero = 0, width = -1, prec = -1;
-      char *result;
-
-      cp += 1;
-      while ((*cp == '-') || (*cp == '+')) {
-        if (*cp == '-') ljust = 1;
-        else plus = 1;
-        cp += 1;
-      }
-      if (*cp == '0') {
-        ld_zero = 1;
-        cp += 1;
-      }
-      if (isdigit((int)*cp)) width = strtoul(cp, &cp, 10);
-      if (*cp == '.') {
-        cp += 1;
-        prec = strtoul(cp, &cp, 10);
+	    if (op->text) {
+		  buf_append(buf, op->text, op->len);
+		  continue;
+	    }
+
+	    cnt = get_format_char(&result, op->ljust, op->plus, op->ld_zero,
+	                          op->width, op->prec, op->fmt, info, idx);
+	    buf_append(buf, result, cnt);
+	    free(result);
       }
-      cnt = get_format_char(&result, ljust, plus, ld_zero, width, prec, *cp,
-                            info, idx);
-      *rtn = realloc(*rtn, (size+cnt)*sizeof(char));
-      memcpy(*rtn+size-1, result, cnt);
-      free(result);
-      size += cnt;
-      if (*cp) cp += 1;
-    }
-  }
-  *(*rtn+size-1) = '\0';
-  return size - 1;
 }
 
-static unsigned int get_numeric(char **rtn, const struct strobe_cb_info *info,
-                                vpiHandle item)
+/* Format a string that is only known when the task is called. */
+static void get_format(struct display_buf_s*buf, const char*fmt,
+                       const struct strobe_cb_info *info, unsigned int *idx)
+{
+      struct format_s*cfmt = compile_format(fmt);
+      run_format(buf, cfmt, info, idx);
+      free_format(cfmt);
+}
+
+static void get_numeric(struct display_buf_s*buf,
+                        const struct strobe_cb_info *info, vpiHandle item)
 {
   int size, min;
   s_vpi_value val;
@@ -947,64 +1108,59 @@ static unsigned int get_numeric(char **rtn, const struct strobe_cb_info *info,
 	 * the string width the minimum display width. */
       min = strlen(val.value.str);
       if (size < min) size = min;
-      *rtn = malloc((size+1)*sizeof(char));
-      sprintf(*rtn, "%*s", size, val.value.str);
+      sprintf(buf_reserve(buf, size), "%*s", size, val.value.str);
+      buf->len += size;
       break;
     default:
-      *rtn = strdup(val.value.str);
+      buf_append(buf, val.value.str, strlen(val.value.str));
   }
-
-  return strlen(*rtn);
 }
 
 /* In many places we can't use the normal str functions since %u and %z
  * can insert NULL characters into the stream. */
-static char *get_display(unsigned int *rtnsz, const struct strobe_cb_info *info)
+static void get_display(struct display_buf_s*buf,
+                        const struct strobe_cb_info *info)
 {
-  char *result, *fmt, *rtn, *func_name;
-  const char *cresult;
+  char *func_name;
   s_vpi_value value;
-  unsigned int idx, size, width;
-  char buf[256];
+  unsigned int idx, width;
+  char tbuf[256];
 
-  rtn = strdup("");
-  size = 1;
   for  (idx = 0; idx < info->nitems; idx += 1) {
     vpiHandle item = info->items[idx];
 
-    switch (vpi_get(vpiType, item)) {
+    switch (info->types[idx]) {
 
       case vpiConstant:
       case vpiParameter:
-        if (vpi_get(vpiConstType, item) == vpiStringConst) {
+        if (info->formats[idx]) {
+          run_format(buf, info->formats[idx], info, &idx);
+        } else if (vpi_get(vpiConstType, item) == vpiStringConst) {
+            /* A string from the thread stack, so get it every time. It
+             * is copied by get_format since the format may fetch other
+             * values. */
           value.format = vpiStringVal;
           vpi_get_value(item, &value);
-          fmt = strdup(value.value.str);
-          width = get_format(&result, fmt, info, &idx);
-          free(fmt);
+          get_format(buf, value.value.str, info, &idx);
         } else if (vpi_get(vpiConstType, item) == vpiRealConst) {
           value.format = vpiRealVal;
           vpi_get_value(item, &value);
 #if !defined(__GNUC__)
 		  if(compatible_flag)
-			  sprintf(buf, "%g", value.value.real);
+			  sprintf(tbuf, "%g", value.value.real);
 		  else {
 			  if(value.value.real == 0.0 || value.value.real == -0.0)
-				  sprintf(buf, "%.05f", value.value.real);
+				  sprintf(tbuf, "%.05f", value.value.real);
 			  else
-				  sprintf(buf, "%#g", value.value.real);
+				  sprintf(tbuf, "%#g", value.value.real);
 		  }
 #else
-          sprintf(buf, compatible_flag ? "%g" : "%#g", value.value.real);
+          sprintf(tbuf, compatible_flag ? "%g" : "%#g", value.value.real);
 #endif
-          result = strdup(buf);
-          width = strlen(result);
+          buf_append(buf, tbuf, strlen(tbuf));
         } else {
-          width = get_numeric(&result, info, item);
+          get_numeric(buf, info, item);
         }
-        rtn = realloc(rtn, (size+width)*sizeof(char));
-        memcpy(rtn+size-1, result, width);
-        free(result);
         break;
 
       case vpiNet:
@@ -1017,10 +1173,7 @@ static char *get_display(unsigned int *rtnsz, const struct strobe_cb_info *info)
       case vpiIntegerVar:
       case vpiMemoryWord:
       case vpiPartSelect:
-        width = get_numeric(&result, info, item);
-        rtn = realloc(rtn, (size+width)*sizeof(char));
-        memcpy(rtn+size-1, result, width);
-        free(result);
+        get_numeric(buf, info, item);
         break;
 
       /* It appears that this is not currently used! A time variable is
@@ -1029,12 +1182,12 @@ static char *get_display(unsigned int *rtnsz, const struct strobe_cb_info *info)
       case vpiTimeVar:
         value.format = vpiDecStrVal;
         vpi_get_value(item, &value);
-        get_time(buf, value.value.str, timeformat_info.prec,
+        get_time(tbuf, value.value.str, timeformat_info.prec,
                  vpi_get(vpiTimeUnit, info->scope));
-        width = strlen(buf);
+        width = strlen(tbuf);
         if (width  < timeformat_info.width) width = timeformat_info.width;
-        rtn = realloc(rtn, (size+width)*sizeof(char));
-        sprintf(rtn+size-1, "%*s", width, buf);
+        sprintf(buf_reserve(buf, width), "%*s", width, tbuf);
+        buf->len += width;
         break;
 
       /* Realtime variables are also processed here. */
@@ -1043,19 +1196,17 @@ static char *get_display(unsigned int *rtnsz, const struct strobe_cb_info *info)
         vpi_get_value(item, &value);
 #if !defined(__GNUC__)
 		if (compatible_flag)
-			sprintf(buf, "%g", value.value.real);
+			sprintf(tbuf, "%g", value.value.real);
 		else {
 			if (value.value.real == 0.0 || value.value.real == -0.0)
-				sprintf(buf, "%.05f", value.value.real);
+				sprintf(tbuf, "%.05f", value.value.real);
 			else
-				sprintf(buf, "%#g", value.value.real);
+				sprintf(tbuf, "%#g", value.value.real);
 		}
 #else
-        sprintf(buf, compatible_flag ? "%g" : "%#g", value.value.real);
+        sprintf(tbuf, compatible_flag ? "%g" : "%#g", value.value.real);
 #endif
-        width = strlen(buf);
-        rtn = realloc(rtn, (size+width)*sizeof(char));
-        memcpy(rtn+size-1, buf, width);
+        buf_append(buf, tbuf, strlen(tbuf));
         break;
 
        /* Process string variables like string constants: interpret
@@ -1063,12 +1214,7 @@ static char *get_display(unsigned int *rtnsz, const struct strobe_cb_info *info)
       case vpiStringVar:
 	value.format = vpiStringVal;
 	vpi_get_value(item, &value);
-	fmt = strdup(value.value.str);
-	width = get_format(&result, fmt, info, &idx);
-	free(fmt);
-        rtn = realloc(rtn, (size+width)*sizeof(char));
-        memcpy(rtn+size-1, result, width);
-        free(result);
+	get_format(buf, value.value.str, info, &idx);
 	break;
 
       case vpiSysFuncCall:
@@ -1078,24 +1224,24 @@ static char *get_display(unsigned int *rtnsz, const struct strobe_cb_info *info)
           vpi_get_value(item, &value);
           width = strlen(value.value.str);
           if (width  < 20) width = 20;
-          rtn = realloc(rtn, (size+width)*sizeof(char));
-          sprintf(rtn+size-1, "%*s", width, value.value.str);
+          sprintf(buf_reserve(buf, width), "%*s", width, value.value.str);
+          buf->len += width;
 
         } else if (strcmp(func_name, "$stime") == 0) {
           value.format = vpiDecStrVal;
           vpi_get_value(item, &value);
           width = strlen(value.value.str);
           if (width  < 10) width = 10;
-          rtn = realloc(rtn, (size+width)*sizeof(char));
-          sprintf(rtn+size-1, "%*s", width, value.value.str);
+          sprintf(buf_reserve(buf, width), "%*s", width, value.value.str);
+          buf->len += width;
 
         } else if (strcmp(func_name, "$simtime") == 0) {
           value.format = vpiDecStrVal;
           vpi_get_value(item, &value);
           width = strlen(value.value.str);
           if (width  < 20) width = 20;
-          rtn = realloc(rtn, (size+width)*sizeof(char));
-          sprintf(rtn+size-1, "%*s", width, value.value.str);
+          sprintf(buf_reserve(buf, width), "%*s", width, value.value.str);
+          buf->len += width;
 
         } else if (strcmp(func_name, "$realtime") == 0) {
           /* Use the local scope precision. */
@@ -1104,18 +1250,13 @@ static char *get_display(unsigned int *rtnsz, const struct strobe_cb_info *info)
           assert(use_prec >= 0);
           value.format = vpiRealVal;
           vpi_get_value(item, &value);
-          sprintf(buf, "%.*f", use_prec, value.value.real);
-          width = strlen(buf);
-          rtn = realloc(rtn, (size+width)*sizeof(char));
-          sprintf(rtn+size-1, "%*s", width, buf);
+          sprintf(tbuf, "%.*f", use_prec, value.value.real);
+          buf_append(buf, tbuf, strlen(tbuf));
 
         } else {
           vpi_printf("WARNING: %s:%d: %s does not support %s as an argument!\n",
                      info->filename, info->lineno, info->name, func_name);
-          strcpy(buf, "<?>");
-          width = strlen(buf);
-          rtn = realloc(rtn, (size+width)*sizeof(char));
-          memcpy(rtn+size-1, buf, width);
+          buf_append(buf, "<?>", 3);
         }
         break;
 
@@ -1123,17 +1264,10 @@ static char *get_display(unsigned int *rtnsz, const struct strobe_cb_info *info)
         vpi_printf("WARNING: %s:%d: unknown argument type (%s) given to %s!\n",
                    info->filename, info->lineno, vpi_get_str(vpiType, item),
                    info->name);
-        cresult = "<?>";
-        width = strlen(cresult);
-        rtn = realloc(rtn, (size+width)*sizeof(char));
-        memcpy(rtn+size-1, cresult, width);
+        buf_append(buf, "<?>", 3);
         break;
     }
-    size += width;
   }
-  rtn[size-1] = '\0';
-  *rtnsz = size - 1;
-  return rtn;
 }
 
 #ifdef BR916_STOPGAP_FIX
@@ -1262,38 +1396,70 @@ static PLI_INT32 sys_common_compiletf(ICARUS_VPI_CONST PLI_BYTE8*name, int no_au
       return 0;
 }
 
+/*
+ * The $display and related tasks keep the argument handles, their
+ * types and the compiled constant formats of each call site in the
+ * user data of the call. This is built by the compiletf routine, and
+ * the call sites are freed by the end of simulation callback.
+ */
+static struct strobe_cb_info*display_call_sites = 0;
+
+static void make_display_info(ICARUS_VPI_CONST PLI_BYTE8*name, vpiHandle callh)
+{
+      struct strobe_cb_info*info;
+      vpiHandle argv, scope;
+
+      argv = vpi_iterate(vpiArgument, callh);
+      scope = vpi_handle(vpiScope, callh);
+      assert(scope);
+
+      info = calloc(1, sizeof(struct strobe_cb_info));
+	/* We could use vpi_get_str(vpiName, callh) to get the task name,
+	 * but name is already defined. */
+      info->name = name;
+      info->filename = strdup(vpi_get_str(vpiFile, callh));
+      info->lineno = (int)vpi_get(vpiLineNo, callh);
+      info->default_format = get_default_format(name);
+      info->scope = scope;
+      if (name[1] == 'f' && argv) info->fd_item = vpi_scan(argv);
+      array_from_iterator(info, argv);
+
+      info->next = display_call_sites;
+      display_call_sites = info;
+      vpi_put_userdata(callh, info);
+}
+
 /* Check the $display, $write, $fdisplay and $fwrite based tasks. */
 static PLI_INT32 sys_display_compiletf(ICARUS_VPI_CONST PLI_BYTE8*name)
 {
 	/* These tasks can have automatic variables and are not monitor. */
-      return sys_common_compiletf(name, 0, 0);
+      sys_common_compiletf(name, 0, 0);
+      make_display_info(name, vpi_handle(vpiSysTfCall, 0));
+      return 0;
 }
 
 /* This implements the $sformatf, $display/$fdisplay
  * and the $write/$fwrite based tasks. */
 static PLI_INT32 sys_display_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
 {
-      vpiHandle callh, argv, scope;
-      struct strobe_cb_info info;
-      char* result;
-      unsigned int size;
+      vpiHandle callh;
+      struct strobe_cb_info*info;
       PLI_UINT32 fd_mcd;
       s_vpi_value val;
 
       callh = vpi_handle(vpiSysTfCall, 0);
-      argv = vpi_iterate(vpiArgument, callh);
+      info = vpi_get_userdata(callh);
+      assert(info);
 
 	/* Get the file/MC descriptor and verify it is valid. */
       if(name[1] == 'f') {
 	      errno = 0;
-	      vpiHandle arg = vpi_scan(argv);
 	      val.format = vpiIntVal;
-	      vpi_get_value(arg, &val);
+	      vpi_get_value(info->fd_item, &val);
 	      fd_mcd = val.value.integer;
 
 		/* If the MCD is zero we have nothing to do so just return. */
 	      if (fd_mcd == 0)  {
-		    vpi_free_object(argv);
 		    return 0;
 	      }
 
@@ -1304,7 +1470,6 @@ static PLI_INT32 sys_display_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
 		    vpi_printf("invalid file descriptor/MCD (0x%x) given "
 		               "to %s.\n", (unsigned int)fd_mcd, name);
 		    errno = EBADF;
-		    vpi_free_object(argv);
 		    return 0;
 	      }
       } else if(strncmp(name,"$sformatf",9) == 0) {
@@ -1315,35 +1480,21 @@ static PLI_INT32 sys_display_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
 	      fd_mcd = 1;
       }
 
-      scope = vpi_handle(vpiScope, callh);
-      assert(scope);
-	/* We could use vpi_get_str(vpiName, callh) to get the task name,
-	 * but name is already defined. */
-      info.name = name;
-      info.filename = strdup(vpi_get_str(vpiFile, callh));
-      info.lineno = (int)vpi_get(vpiLineNo, callh);
-      info.default_format = get_default_format(name);
-      info.scope = scope;
-      array_from_iterator(&info, argv);
-
-	/* Because %u and %z may put embedded NULL characters into the
-	 * returned string strlen() may not match the real size! */
-      result = get_display(&size, &info);
+      buf_reset(&display_result);
+      get_display(&display_result, info);
 
       if(fd_mcd > 0) {
-	      my_mcd_rawwrite(fd_mcd, result, size);
 	      if ((strncmp(name,"$display",8) == 0) ||
-	          (strncmp(name,"$fdisplay",9) == 0)) my_mcd_rawwrite(fd_mcd, "\n", 1);
+	          (strncmp(name,"$fdisplay",9) == 0))
+		    buf_append(&display_result, "\n", 1);
+	      my_mcd_rawwrite(fd_mcd, display_result.text, display_result.len);
       } else {
 	      /* Return as a string ($sformatf) */
 	      val.format = vpiStringVal;
-	      val.value.str = result;
+	      val.value.str = display_result.text;
 	      vpi_put_value(callh, &val, 0, vpiNoDelay);
       }
 
-      free(result);
-      free(info.filename);
-      free(info.items);
       return 0;
 }
 
@@ -1363,18 +1514,15 @@ static PLI_INT32 strobe_cb(p_cb_data cb)
 	 * Which has the same basic effect. */
       if ((! IS_MCD(info->fd_mcd) && vpi_get_file(info->fd_mcd) != NULL) ||
           ( IS_MCD(info->fd_mcd) && my_mcd_printf(info->fd_mcd, "") != EOF)) {
-	    char* result;
-	    unsigned int size;
-	      /* Because %u and %z may put embedded NULL characters into the
-	       * returned string strlen() may not match the real size! */
-	    result = get_display(&size, info);
-	    my_mcd_rawwrite(info->fd_mcd, result, size);
-	    my_mcd_rawwrite(info->fd_mcd, "\n", 1);
-	    free(result);
+	    buf_reset(&display_result);
+	    get_display(&display_result, info);
+	    buf_append(&display_result, "\n", 1);
+	    my_mcd_rawwrite(info->fd_mcd, display_result.text,
+	                    display_result.len);
       }
 
       free(info->filename);
-      free(info->items);
+      free_item_array(info);
       free(info);
       return 0;
 }
@@ -1463,25 +1611,21 @@ static PLI_INT32 sys_strobe_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
  * though that monitor may be watching many variables).
  */
 
-static struct strobe_cb_info monitor_info = { 0, 0, 0, 0, 0, 0, 0, 0 };
+static struct strobe_cb_info monitor_info = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
 static vpiHandle *monitor_callbacks = 0;
 static int monitor_scheduled = 0;
 static int monitor_enabled = 1;
 
 static PLI_INT32 monitor_cb_2(p_cb_data cb)
 {
-      char* result;
-      unsigned int size;
-
       (void)cb; /* Parameter is not used. */
 
-	/* Because %u and %z may put embedded NULL characters into the
-	 * returned string strlen() may not match the real size! */
-      result = get_display(&size, &monitor_info);
-      my_mcd_rawwrite(monitor_info.fd_mcd, result, size);
-      my_mcd_rawwrite(monitor_info.fd_mcd, "\n", 1);
+      buf_reset(&display_result);
+      get_display(&display_result, &monitor_info);
+      buf_append(&display_result, "\n", 1);
+      my_mcd_rawwrite(monitor_info.fd_mcd, display_result.text,
+                      display_result.len);
       monitor_scheduled = 0;
-      free(result);
       return 0;
 }
 
@@ -1551,9 +1695,7 @@ static PLI_INT32 sys_monitor_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 	    monitor_callbacks = 0;
 
 	    free(monitor_info.filename);
-	    free(monitor_info.items);
-	    monitor_info.items = 0;
-	    monitor_info.nitems = 0;
+	    free_item_array(&monitor_info);
 	    monitor_info.name = 0;
       }
 
@@ -1665,7 +1807,6 @@ static PLI_INT32 sys_swrite_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
   vpiHandle callh, argv, reg, scope;
   struct strobe_cb_info info;
   s_vpi_value val;
-  unsigned int size;
 
   callh = vpi_handle(vpiSysTfCall, 0);
   argv = vpi_iterate(vpiArgument, callh);
@@ -1684,17 +1825,18 @@ static PLI_INT32 sys_swrite_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
 
   /* Because %u and %z may put embedded NULL characters into the returned
    * string strlen() may not match the real size! */
-  val.value.str = get_display(&size, &info);
+  buf_reset(&display_result);
+  get_display(&display_result, &info);
+  val.value.str = display_result.text;
   val.format = vpiStringVal;
   vpi_put_value(reg, &val, 0, vpiNoDelay);
-  if (size != strlen(val.value.str)) {
+  if (display_result.len != strlen(val.value.str)) {
     vpi_printf("WARNING: %s:%d: %s returned a value with an embedded NULL "
                "(see %%u/%%z).\n", info.filename, info.lineno, name);
   }
 
-  free(val.value.str);
   free(info.filename);
-  free(info.items);
+  free_item_array(&info);
   return 0;
 }
 
@@ -1754,8 +1896,8 @@ static PLI_INT32 sys_sformat_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
   vpiHandle callh, argv, reg, scope;
   struct strobe_cb_info info;
   s_vpi_value val;
-  char *result, *fmt;
-  unsigned int idx, size;
+  char *fmt;
+  unsigned int idx;
 
   callh = vpi_handle(vpiSysTfCall, 0);
   argv = vpi_iterate(vpiArgument, callh);
@@ -1775,7 +1917,8 @@ static PLI_INT32 sys_sformat_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
   info.scope = scope;
   array_from_iterator(&info, argv);
   idx = -1;
-  size = get_format(&result, fmt, &info, &idx);
+  buf_reset(&display_result);
+  get_format(&display_result, fmt, &info, &idx);
   free(fmt);
 
   if (idx+1< info.nitems) {
@@ -1784,17 +1927,16 @@ static PLI_INT32 sys_sformat_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
                info.nitems-idx-1);
   }
 
-  val.value.str = result;
+  val.value.str = display_result.text;
   val.format = vpiStringVal;
   vpi_put_value(reg, &val, 0, vpiNoDelay);
-  if (size != strlen(val.value.str)) {
+  if (display_result.len != strlen(val.value.str)) {
     vpi_printf("WARNING: %s:%d: %s returned a value with an embedded NULL "
                "(see %%u/%%z).\n", info.filename, info.lineno, name);
   }
 
-  free(val.value.str);
   free(info.filename);
-  free(info.items);
+  free_item_array(&info);
   return 0;
 }
 
@@ -1835,6 +1977,7 @@ static PLI_INT32 sys_sformatf_compiletf(ICARUS_VPI_CONST PLI_BYTE8 *name)
   }
 
   if (sys_check_args(callh, argv, name, 0, 0)) vpi_control(vpiFinish, 1);
+  make_display_info(name, callh);
   return 0;
 }
 
@@ -2134,7 +2277,10 @@ static PLI_INT32 sys_severity_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 
       vpi_printf("%s: %s:%d: ", sstr, info.filename, info.lineno);
 
-      dstr = get_display(&size, &info);
+      buf_reset(&display_result);
+      get_display(&display_result, &info);
+      dstr = display_result.text;
+      size = display_result.len;
       while (location < size) {
 	    if (dstr[location] == '\0') {
 		  my_mcd_printf(1, "%c", '\0');
@@ -2155,8 +2301,7 @@ static PLI_INT32 sys_severity_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 
       free(--sstr);  /* Get the $ back. */
       free(info.filename);
-      free(info.items);
-      free(dstr);
+      free_item_array(&info);
 
       if (strncmp(name,"$fatal",6) == 0) {
             vpi_control(vpiFinish, finish_number.value.integer);
@@ -2172,13 +2317,19 @@ static PLI_INT32 sys_end_of_simulation(p_cb_data cb_data)
       free(monitor_callbacks);
       monitor_callbacks = 0;
       free(monitor_info.filename);
-      free(monitor_info.items);
-      monitor_info.items = 0;
-      monitor_info.nitems = 0;
+      free_item_array(&monitor_info);
       monitor_info.name = 0;
 
       free(timeformat_info.suff);
       timeformat_info.suff = 0;
+
+      while (display_call_sites) {
+	    struct strobe_cb_info*info = display_call_sites;
+	    display_call_sites = info->next;
+	    free(info->filename);
+	    free_item_array(info);
+	    free(info);
+      }
       return 0;
 }
 
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 1999-2015 Stephen Williams (steve@icarus.com)
+ * Copyright (c) 1999-2016 Stephen Williams (steve@icarus.com)
  *
  *    This source code is free software; you can redistribute it
  *    and/or modify it in source code form under the terms of the GNU
@@ -30,6 +30,9 @@
 # include  <string.h>
 # include  <assert.h>
 # include  <time.h>
+#ifdef HAVE_LIBPTHREAD
+# include  <pthread.h>
+#endif
 # include  "ivl_alloc.h"
 
 static char *dump_path = NULL;
@@ -40,14 +43,15 @@ struct vcd_info {
       vpiHandle cb;
       struct t_vpi_time time;
       struct vcd_info *next;
-      struct vcd_info *dmp_next;
       fstHandle handle;
-      int scheduled;
+	/* The type and size of the item do not change, so they are
+	 * looked up once when the item is added to the dump. */
+      PLI_INT32 type;
+      unsigned size;
 };
 
 
 static struct vcd_info *vcd_list = NULL;
-static struct vcd_info *vcd_dmp_list = NULL;
 static PLI_UINT64 vcd_cur_time = 0;
 static int dump_is_off = 0;
 static long dump_limit = 0;
@@ -71,40 +75,445 @@ static const char*units_names[] = {
       "fs"
 };
 
+/*
+ * The simulation thread does not call the FST writer for each value
+ * change. Instead it appends a record with the raw (aval/bval) value
+ * to a block, and the filled blocks are handed to a writer thread that
+ * formats the values and passes them to the FST library, which also
+ * compresses them in that thread. Without pthreads the blocks are
+ * written directly when they are handed off.
+ *
+ * Once the writer thread runs, every call that writes to dump_file
+ * must go through a record so that the FST calls stay in order.
+ *
+ * A fork (e.g. for the runs of $checkpoint) only copies the thread
+ * that calls it, so the writer is stopped before a fork, with all the
+ * queued blocks written, and started again in both processes after
+ * it. For the same reason the FST library is not put in its parallel
+ * mode, since its thread may hold the library lock at the fork.
+ */
+enum fst_rec_kind_e {
+      FST_REC_TIME,
+      FST_REC_VEC,
+      FST_REC_REAL,
+      FST_REC_X,
+      FST_REC_EVENT,
+      FST_REC_ACTIVE,
+      FST_REC_FLUSH,
+      FST_REC_LIMIT
+};
+
+struct fst_rec {
+      unsigned char kind;
+      fstHandle handle;
+	/* The width in bits of a vector or X value. The vector words
+	 * follow the record. */
+      unsigned wid;
+      union {
+	    PLI_UINT64 time;
+	    double real;
+	    long limit;
+	    int active;
+      } u;
+};
+
+#define FST_BLOCK_BYTES (256*1024)
+  /* The number of filled blocks the writer may fall behind by before
+   * the simulation waits for it. */
+#define FST_BLOCK_QUEUE 16
+
+struct fst_block {
+      struct fst_block*next;
+      size_t used;
+      size_t size;
+      char*data;
+};
+
+static struct fst_block*fst_cur_block = 0;
+static struct fst_block*fst_free_blocks = 0;
+static int fst_limit_reached = 0;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_t fst_thread;
+static pthread_mutex_t fst_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t fst_work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t fst_room_cond = PTHREAD_COND_INITIALIZER;
+static struct fst_block*fst_queue_head = 0;
+static struct fst_block*fst_queue_tail = 0;
+static unsigned fst_queue_len = 0;
+static int fst_thread_running = 0;
+static int fst_thread_busy = 0;
+static int fst_thread_stop = 0;
+static int fst_thread_limit = 0;
+static int fst_fork_restart = 0;
+#endif
+
+static size_t fst_rec_size(unsigned kind, unsigned wid)
+{
+      size_t res = sizeof(struct fst_rec);
+      if (kind == FST_REC_VEC)
+	    res += ((wid + 31) / 32) * sizeof(s_vpi_vecval);
+      return res;
+}
+
+static struct fst_block*fst_block_new(size_t need)
+{
+      struct fst_block*blk = 0;
+
+#ifdef HAVE_LIBPTHREAD
+      pthread_mutex_lock(&fst_mutex);
+#endif
+      if (fst_free_blocks && fst_free_blocks->size >= need) {
+	    blk = fst_free_blocks;
+	    fst_free_blocks = blk->next;
+      }
+#ifdef HAVE_LIBPTHREAD
+      pthread_mutex_unlock(&fst_mutex);
+#endif
+
+      if (blk == 0) {
+	    blk = malloc(sizeof(*blk));
+	    blk->size = need > FST_BLOCK_BYTES ? need : FST_BLOCK_BYTES;
+	    blk->data = malloc(blk->size);
+      }
+      blk->next = 0;
+      blk->used = 0;
+      return blk;
+}
+
+static void fst_block_free_list(void)
+{
+      while (fst_free_blocks) {
+	    struct fst_block*blk = fst_free_blocks;
+	    fst_free_blocks = blk->next;
+	    free(blk->data);
+	    free(blk);
+      }
+}
+
+/*
+ * Format a vector value as the string of '0', '1', 'z' and 'x' the FST
+ * writer expects, most significant bit first.
+ */
+static const char*fst_format_vec(const s_vpi_vecval*vec, unsigned wid)
+{
+      static char*buf = 0;
+      static unsigned buf_len = 0;
+      static const char bit_chars[4] = { '0', '1', 'z', 'x' };
+      unsigned idx;
+      char*cp;
+
+      if (wid + 1 > buf_len) {
+	    buf_len = wid + 1;
+	    buf = realloc(buf, buf_len);
+      }
+
+      cp = buf + wid;
+      *cp = 0;
+      for (idx = 0 ; idx < wid ; idx += 32) {
+	    PLI_UINT32 aval = vec[idx/32].aval;
+	    PLI_UINT32 bval = vec[idx/32].bval;
+	    unsigned cnt = wid - idx < 32 ? wid - idx : 32;
+	    unsigned bdx;
+	    if (bval == 0) {
+		  for (bdx = 0 ; bdx < cnt ; bdx += 1) {
+			*--cp = '0' + (aval & 1);
+			aval >>= 1;
+		  }
+	    } else {
+		  for (bdx = 0 ; bdx < cnt ; bdx += 1) {
+			*--cp = bit_chars[(aval & 1) | ((bval & 1) << 1)];
+			aval >>= 1;
+			bval >>= 1;
+		  }
+	    }
+      }
+
+      return buf;
+}
+
+static const char*fst_format_x(unsigned wid)
+{
+      static char*buf = 0;
+      static unsigned buf_len = 0;
+
+      if (wid + 1 > buf_len) {
+	    buf_len = wid + 1;
+	    buf = realloc(buf, buf_len);
+      }
+      memset(buf, 'x', wid);
+      buf[wid] = 0;
+
+      return buf;
+}
+
+static void fst_play_block(const struct fst_block*blk)
+{
+      size_t off = 0;
+
+      while (off < blk->used) {
+	    const struct fst_rec*rec = (const struct fst_rec*)(blk->data + off);
+
+	    switch (rec->kind) {
+		case FST_REC_TIME:
+		  fstWriterEmitTimeChange(dump_file, rec->u.time);
+		  break;
+		case FST_REC_VEC:
+		  fstWriterEmitValueChange(dump_file, rec->handle,
+		                   fst_format_vec((const s_vpi_vecval*)(rec+1),
+		                                  rec->wid));
+		  break;
+		case FST_REC_REAL:
+		  fstWriterEmitValueChange(dump_file, rec->handle,
+		                           &rec->u.real);
+		  break;
+		case FST_REC_X:
+		  fstWriterEmitValueChange(dump_file, rec->handle,
+		                           fst_format_x(rec->wid));
+		  break;
+		case FST_REC_EVENT:
+		  fstWriterEmitValueChange(dump_file, rec->handle, "1");
+		  break;
+		case FST_REC_ACTIVE:
+		  fstWriterEmitDumpActive(dump_file, rec->u.active);
+		  break;
+		case FST_REC_FLUSH:
+		  fstWriterFlushContext(dump_file);
+		  break;
+		case FST_REC_LIMIT:
+		  fstWriterSetDumpSizeLimit(dump_file, rec->u.limit);
+		  break;
+		default:
+		  assert(0);
+	    }
+
+	    off += fst_rec_size(rec->kind, rec->wid);
+      }
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void*fst_writer_thread(void*arg)
+{
+      (void)arg; /* Parameter is not used. */
+
+      pthread_mutex_lock(&fst_mutex);
+      for (;;) {
+	    struct fst_block*blk;
+	    while (fst_queue_head == 0 && !fst_thread_stop)
+		  pthread_cond_wait(&fst_work_cond, &fst_mutex);
+	    if (fst_queue_head == 0)
+		  break;
+
+	    blk = fst_queue_head;
+	    fst_queue_head = blk->next;
+	    if (fst_queue_head == 0)
+		  fst_queue_tail = 0;
+	    fst_queue_len -= 1;
+	    fst_thread_busy = 1;
+	    pthread_mutex_unlock(&fst_mutex);
+
+	    fst_play_block(blk);
+
+	    pthread_mutex_lock(&fst_mutex);
+	    fst_thread_busy = 0;
+	    fst_thread_limit = fstWriterGetDumpSizeLimitReached(dump_file);
+	    blk->next = fst_free_blocks;
+	    fst_free_blocks = blk;
+	    pthread_cond_signal(&fst_room_cond);
+      }
+      pthread_mutex_unlock(&fst_mutex);
+
+      return 0;
+}
+
+/*
+ * Wait, with fst_mutex held, until the writer has played all the
+ * blocks that were handed to it.
+ */
+static void fst_wait_writer_idle(void)
+{
+      while (fst_queue_head || fst_thread_busy)
+	    pthread_cond_wait(&fst_room_cond, &fst_mutex);
+}
+#endif
+
+/*
+ * Hand the block being filled to the writer.
+ */
+static void fst_flush_block(void)
+{
+      struct fst_block*blk = fst_cur_block;
+
+      if (blk == 0)
+	    return;
+      fst_cur_block = 0;
+
+#ifdef HAVE_LIBPTHREAD
+      if (fst_thread_running) {
+	    pthread_mutex_lock(&fst_mutex);
+	    while (fst_queue_len >= FST_BLOCK_QUEUE)
+		  pthread_cond_wait(&fst_room_cond, &fst_mutex);
+	    if (fst_queue_tail)
+		  fst_queue_tail->next = blk;
+	    else
+		  fst_queue_head = blk;
+	    fst_queue_tail = blk;
+	    fst_queue_len += 1;
+	    pthread_cond_signal(&fst_work_cond);
+	      /* The size limit is only known once the writer has played
+	       * the blocks, so with a limit the writer is not allowed to
+	       * fall behind. Otherwise the whole queue could be recorded
+	       * past the limit before it is noticed. */
+	    if (dump_limit > 0)
+		  fst_wait_writer_idle();
+	    fst_limit_reached = fst_thread_limit;
+	    pthread_mutex_unlock(&fst_mutex);
+	    return;
+      }
+#endif
+
+      fst_play_block(blk);
+      fst_limit_reached = fstWriterGetDumpSizeLimitReached(dump_file);
+      blk->next = fst_free_blocks;
+      fst_free_blocks = blk;
+}
+
+static struct fst_rec*fst_rec_new(unsigned kind, unsigned wid)
+{
+      size_t need = fst_rec_size(kind, wid);
+      struct fst_rec*rec;
+
+      if (fst_cur_block && fst_cur_block->used + need > fst_cur_block->size)
+	    fst_flush_block();
+      if (fst_cur_block == 0)
+	    fst_cur_block = fst_block_new(need);
+
+      rec = (struct fst_rec*)(fst_cur_block->data + fst_cur_block->used);
+      fst_cur_block->used += need;
+      rec->kind = kind;
+      rec->wid = wid;
+      rec->handle = 0;
+      return rec;
+}
+
+static void fst_writer_start(void)
+{
+#ifdef HAVE_LIBPTHREAD
+      fst_thread_stop = 0;
+      fst_thread_limit = fst_limit_reached;
+      if (pthread_create(&fst_thread, 0, fst_writer_thread, 0) == 0)
+	    fst_thread_running = 1;
+#endif
+}
+
+/*
+ * Write out everything that is recorded and stop the writer thread,
+ * so that dump_file can again be used directly.
+ */
+static void fst_writer_stop(void)
+{
+      fst_flush_block();
+
+#ifdef HAVE_LIBPTHREAD
+      if (fst_thread_running) {
+	    pthread_mutex_lock(&fst_mutex);
+	    fst_thread_stop = 1;
+	    pthread_cond_signal(&fst_work_cond);
+	    pthread_mutex_unlock(&fst_mutex);
+	    pthread_join(fst_thread, 0);
+	    fst_thread_running = 0;
+      }
+#endif
+
+      fst_block_free_list();
+}
+
+/*
+ * Hand the block being filled to the writer and wait until everything
+ * that is recorded has been passed to the FST library.
+ */
+static void fst_writer_drain(void)
+{
+      fst_flush_block();
+
+#ifdef HAVE_LIBPTHREAD
+      if (fst_thread_running) {
+	    pthread_mutex_lock(&fst_mutex);
+	    fst_wait_writer_idle();
+	    fst_limit_reached = fst_thread_limit;
+	    pthread_mutex_unlock(&fst_mutex);
+      }
+#endif
+}
+
+#ifdef HAVE_LIBPTHREAD
+static void fst_prepare_fork(void)
+{
+      fst_fork_restart = fst_thread_running;
+      if (fst_thread_running) {
+	    fst_writer_stop();
+	    fflush(0);
+      }
+}
+
+static void fst_after_fork(void)
+{
+      if (fst_fork_restart)
+	    fst_writer_start();
+      fst_fork_restart = 0;
+}
+#endif
+
+static void emit_time_change(PLI_UINT64 now)
+{
+      struct fst_rec*rec = fst_rec_new(FST_REC_TIME, 0);
+      rec->u.time = now;
+}
+
+static void emit_dump_active(int flag)
+{
+      struct fst_rec*rec = fst_rec_new(FST_REC_ACTIVE, 0);
+      rec->u.active = flag;
+}
+
 static void show_this_item(struct vcd_info*info)
 {
       s_vpi_value value;
-      PLI_INT32 type = vpi_get(vpiType, info->item);
+      struct fst_rec*rec;
 
-      if (type == vpiRealVar) {
+      if (info->type == vpiRealVar) {
 	    value.format = vpiRealVal;
 	    vpi_get_value(info->item, &value);
-	    fstWriterEmitValueChange(dump_file, info->handle, &value.value.real);
+	    rec = fst_rec_new(FST_REC_REAL, 0);
+	    rec->u.real = value.value.real;
+      } else if (info->type == vpiNamedEvent) {
+	    rec = fst_rec_new(FST_REC_EVENT, 0);
       } else {
-	    value.format = vpiBinStrVal;
+	    value.format = vpiVectorVal;
 	    vpi_get_value(info->item, &value);
-	    fstWriterEmitValueChange(dump_file, info->handle, (type != vpiNamedEvent) ? value.value.str : "1");
+	    rec = fst_rec_new(FST_REC_VEC, info->size);
+	    memcpy(rec+1, value.value.vector,
+	           ((info->size + 31) / 32) * sizeof(s_vpi_vecval));
       }
+      rec->handle = info->handle;
 }
 
 /* Dump values for a $dumpoff. */
 static void show_this_item_x(struct vcd_info*info)
 {
-      PLI_INT32 type = vpi_get(vpiType, info->item);
+      struct fst_rec*rec;
 
-      if (type == vpiRealVar) {
+      if (info->type == vpiRealVar) {
 	      /* Some tools dump nothing here...? */
-            double mynan = strtod("NaN", NULL);
-	    fstWriterEmitValueChange(dump_file, info->handle, &mynan);
-      } else if (type == vpiNamedEvent) {
+	    rec = fst_rec_new(FST_REC_REAL, 0);
+	    rec->u.real = strtod("NaN", NULL);
+      } else if (info->type == vpiNamedEvent) {
 	    /* Do nothing for named events. */
+	    return;
       } else {
-	    int siz = vpi_get(vpiSize, info->item);
-	    char *xmem = malloc(siz);
-	    memset(xmem, 'x', siz);
-	    fstWriterEmitValueChange(dump_file, info->handle, xmem);
-	    free(xmem);
+	    rec = fst_rec_new(FST_REC_X, info->size);
       }
+      rec->handle = info->handle;
 }
 
 
@@ -143,53 +552,35 @@ static void vcd_checkpoint_x(void)
 	    show_this_item_x(cur);
 }
 
-static PLI_INT32 variable_cb_2(p_cb_data cause)
-{
-      struct vcd_info* info = vcd_dmp_list;
-      PLI_UINT64 now = timerec_to_time64(cause->time);
-
-      if (now != vcd_cur_time) {
-	    fstWriterEmitTimeChange(dump_file, now);
-	    vcd_cur_time = now;
-      }
-
-      do {
-           show_this_item(info);
-           info->scheduled = 0;
-      } while ((info = info->dmp_next) != 0);
-
-      vcd_dmp_list = 0;
-
-      return 0;
-}
-
-static PLI_INT32 variable_cb_1(p_cb_data cause)
+/*
+ * The value change callbacks are registered with the
+ * cbValueChangeReadOnlySynch reason, so this is called once for each
+ * item that changed, at the end of the time step of the change.
+ */
+static PLI_INT32 variable_cb(p_cb_data cause)
 {
-      struct t_cb_data cb;
       struct vcd_info*info = (struct vcd_info*)cause->user_data;
+      PLI_UINT64 now = timerec_to_time64(cause->time);
 
       if (dump_is_full) return 0;
       if (dump_is_off) return 0;
       if (dump_header_pending()) return 0;
-      if (info->scheduled) return 0;
+	/* The header already has the values of this time step. */
+      if (now == dumpvars_time) return 0;
 
-      if ((dump_limit > 0) && fstWriterGetDumpSizeLimitReached(dump_file)) {
+      if ((dump_limit > 0) && fst_limit_reached) {
             dump_is_full = 1;
             vpi_printf("WARNING: Dump file limit (%ld bytes) "
                                "exceeded.\n", dump_limit);
             return 0;
       }
 
-      if (!vcd_dmp_list) {
-          cb = *cause;
-          cb.reason = cbReadOnlySynch;
-          cb.cb_rtn = variable_cb_2;
-          vpi_register_cb(&cb);
+      if (now != vcd_cur_time) {
+	    emit_time_change(now);
+	    vcd_cur_time = now;
       }
 
-      info->scheduled = 1;
-      info->dmp_next  = vcd_dmp_list;
-      vcd_dmp_list    = info;
+      show_this_item(info);
 
       return 0;
 }
@@ -205,8 +596,12 @@ static PLI_INT32 dumpvars_cb(p_cb_data cause)
 
       /* nothing to do for $enddefinitions $end */
 
+	/* The hierarchy is complete, so from here on the writer
+	 * thread owns dump_file. */
+      fst_writer_start();
+
       if (!dump_is_off) {
-	    fstWriterEmitTimeChange(dump_file, dumpvars_time);
+	    emit_time_change(dumpvars_time);
 	    /* nothing to do for  $dumpvars... */
 	    vcd_checkpoint();
 	    /* ...nothing to do for $end */
@@ -226,10 +621,12 @@ static PLI_INT32 finish_cb(p_cb_data cause)
       dumpvars_time = timerec_to_time64(cause->time);
 
       if (!dump_is_off && !dump_is_full && dumpvars_time != vcd_cur_time) {
-	    fstWriterEmitTimeChange(dump_file, dumpvars_time);
+	    emit_time_change(dumpvars_time);
       }
 
+      fst_writer_stop();
       fstWriterClose(dump_file);
+      vcd_dump_closed();
 
       for (cur = vcd_list ;  cur ;  cur = next) {
 	    next = cur->next;
@@ -296,11 +693,11 @@ static PLI_INT32 sys_dumpoff_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       now64 = timerec_to_time64(&now);
 
       if (now64 > vcd_cur_time) {
-	    fstWriterEmitTimeChange(dump_file, now64);
+	    emit_time_change(now64);
 	    vcd_cur_time = now64;
       }
 
-      fstWriterEmitDumpActive(dump_file, 0); /* $dumpoff */
+      emit_dump_active(0); /* $dumpoff */
       vcd_checkpoint_x();
 
       return 0;
@@ -325,11 +722,11 @@ static PLI_INT32 sys_dumpon_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       now64 = timerec_to_time64(&now);
 
       if (now64 > vcd_cur_time) {
-	    fstWriterEmitTimeChange(dump_file, now64);
+	    emit_time_change(now64);
 	    vcd_cur_time = now64;
       }
 
-      fstWriterEmitDumpActive(dump_file, 1); /* $dumpon */
+      emit_dump_active(1); /* $dumpon */
       vcd_checkpoint();
 
       return 0;
@@ -351,7 +748,7 @@ static PLI_INT32 sys_dumpall_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       now64 = timerec_to_time64(&now);
 
       if (now64 > vcd_cur_time) {
-	    fstWriterEmitTimeChange(dump_file, now64);
+	    emit_time_change(now64);
 	    vcd_cur_time = now64;
       }
 
@@ -384,6 +781,7 @@ static void open_dumpfile(vpiHandle callh)
 
 	    vpi_printf("FST info: dumpfile %s opened for output.\n",
 	               dump_path);
+	    vcd_dump_opened(dump_path);
 
 	    time(&walltime);
 
@@ -452,7 +850,10 @@ static PLI_INT32 sys_dumpfile_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 static PLI_INT32 sys_dumpflush_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 {
       (void)name; /* Parameter is not used. */
-      if (dump_file) fstWriterFlushContext(dump_file);
+      if (dump_file) {
+	    fst_rec_new(FST_REC_FLUSH, 0);
+	    fst_writer_drain();
+      }
 
       return 0;
 }
@@ -469,7 +870,7 @@ static PLI_INT32 sys_dumplimit_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
       val.format = vpiIntVal;
       vpi_get_value(vpi_scan(argv), &val);
       dump_limit = val.value.integer;
-      fstWriterSetDumpSizeLimit(dump_file, dump_limit);
+      if (dump_file) fst_rec_new(FST_REC_LIMIT, 0)->u.limit = dump_limit;
 
       vpi_free_object(argv);
       return 0;
@@ -642,16 +1043,16 @@ static void scan_item(unsigned depth, vpiHandle item, int skip)
 		  info->time.type = vpiSimTime;
 		  info->item  = item;
 		  info->handle = new_ident;
-		  info->scheduled = 0;
+		  info->type  = item_type;
+		  info->size  = size;
 
 		  cb.time      = &info->time;
 		  cb.user_data = (char*)info;
 		  cb.value     = NULL;
 		  cb.obj       = item;
-		  cb.reason    = cbValueChange;
-		  cb.cb_rtn    = variable_cb_1;
+		  cb.reason    = cbValueChangeReadOnlySynch;
+		  cb.cb_rtn    = variable_cb;
 
-		  info->dmp_next = 0;
 		  info->next  = vcd_list;
 		  vcd_list    = info;
 
@@ -902,6 +1303,10 @@ void sys_fst_register(void)
 	/* Scan the extended arguments, looking for fst optimization flags. */
       vpi_get_vlog_info(&vlog_info);
 
+#ifdef HAVE_LIBPTHREAD
+      pthread_atfork(fst_prepare_fork, fst_after_fork, fst_after_fork);
+#endif
+
 	/* The "speed" option is not used in this dumper. */
       for (idx = 0 ;  idx < vlog_info.argc ;  idx += 1) {
 	    if (strcmp(vlog_info.argv[idx],"-fst-space") == 0) {
@@ -17,7 +17,10 @@
  */
 
 #include "sys_priv.h"
+#include "vcd_priv.h"
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
 static PLI_INT32 finish_and_return_calltf(ICARUS_VPI_CONST PLI_BYTE8* name)
 {
@@ -41,6 +44,44 @@ static PLI_INT32 finish_and_return_calltf(ICARUS_VPI_CONST PLI_BYTE8* name)
     return 0;
 }
 
+/*
+ * $checkpoint("runsfile") forks a simulation run from the current
+ * state for each line of plusargs in the runs file. The runs share
+ * the open files of the simulation, so this is refused while a
+ * waveform dump is open: the runs would all write to the same file.
+ */
+static PLI_INT32 checkpoint_calltf(ICARUS_VPI_CONST PLI_BYTE8* name)
+{
+    vpiHandle callh = vpi_handle(vpiSysTfCall, 0);
+    vpiHandle argv = vpi_iterate(vpiArgument, callh);
+    vpiHandle arg;
+    s_vpi_value val;
+    char *path;
+
+    /* Get the runs file name. */
+    arg = vpi_scan(argv);
+    vpi_free_object(argv);
+    val.format = vpiStringVal;
+    vpi_get_value(arg, &val);
+
+    if (vcd_open_dump_path()) {
+	vpi_printf("ERROR: %s:%d: ", vpi_get_str(vpiFile, callh),
+	           (int)vpi_get(vpiLineNo, callh));
+	vpi_printf("%s can not fork runs while the dump file %s is "
+	           "open.\n", name, vcd_open_dump_path());
+	vpi_printf("       Start the dump after the checkpoint, with a "
+	           "file name for each run.\n");
+	vpi_control(vpiFinish, 1);
+	return 0;
+    }
+
+    /* The string is only valid until the next VPI call. */
+    path = strdup(val.value.str);
+    vpip_checkpoint(path);
+    free(path);
+    return 0;
+}
+
 static PLI_INT32 task_not_implemented_compiletf(ICARUS_VPI_CONST PLI_BYTE8* name)
 {
       vpiHandle callh = vpi_handle(vpiSysTfCall, 0);
@@ -82,6 +123,15 @@ void sys_special_register(void)
       tf_data.tfname      = "$finish_and_return";
       tf_data.user_data   = "$finish_and_return";
       res = vpi_register_systf(&tf_data);
+      vpip_make_systf_system_defined(res);
+
+      tf_data.type        = vpiSysTask;
+      tf_data.calltf      = checkpoint_calltf;
+      tf_data.compiletf   = sys_one_string_arg_compiletf;
+      tf_data.sizetf      = 0;
+      tf_data.tfname      = "$checkpoint";
+      tf_data.user_data   = "$checkpoint";
+      res = vpi_register_systf(&tf_data);
       vpip_make_systf_system_defined(res);
 
 	/* These tasks are not currently implemented. */
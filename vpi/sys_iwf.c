@@ -0,0 +1,717 @@
+/*
+ * Copyright (c) 2016 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include "sys_priv.h"
+# include "vcd_priv.h"
+# include "iwf_write.h"
+
+/*
+ * This file contains the implementations of the IWF related functions.
+ * The IWF file has no scopes, each signal is given by its full name.
+ */
+
+# include  <stdio.h>
+# include  <stdlib.h>
+# include  <string.h>
+# include  <assert.h>
+# include  "ivl_alloc.h"
+
+static char *dump_path = NULL;
+static struct iwf_writer *dump_file = NULL;
+
+struct vcd_info {
+      vpiHandle item;
+      vpiHandle cb;
+      struct t_vpi_time time;
+      struct vcd_info *next;
+      uint32_t handle;
+      PLI_INT32 type;
+};
+
+
+static struct vcd_info *vcd_list = NULL;
+static PLI_UINT64 vcd_cur_time = 0;
+static int dump_is_off = 0;
+static long dump_limit = 0;
+static int dump_is_full = 0;
+static int finish_status = 0;
+
+static void show_this_item(struct vcd_info*info)
+{
+      s_vpi_value value;
+
+      if (info->type == vpiRealVar) {
+	    value.format = vpiRealVal;
+	    vpi_get_value(info->item, &value);
+	    iwf_writer_emit_real(dump_file, info->handle, value.value.real);
+      } else if (info->type == vpiNamedEvent) {
+	    iwf_writer_emit_event(dump_file, info->handle);
+      } else {
+	    value.format = vpiVectorVal;
+	    vpi_get_value(info->item, &value);
+	    iwf_writer_emit_vector(dump_file, info->handle,
+	                           (const uint32_t*)value.value.vector);
+      }
+}
+
+/* Dump values for a $dumpoff. */
+static void show_this_item_x(struct vcd_info*info)
+{
+      if (info->type == vpiRealVar) {
+	      /* Some tools dump nothing here...? */
+	    iwf_writer_emit_real(dump_file, info->handle, strtod("NaN", NULL));
+      } else if (info->type == vpiNamedEvent) {
+	    /* Do nothing for named events. */
+      } else {
+	    iwf_writer_emit_x(dump_file, info->handle);
+      }
+}
+
+static struct vcd_names_list_s iwf_tab = { 0, 0, 0, 0 };
+static struct vcd_names_list_s iwf_var = { 0, 0, 0, 0 };
+
+
+static int dumpvars_status = 0; /* 0:fresh 1:cb installed, 2:callback done */
+static PLI_UINT64 dumpvars_time;
+__inline__ static int dump_header_pending(void)
+{
+      return dumpvars_status != 2;
+}
+
+/*
+ * This function writes out all the traced variables, whether they
+ * changed or not.
+ */
+static void vcd_checkpoint(void)
+{
+      struct vcd_info*cur;
+
+      for (cur = vcd_list ;  cur ;  cur = cur->next)
+	    show_this_item(cur);
+}
+
+static void vcd_checkpoint_x(void)
+{
+      struct vcd_info*cur;
+
+      for (cur = vcd_list ;  cur ;  cur = cur->next)
+	    show_this_item_x(cur);
+}
+
+/*
+ * The value change callbacks are registered with the
+ * cbValueChangeReadOnlySynch reason, so this is called once for each
+ * item that changed, at the end of the time step of the change.
+ */
+static PLI_INT32 variable_cb(p_cb_data cause)
+{
+      struct vcd_info*info = (struct vcd_info*)cause->user_data;
+      PLI_UINT64 now = timerec_to_time64(cause->time);
+
+      if (dump_is_full) return 0;
+      if (dump_is_off) return 0;
+      if (dump_header_pending()) return 0;
+	/* The header already has the values of this time step. */
+      if (now == dumpvars_time) return 0;
+
+      if ((dump_limit > 0) && (iwf_writer_size(dump_file) > (uint64_t)dump_limit)) {
+            dump_is_full = 1;
+            vpi_printf("WARNING: Dump file limit (%ld bytes) "
+                               "exceeded.\n", dump_limit);
+            return 0;
+      }
+
+      if (now != vcd_cur_time) {
+	    iwf_writer_set_time(dump_file, now);
+	    vcd_cur_time = now;
+      }
+
+      show_this_item(info);
+
+      return 0;
+}
+
+static PLI_INT32 dumpvars_cb(p_cb_data cause)
+{
+      if (dumpvars_status != 1) return 0;
+
+      dumpvars_status = 2;
+
+      dumpvars_time = timerec_to_time64(cause->time);
+      vcd_cur_time = dumpvars_time;
+
+      if (!dump_is_off) {
+	    iwf_writer_set_time(dump_file, dumpvars_time);
+	    vcd_checkpoint();
+      }
+
+      return 0;
+}
+
+static PLI_INT32 finish_cb(p_cb_data cause)
+{
+      struct vcd_info *cur, *next;
+
+      if (finish_status != 0) return 0;
+
+      finish_status = 1;
+
+      dumpvars_time = timerec_to_time64(cause->time);
+
+      if (!dump_is_off && !dump_is_full && dumpvars_time != vcd_cur_time) {
+	    iwf_writer_set_time(dump_file, dumpvars_time);
+      }
+
+      iwf_writer_close(dump_file);
+      dump_file = 0;
+      vcd_dump_closed();
+
+      for (cur = vcd_list ;  cur ;  cur = next) {
+	    next = cur->next;
+	    free(cur);
+      }
+      vcd_list = 0;
+      vcd_names_delete(&iwf_tab);
+      vcd_names_delete(&iwf_var);
+      nexus_ident_delete();
+      free(dump_path);
+      dump_path = 0;
+
+      return 0;
+}
+
+__inline__ static int install_dumpvars_callback(void)
+{
+      struct t_cb_data cb;
+      static struct t_vpi_time now;
+
+      if (dumpvars_status == 1) return 0;
+
+      if (dumpvars_status == 2) {
+	    vpi_printf("IWF warning: $dumpvars ignored, previously"
+	               " called at simtime %" PLI_UINT64_FMT "\n",
+	               dumpvars_time);
+	    return 1;
+      }
+
+      now.type = vpiSimTime;
+      cb.time = &now;
+      cb.reason = cbReadOnlySynch;
+      cb.cb_rtn = dumpvars_cb;
+      cb.user_data = 0x0;
+      cb.obj = 0x0;
+
+      vpi_register_cb(&cb);
+
+      cb.reason = cbEndOfSimulation;
+      cb.cb_rtn = finish_cb;
+
+      vpi_register_cb(&cb);
+
+      dumpvars_status = 1;
+      return 0;
+}
+
+/*
+ * Move to the time of a dump task, if it is later than the last
+ * change that was written.
+ */
+static void dump_task_time(void)
+{
+      s_vpi_time now;
+      PLI_UINT64 now64;
+
+      now.type = vpiSimTime;
+      vpi_get_time(0, &now);
+      now64 = timerec_to_time64(&now);
+
+      if (now64 > vcd_cur_time) {
+	    iwf_writer_set_time(dump_file, now64);
+	    vcd_cur_time = now64;
+      }
+}
+
+static PLI_INT32 sys_dumpoff_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      (void)name; /* Parameter is not used. */
+
+      if (dump_is_off) return 0;
+
+      dump_is_off = 1;
+
+      if (dump_file == 0) return 0;
+      if (dump_header_pending()) return 0;
+
+      dump_task_time();
+      vcd_checkpoint_x();
+
+      return 0;
+}
+
+static PLI_INT32 sys_dumpon_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      (void)name; /* Parameter is not used. */
+
+      if (!dump_is_off) return 0;
+
+      dump_is_off = 0;
+
+      if (dump_file == 0) return 0;
+      if (dump_header_pending()) return 0;
+
+      dump_task_time();
+      vcd_checkpoint();
+
+      return 0;
+}
+
+static PLI_INT32 sys_dumpall_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      (void)name; /* Parameter is not used. */
+
+      if (dump_is_off) return 0;
+      if (dump_file == 0) return 0;
+      if (dump_header_pending()) return 0;
+
+      dump_task_time();
+      vcd_checkpoint();
+
+      return 0;
+}
+
+static void open_dumpfile(vpiHandle callh)
+{
+      if (dump_path == 0) dump_path = strdup("dump.iwf");
+
+      dump_file = iwf_writer_create(dump_path, vpi_get(vpiTimePrecision, 0));
+
+      if (dump_file == 0) {
+	    vpi_printf("IWF Error: %s:%d: ", vpi_get_str(vpiFile, callh),
+	               (int)vpi_get(vpiLineNo, callh));
+	    vpi_printf("Unable to open %s for output.\n", dump_path);
+	    vpi_control(vpiFinish, 1);
+	    free(dump_path);
+	    dump_path = 0;
+	    return;
+      }
+
+      vpi_printf("IWF info: dumpfile %s opened for output.\n", dump_path);
+      vcd_dump_opened(dump_path);
+}
+
+static PLI_INT32 sys_dumpfile_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      vpiHandle callh = vpi_handle(vpiSysTfCall, 0);
+      vpiHandle argv = vpi_iterate(vpiArgument, callh);
+      char *path;
+
+        /* $dumpfile must be called before $dumpvars starts! */
+      if (dumpvars_status != 0) {
+	    char msg[64];
+	    snprintf(msg, sizeof(msg), "IWF warning: %s:%d:",
+	             vpi_get_str(vpiFile, callh),
+	             (int)vpi_get(vpiLineNo, callh));
+	    msg[sizeof(msg)-1] = 0;
+	    vpi_printf("%s %s called after $dumpvars started,\n", msg, name);
+	    vpi_printf("%*s using existing file (%s).\n",
+	               (int) strlen(msg), " ", dump_path);
+	    vpi_free_object(argv);
+	    return 0;
+      }
+
+      path = get_filename(callh, name, vpi_scan(argv));
+      vpi_free_object(argv);
+      if (! path) return 0;
+
+      if (dump_path) {
+	    vpi_printf("IWF warning: %s:%d: ", vpi_get_str(vpiFile, callh),
+	               (int)vpi_get(vpiLineNo, callh));
+	    vpi_printf("Overriding dump file %s with %s.\n", dump_path, path);
+	    free(dump_path);
+      }
+      dump_path = path;
+
+      return 0;
+}
+
+static PLI_INT32 sys_dumpflush_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      (void)name; /* Parameter is not used. */
+      if (dump_file) iwf_writer_flush(dump_file);
+
+      return 0;
+}
+
+static PLI_INT32 sys_dumplimit_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
+{
+      vpiHandle callh = vpi_handle(vpiSysTfCall, 0);
+      vpiHandle argv = vpi_iterate(vpiArgument, callh);
+      s_vpi_value val;
+
+      (void)name; /* Parameter is not used. */
+
+      /* Get the value and set the dump limit. */
+      val.format = vpiIntVal;
+      vpi_get_value(vpi_scan(argv), &val);
+      dump_limit = val.value.integer;
+
+      vpi_free_object(argv);
+      return 0;
+}
+
+static void scan_item(unsigned depth, vpiHandle item, int skip)
+{
+      struct t_cb_data cb;
+      struct vcd_info* info;
+
+      unsigned type = IWF_VECTOR;
+      const char *fullname;
+      const char *ident;
+      uint32_t new_ident;
+      int nexus_id;
+      unsigned size;
+      PLI_INT32 item_type;
+
+      item_type = vpi_get(vpiType, item);
+      switch (item_type) {
+	  case vpiNamedEvent: type = IWF_EVENT; break;
+	  case vpiRealVar:    type = IWF_REAL; break;
+	  case vpiIntVar:
+	  case vpiIntegerVar:
+	  case vpiMemoryWord:
+	  case vpiBitVar:
+	  case vpiByteVar:
+	  case vpiShortIntVar:
+	  case vpiLongIntVar:
+	  case vpiReg:
+	  case vpiTimeVar:
+	  case vpiNet:        type = IWF_VECTOR; break;
+
+	  case vpiParameter:
+	    vpi_printf("IWF sorry: $dumpvars: can not dump parameters.\n");
+	    return;
+
+	  case vpiNamedBegin:
+	  case vpiNamedFork:
+	  case vpiFunction:
+	  case vpiGenScope:
+	  case vpiModule:
+	  case vpiTask:
+	    break;
+
+	  default:
+	    vpi_printf("IWF warning: $dumpvars: Unsupported argument "
+	               "type (%s)\n", vpi_get_str(vpiType, item));
+	    return;
+      }
+
+	/* Turn a non-constant array word select into a constant word
+	 * select. Dumping array words is an Icarus extension. */
+      if (item_type == vpiMemoryWord &&
+          vpi_get(vpiConstantSelect, item) == 0) {
+	    vpiHandle array = vpi_handle(vpiParent, item);
+	    PLI_INT32 idx = vpi_get(vpiIndex, item);
+	    item = vpi_handle_by_index(array, idx);
+      }
+
+      fullname = vpi_get_str(vpiFullName, item);
+
+      switch (item_type) {
+	  case vpiNamedEvent:
+	  case vpiIntegerVar:
+	  case vpiBitVar:
+	  case vpiByteVar:
+	  case vpiShortIntVar:
+	  case vpiIntVar:
+	  case vpiLongIntVar:
+	  case vpiRealVar:
+	  case vpiMemoryWord:
+	  case vpiReg:
+	  case vpiTimeVar:
+	  case vpiNet:
+
+	      /* If we are skipping all signal or this is in an automatic
+	       * scope then just return. */
+            if (skip || vpi_get(vpiAutomatic, item)) return;
+
+	      /* Skip this signal if it has already been included.
+	       * This can only happen for implicitly given signals. */
+	    if (vcd_names_search(&iwf_var, fullname)) return;
+
+	      /* Some signals can have an alias so handle that. The
+	       * nexus ident is the handle plus one. */
+	    nexus_id = vpi_get(_vpiNexusId, item);
+
+	    ident = 0;
+	    if (nexus_id) ident = find_nexus_ident(nexus_id);
+
+	      /* Named events do not have a size, but other tools use
+	       * a size of 1 so we will also use a width of one for
+	       * events. */
+	    if (item_type == vpiNamedEvent) size = 1;
+	    else if (item_type == vpiRealVar) size = 64;
+	    else size = vpi_get(vpiSize, item);
+
+	    new_ident = iwf_writer_add_signal(dump_file, fullname, type, size,
+	                          ident ? (uint32_t)((intptr_t)ident - 1)
+	                                : IWF_NO_ALIAS);
+
+	    if (!ident) {
+		  if (nexus_id) set_nexus_ident(nexus_id,
+		                          (const char *)(intptr_t)(new_ident + 1));
+
+		    /* Add a callback for the signal. */
+		  info = malloc(sizeof(*info));
+
+		  info->time.type = vpiSimTime;
+		  info->item  = item;
+		  info->handle = new_ident;
+		  info->type  = item_type;
+
+		  cb.time      = &info->time;
+		  cb.user_data = (char*)info;
+		  cb.value     = NULL;
+		  cb.obj       = item;
+		  cb.reason    = cbValueChangeReadOnlySynch;
+		  cb.cb_rtn    = variable_cb;
+
+		  info->next  = vcd_list;
+		  vcd_list    = info;
+
+		  info->cb    = vpi_register_cb(&cb);
+	    }
+
+	    break;
+
+	  case vpiModule:
+	  case vpiGenScope:
+	  case vpiFunction:
+	  case vpiTask:
+	  case vpiNamedBegin:
+	  case vpiNamedFork:
+
+	    if (depth > 0) {
+		  /* list of types to iterate upon */
+		  static int types[] = {
+			/* Value */
+			vpiNamedEvent,
+			vpiNet,
+			/* vpiParameter, */
+			vpiReg,
+			vpiVariables,
+			/* Scope */
+			vpiFunction,
+			vpiGenScope,
+			vpiModule,
+			vpiNamedBegin,
+			vpiNamedFork,
+			vpiTask,
+			-1
+		  };
+		  int i;
+		  int nskip = (vcd_names_search(&iwf_tab, fullname) != 0);
+
+		    /* We have to always scan the scope because the
+		     * depth could be different for this call. */
+		  if (nskip) {
+			vpi_printf("IWF warning: ignoring signals in "
+			           "previously scanned scope %s.\n", fullname);
+		  } else {
+			vcd_names_add(&iwf_tab, fullname);
+		  }
+
+		  for (i=0; types[i]>0; i++) {
+			vpiHandle hand;
+			vpiHandle argv = vpi_iterate(types[i], item);
+			while (argv && (hand = vpi_scan(argv))) {
+			      scan_item(depth-1, hand, nskip);
+			}
+		  }
+	    }
+	    break;
+      }
+}
+
+static PLI_INT32 sys_dumpvars_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      vpiHandle callh = vpi_handle(vpiSysTfCall, 0);
+      vpiHandle argv = vpi_iterate(vpiArgument, callh);
+      vpiHandle item;
+      s_vpi_value value;
+      unsigned depth = 0;
+
+      (void)name; /* Parameter is not used. */
+
+      if (dump_file == 0) {
+	    open_dumpfile(callh);
+	    if (dump_file == 0) {
+		  if (argv) vpi_free_object(argv);
+		  return 0;
+	    }
+      }
+
+      if (install_dumpvars_callback()) {
+	    if (argv) vpi_free_object(argv);
+	    return 0;
+      }
+
+        /* Get the depth if it exists. */
+      if (argv) {
+	    value.format = vpiIntVal;
+	    vpi_get_value(vpi_scan(argv), &value);
+	    depth = value.value.integer;
+      }
+      if (!depth) depth = 10000;
+
+        /* This dumps all the modules in the design if none are given. */
+      if (!argv || !(item = vpi_scan(argv))) {
+	    argv = vpi_iterate(vpiModule, 0x0);
+	    assert(argv);  /* There must be at least one top level module. */
+	    item = vpi_scan(argv);
+      }
+
+      for ( ; item; item = vpi_scan(argv)) {
+	    char *scname;
+	    const char *fullname;
+	    int add_var = 0;
+	    PLI_INT32 item_type = vpi_get(vpiType, item);
+
+	      /* If this is a signal make sure it has not already
+	       * been included. */
+	    switch (item_type) {
+	        case vpiIntegerVar:
+		case vpiBitVar:
+		case vpiByteVar:
+		case vpiShortIntVar:
+		case vpiIntVar:
+		case vpiLongIntVar:
+	        case vpiMemoryWord:
+	        case vpiNamedEvent:
+	        case vpiNet:
+	        case vpiParameter:
+	        case vpiRealVar:
+	        case vpiReg:
+	        case vpiTimeVar:
+		    /* Warn if the variables scope (which includes the
+		     * variable) or the variable itself was already
+		     * included. A scope does not automatically include
+		     * memory words so do not check the scope for them.  */
+		  scname = strdup(vpi_get_str(vpiFullName,
+		                              vpi_handle(vpiScope, item)));
+		  fullname = vpi_get_str(vpiFullName, item);
+		  if (((item_type != vpiMemoryWord) &&
+		       vcd_names_search(&iwf_tab, scname)) ||
+		      vcd_names_search(&iwf_var, fullname)) {
+		        vpi_printf("IWF warning: skipping signal %s, "
+		                   "it was previously included.\n",
+		                   fullname);
+		        free(scname);
+		        continue;
+		  } else {
+		        add_var = 1;
+		  }
+		  free(scname);
+	    }
+
+	    scan_item(depth, item, 0);
+	      /* The scope list must be sorted after we scan an item.  */
+	    vcd_names_sort(&iwf_tab);
+
+	      /* Add this signal to the variable list so we can verify it
+	       * is not included twice. This must be done after it has
+	       * been added */
+	    if (add_var) {
+		  vcd_names_add(&iwf_var, vpi_get_str(vpiFullName, item));
+		  vcd_names_sort(&iwf_var);
+	    }
+      }
+
+      return 0;
+}
+
+void sys_iwf_register(void)
+{
+      s_vpi_systf_data tf_data;
+      vpiHandle res;
+
+      /* All the compiletf routines are located in vcd_priv.c. */
+
+      tf_data.type      = vpiSysTask;
+      tf_data.tfname    = "$dumpall";
+      tf_data.calltf    = sys_dumpall_calltf;
+      tf_data.compiletf = sys_no_arg_compiletf;
+      tf_data.sizetf    = 0;
+      tf_data.user_data = "$dumpall";
+      res = vpi_register_systf(&tf_data);
+      vpip_make_systf_system_defined(res);
+
+      tf_data.type      = vpiSysTask;
+      tf_data.tfname    = "$dumpfile";
+      tf_data.calltf    = sys_dumpfile_calltf;
+      tf_data.compiletf = sys_one_string_arg_compiletf;
+      tf_data.sizetf    = 0;
+      tf_data.user_data = "$dumpfile";
+      res = vpi_register_systf(&tf_data);
+      vpip_make_systf_system_defined(res);
+
+      tf_data.type      = vpiSysTask;
+      tf_data.tfname    = "$dumpflush";
+      tf_data.calltf    = sys_dumpflush_calltf;
+      tf_data.compiletf = sys_no_arg_compiletf;
+      tf_data.sizetf    = 0;
+      tf_data.user_data = "$dumpflush";
+      res = vpi_register_systf(&tf_data);
+      vpip_make_systf_system_defined(res);
+
+      tf_data.type      = vpiSysTask;
+      tf_data.tfname    = "$dumplimit";
+      tf_data.calltf    = sys_dumplimit_calltf;
+      tf_data.compiletf = sys_one_numeric_arg_compiletf;
+      tf_data.sizetf    = 0;
+      tf_data.user_data = "$dumplimit";
+      res = vpi_register_systf(&tf_data);
+      vpip_make_systf_system_defined(res);
+
+      tf_data.type      = vpiSysTask;
+      tf_data.tfname    = "$dumpoff";
+      tf_data.calltf    = sys_dumpoff_calltf;
+      tf_data.compiletf = sys_no_arg_compiletf;
+      tf_data.sizetf    = 0;
+      tf_data.user_data = "$dumpoff";
+      res = vpi_register_systf(&tf_data);
+      vpip_make_systf_system_defined(res);
+
+      tf_data.type      = vpiSysTask;
+      tf_data.tfname    = "$dumpon";
+      tf_data.calltf    = sys_dumpon_calltf;
+      tf_data.compiletf = sys_no_arg_compiletf;
+      tf_data.sizetf    = 0;
+      tf_data.user_data = "$dumpon";
+      res = vpi_register_systf(&tf_data);
+      vpip_make_systf_system_defined(res);
+
+      tf_data.type      = vpiSysTask;
+      tf_data.tfname    = "$dumpvars";
+      tf_data.calltf    = sys_dumpvars_calltf;
+      tf_data.compiletf = sys_dumpvars_compiletf;
+      tf_data.sizetf    = 0;
+      tf_data.user_data = "$dumpvars";
+      res = vpi_register_systf(&tf_data);
+      vpip_make_systf_system_defined(res);
+}
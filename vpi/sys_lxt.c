@@ -436,6 +436,7 @@ static void *close_dumpfile(void)
 {
       lt_close(dump_file);
       dump_file = NULL;
+      vcd_dump_closed();
       return NULL;
 }
 
@@ -458,6 +459,7 @@ static void open_dumpfile(vpiHandle callh)
 
 	    vpi_printf("LXT info: dumpfile %s opened for output.\n",
 	               dump_path);
+	    vcd_dump_opened(dump_path);
 
 	    assert(prec >= -15);
 	    lt_set_timescale(dump_file, prec);
@@ -475,6 +475,7 @@ static void *close_dumpfile(void)
       vcd_work_terminate();
       lxt2_wr_close(dump_file);
       dump_file = NULL;
+      vcd_dump_closed();
       return NULL;
 }
 
@@ -511,6 +512,7 @@ static void open_dumpfile(vpiHandle callh)
 
 	    vpi_printf("LXT2 info: dumpfile %s opened for output.\n",
 	               dump_path);
+	    vcd_dump_opened(dump_path);
 
 	    assert(prec >= -15);
 	    lxt2_wr_set_timescale(dump_file, prec);
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 1999-2014 Stephen Williams (steve@icarus.com)
+ * Copyright (c) 1999-2016 Stephen Williams (steve@icarus.com)
  *
  *    This source code is free software; you can redistribute it
  *    and/or modify it in source code form under the terms of the GNU
@@ -23,8 +23,10 @@
 # include  <stdlib.h>
 # include  <stdio.h>
 # include  <assert.h>
-# include  "sys_readmem_lex.h"
 # include  <sys/stat.h>
+#if !defined(__MINGW32__)
+# include  <sys/mman.h>
+#endif
 # include  "ivl_alloc.h"
 
 char **search_list = NULL;
@@ -256,17 +258,275 @@ static PLI_INT32 sys_mem_compiletf(ICARUS_VPI_CONST PLI_BYTE8*name)
       return 0;
 }
 
+/*
+ * The readmem files are scanned straight out of memory, instead of a
+ * token at a time through stdio. When possible the file is mapped,
+ * otherwise it is read into a buffer.
+ */
+struct readmem_text_s {
+      const char*text;
+      size_t size;
+      int mapped;
+};
+
+static void readmem_load_text(FILE*file, struct readmem_text_s*buf)
+{
+      size_t alloc = 0;
+      char*text = 0;
+
+      buf->text = 0;
+      buf->size = 0;
+      buf->mapped = 0;
+
+#if !defined(__MINGW32__)
+      {
+	    struct stat sb;
+	    int fd = fileno(file);
+	    if (fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0
+	        && (size_t)sb.st_size == (unsigned long long)sb.st_size) {
+		  void*res = mmap(0, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		  if (res != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+			madvise(res, sb.st_size, MADV_SEQUENTIAL);
+#endif
+			buf->text = (const char*)res;
+			buf->size = sb.st_size;
+			buf->mapped = 1;
+			return;
+		  }
+	    }
+      }
+#endif
+
+      for (;;) {
+	    size_t cnt;
+	    if (buf->size == alloc) {
+		  alloc = alloc ? 2*alloc : 65536;
+		  text = realloc(text, alloc);
+	    }
+	    cnt = fread(text + buf->size, 1, alloc - buf->size, file);
+	    if (cnt == 0) break;
+	    buf->size += cnt;
+      }
+      buf->text = text;
+}
+
+static void readmem_free_text(struct readmem_text_s*buf)
+{
+#if !defined(__MINGW32__)
+      if (buf->mapped) {
+	    munmap((void*)buf->text, buf->size);
+	    return;
+      }
+#endif
+      free((char*)buf->text);
+}
+
+# define MEM_ADDRESS 257
+# define MEM_WORD    258
+# define MEM_ERROR   259
+
+/*
+ * The digit tables give the aval bits of a digit in the low nibble
+ * and the bval bits in the high nibble. DIGIT_SKIP is an '_' and
+ * DIGIT_BAD is a character that can not be part of a word.
+ */
+# define DIGIT_SKIP 0x100
+# define DIGIT_BAD  0x200
+
+static unsigned short hex_digit[256];
+static unsigned short bin_digit[256];
+
+static void readmem_init_digits(void)
+{
+      static int done = 0;
+      unsigned idx;
+
+      if (done) return;
+      done = 1;
+
+      for (idx = 0 ; idx < 256 ; idx += 1) {
+	    hex_digit[idx] = DIGIT_BAD;
+	    bin_digit[idx] = DIGIT_BAD;
+      }
+      for (idx = 0 ; idx < 10 ; idx += 1)
+	    hex_digit['0'+idx] = idx;
+      for (idx = 0 ; idx < 6 ; idx += 1) {
+	    hex_digit['a'+idx] = 10 + idx;
+	    hex_digit['A'+idx] = 10 + idx;
+      }
+      hex_digit['x'] = hex_digit['X'] = 0xff;
+      hex_digit['z'] = hex_digit['Z'] = 0xf0;
+      hex_digit['_'] = DIGIT_SKIP;
+
+      bin_digit['0'] = 0x00;
+      bin_digit['1'] = 0x01;
+      bin_digit['x'] = bin_digit['X'] = 0x11;
+      bin_digit['z'] = bin_digit['Z'] = 0x10;
+      bin_digit['_'] = DIGIT_SKIP;
+}
+
+struct readmem_scan_s {
+      const char*cur;
+      const char*end;
+      const unsigned short*digits;
+      unsigned digit_bits;
+      unsigned wid;
+	/* The address of a MEM_ADDRESS token. */
+      PLI_UINT32 addr;
+	/* The character of a MEM_ERROR token. */
+      char error_token[2];
+};
+
+/*
+ * Convert the digits of a word into the vecval array. The digits are
+ * taken from the right, and any digits beyond the width of the word
+ * are ignored.
+ */
+static void readmem_make_word(const struct readmem_scan_s*scan,
+                              const char*beg, const char*end,
+                              s_vpi_vecval*vec)
+{
+      unsigned pos = 0;
+      unsigned idx;
+
+      for (idx = 0 ; idx < (scan->wid+31)/32 ; idx += 1) {
+	    vec[idx].aval = 0;
+	    vec[idx].bval = 0;
+      }
+
+      while (pos < scan->wid && end > beg) {
+	    unsigned code;
+	    end -= 1;
+	    code = scan->digits[(unsigned char)*end];
+	    if (code == DIGIT_SKIP) continue;
+	    vec[pos/32].aval |= (PLI_INT32)((PLI_UINT32)(code&0x0f) << pos%32);
+	    vec[pos/32].bval |= (PLI_INT32)((PLI_UINT32)(code>>4) << pos%32);
+	    pos += scan->digit_bits;
+      }
+}
+
+/*
+ * Get the next token of the file. A MEM_WORD is converted into the
+ * vec array, a MEM_ADDRESS is left in scan->addr.
+ */
+static int readmem_next(struct readmem_scan_s*scan, s_vpi_vecval*vec)
+{
+      const char*cur = scan->cur;
+      const char*end = scan->end;
+
+      while (cur < end) {
+	    const char*beg;
+	    char ch = *cur;
+
+	    switch (ch) {
+		case ' ':
+		case '\t':
+		case '\f':
+		case '\n':
+		case '\r':
+		  cur += 1;
+		  continue;
+
+		case '/':
+		  if (cur+1 < end && cur[1] == '/') {
+			cur = memchr(cur, '\n', end-cur);
+			if (cur == 0) cur = end;
+			continue;
+		  }
+		  if (cur+1 < end && cur[1] == '*') {
+			cur += 2;
+			for (;;) {
+			      const char*star = memchr(cur, '*', end-cur);
+			      if (star == 0) {
+				    cur = end;
+				    break;
+			      }
+			      cur = star + 1;
+			      if (cur < end && *cur == '/') {
+				    cur += 1;
+				    break;
+			      }
+			}
+			continue;
+		  }
+		  break;
+
+		case '@':
+		  if (cur+1 < end && hex_digit[(unsigned char)cur[1]] < 16) {
+			unsigned long long addr = 0;
+			cur += 1;
+			while (cur < end && hex_digit[(unsigned char)*cur] < 16) {
+			      addr = (addr << 4) | hex_digit[(unsigned char)*cur];
+			      if (addr > 0xffffffffULL) addr = 0x100000000ULL;
+			      cur += 1;
+			}
+			scan->addr = addr > 0xffffffffULL ? 0xffffffff : addr;
+			scan->cur = cur;
+			return MEM_ADDRESS;
+		  }
+		  break;
+
+		default:
+		  if (scan->digits[(unsigned char)ch] == DIGIT_BAD)
+			break;
+		  beg = cur;
+		  while (cur < end && scan->digits[(unsigned char)*cur] != DIGIT_BAD)
+			cur += 1;
+		  readmem_make_word(scan, beg, cur, vec);
+		  scan->cur = cur;
+		  return MEM_WORD;
+	    }
+
+	    scan->error_token[0] = ch;
+	    scan->error_token[1] = 0;
+	    scan->cur = cur + 1;
+	    return MEM_ERROR;
+      }
+
+      scan->cur = cur;
+      return 0;
+}
+
+/*
+ * Store a run of words read from the file into the memory. The words
+ * are in the run array in address order, starting at address first.
+ */
+static void readmem_store_run(vpiHandle mitem, int first, unsigned count,
+                              s_vpi_vecval*run, unsigned stride)
+{
+      s_vpi_value value;
+      unsigned idx;
+
+      if (count == 0) return;
+      if (vpip_put_array_words(mitem, first, count, run) == count) return;
+
+      value.format = vpiVectorVal;
+      for (idx = 0 ; idx < count ; idx += 1) {
+	    vpiHandle word_index = vpi_handle_by_index(mitem, first+idx);
+	    assert(word_index);
+	    value.value.vector = run + idx*stride;
+	    vpi_put_value(word_index, &value, 0, vpiNoDelay);
+      }
+}
+
+/*
+ * Words are stored and fetched in runs of (about) this many vecvals.
+ */
+# define MEM_RUN_VALS 16384
+
 static PLI_INT32 sys_readmem_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 {
       int code, wwid, addr;
       FILE*file;
       char *fname = 0;
-      s_vpi_value value;
       vpiHandle callh = vpi_handle(vpiSysTfCall, 0);
       vpiHandle argv = vpi_iterate(vpiArgument, callh);
       vpiHandle mitem = 0;
       vpiHandle start_item = 0;
       vpiHandle stop_item = 0;
+      struct readmem_text_s text;
+      struct readmem_scan_s scan;
 
       /* start_addr and stop_addr are the parameters given to $readmem in the
 	 Verilog code. When not specified, start_addr is equal to the lower of
@@ -281,6 +541,14 @@ static PLI_INT32 sys_readmem_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       /* This is the number of words that we need from the memory. */
       unsigned word_count;
 
+      /* The words are collected into runs of consecutive addresses
+	 that are stored into the memory together. The run is filled
+	 from the back when the addresses go down, so that it is
+	 always in address order. */
+      s_vpi_vecval*run;
+      unsigned stride, run_size, run_len;
+      int run_addr;
+
       /*======================================== Get parameters */
 
       get_mem_params(argv, callh, name,
@@ -323,25 +591,51 @@ static PLI_INT32 sys_readmem_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 
       wwid = vpi_get(vpiSize, vpi_handle_by_index(mitem, min_addr));
 
-      /* variable that will be used by the lexer to pass values
-	 back to this code */
-      value.format = vpiVectorVal;
-      value.value.vector = calloc((wwid+31)/32, sizeof(s_vpi_vecval));
+      stride = (wwid+31)/32;
+      run_size = MEM_RUN_VALS / stride;
+      if (run_size == 0) run_size = 1;
+      run = malloc(run_size * stride * sizeof(s_vpi_vecval));
+      run_len = 0;
+      run_addr = 0;
+
+      /* Configure the scanner */
+      readmem_load_text(file, &text);
+      readmem_init_digits();
+      scan.cur = text.text;
+      scan.end = text.text + text.size;
+      scan.wid = wwid;
+      if (strcmp(name,"$readmemb") == 0) {
+	    scan.digits = bin_digit;
+	    scan.digit_bits = 1;
+      } else {
+	    scan.digits = hex_digit;
+	    scan.digit_bits = 4;
+      }
 
-      /* Configure the readmem lexer */
-      if (strcmp(name,"$readmemb") == 0)
-	  sys_readmem_start_file(file, 1, wwid, value.value.vector);
-      else
-	  sys_readmem_start_file(file, 0, wwid, value.value.vector);
+# define FLUSH_RUN() do { \
+	    if (addr_incr > 0) \
+		  readmem_store_run(mitem, run_addr, run_len, run, stride); \
+	    else \
+		  readmem_store_run(mitem, run_addr-(int)run_len+1, run_len, \
+		                    run + (run_size-run_len)*stride, stride); \
+	    run_len = 0; \
+      } while (0)
 
       /*======================================== Read memory file */
 
       /* Run through the input file and store the new contents in the memory */
       addr = start_addr;
-      while ((code = readmemlex()) != 0) {
+      for (;;) {
+	  s_vpi_vecval*slot = run + stride * (addr_incr > 0
+	                                      ? run_len
+	                                      : run_size-run_len-1);
+	  code = readmem_next(&scan, slot);
+	  if (code == 0) break;
+
 	  switch (code) {
 	  case MEM_ADDRESS:
-	      addr = value.value.vector->aval;
+	      FLUSH_RUN();
+	      addr = scan.addr;
 	      if (addr < min_addr || addr > max_addr) {
 		  vpi_printf("ERROR: %s:%d: ", vpi_get_str(vpiFile, callh),
 		             (int)vpi_get(vpiLineNo, callh));
@@ -359,13 +653,13 @@ static PLI_INT32 sys_readmem_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 
 	  case MEM_WORD:
 	      if (addr >= min_addr && addr <= max_addr) {
-		  vpiHandle word_index;
-		  word_index = vpi_handle_by_index(mitem, addr);
-		  assert(word_index);
-		  vpi_put_value(word_index, &value, 0, vpiNoDelay);
+		  if (run_len == 0) run_addr = addr;
+		  run_len += 1;
+		  if (run_len == run_size) FLUSH_RUN();
 
 		  if (word_count > 0) word_count -= 1;
 	      } else {
+		  FLUSH_RUN();
 		  vpi_printf("WARNING: %s:%d: ", vpi_get_str(vpiFile, callh),
 		             (int)vpi_get(vpiLineNo, callh));
 		  vpi_printf("%s(%s): Too many words in the file for the "
@@ -378,10 +672,11 @@ static PLI_INT32 sys_readmem_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 	      break;
 
 	  case MEM_ERROR:
+	      FLUSH_RUN();
 	      vpi_printf("ERROR: %s:%d: ", vpi_get_str(vpiFile, callh),
 	                 (int)vpi_get(vpiLineNo, callh));
 	      vpi_printf("%s(%s): Invalid input character: %s\n", name,
-	                 fname, readmem_error_token);
+	                 fname, scan.error_token);
 	      goto bailout;
 	      break;
 
@@ -390,6 +685,9 @@ static PLI_INT32 sys_readmem_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 	      break;
 	  }
       }
+      FLUSH_RUN();
+
+# undef FLUSH_RUN
 
 	/* Print a warning if there are not enough words in the data file. */
       if (word_count > 0) {
@@ -401,10 +699,10 @@ static PLI_INT32 sys_readmem_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       }
 
  bailout:
-      free(value.value.vector);
+      free(run);
       free(fname);
+      readmem_free_text(&text);
       fclose(file);
-      destroy_readmem_lexor();
       return 0;
 }
 
@@ -507,9 +805,45 @@ static PLI_INT32 sys_readmempath_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       return 0;
 }
 
+/*
+ * Format a word for $writememh or $writememb, followed by a newline,
+ * the same way that vpiHexStrVal and vpiBinStrVal would.
+ */
+static void writemem_format_word(char*buf, const s_vpi_vecval*vec,
+                                 unsigned wid, unsigned digit_bits)
+{
+      unsigned ndig = (wid + digit_bits-1) / digit_bits;
+      char*cp = buf + ndig;
+      unsigned pos;
+
+      cp[0] = '\n';
+      cp[1] = 0;
+
+      for (pos = 0 ; pos < wid ; pos += digit_bits) {
+	    unsigned cnt = wid-pos < digit_bits ? wid-pos : digit_bits;
+	    PLI_UINT32 mask = (1U << cnt) - 1U;
+	    PLI_UINT32 aval = ((PLI_UINT32)vec[pos/32].aval >> pos%32) & mask;
+	    PLI_UINT32 bval = ((PLI_UINT32)vec[pos/32].bval >> pos%32) & mask;
+	    char ch;
+
+	    if (bval == 0)
+		  ch = "0123456789abcdef"[aval];
+	    else if (bval == mask && aval == 0)
+		  ch = 'z';
+	    else if (bval == mask && aval == mask)
+		  ch = 'x';
+	    else if ((aval & bval) == 0)
+		  ch = 'Z';
+	    else
+		  ch = 'X';
+
+	    *--cp = ch;
+      }
+}
+
 static PLI_INT32 sys_writemem_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 {
-      int addr;
+      int addr, wwid;
       FILE*file;
       char*fname = 0;
       unsigned cnt;
@@ -523,6 +857,10 @@ static PLI_INT32 sys_writemem_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       int start_addr, stop_addr, addr_incr;
       int min_addr, max_addr; // Not used in this routine.
 
+      s_vpi_vecval*run;
+      unsigned stride, run_size, digit_bits;
+      char*line;
+
       /*======================================== Get parameters */
 
       get_mem_params(argv, callh, name,
@@ -549,23 +887,55 @@ static PLI_INT32 sys_writemem_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 	    return 0;
       }
 
-      if (strcmp(name,"$writememb")==0) value.format = vpiBinStrVal;
-      else value.format = vpiHexStrVal;
+      if (strcmp(name,"$writememb")==0) {
+	    value.format = vpiBinStrVal;
+	    digit_bits = 1;
+      } else {
+	    value.format = vpiHexStrVal;
+	    digit_bits = 4;
+      }
+
+      wwid = vpi_get(vpiSize, vpi_handle_by_index(mitem, min_addr));
+      stride = (wwid+31)/32;
+      run_size = MEM_RUN_VALS / stride;
+      if (run_size == 0) run_size = 1;
+      run = malloc(run_size * stride * sizeof(s_vpi_vecval));
+      line = malloc(wwid + 2);
 
       /*======================================== Write memory file */
 
       cnt = 0;
-      for(addr=start_addr; addr!=stop_addr+addr_incr; addr+=addr_incr, ++cnt) {
-	  vpiHandle word_index;
-
-	  if (cnt%16 == 0) fprintf(file, "// 0x%08x\n", cnt);
-
-	  word_index = vpi_handle_by_index(mitem, addr);
-	  assert(word_index);
-	  vpi_get_value(word_index, &value);
-	  fprintf(file, "%s\n", value.value.str);
+      addr = start_addr;
+      while (addr != stop_addr+addr_incr) {
+	  unsigned idx, count;
+	  int first, bulk;
+
+	    /* Fetch the next run of words in one go if the memory
+	       allows it. The run is in address order. */
+	  count = addr_incr > 0 ? stop_addr-addr+1 : addr-stop_addr+1;
+	  if (count > run_size) count = run_size;
+	  first = addr_incr > 0 ? addr : addr-(int)count+1;
+	  bulk = vpip_get_array_words(mitem, first, count, run) == count;
+
+	  for (idx = 0 ; idx < count ; idx += 1, addr += addr_incr, ++cnt) {
+	      if (cnt%16 == 0) fprintf(file, "// 0x%08x\n", cnt);
+
+	      if (bulk) {
+		  unsigned pos = addr_incr > 0 ? idx : count-idx-1;
+		  writemem_format_word(line, run + pos*stride, wwid,
+		                       digit_bits);
+		  fputs(line, file);
+	      } else {
+		  vpiHandle word_index = vpi_handle_by_index(mitem, addr);
+		  assert(word_index);
+		  vpi_get_value(word_index, &value);
+		  fprintf(file, "%s\n", value.value.str);
+	      }
+	  }
       }
 
+      free(line);
+      free(run);
       fclose(file);
       free(fname);
       return 0;
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 1999-2010,2012 Stephen Williams (steve@icarus.com)
+ * Copyright (c) 1999-2010,2012,2016 Stephen Williams (steve@icarus.com)
  *
  *    This source code is free software; you can redistribute it
  *    and/or modify it in source code form under the terms of the GNU
@@ -40,6 +40,7 @@ extern void sys_sdf_register(void);
 extern void sys_time_register(void);
 extern void sys_vcd_register(void);
 extern void sys_vcdoff_register(void);
+extern void sys_iwf_register(void);
 extern void sys_special_register(void);
 extern void table_model_register(void);
 extern void vams_simparam_register(void);
@@ -137,6 +138,12 @@ static void sys_lxt_or_vcd_register(void)
 	    } else if (strcmp(vlog_info.argv[idx],"-lx2-none") == 0) {
 		  dumper = "none";
 
+	    } else if (strcmp(vlog_info.argv[idx],"-iwf") == 0) {
+		  dumper = "iwf";
+
+	    } else if (strcmp(vlog_info.argv[idx],"-iwf-none") == 0) {
+		  dumper = "none";
+
 	    } else if (strcmp(vlog_info.argv[idx],"-vcd") == 0) {
 		  dumper = "vcd";
 
@@ -182,6 +189,12 @@ static void sys_lxt_or_vcd_register(void)
       else if (strcmp(dumper, "LX2") == 0)
 	    sys_lxt2_register();
 
+      else if (strcmp(dumper, "iwf") == 0)
+	    sys_iwf_register();
+
+      else if (strcmp(dumper, "IWF") == 0)
+	    sys_iwf_register();
+
       else if (strcmp(dumper, "none") == 0)
 	    sys_vcdoff_register();
 
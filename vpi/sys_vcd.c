@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 1999-2015 Stephen Williams (steve@icarus.com)
+ * Copyright (c) 1999-2016 Stephen Williams (steve@icarus.com)
  *
  *    This source code is free software; you can redistribute it
  *    and/or modify it in source code form under the terms of the GNU
@@ -34,19 +34,29 @@
 static char *dump_path = NULL;
 static FILE *dump_file = NULL;
 
+/*
+ * The value changes are written through a large stdio buffer so that
+ * the file is written in big blocks instead of many small writes.
+ */
+#define VCD_FILE_BUFSIZE (1024*1024)
+
 struct vcd_info {
       vpiHandle item;
       vpiHandle cb;
       struct t_vpi_time time;
       const char *ident;
+	/* The type and size of the item do not change, so they are
+	 * looked up once when the item is added to the dump. */
+      PLI_INT32 type;
+      unsigned size;
+      unsigned ident_len;
       struct vcd_info *next;
-      struct vcd_info *dmp_next;
-      int scheduled;
 };
 
 
 static struct vcd_info *vcd_list = NULL;
-static struct vcd_info *vcd_dmp_list = NULL;
+static char *vcd_line_buf = NULL;
+static unsigned vcd_line_len = 0;
 static PLI_UINT64 vcd_cur_time = 0;
 static int dump_is_off = 0;
 static long dump_limit = 0;
@@ -99,40 +109,69 @@ static char *truncate_bitvec(char *s)
       }
 }
 
+/*
+ * Make sure the line buffer can hold a value change line for the
+ * given item: the 'b', the value bits, a space, the identifier and
+ * the newline. Return 0 if the buffer could not be grown.
+ */
+static int reserve_line_buf(const struct vcd_info*info)
+{
+      unsigned need = info->size + info->ident_len + 4;
+      char*buf;
+      if (need <= vcd_line_len) return 1;
+
+      buf = realloc(vcd_line_buf, need);
+      if (buf == 0) return 0;
+
+      vcd_line_buf = buf;
+      vcd_line_len = need;
+      return 1;
+}
+
 static void show_this_item(struct vcd_info*info)
 {
       s_vpi_value value;
-      PLI_INT32 type = vpi_get(vpiType, info->item);
+      char *cp;
 
-      if (type == vpiRealVar) {
+      if (info->type == vpiRealVar) {
 	    value.format = vpiRealVal;
 	    vpi_get_value(info->item, &value);
 	    fprintf(dump_file, "r%.16g %s\n", value.value.real, info->ident);
-      } else if (type == vpiNamedEvent) {
-	    fprintf(dump_file, "1%s\n", info->ident);
-      } else if (vpi_get(vpiSize, info->item) == 1) {
-	    value.format = vpiBinStrVal;
-	    vpi_get_value(info->item, &value);
-	    fprintf(dump_file, "%s%s\n", value.value.str, info->ident);
+	    return;
+      }
+
+      cp = vcd_line_buf;
+      if (info->type == vpiNamedEvent) {
+	    *cp++ = '1';
       } else {
 	    value.format = vpiBinStrVal;
 	    vpi_get_value(info->item, &value);
-	    fprintf(dump_file, "b%s %s\n", truncate_bitvec(value.value.str),
-		    info->ident);
+	    if (info->size == 1) {
+		  *cp++ = value.value.str[0];
+	    } else {
+		  char *bits = truncate_bitvec(value.value.str);
+		  size_t len = info->size - (bits - value.value.str);
+		  *cp++ = 'b';
+		  memcpy(cp, bits, len);
+		  cp += len;
+		  *cp++ = ' ';
+	    }
       }
+      memcpy(cp, info->ident, info->ident_len);
+      cp += info->ident_len;
+      *cp++ = '\n';
+      fwrite(vcd_line_buf, 1, cp - vcd_line_buf, dump_file);
 }
 
 /* Dump values for a $dumpoff. */
 static void show_this_item_x(struct vcd_info*info)
 {
-      PLI_INT32 type = vpi_get(vpiType, info->item);
-
-      if (type == vpiRealVar) {
+      if (info->type == vpiRealVar) {
 	      /* Some tools dump nothing here...? */
 	    fprintf(dump_file, "rNaN %s\n", info->ident);
-      } else if (type == vpiNamedEvent) {
+      } else if (info->type == vpiNamedEvent) {
 	    /* Do nothing for named events. */
-      } else if (vpi_get(vpiSize, info->item) == 1) {
+      } else if (info->size == 1) {
 	    fprintf(dump_file, "x%s\n", info->ident);
       } else {
 	    fprintf(dump_file, "bx %s\n", info->ident);
@@ -175,35 +214,21 @@ static void vcd_checkpoint_x(void)
 	    show_this_item_x(cur);
 }
 
-static PLI_INT32 variable_cb_2(p_cb_data cause)
-{
-      struct vcd_info* info = vcd_dmp_list;
-      PLI_UINT64 now = timerec_to_time64(cause->time);
-
-      if (now != vcd_cur_time) {
-	    fprintf(dump_file, "#%" PLI_UINT64_FMT "\n", now);
-	    vcd_cur_time = now;
-      }
-
-      do {
-           show_this_item(info);
-           info->scheduled = 0;
-      } while ((info = info->dmp_next) != 0);
-
-      vcd_dmp_list = 0;
-
-      return 0;
-}
-
-static PLI_INT32 variable_cb_1(p_cb_data cause)
+/*
+ * The value change callbacks are registered with the
+ * cbValueChangeReadOnlySynch reason, so this is called once for each
+ * item that changed, at the end of the time step of the change.
+ */
+static PLI_INT32 variable_cb(p_cb_data cause)
 {
-      struct t_cb_data cb;
       struct vcd_info*info = (struct vcd_info*)cause->user_data;
+      PLI_UINT64 now = timerec_to_time64(cause->time);
 
       if (dump_is_full) return 0;
       if (dump_is_off) return 0;
       if (dump_header_pending()) return 0;
-      if (info->scheduled) return 0;
+	/* The header already has the values of this time step. */
+      if (now == dumpvars_time) return 0;
 
       if ((dump_limit > 0) && (ftell(dump_file) > dump_limit)) {
             dump_is_full = 1;
@@ -214,16 +239,12 @@ static PLI_INT32 variable_cb_1(p_cb_data cause)
             return 0;
       }
 
-      if (!vcd_dmp_list) {
-          cb = *cause;
-          cb.reason = cbReadOnlySynch;
-          cb.cb_rtn = variable_cb_2;
-          vpi_register_cb(&cb);
+      if (now != vcd_cur_time) {
+	    fprintf(dump_file, "#%" PLI_UINT64_FMT "\n", now);
+	    vcd_cur_time = now;
       }
 
-      info->scheduled = 1;
-      info->dmp_next  = vcd_dmp_list;
-      vcd_dmp_list    = info;
+      show_this_item(info);
 
       return 0;
 }
@@ -264,6 +285,7 @@ static PLI_INT32 finish_cb(p_cb_data cause)
       }
 
       fclose(dump_file);
+      vcd_dump_closed();
 
       for (cur = vcd_list ;  cur ;  cur = next) {
 	    next = cur->next;
@@ -271,6 +293,9 @@ static PLI_INT32 finish_cb(p_cb_data cause)
 	    free(cur);
       }
       vcd_list = 0;
+      free(vcd_line_buf);
+      vcd_line_buf = 0;
+      vcd_line_len = 0;
       vcd_names_delete(&vcd_tab);
       vcd_names_delete(&vcd_var);
       nexus_ident_delete();
@@ -404,6 +429,10 @@ static void open_dumpfile(vpiHandle callh)
       if (dump_path == 0) dump_path = strdup("dump.vcd");
 
       dump_file = fopen(dump_path, "w");
+      if (dump_file) {
+	    setvbuf(dump_file, 0, _IOFBF, VCD_FILE_BUFSIZE);
+	    vcd_dump_opened(dump_path);
+      }
 
       if (dump_file == 0) {
 	    vpi_printf("VCD Error: %s:%d: ", vpi_get_str(vpiFile, callh),
@@ -643,16 +672,28 @@ static void scan_item(unsigned depth, vpiHandle item, int skip)
 		  info->time.type = vpiSimTime;
 		  info->item  = item;
 		  info->ident = ident;
-		  info->scheduled = 0;
+		  info->type  = vpi_get(vpiType, item);
+		    /* Named events have no vpiSize, but are dumped as a
+		     * single character. */
+		  if (info->type == vpiNamedEvent) info->size = 1;
+		  else info->size = vpi_get(vpiSize, item);
+		  info->ident_len = strlen(ident);
+		  if (!reserve_line_buf(info)) {
+			vpi_printf("VCD Error: Unable to allocate the value "
+			           "buffer for %s (%u bits).\n", fullname,
+			           info->size);
+			vpi_control(vpiFinish, 1);
+			free(info);
+			return;
+		  }
 
 		  cb.time      = &info->time;
 		  cb.user_data = (char*)info;
 		  cb.value     = NULL;
 		  cb.obj       = item;
-		  cb.reason    = cbValueChange;
-		  cb.cb_rtn    = variable_cb_1;
+		  cb.reason    = cbValueChangeReadOnlySynch;
+		  cb.cb_rtn    = variable_cb;
 
-		  info->dmp_next = 0;
 		  info->next  = vcd_list;
 		  vcd_list    = info;
 
@@ -49,6 +49,25 @@ int is_escaped_id(const char *name)
 
 struct stringheap_s name_heap = {0, 0};
 
+static char*open_dump_path = 0;
+
+void vcd_dump_opened(const char*path)
+{
+      free(open_dump_path);
+      open_dump_path = strdup(path);
+}
+
+void vcd_dump_closed(void)
+{
+      free(open_dump_path);
+      open_dump_path = 0;
+}
+
+const char*vcd_open_dump_path(void)
+{
+      return open_dump_path;
+}
+
 struct vcd_names_s {
       const char *name;
       struct vcd_names_s *next;
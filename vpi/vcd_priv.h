@@ -126,6 +126,15 @@ EXTERN void vcd_work_dumpoff(void);
 EXTERN void vcd_work_emit_double(struct lxt2_wr_symbol*sym, double val);
 EXTERN void vcd_work_emit_bits(struct lxt2_wr_symbol*sym, const char*bits);
 
+/*
+ * The dumpers report the file they have open for output here, so
+ * that $checkpoint can refuse to fork runs that would all write to
+ * it. vcd_open_dump_path() returns 0 if no dump file is open.
+ */
+EXTERN void vcd_dump_opened(const char*path);
+EXTERN void vcd_dump_closed(void);
+EXTERN const char*vcd_open_dump_path(void);
+
 /* The compiletf routines are common for the VCD, LXT and LXT2 dumpers. */
 EXTERN PLI_INT32 sys_dumpvars_compiletf(ICARUS_VPI_CONST PLI_BYTE8 *name);
 
@@ -630,6 +630,9 @@ extern DLLEXPORT void (*vlog_startup_routines[])(void);
 extern void vpip_format_strength(char*str, s_vpi_value*value, unsigned bit);
 extern void vpip_set_return_value(int value);
 extern s_vpi_vecval vpip_calc_clog2(vpiHandle arg);
+  /* Fork the runs listed in the file from the current simulation
+     state. This is the implementation of $checkpoint. */
+extern void vpip_checkpoint(const char*runs_path);
 extern void vpip_make_systf_system_defined(vpiHandle ref);
 
   /* Perform fwrite to mcd files. This is used to write raw data,
@@ -647,6 +650,25 @@ extern void vpip_mcd_rawwrite(PLI_UINT32 mcd, const char*buf, size_t count);
 extern void vpip_count_drivers(vpiHandle ref, unsigned idx,
                                unsigned counts[4]);
 
+  /* A value change callback reason. The callback is not run when the
+     value changes, but in the read-only synch region of the time step
+     of the change, and only once for any number of changes of the
+     object in that time step. Callbacks on a whole memory are run at
+     each change, as for cbValueChange. */
+#define cbValueChangeReadOnlySynch 0x1000100
+
+  /* Write or read count consecutive words of the memory 'ref',
+     starting at word 'index' (in the declared address range). The
+     words are packed in the 'vals' array, each taking (width+31)/32
+     vecvals. These return the number of words transferred, which is
+     0 if the memory does not support block transfers or the range is
+     not all in the memory. The caller must then use the per word
+     vpi_handle_by_index() and vpi_put/get_value() instead. */
+extern unsigned vpip_put_array_words(vpiHandle ref, PLI_INT32 index,
+                                     unsigned count, const s_vpi_vecval*vals);
+extern unsigned vpip_get_array_words(vpiHandle ref, PLI_INT32 index,
+                                     unsigned count, s_vpi_vecval*vals);
+
 /*
  * Stopgap fix for br916. We need to reject any attempt to pass a thread
  * variable to $strobe or $monitor. To do this, we use some private VPI
@@ -532,24 +532,18 @@ void vvp_arith_sum::recv_vec4(vvp_net_ptr_t ptr, const vvp_vector4_t&bit,
 
       vvp_net_t*net = ptr.ptr();
 
-      vvp_vector4_t value (wid_);
-
-	/* Pad input vectors with this value to widen to the desired
-	   output width. */
-      const vvp_bit4_t pad = BIT4_0;
-
-      vvp_bit4_t carry = BIT4_0;
-      for (unsigned idx = 0 ;  idx < wid_ ;  idx += 1) {
-	    vvp_bit4_t a = (idx >= op_a_.size())? pad : op_a_.value(idx);
-	    vvp_bit4_t b = (idx >= op_b_.size())? pad : op_b_.value(idx);
-	    vvp_bit4_t cur = add_with_carry(a, b, carry);
-
-	    if (cur == BIT4_X) {
-		  net->send_vec4(x_val_, 0);
-		  return;
-	    }
-
-	    value.set_bit(idx, cur);
+	/* Pad the input vectors with 0 (or truncate them) to the
+	   desired output width, then add them a word at a time. Any
+	   X or Z bit in the inputs makes the entire result X. */
+      vvp_vector4_t value (op_a_);
+      value.resize(wid_, BIT4_0);
+
+      if (op_b_.size() == wid_) {
+	    value.add(op_b_);
+      } else {
+	    vvp_vector4_t tmp (op_b_);
+	    tmp.resize(wid_, BIT4_0);
+	    value.add(tmp);
       }
 
       net->send_vec4(value, 0);
@@ -565,10 +559,11 @@ vvp_arith_sub::~vvp_arith_sub()
 }
 
 /*
- * Subtraction works by adding the 2s complement of the B input from
- * the A input. The 2s complement is the 1s complement plus one, so we
- * further reduce the operation to adding in the inverted value and
- * adding a correction.
+ * The inputs are padded (or truncated) to the output width, and the
+ * vvp_vector4_t::sub method subtracts them a word at a time by adding
+ * the 2s complement of the B input to the A input. The B input is
+ * padded with 0, but the A input is padded with 1, as the bit-by-bit
+ * loop that this replaced did.
  */
 void vvp_arith_sub::recv_vec4(vvp_net_ptr_t ptr, const vvp_vector4_t&bit,
                               vvp_context_t)
@@ -577,24 +572,15 @@ void vvp_arith_sub::recv_vec4(vvp_net_ptr_t ptr, const vvp_vector4_t&bit,
 
       vvp_net_t*net = ptr.ptr();
 
-      vvp_vector4_t value (wid_);
-
-	/* Pad input vectors with this value to widen to the desired
-	   output width. */
-      const vvp_bit4_t pad = BIT4_1;
+      vvp_vector4_t value (op_a_);
+      value.resize(wid_, BIT4_1);
 
-      vvp_bit4_t carry = BIT4_1;
-      for (unsigned idx = 0 ;  idx < wid_ ;  idx += 1) {
-	    vvp_bit4_t a = (idx >= op_a_.size())? pad : op_a_.value(idx);
-	    vvp_bit4_t b = (idx >= op_b_.size())? pad : ~op_b_.value(idx);
-	    vvp_bit4_t cur = add_with_carry(a, b, carry);
-
-	    if (cur == BIT4_X) {
-		  net->send_vec4(x_val_, 0);
-		  return;
-	    }
-
-	    value.set_bit(idx, cur);
+      if (op_b_.size() == wid_) {
+	    value.sub(op_b_);
+      } else {
+	    vvp_vector4_t tmp (op_b_);
+	    tmp.resize(wid_, BIT4_0);
+	    value.sub(tmp);
       }
 
       net->send_vec4(value, 0);
@@ -611,15 +597,7 @@ void vvp_cmp_eeq::recv_vec4(vvp_net_ptr_t ptr, const vvp_vector4_t&bit,
       dispatch_operand_(ptr, bit);
 
       vvp_vector4_t eeq (1);
-      eeq.set_bit(0, BIT4_1);
-
-      assert(op_a_.size() == op_b_.size());
-      for (unsigned idx = 0 ;  idx < op_a_.size() ;  idx += 1)
-	    if (op_a_.value(idx) != op_b_.value(idx)) {
-		  eeq.set_bit(0, BIT4_0);
-		  break;
-	    }
-
+      eeq.set_bit(0, op_a_.eeq(op_b_)? BIT4_1 : BIT4_0);
 
       vvp_net_t*net = ptr.ptr();
       net->send_vec4(eeq, 0);
@@ -636,15 +614,7 @@ void vvp_cmp_nee::recv_vec4(vvp_net_ptr_t ptr, const vvp_vector4_t&bit,
       dispatch_operand_(ptr, bit);
 
       vvp_vector4_t eeq (1);
-      eeq.set_bit(0, BIT4_0);
-
-      assert(op_a_.size() == op_b_.size());
-      for (unsigned idx = 0 ;  idx < op_a_.size() ;  idx += 1)
-	    if (op_a_.value(idx) != op_b_.value(idx)) {
-		  eeq.set_bit(0, BIT4_1);
-		  break;
-	    }
-
+      eeq.set_bit(0, op_a_.eeq(op_b_)? BIT4_0 : BIT4_1);
 
       vvp_net_t*net = ptr.ptr();
       net->send_vec4(eeq, 0);
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2007-2013 Stephen Williams (steve@icarus.com)
+ * Copyright (c) 2007-2016 Stephen Williams (steve@icarus.com)
  *
  *    This source code is free software; you can redistribute it
  *    and/or modify it in source code form under the terms of the GNU
@@ -40,6 +40,7 @@ unsigned long count_net_arrays = 0;
 unsigned long count_net_array_words = 0;
 unsigned long count_var_arrays = 0;
 unsigned long count_var_array_words = 0;
+unsigned long count_var_array_sparse = 0;
 unsigned long count_real_arrays = 0;
 unsigned long count_real_array_words = 0;
 
@@ -260,9 +261,7 @@ vpiHandle __vpiArray::get_iter_index(struct __vpiArrayIterator*, int idx)
 
       assert(vals4 || vals);
 
-      if (vals_words == 0) make_vals_words();
-
-      return &(vals_words[idx].as_word);
+      return vals_word_handle_(idx);
 }
 
 int __vpiArray::vpi_get(int code)
@@ -328,10 +327,27 @@ vpiHandle __vpiArray::vpi_index(int index)
 	    return nets[index];
       }
 
+      return vals_word_handle_(index);
+}
+
+vpiHandle __vpiArray::vals_word_handle_(unsigned idx)
+{
+      if (vals_word_pages) {
+	    const unsigned page_words = vvp_vector4array_sparse::PAGE_WORDS;
+	    unsigned page = idx / page_words;
+	    if (vals_word_pages[page] == 0) {
+		  unsigned base = page * page_words;
+		  unsigned count = get_size() - base;
+		  if (count > page_words) count = page_words;
+		  vals_word_pages[page] = make_array_words(this, base, count);
+	    }
+	    return &(vals_word_pages[page][idx % page_words].as_word);
+      }
+
       if (vals_words == 0)
 	    make_vals_words();
 
-      return &(vals_words[index].as_word);
+      return &(vals_words[idx].as_word);
 }
 
 int __vpiArrayWord::as_word_t::vpi_get(int code)
@@ -778,6 +794,7 @@ vpiHandle vpip_make_array(char*label, const char*name,
       obj->vals  = 0;
       obj->vals_width = 0;
       obj->vals_words = 0;
+      obj->vals_word_pages = 0;
 
 	// Initialize (clear) the read-ports list.
       obj->ports_ = 0;
@@ -845,6 +862,36 @@ void __vpiArray::attach_word(unsigned addr, vpiHandle word)
       }
 }
 
+/*
+ * Memories that would need more than this many bytes of word storage
+ * are given a sparse array, so that only the pages that are actually
+ * written take up host memory.
+ */
+static const unsigned long long SPARSE_ARRAY_BYTES = 16ULL * 1024 * 1024;
+
+static bool use_sparse_array(unsigned word_bytes, unsigned words)
+{
+      if (words <= vvp_vector4array_sparse::PAGE_WORDS)
+	    return false;
+
+      unsigned long long bytes = (unsigned long long)words * word_bytes;
+      return bytes > SPARSE_ARRAY_BYTES;
+}
+
+/*
+ * The VPI word handles of a sparse array are also made a page at a
+ * time, when the first word in the page is looked up.
+ */
+static void make_sparse_word_pages(struct __vpiArray*arr)
+{
+      unsigned npages = (arr->get_size() + vvp_vector4array_sparse::PAGE_WORDS-1)
+	    / vvp_vector4array_sparse::PAGE_WORDS;
+      arr->vals_word_pages = new struct __vpiArrayWord*[npages];
+      for (unsigned idx = 0 ; idx < npages ; idx += 1)
+	    arr->vals_word_pages[idx] = 0;
+      count_var_array_sparse += 1;
+}
+
 void compile_var_array(char*label, char*name, int last, int first,
 		   int msb, int lsb, char signed_flag)
 {
@@ -858,6 +905,11 @@ void compile_var_array(char*label, char*name, int last, int first,
       if (vpip_peek_current_scope()->is_automatic()) {
             arr->vals4 = new vvp_vector4array_aa(arr->vals_width,
 						 arr->get_size());
+      } else if (use_sparse_array((arr->vals_width+3) / 4, arr->get_size())) {
+	      // Each bit of a word takes two bits of storage.
+            arr->vals4 = new vvp_vector4array_sparse(arr->vals_width,
+						     arr->get_size());
+	    make_sparse_word_pages(arr);
       } else {
             arr->vals4 = new vvp_vector4array_sa(arr->vals_width,
 						 arr->get_size());
@@ -872,6 +924,16 @@ void compile_var_array(char*label, char*name, int last, int first,
       delete[] name;
 }
 
+template <class TYPE> static vvp_darray* new_var2_words(struct __vpiArray*arr)
+{
+      if (use_sparse_array(sizeof(TYPE), arr->get_size())) {
+	    make_sparse_word_pages(arr);
+	    return new vvp_darray_atom_sparse<TYPE>(arr->get_size());
+      }
+
+      return new vvp_darray_atom<TYPE>(arr->get_size());
+}
+
 void compile_var2_array(char*label, char*name, int last, int first,
 		   int msb, int lsb, bool signed_flag)
 {
@@ -886,21 +948,21 @@ void compile_var2_array(char*label, char*name, int last, int first,
 
       assert(! arr->nets);
       if (lsb == 0 && msb == 7 && signed_flag) {
-	    arr->vals = new vvp_darray_atom<int8_t>(arr->get_size());
+	    arr->vals = new_var2_words<int8_t>(arr);
       } else if (lsb == 0 && msb == 7 && !signed_flag) {
-	    arr->vals = new vvp_darray_atom<uint8_t>(arr->get_size());
+	    arr->vals = new_var2_words<uint8_t>(arr);
       } else if (lsb == 0 && msb == 15 && signed_flag) {
-	    arr->vals = new vvp_darray_atom<int16_t>(arr->get_size());
+	    arr->vals = new_var2_words<int16_t>(arr);
       } else if (lsb == 0 && msb == 15 && !signed_flag) {
-	    arr->vals = new vvp_darray_atom<uint16_t>(arr->get_size());
+	    arr->vals = new_var2_words<uint16_t>(arr);
       } else if (lsb == 0 && msb == 31 && signed_flag) {
-	    arr->vals = new vvp_darray_atom<int32_t>(arr->get_size());
+	    arr->vals = new_var2_words<int32_t>(arr);
       } else if (lsb == 0 && msb == 31 && !signed_flag) {
-	    arr->vals = new vvp_darray_atom<uint32_t>(arr->get_size());
+	    arr->vals = new_var2_words<uint32_t>(arr);
       } else if (lsb == 0 && msb == 63 && signed_flag) {
-	    arr->vals = new vvp_darray_atom<int64_t>(arr->get_size());
+	    arr->vals = new_var2_words<int64_t>(arr);
       } else if (lsb == 0 && msb == 63 && !signed_flag) {
-	    arr->vals = new vvp_darray_atom<uint64_t>(arr->get_size());
+	    arr->vals = new_var2_words<uint64_t>(arr);
       } else {
 	      // For now, only support the atom sizes.
 	    assert(0);
@@ -1266,7 +1328,11 @@ void __vpiArray::word_change(unsigned long addr)
 	    }
 
 	    if (cur->cb_data.cb_rtn != 0) {
-		  if (cur->test_value_callback_ready()) {
+		    // Callbacks on a whole array are not coalesced, as
+		    // each run reports a different word.
+		  if (cur->sync_flag && cur->word_addr != -1) {
+			cur->mark_sync_change();
+		  } else if (cur->test_value_callback_ready()) {
 			if (cur->cb_data.value) {
 			      if (vpi_array_is_real(this)) {
 				    double val = 0.0;
@@ -1286,6 +1352,9 @@ void __vpiArray::word_change(unsigned long addr)
 
 		  prev = cur;
 
+	    } else if (cur->sync_pending) {
+		  prev = cur;
+
 	    } else if (prev == 0) {
 
 		  vpi_callbacks = next;
@@ -1512,6 +1581,7 @@ void compile_array_alias(char*label, char*name, char*src)
       obj->vals  = mem->vals;
       obj->vals_width = mem->vals_width;
       obj->vals_words = mem->vals_words;
+      obj->vals_word_pages = mem->vals_word_pages;
 
       obj->ports_ = 0;
       obj->vpi_callbacks = 0;
@@ -1606,6 +1676,62 @@ vpiHandle vpip_make_vthr_APV(char*label, unsigned index, unsigned bit, unsigned
       return obj;
 }
 
+/*
+ * These implement the block word transfers of $readmem and $writemem,
+ * which would otherwise need a word handle and a value conversion for
+ * each word of the memory.
+ */
+static struct __vpiArray* array_for_block(vpiHandle ref, PLI_INT32 index,
+					  unsigned count, unsigned long&addr)
+{
+      struct __vpiArray*arr = dynamic_cast<__vpiArray*>(ref);
+      if (arr == 0 || arr->vals4 == 0)
+	    return 0;
+
+      long tmp = (long)index - arr->first_addr.get_value();
+      if (tmp < 0 || (unsigned long)tmp + count > arr->get_size())
+	    return 0;
+
+      addr = tmp;
+      return arr;
+}
+
+extern "C" unsigned vpip_put_array_words(vpiHandle ref, PLI_INT32 index,
+					 unsigned count, const s_vpi_vecval*vals)
+{
+      unsigned long addr;
+      struct __vpiArray*arr = array_for_block(ref, index, count, addr);
+      if (arr == 0 || schedule_at_rosync())
+	    return 0;
+
+      unsigned stride = (arr->vals_width + 31) / 32;
+      vvp_vector4_t tmp (arr->vals_width);
+      for (unsigned idx = 0 ; idx < count ; idx += 1) {
+	    tmp.set_vecvals(vals);
+	    arr->set_word(addr+idx, 0, tmp);
+	    vals += stride;
+      }
+
+      return count;
+}
+
+extern "C" unsigned vpip_get_array_words(vpiHandle ref, PLI_INT32 index,
+					 unsigned count, s_vpi_vecval*vals)
+{
+      unsigned long addr;
+      struct __vpiArray*arr = array_for_block(ref, index, count, addr);
+      if (arr == 0)
+	    return 0;
+
+      unsigned stride = (arr->vals_width + 31) / 32;
+      for (unsigned idx = 0 ; idx < count ; idx += 1) {
+	    arr->vals4->get_word(addr+idx).get_vecvals(vals);
+	    vals += stride;
+      }
+
+      return count;
+}
+
 void compile_array_cleanup(void)
 {
       delete array_table;
@@ -1616,7 +1742,15 @@ void compile_array_cleanup(void)
 void memory_delete(vpiHandle item)
 {
       struct __vpiArray*arr = (struct __vpiArray*) item;
-      if (arr->vals_words) delete [] (arr->vals_words-1);
+      if (arr->vals_words) delete_array_words(arr->vals_words);
+      if (arr->vals_word_pages) {
+	    unsigned npages = (arr->get_size() + vvp_vector4array_sparse::PAGE_WORDS-1)
+		  / vvp_vector4array_sparse::PAGE_WORDS;
+	    for (unsigned idx = 0 ; idx < npages ; idx += 1)
+		  if (arr->vals_word_pages[idx])
+			delete_array_words(arr->vals_word_pages[idx]);
+	    delete [] arr->vals_word_pages;
+      }
 
 //      if (arr->vals4) {}
 // Delete the individual words?
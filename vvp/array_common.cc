@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014 Stephen Williams (steve@icarus.com)
+ * Copyright (c) 2014-2016 Stephen Williams (steve@icarus.com)
  * Copyright (c) 2014 CERN
  * @author Maciej Suminski <maciej.suminski@cern.ch>
  *
@@ -37,20 +37,33 @@ vpiHandle __vpiArrayBase::vpi_array_base_iterate(int code)
     return 0;
 }
 
-void __vpiArrayBase::make_vals_words()
+struct __vpiArrayWord*make_array_words(struct __vpiArrayBase*parent,
+				       unsigned base, unsigned count)
 {
-    assert(vals_words == 0);
-    vals_words = new struct __vpiArrayWord[get_size() + 1];
+    struct __vpiArrayWord*words = new struct __vpiArrayWord[count + 2];
 
-    // Make word[-1] point to the parent.
-    vals_words->parent = this;
+    // Make word[-2] hold the base index and word[-1] point to the parent.
+    words[0].base = base;
+    words[1].parent = parent;
     // Now point to word-0
-    vals_words += 1;
+    words += 2;
 
-    struct __vpiArrayWord*words = vals_words;
-    for (unsigned idx = 0 ; idx < get_size() ; idx += 1) {
+    for (unsigned idx = 0 ; idx < count ; idx += 1) {
             words[idx].word0 = words;
     }
+
+    return words;
+}
+
+void delete_array_words(struct __vpiArrayWord*word0)
+{
+    delete [] (word0-2);
+}
+
+void __vpiArrayBase::make_vals_words()
+{
+    assert(vals_words == 0);
+    vals_words = make_array_words(this, 0, get_size());
 }
 
 vpiHandle __vpiArrayIterator::vpi_index(int)
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014 Stephen Williams (steve@icarus.com)
+ * Copyright (c) 2014-2016 Stephen Williams (steve@icarus.com)
  * Copyright (c) 2014 CERN
  * @author Maciej Suminski <maciej.suminski@cern.ch>
  *
@@ -62,6 +62,11 @@ struct __vpiArrayIndex : public __vpiHandle {
  *
  * To then get to the parent, use word0[-1].parent.
  *
+ * A large (sparse) array allocates its ArrayWord objects in pages of
+ * words instead, each with its own word0. In that case word0[-2].base
+ * is the index of the first word of the page, and it is 0 for arrays
+ * that have a single block of ArrayWord objects.
+ *
  * The vpiArrayWord is also used as a handle for the index (vpiIndex)
  * for the word. To make that work, return the pointer to the as_index
  * member instead of the as_word member. The result is a different set
@@ -86,13 +91,22 @@ struct __vpiArrayWord {
       union {
 	    struct __vpiArrayBase*parent;
 	    struct __vpiArrayWord*word0;
+	    unsigned long base;
       };
 
-      inline unsigned get_index() const { return this - word0; }
+      inline unsigned get_index() const { return (word0 - 2)->base + (this - word0); }
       inline struct __vpiArrayBase*get_parent() const { return (word0 - 1)->parent; }
 };
 
 struct __vpiArrayWord*array_var_word_from_handle(vpiHandle ref);
 struct __vpiArrayWord*array_var_index_from_handle(vpiHandle ref);
 
+/*
+ * Allocate the ArrayWord objects for count words of the parent array,
+ * starting with the word at index base, and return word0.
+ */
+extern struct __vpiArrayWord*make_array_words(struct __vpiArrayBase*parent,
+					      unsigned base, unsigned count);
+extern void delete_array_words(struct __vpiArrayWord*word0);
+
 #endif /* ARRAY_COMMON_H */
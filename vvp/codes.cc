@@ -96,6 +96,37 @@ vvp_code_t codespace_null(void)
       return first_chunk + 0;
 }
 
+/*
+ * Scan all the allocated instructions looking for pairs that can be
+ * fused. The second instruction of a pair is left in place, because
+ * other jumps may branch directly to it. The instruction that
+ * precedes a chunk link is never a candidate, as its successor is
+ * the link and not a jump.
+ */
+void codespace_fuse_jumps(void)
+{
+      for (vvp_code_t chunk = first_chunk ;  chunk ;  ) {
+	    unsigned cnt = (chunk == current_chunk)
+		  ? current_within_chunk
+		  : code_chunk_size - 1;
+
+	    for (unsigned idx = 0 ;  idx+1 < cnt ;  idx += 1) {
+		  vvp_code_t cp = chunk + idx;
+		  vvp_code_fun fused = vthread_fused_jump(cp[0].opcode,
+							  cp[1].opcode);
+		  if (fused == 0)
+			continue;
+
+		  cp->opcode = fused;
+		  count_opcodes_fused += 1;
+	    }
+
+	    if (chunk == current_chunk)
+		  break;
+	    chunk = chunk[code_chunk_size-1].cptr;
+      }
+}
+
 #ifdef CHECK_WITH_VALGRIND
 void codespace_delete(void)
 {
@@ -302,4 +302,17 @@ extern vvp_code_t codespace_allocate(void);
 extern vvp_code_t codespace_next(void);
 extern vvp_code_t codespace_null(void);
 
+/*
+ * After the code is linked, this function replaces instructions that
+ * set a flag, and are followed by a conditional jump, with a fused
+ * opcode that does both without returning to the dispatch loop.
+ */
+extern void codespace_fuse_jumps(void);
+
+/*
+ * Return the fused opcode for the op instruction followed by the
+ * jmp instruction, or nil if there is no such fused opcode.
+ */
+extern vvp_code_fun vthread_fused_jump(vvp_code_fun op, vvp_code_fun jmp);
+
 #endif /* IVL_codes_H */
@@ -31,6 +31,7 @@
 # include  "vpi_priv.h"
 # include  "parse_misc.h"
 # include  "statistics.h"
+# include  "profile.h"
 # include  "schedule.h"
 # include  <iostream>
 # include  <list>
@@ -784,6 +785,10 @@ void compile_cleanup(void)
       compile_island_cleanup();
       compile_array_cleanup();
 
+	/* All the code is in place now, so common instruction pairs
+	   can be fused. */
+      codespace_fuse_jumps();
+
       if (verbose_flag) {
 	    fprintf(stderr, " ... Compiletf functions\n");
 	    fflush(stderr);
@@ -1914,7 +1919,12 @@ void compile_thread(char*start_sym, char*flag)
       if (flag && (strcmp(flag,"$push") == 0))
 	    push_flag = true;
 
-      vthread_t thr = vthread_new(pc, vpip_peek_current_scope());
+      if (vvp_profile_enabled)
+	    vvp_profile_label(pc, start_sym);
+
+	// The initial, always and final threads run only once, so
+	// they do not take part in the stack pool of their scope.
+      vthread_t thr = vthread_new(pc, vpip_peek_current_scope(), false);
 
       if (flag && (strcmp(flag,"$init") == 0))
 	    schedule_init_vthread(thr);
@@ -558,6 +558,27 @@ extern void compile_island_tranvp(char*island, char*ba, char*bb,
 
 extern void delete_udp_symbols(void);
 
+/*
+ * Evaluate the clusters of scalar gates as packed bit planes. This
+ * rewrites the linked net graph, so it is called after
+ * compile_cleanup() and before the simulation starts.
+ */
+extern void compile_gate_packs(void);
+
+/*
+ * Call the fun for each edge between two packed gates. These edges
+ * are not in the fan-out lists, as the cluster handles them.
+ */
+extern void gate_pack_edges(void (*fun)(vvp_net_t*src, vvp_net_t*dst,
+					void*data), void*data);
+
+/*
+ * Give the functors that run as scheduled events a level, so that
+ * they run in level order within a time step. This is called after
+ * compile_cleanup() and before the simulation starts.
+ */
+extern void compile_levelize(void);
+
 extern void compile_class_start(char*lab, char*nam, unsigned nprop);
 extern void compile_class_property(unsigned idx, char*nam, char*typ, uint64_t array_size);
 extern void compile_class_done(void);
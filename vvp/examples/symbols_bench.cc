@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2016 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * This is a benchmark for the vvp symbol tables. It is not part of
+ * vvp, but is a standalone driver for the symbols.cc source file. It
+ * sets and then gets N labels of the form that the code generator
+ * writes (L_0x...), in a scrambled order, like the labels of a large
+ * netlist, and prints the time that takes. Build it in the vvp build
+ * directory, where the config.h header is, and run it with the number
+ * of labels:
+ *
+ *    g++ -O2 -I. -I.. -o symbols_bench examples/symbols_bench.cc symbols.cc
+ *    ./symbols_bench 1000000
+ */
+
+# include  "symbols.h"
+# include  <cstdio>
+# include  <cstdlib>
+# include  <ctime>
+
+/*
+ * Format the label for item idx. The item number is scrambled with an
+ * odd multiplier modulo 2**30, so the labels are unique for up to 2**30
+ * items, but are not made in order.
+ */
+static void make_label(char*buf, size_t len, unsigned long idx)
+{
+      unsigned long addr = 0x55d0c0a00000UL + (idx * 2654435761UL % 0x40000000UL) * 16;
+      snprintf(buf, len, "L_0x%lx", addr);
+}
+
+int main(int argc, char*argv[])
+{
+      unsigned long count = 1000000;
+      if (argc > 1)
+	    count = strtoul(argv[1], 0, 0);
+
+      symbol_table_t tbl = new_symbol_table();
+      char buf[64];
+
+      clock_t start = clock();
+      for (unsigned long idx = 0 ;  idx < count ;  idx += 1) {
+	    make_label(buf, sizeof buf, idx);
+	    symbol_value_t val;
+	    val.num = idx + 1;
+	    sym_set_value(tbl, buf, val);
+      }
+
+      clock_t mid = clock();
+      unsigned long errors = 0;
+      for (unsigned long idx = count ;  idx > 0 ;  idx -= 1) {
+	    make_label(buf, sizeof buf, idx - 1);
+	    symbol_value_t val = sym_get_value(tbl, buf);
+	    if (val.num != idx)
+		  errors += 1;
+      }
+      clock_t end = clock();
+
+      delete_symbol_table(tbl);
+
+      printf("%lu labels: set %.2fs, get %.2fs, total %.2fs\n", count,
+	     (double)(mid - start) / CLOCKS_PER_SEC,
+	     (double)(end - mid) / CLOCKS_PER_SEC,
+	     (double)(end - start) / CLOCKS_PER_SEC);
+      if (errors) {
+	    printf("%lu labels had the wrong value\n", errors);
+	    return 1;
+      }
+      return 0;
+}
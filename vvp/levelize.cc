@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2016 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "config.h"
+# include  "compile.h"
+# include  "schedule.h"
+# include  "vvp_net.h"
+# include  "statistics.h"
+# include  "dff.h"
+# include  "udp.h"
+# include  <algorithm>
+# include  <vector>
+# include  <cassert>
+
+/*
+ * Levelized evaluation gives each functor that runs as a scheduled
+ * event (the gates, the UDPs and the bit selects) a level, which is
+ * the length of the longest path to its net from a net that nothing
+ * drives. The scheduler then runs the pending functors of the current
+ * time step lowest level first, before the other active events (see
+ * schedule_levelize). When a functor runs, all the functors that
+ * drive it have already settled, so in a synchronous design each
+ * changed functor runs once per clock edge instead of once for every
+ * glitch on its inputs.
+ *
+ * The inputs of flip-flops (.dff nodes and sequential UDPs) do not
+ * count as edges, so the flip-flops are sources like the variables.
+ * The flip-flops themselves are not given a level. A sequential UDP
+ * takes its new state when the clock edge arrives, but sends it from
+ * its event, so that event must stay in the normal active queue and
+ * run after all the levels, and so the whole clock tree, have
+ * settled. Run at a level, it could change the data input of another
+ * flip-flop before the clock edge reaches that flip-flop through a
+ * later buffer of the clock tree.
+ *
+ * The functors that are still in a loop, for example in a latch made
+ * of gates, are not given a level either and stay in the normal
+ * active queue, as are the functors behind delays and in tran
+ * islands. The levels only change the order of events within a time
+ * step.
+ */
+
+unsigned long count_levelized = 0;
+unsigned long count_levels = 0;
+unsigned long count_levelize_loops = 0;
+
+static void collect_net(vvp_net_t*net, void*data)
+{
+      std::vector<vvp_net_t*>*table = static_cast<std::vector<vvp_net_t*>*>(data);
+      table->push_back(net);
+}
+
+static size_t net_index(const std::vector<vvp_net_t*>&table, vvp_net_t*net)
+{
+      std::vector<vvp_net_t*>::const_iterator cur
+	    = std::lower_bound(table.begin(), table.end(), net);
+      assert(cur != table.end() && *cur == net);
+      return cur - table.begin();
+}
+
+static bool is_flip_flop(vvp_net_t*net)
+{
+      if (dynamic_cast<vvp_dff*>(net->fun))
+	    return true;
+      if (vvp_udp_fun_core*udp = dynamic_cast<vvp_udp_fun_core*>(net->fun))
+	    return udp->is_sequential();
+      return false;
+}
+
+/*
+ * A graph over the indices of the nets in the sorted table, with the
+ * edges of each net in succ[first[idx]] to succ[first[idx+1]-1].
+ */
+struct level_graph_s {
+      std::vector<size_t> first;
+      std::vector<size_t> succ;
+};
+
+typedef std::vector<std::pair<size_t,size_t> > level_edges_t;
+
+static void make_graph(size_t count, const level_edges_t&edges,
+		       level_graph_s&graph)
+{
+      graph.first.assign(count+1, 0);
+      graph.succ.resize(edges.size());
+      for (size_t idx = 0 ; idx < edges.size() ; idx += 1)
+	    graph.first[edges[idx].first+1] += 1;
+      for (size_t idx = 0 ; idx < count ; idx += 1)
+	    graph.first[idx+1] += graph.first[idx];
+
+      std::vector<size_t> fill (graph.first.begin(), graph.first.end()-1);
+      for (size_t idx = 0 ; idx < edges.size() ; idx += 1)
+	    graph.succ[fill[edges[idx].first]++] = edges[idx].second;
+}
+
+struct level_collect_s {
+      const std::vector<vvp_net_t*>*table;
+      level_edges_t*edges;
+};
+
+static void add_edge(vvp_net_t*src, vvp_net_t*dst, void*data)
+{
+      level_collect_s*col = static_cast<level_collect_s*>(data);
+      if (is_flip_flop(dst))
+	    return;
+      col->edges->push_back(std::make_pair(net_index(*col->table, src),
+					   net_index(*col->table, dst)));
+}
+
+static void collect_edges(const std::vector<vvp_net_t*>&table, level_edges_t&edges)
+{
+      level_collect_s col;
+      col.table = &table;
+      col.edges = &edges;
+
+      for (size_t idx = 0 ; idx < table.size() ; idx += 1) {
+	    vvp_net_ptr_t cur = table[idx]->fanout_head();
+	    while (vvp_net_t*dst = cur.ptr()) {
+		  add_edge(table[idx], dst, &col);
+		  cur = dst->port[cur.port()];
+	    }
+	      /* The input functors of a wide functor call the core
+		 directly, and not through the fan-out. */
+	    if (vvp_wide_fun_t*wide = dynamic_cast<vvp_wide_fun_t*>(table[idx]->fun)) {
+		  if (vvp_net_t*dst = wide->core_net())
+			add_edge(table[idx], dst, &col);
+	    }
+      }
+
+	/* The edges between packed gates are only in the clusters. */
+      gate_pack_edges(&add_edge, &col);
+}
+
+/*
+ * Depth first search of the graph from each of the roots in turn,
+ * appending the nodes to the post list as they are finished. The
+ * comp is set to the root for the nodes that the search reaches.
+ */
+static void depth_first(const level_graph_s&graph, const std::vector<size_t>&roots,
+			std::vector<size_t>&comp, std::vector<size_t>&post)
+{
+      const size_t NONE = (size_t)-1;
+      comp.assign(graph.first.size() - 1, NONE);
+      std::vector<std::pair<size_t,size_t> > stack;
+      for (size_t idx = 0 ; idx < roots.size() ; idx += 1) {
+	    size_t root = roots[idx];
+	    if (comp[root] != NONE)
+		  continue;
+
+	    comp[root] = root;
+	    stack.push_back(std::make_pair(root, graph.first[root]));
+	    while (! stack.empty()) {
+		  size_t pos = stack.back().first;
+		  size_t edge = stack.back().second;
+		  if (edge == graph.first[pos+1]) {
+			post.push_back(pos);
+			stack.pop_back();
+			continue;
+		  }
+
+		  stack.back().second = edge + 1;
+		  size_t dst = graph.succ[edge];
+		  if (comp[dst] == NONE) {
+			comp[dst] = root;
+			stack.push_back(std::make_pair(dst, graph.first[dst]));
+		  }
+	    }
+      }
+}
+
+void compile_levelize(void)
+{
+      std::vector<vvp_net_t*> nets;
+      vvp_net_walk(&collect_net, &nets);
+      std::vector<vvp_net_t*> table (nets);
+      std::sort(table.begin(), table.end());
+      size_t count = table.size();
+
+      level_edges_t edges;
+      collect_edges(table, edges);
+      level_graph_s graph;
+      make_graph(count, edges, graph);
+
+	/* Get the nets in reverse post order, searching from the nets
+	   in allocation order. */
+      std::vector<size_t> roots (count);
+      for (size_t idx = 0 ; idx < count ; idx += 1)
+	    roots[idx] = net_index(table, nets[idx]);
+      std::vector<size_t> comp;
+      std::vector<size_t> post;
+      post.reserve(count);
+      depth_first(graph, roots, comp, post);
+      assert(post.size() == count);
+
+	/* Searching the reversed graph in that order finds the loops
+	   (the strongly connected components). A net is in a loop if
+	   another net has the same component, or if it drives itself. */
+      std::reverse(post.begin(), post.end());
+      for (size_t idx = 0 ; idx < edges.size() ; idx += 1)
+	    std::swap(edges[idx].first, edges[idx].second);
+      level_graph_s rev;
+      make_graph(count, edges, rev);
+      std::vector<size_t> rpost;
+      rpost.reserve(count);
+      depth_first(rev, post, comp, rpost);
+
+      std::vector<size_t> comp_size (count, 0);
+      for (size_t idx = 0 ; idx < count ; idx += 1)
+	    comp_size[comp[idx]] += 1;
+
+      std::vector<bool> in_loop (count, false);
+      for (size_t idx = 0 ; idx < count ; idx += 1) {
+	    if (comp_size[comp[idx]] > 1)
+		  in_loop[idx] = true;
+	    for (size_t edge = graph.first[idx] ; edge < graph.first[idx+1] ; edge += 1) {
+		  if (graph.succ[edge] == idx)
+			in_loop[idx] = true;
+	    }
+      }
+
+	/* Longest paths in the reverse post order, following only
+	   the edges that go forward in that order. The other edges
+	   are all within loops. */
+      std::vector<size_t> rank (count);
+      for (size_t idx = 0 ; idx < count ; idx += 1)
+	    rank[post[idx]] = idx;
+
+      std::vector<unsigned> level (count, 0);
+      for (size_t idx = 0 ; idx < count ; idx += 1) {
+	    size_t pos = post[idx];
+	    for (size_t edge = graph.first[pos] ; edge < graph.first[pos+1] ; edge += 1) {
+		  size_t dst = graph.succ[edge];
+		  if (rank[dst] > rank[pos] && level[dst] <= level[pos])
+			level[dst] = level[pos] + 1;
+	    }
+      }
+
+	/* Level 0 is the normal active queue, so the functors start at
+	   level 1. A functor that serves several nets gets the highest
+	   of their levels. */
+      count_levelized = 0;
+      count_levelize_loops = 0;
+      unsigned max_level = 0;
+      for (size_t idx = 0 ; idx < count ; idx += 1) {
+	    if (table[idx]->fun == 0)
+		  continue;
+	    vvp_gen_event_t obj = table[idx]->fun->levelize_event();
+	    if (obj == 0)
+		  continue;
+
+	    if (is_flip_flop(table[idx]))
+		  continue;
+
+	    if (in_loop[idx]) {
+		  count_levelize_loops += 1;
+		  continue;
+	    }
+
+	    if (obj->sched_level == 0)
+		  count_levelized += 1;
+	    if (obj->sched_level <= level[idx])
+		  obj->sched_level = level[idx] + 1;
+	    if (obj->sched_level > max_level)
+		  max_level = obj->sched_level;
+      }
+
+      count_levels = max_level;
+      schedule_levelize(max_level);
+}
@@ -74,6 +74,23 @@ void vvp_fun_boolean_::recv_vec4_pv(vvp_net_ptr_t ptr, const vvp_vector4_t&bit,
       }
 }
 
+/*
+ * The inputs of a boolean functor normally all have the width of the
+ * output. In that case the result can be calculated a word at a time
+ * with the vvp_vector4_t operators, which implement the same 4-value
+ * truth tables as the scalar operators. If any input has a different
+ * width, the functors fall back on the bit-by-bit loop.
+ */
+bool vvp_fun_boolean_::same_width_inputs_() const
+{
+      unsigned wid = input_[0].size();
+      for (unsigned idx = 1 ;  idx < 4 ;  idx += 1) {
+	    if (input_[idx].size() != wid)
+		  return false;
+      }
+      return true;
+}
+
 vvp_fun_and::vvp_fun_and(unsigned wid, bool invert)
 : vvp_fun_boolean_(wid), invert_(invert)
 {
@@ -91,6 +108,16 @@ void vvp_fun_and::run_run()
 
       vvp_vector4_t result (input_[0]);
 
+      if (same_width_inputs_()) {
+	    result &= input_[1];
+	    result &= input_[2];
+	    result &= input_[3];
+	    if (invert_)
+		  result.invert();
+	    ptr->send_vec4(result, 0);
+	    return;
+      }
+
       for (unsigned idx = 0 ;  idx < result.size() ;  idx += 1) {
 	    vvp_bit4_t bitbit = result.value(idx);
 	    for (unsigned pdx = 1 ;  pdx < 4 ;  pdx += 1) {
@@ -515,6 +542,16 @@ void vvp_fun_or::run_run()
 
       vvp_vector4_t result (input_[0]);
 
+      if (same_width_inputs_()) {
+	    result |= input_[1];
+	    result |= input_[2];
+	    result |= input_[3];
+	    if (invert_)
+		  result.invert();
+	    ptr->send_vec4(result, 0);
+	    return;
+      }
+
       for (unsigned idx = 0 ;  idx < result.size() ;  idx += 1) {
 	    vvp_bit4_t bitbit = result.value(idx);
 	    for (unsigned pdx = 1 ;  pdx < 4 ;  pdx += 1) {
@@ -551,6 +588,16 @@ void vvp_fun_xor::run_run()
 
       vvp_vector4_t result (input_[0]);
 
+      if (same_width_inputs_()) {
+	    result ^= input_[1];
+	    result ^= input_[2];
+	    result ^= input_[3];
+	    if (invert_)
+		  result.invert();
+	    ptr->send_vec4(result, 0);
+	    return;
+      }
+
       for (unsigned idx = 0 ;  idx < result.size() ;  idx += 1) {
 	    vvp_bit4_t bitbit = result.value(idx);
 	    for (unsigned pdx = 1 ;  pdx < 4 ;  pdx += 1) {
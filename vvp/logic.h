@@ -1,7 +1,7 @@
 #ifndef IVL_logic_H
 #define IVL_logic_H
 /*
- * Copyright (c) 2000-2014 Stephen Williams (steve@icarus.com)
+ * Copyright (c) 2000-2016 Stephen Williams (steve@icarus.com)
  *
  *    This source code is free software; you can redistribute it
  *    and/or modify it in source code form under the terms of the GNU
@@ -38,6 +38,13 @@ class vvp_fun_boolean_ : public vvp_net_fun_t, protected vvp_gen_event_s {
 			unsigned base, unsigned wid, unsigned vwid,
                         vvp_context_t);
 
+      unsigned width() const { return input_[0].size(); }
+
+      vvp_gen_event_t levelize_event() { return this; }
+
+    protected:
+      bool same_width_inputs_() const;
+
     protected:
       vvp_vector4_t input_[4];
       vvp_net_t*net_;
@@ -49,6 +56,8 @@ class vvp_fun_and  : public vvp_fun_boolean_ {
       explicit vvp_fun_and(unsigned wid, bool invert);
       ~vvp_fun_and();
 
+      bool inverted() const { return invert_; }
+
     private:
       void run_run();
       bool invert_;
@@ -72,6 +81,10 @@ class vvp_fun_buf: public vvp_net_fun_t, private vvp_gen_event_s {
 			unsigned base, unsigned wid, unsigned vwid,
                         vvp_context_t);
 
+      unsigned width() const { return input_.size(); }
+
+      vvp_gen_event_t levelize_event() { return this; }
+
     private:
       void run_run();
 
@@ -138,6 +151,8 @@ class vvp_fun_muxz : public vvp_net_fun_t, private vvp_gen_event_s {
 			unsigned base, unsigned wid, unsigned vwid,
                         vvp_context_t);
 
+      vvp_gen_event_t levelize_event() { return this; }
+
     private:
       void run_run();
 
@@ -160,6 +175,8 @@ class vvp_fun_muxr : public vvp_net_fun_t, private vvp_gen_event_s {
       void recv_real(vvp_net_ptr_t p, double bit,
                      vvp_context_t);
 
+      vvp_gen_event_t levelize_event() { return this; }
+
     private:
       void run_run();
 
@@ -182,6 +199,10 @@ class vvp_fun_not: public vvp_net_fun_t, private vvp_gen_event_s {
 			unsigned base, unsigned wid, unsigned vwid,
                         vvp_context_t);
 
+      unsigned width() const { return input_.size(); }
+
+      vvp_gen_event_t levelize_event() { return this; }
+
     private:
       void run_run();
 
@@ -196,6 +217,8 @@ class vvp_fun_or  : public vvp_fun_boolean_ {
       explicit vvp_fun_or(unsigned wid, bool invert);
       ~vvp_fun_or();
 
+      bool inverted() const { return invert_; }
+
     private:
       void run_run();
       bool invert_;
@@ -207,6 +230,8 @@ class vvp_fun_xor  : public vvp_fun_boolean_ {
       explicit vvp_fun_xor(unsigned wid, bool invert);
       ~vvp_fun_xor();
 
+      bool inverted() const { return invert_; }
+
     private:
       void run_run();
       bool invert_;
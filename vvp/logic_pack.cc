@@ -0,0 +1,795 @@
+/*
+ * Copyright (c) 2016 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "config.h"
+# include  "compile.h"
+# include  "logic.h"
+# include  "schedule.h"
+# include  "statistics.h"
+# include  "vvp_net_sig.h"
+# include  <algorithm>
+# include  <vector>
+# include  <cassert>
+# include  <stdint.h>
+#ifdef CHECK_WITH_VALGRIND
+# include  "vvp_cleanup.h"
+#endif
+
+/*
+ * Gate packing evaluates clusters of scalar AND/OR/XOR/BUF/NOT gates
+ * (and their inverted forms) as bit planes, 64 gates to a word,
+ * instead of as one functor and one event per gate.
+ *
+ * At link time the gates whose outputs drive inputs of other gates
+ * are grouped into clusters (the connected components of those
+ * edges), and the gates of a cluster are levelized. Gates of the same
+ * level and function are put in packs of up to 64. A gate value is
+ * kept as two bits, one in the "zero" plane and one in the "one"
+ * plane, so 0 is (1,0), 1 is (0,1) and x or z is (0,0). The gate
+ * functions are then word operations on the planes.
+ *
+ * The edges between gates of a cluster are removed from the fan-out
+ * lists. The cluster instead marks the consumers of a changed gate
+ * dirty, and when the cluster runs it evaluates the dirty gates in
+ * level order. Only the gate outputs that have other receivers, or a
+ * filter that holds the net value, are sent into the net graph. The
+ * functor of each packed gate is replaced with a vvp_fun_gate_pack
+ * that passes the values on its inputs to the cluster.
+ *
+ * A cluster runs as a single active event, so within a time step the
+ * gates settle in level order and the zero-delay glitches that the
+ * gate-at-a-time evaluation may produce are not seen.
+ *
+ * Gates that are part of a combinational loop are not packed, and
+ * neither are gates with a delay or a drive strength, as those go
+ * through another node before reaching their receivers.
+ */
+
+unsigned long count_gate_clusters = 0;
+unsigned long count_gate_packs = 0;
+unsigned long count_gate_packed = 0;
+
+# define GATE_PACK_LANES 64
+
+enum gate_kind_t { GATE_AND = 0, GATE_OR, GATE_XOR, GATE_BUF };
+
+static inline unsigned lowest_bit(uint64_t bits)
+{
+#if defined(__GNUC__)
+      return __builtin_ctzll(bits);
+#else
+      unsigned idx = 0;
+      while ((bits & 1) == 0) {
+	    bits >>= 1;
+	    idx += 1;
+      }
+      return idx;
+#endif
+}
+
+struct gate_pack_s {
+      unsigned char kind;
+      bool invert;
+      unsigned char arity;
+	// The source slots, GATE_PACK_LANES groups of arity.
+      size_t src;
+};
+
+class vvp_gate_cluster : public vvp_gen_event_s {
+
+    public:
+      vvp_gate_cluster();
+      ~vvp_gate_cluster();
+
+	// A gate input changed.
+      void recv(unsigned out_slot, unsigned in_slot, vvp_bit4_t bit);
+	// The net of the gate was forced or released.
+      void force(unsigned out_slot);
+
+    private:
+      void run_run();
+
+      void eval_pack_(size_t pdx);
+      void mark_dirty_(unsigned slot);
+      void send_(unsigned slot, vvp_bit4_t bit);
+
+      vvp_bit4_t slot_value_(unsigned slot) const
+      {
+	    uint64_t mask = 1ULL << (slot % GATE_PACK_LANES);
+	    if (zero_[slot / GATE_PACK_LANES] & mask) return BIT4_0;
+	    if (one_[slot / GATE_PACK_LANES] & mask) return BIT4_1;
+	    return BIT4_X;
+      }
+
+    private:
+      friend void compile_gate_packs(void);
+      friend void gate_pack_edges(void (*fun)(vvp_net_t*, vvp_net_t*, void*),
+				  void*data);
+
+      std::vector<gate_pack_s> packs_;
+	// The value planes. The first word for each pack holds the
+	// outputs of the pack, and the rest hold the gate inputs that
+	// are driven from outside the cluster.
+      std::vector<uint64_t> zero_;
+      std::vector<uint64_t> one_;
+	// Per pack masks of the gates that need evaluation, that have
+	// sent a value, that are forced, and that send their value to
+	// the net graph.
+      std::vector<uint64_t> dirty_;
+      std::vector<uint64_t> sent_;
+      std::vector<uint64_t> forced_;
+      std::vector<uint64_t> extern_;
+	// One bit for each pack with dirty gates.
+      std::vector<uint64_t> pending_;
+      size_t first_pending_;
+      bool scheduled_;
+
+      std::vector<uint32_t> src_;
+	// The net and the consumers of each output slot.
+      std::vector<vvp_net_t*> nets_;
+      std::vector<uint32_t> cons_off_;
+      std::vector<uint32_t> cons_;
+};
+
+/*
+ * This replaces the functor of a packed gate, and passes the inputs
+ * to the cluster.
+ */
+class vvp_fun_gate_pack : public vvp_net_fun_t {
+
+    public:
+      vvp_fun_gate_pack(vvp_gate_cluster*cluster, unsigned out_slot,
+			unsigned in_slot, unsigned arity);
+      ~vvp_fun_gate_pack();
+
+      void recv_vec4(vvp_net_ptr_t p, const vvp_vector4_t&bit,
+                     vvp_context_t);
+      void recv_vec4_pv(vvp_net_ptr_t p, const vvp_vector4_t&bit,
+			unsigned base, unsigned wid, unsigned vwid,
+                        vvp_context_t);
+      void force_flag(bool run_now);
+	// The cluster runs as the event for all of its gates.
+      vvp_gen_event_t levelize_event() { return cluster_; }
+
+    private:
+      vvp_gate_cluster*cluster_;
+      unsigned out_slot_;
+      unsigned in_slot_;
+      unsigned arity_;
+};
+
+vvp_fun_gate_pack::vvp_fun_gate_pack(vvp_gate_cluster*cluster,
+				     unsigned out_slot, unsigned in_slot,
+				     unsigned arity)
+: cluster_(cluster), out_slot_(out_slot), in_slot_(in_slot), arity_(arity)
+{
+}
+
+vvp_fun_gate_pack::~vvp_fun_gate_pack()
+{
+}
+
+void vvp_fun_gate_pack::recv_vec4(vvp_net_ptr_t ptr, const vvp_vector4_t&bit,
+				  vvp_context_t)
+{
+      unsigned port = ptr.port();
+      if (port >= arity_)
+	    return;
+
+      vvp_bit4_t val = bit.size() > 0 ? bit.value(0) : BIT4_Z;
+      cluster_->recv(out_slot_, in_slot_ + port, val);
+}
+
+void vvp_fun_gate_pack::recv_vec4_pv(vvp_net_ptr_t ptr, const vvp_vector4_t&bit,
+				     unsigned base, unsigned wid, unsigned vwid,
+				     vvp_context_t ctx)
+{
+      recv_vec4_pv_(ptr, bit, base, wid, vwid, ctx);
+}
+
+void vvp_fun_gate_pack::force_flag(bool)
+{
+      cluster_->force(out_slot_);
+}
+
+vvp_gate_cluster::vvp_gate_cluster()
+{
+      first_pending_ = 0;
+      scheduled_ = false;
+}
+
+vvp_gate_cluster::~vvp_gate_cluster()
+{
+}
+
+void vvp_gate_cluster::mark_dirty_(unsigned slot)
+{
+      size_t pdx = slot / GATE_PACK_LANES;
+      dirty_[pdx] |= 1ULL << (slot % GATE_PACK_LANES);
+      pending_[pdx / 64] |= 1ULL << (pdx % 64);
+      if (pdx < first_pending_)
+	    first_pending_ = pdx;
+
+      if (! scheduled_) {
+	    scheduled_ = true;
+	    schedule_functor(this);
+      }
+}
+
+void vvp_gate_cluster::recv(unsigned out_slot, unsigned in_slot, vvp_bit4_t bit)
+{
+      size_t wdx = in_slot / GATE_PACK_LANES;
+      uint64_t mask = 1ULL << (in_slot % GATE_PACK_LANES);
+      uint64_t zero = bit == BIT4_0 ? mask : 0;
+      uint64_t one  = bit == BIT4_1 ? mask : 0;
+
+      if ((zero_[wdx] & mask) == zero && (one_[wdx] & mask) == one) {
+	      /* The planes do not tell x from z, but an x that
+		 replaces the initial z of an input still makes a
+		 gate that has not run yet run, as it would if it
+		 were not packed. */
+	    uint64_t out_mask = 1ULL << (out_slot % GATE_PACK_LANES);
+	    if (bit != BIT4_X || (sent_[out_slot / GATE_PACK_LANES] & out_mask))
+		  return;
+      }
+
+      zero_[wdx] = (zero_[wdx] & ~mask) | zero;
+      one_[wdx]  = (one_[wdx] & ~mask) | one;
+      mark_dirty_(out_slot);
+}
+
+void vvp_gate_cluster::send_(unsigned slot, vvp_bit4_t bit)
+{
+      vvp_vector4_t val (1, bit);
+      nets_[slot]->send_vec4(val, 0);
+}
+
+void vvp_gate_cluster::force(unsigned out_slot)
+{
+      size_t pdx = out_slot / GATE_PACK_LANES;
+      uint64_t mask = 1ULL << (out_slot % GATE_PACK_LANES);
+      vvp_net_t*net = nets_[out_slot];
+
+      if (net->fil && net->fil->is_forced(0)) {
+	      /* The gates of the cluster that this gate drives see
+		 the forced value until the net is released. */
+	    vvp_signal_value*sig = dynamic_cast<vvp_signal_value*>(net->fil);
+	    vvp_bit4_t bit = sig ? sig->value(0) : BIT4_X;
+	    forced_[pdx] |= mask;
+	    sent_[pdx] |= mask;
+	    zero_[pdx] = (zero_[pdx] & ~mask) | (bit == BIT4_0 ? mask : 0);
+	    one_[pdx]  = (one_[pdx] & ~mask)  | (bit == BIT4_1 ? mask : 0);
+	    for (uint32_t idx = cons_off_[out_slot] ; idx < cons_off_[out_slot+1] ; idx += 1)
+		  mark_dirty_(cons_[idx]);
+
+      } else if (forced_[pdx] & mask) {
+	      /* Released, so evaluate the gate again and send the
+		 result as if it were new. */
+	    forced_[pdx] &= ~mask;
+	    sent_[pdx] &= ~mask;
+	    mark_dirty_(out_slot);
+      }
+}
+
+void vvp_gate_cluster::eval_pack_(size_t pdx)
+{
+      const gate_pack_s&pack = packs_[pdx];
+      uint64_t dirty = dirty_[pdx];
+      dirty_[pdx] = 0;
+
+	/* Gather the input bits of the dirty gates into words. */
+      uint64_t in_zero[4] = { 0, 0, 0, 0 };
+      uint64_t in_one[4]  = { 0, 0, 0, 0 };
+      const uint32_t*src = &src_[pack.src];
+      for (uint64_t bits = dirty ; bits ; bits &= bits - 1) {
+	    unsigned lane = lowest_bit(bits);
+	    const uint32_t*cur = src + lane*pack.arity;
+	    for (unsigned pin = 0 ; pin < pack.arity ; pin += 1) {
+		  uint32_t slot = cur[pin];
+		  unsigned shift = slot % GATE_PACK_LANES;
+		  in_zero[pin] |= ((zero_[slot / GATE_PACK_LANES] >> shift) & 1) << lane;
+		  in_one[pin]  |= ((one_[slot / GATE_PACK_LANES] >> shift) & 1) << lane;
+	    }
+      }
+
+      uint64_t zero = in_zero[0];
+      uint64_t one  = in_one[0];
+      for (unsigned pin = 1 ; pin < pack.arity ; pin += 1) {
+	    uint64_t tmp;
+	    switch (pack.kind) {
+		case GATE_AND:
+		  zero |= in_zero[pin];
+		  one  &= in_one[pin];
+		  break;
+		case GATE_OR:
+		  zero &= in_zero[pin];
+		  one  |= in_one[pin];
+		  break;
+		case GATE_XOR:
+		  tmp  = (zero & in_zero[pin]) | (one & in_one[pin]);
+		  one  = (zero & in_one[pin]) | (one & in_zero[pin]);
+		  zero = tmp;
+		  break;
+		default:
+		  assert(0);
+		  break;
+	    }
+      }
+      if (pack.invert)
+	    std::swap(zero, one);
+
+      uint64_t forced = dirty & forced_[pdx];
+      uint64_t changed = (zero ^ zero_[pdx]) | (one ^ one_[pdx]) | ~sent_[pdx];
+      changed &= dirty & ~forced;
+
+      zero_[pdx] = (zero_[pdx] & ~changed) | (zero & changed);
+      one_[pdx]  = (one_[pdx] & ~changed)  | (one & changed);
+      sent_[pdx] |= changed;
+
+      for (uint64_t bits = changed ; bits ; bits &= bits - 1) {
+	    unsigned lane = lowest_bit(bits);
+	    unsigned slot = pdx*GATE_PACK_LANES + lane;
+
+	      /* The consumers are in later packs, so they are found
+		 further on in this run of the cluster. */
+	    for (uint32_t idx = cons_off_[slot] ; idx < cons_off_[slot+1] ; idx += 1) {
+		  uint32_t cons = cons_[idx];
+		  size_t cdx = cons / GATE_PACK_LANES;
+		  dirty_[cdx] |= 1ULL << (cons % GATE_PACK_LANES);
+		  pending_[cdx / 64] |= 1ULL << (cdx % 64);
+	    }
+
+	    if (extern_[pdx] & (1ULL << lane))
+		  send_(slot, slot_value_(slot));
+      }
+
+	/* A forced gate still sends its value so that the filter has
+	   the driven value when the net is released. */
+      for (uint64_t bits = forced & extern_[pdx] ; bits ; bits &= bits - 1) {
+	    unsigned lane = lowest_bit(bits);
+	    uint64_t mask = 1ULL << lane;
+	    vvp_bit4_t bit = (zero & mask) ? BIT4_0 : (one & mask) ? BIT4_1 : BIT4_X;
+	    send_(pdx*GATE_PACK_LANES + lane, bit);
+      }
+}
+
+void vvp_gate_cluster::run_run()
+{
+      size_t wdx = first_pending_ / 64;
+      first_pending_ = packs_.size();
+      scheduled_ = false;
+
+	/* Evaluating a pack only marks later packs, so one pass in
+	   pack order settles the cluster. An input that comes back
+	   into the cluster through other nodes while it runs
+	   schedules the cluster again. */
+      while (wdx < pending_.size()) {
+	    if (pending_[wdx] == 0) {
+		  wdx += 1;
+		  continue;
+	    }
+
+	    unsigned bit = lowest_bit(pending_[wdx]);
+	    pending_[wdx] &= ~(1ULL << bit);
+	    eval_pack_(wdx*64 + bit);
+      }
+}
+
+/*
+ * Link time analysis. The gates are indexed by their position in a
+ * sorted table of their nets.
+ */
+
+struct gate_info_s {
+      vvp_net_t*net;
+      unsigned char kind;
+      bool invert;
+      unsigned char arity;
+};
+
+static bool get_gate_info(vvp_net_t*net, gate_info_s&info)
+{
+      info.net = net;
+      info.invert = false;
+      info.arity = 4;
+
+      if (vvp_fun_and*fun = dynamic_cast<vvp_fun_and*>(net->fun)) {
+	    info.kind = GATE_AND;
+	    info.invert = fun->inverted();
+	    return fun->width() == 1;
+      }
+      if (vvp_fun_or*fun = dynamic_cast<vvp_fun_or*>(net->fun)) {
+	    info.kind = GATE_OR;
+	    info.invert = fun->inverted();
+	    return fun->width() == 1;
+      }
+      if (vvp_fun_xor*fun = dynamic_cast<vvp_fun_xor*>(net->fun)) {
+	    info.kind = GATE_XOR;
+	    info.invert = fun->inverted();
+	    return fun->width() == 1;
+      }
+
+	/* A buf or not is a one input AND. */
+      info.arity = 1;
+      if (vvp_fun_buf*fun = dynamic_cast<vvp_fun_buf*>(net->fun)) {
+	    info.kind = GATE_AND;
+	    return fun->width() == 1;
+      }
+      if (vvp_fun_not*fun = dynamic_cast<vvp_fun_not*>(net->fun)) {
+	    info.kind = GATE_AND;
+	    info.invert = true;
+	    return fun->width() == 1;
+      }
+
+      return false;
+}
+
+static void collect_gate(vvp_net_t*net, void*data)
+{
+      std::vector<gate_info_s>*table = static_cast<std::vector<gate_info_s>*>(data);
+      gate_info_s info;
+      if (get_gate_info(net, info))
+	    table->push_back(info);
+}
+
+static bool compare_gate_net(const gate_info_s&a, const gate_info_s&b)
+{
+      return a.net < b.net;
+}
+
+static size_t gate_index(const std::vector<gate_info_s>&table, vvp_net_t*net)
+{
+      gate_info_s key;
+      key.net = net;
+      std::vector<gate_info_s>::const_iterator cur
+	    = std::lower_bound(table.begin(), table.end(), key, compare_gate_net);
+      if (cur == table.end() || cur->net != net)
+	    return table.size();
+      return cur - table.begin();
+}
+
+static size_t find_root(std::vector<size_t>&parent, size_t idx)
+{
+      while (parent[idx] != idx) {
+	    parent[idx] = parent[parent[idx]];
+	    idx = parent[idx];
+      }
+      return idx;
+}
+
+struct gate_order_s {
+      size_t root;
+      unsigned level;
+      unsigned char kind;
+      bool invert;
+      unsigned char arity;
+      size_t gate;
+
+      bool operator < (const gate_order_s&that) const
+      {
+	    if (root != that.root) return root < that.root;
+	    if (level != that.level) return level < that.level;
+	    if (kind != that.kind) return kind < that.kind;
+	    if (invert != that.invert) return invert < that.invert;
+	    if (arity != that.arity) return arity < that.arity;
+	    return gate < that.gate;
+      }
+};
+
+static std::vector<vvp_gate_cluster*> gate_clusters;
+
+void compile_gate_packs(void)
+{
+      std::vector<gate_info_s> gates;
+      vvp_net_walk(&collect_gate, &gates);
+      std::sort(gates.begin(), gates.end(), compare_gate_net);
+      size_t ngates = gates.size();
+      const size_t none = ngates;
+
+	/* Find the gate inputs that are driven by other gates. The
+	   driver of input pin of gate g is src[g*4+pin]. */
+      std::vector<size_t> src (4*ngates, none);
+      std::vector<size_t> succ_off (ngates+1, 0);
+      std::vector<size_t> succ;
+      for (size_t idx = 0 ; idx < ngates ; idx += 1) {
+	    vvp_net_ptr_t cur = gates[idx].net->fanout_head();
+	    while (vvp_net_t*dst = cur.ptr()) {
+		  size_t gdx = gate_index(gates, dst);
+		  if (gdx != none && cur.port() < gates[gdx].arity) {
+			src[4*gdx + cur.port()] = idx;
+			succ.push_back(gdx);
+		  }
+		  cur = dst->port[cur.port()];
+	    }
+	    succ_off[idx+1] = succ.size();
+      }
+
+	/* Levelize the gates. The gates that are left are in a loop,
+	   or are downstream of one. */
+      std::vector<unsigned> level (ngates, 0);
+      std::vector<size_t> indeg (ngates, 0);
+      std::vector<size_t> queue;
+      for (size_t idx = 0 ; idx < succ.size() ; idx += 1)
+	    indeg[succ[idx]] += 1;
+      for (size_t idx = 0 ; idx < ngates ; idx += 1) {
+	    if (indeg[idx] == 0)
+		  queue.push_back(idx);
+      }
+      for (size_t qdx = 0 ; qdx < queue.size() ; qdx += 1) {
+	    size_t cur = queue[qdx];
+	    for (size_t sdx = succ_off[cur] ; sdx < succ_off[cur+1] ; sdx += 1) {
+		  size_t nxt = succ[sdx];
+		  level[nxt] = std::max(level[nxt], level[cur] + 1);
+		  if (--indeg[nxt] == 0)
+			queue.push_back(nxt);
+	    }
+      }
+
+	/* Trim the gates that are only downstream of a loop from the
+	   left over gates, working back from the gates that drive
+	   no other left over gate. What remains is not packed. */
+      std::vector<bool> packed (ngates, true);
+      if (queue.size() < ngates) {
+	    std::vector<size_t> outdeg (ngates, 0);
+	    std::vector<size_t> trim;
+	    for (size_t idx = 0 ; idx < ngates ; idx += 1) {
+		  if (indeg[idx] == 0)
+			continue;
+		  for (size_t sdx = succ_off[idx] ; sdx < succ_off[idx+1] ; sdx += 1) {
+			if (indeg[succ[sdx]] != 0)
+			      outdeg[idx] += 1;
+		  }
+		  if (outdeg[idx] == 0)
+			trim.push_back(idx);
+	    }
+	    std::vector<bool> trimmed (ngates, false);
+	    for (size_t tdx = 0 ; tdx < trim.size() ; tdx += 1) {
+		  size_t cur = trim[tdx];
+		  trimmed[cur] = true;
+		  for (unsigned pin = 0 ; pin < 4 ; pin += 1) {
+			size_t drv = src[4*cur + pin];
+			if (drv == none || indeg[drv] == 0)
+			      continue;
+			if (--outdeg[drv] == 0)
+			      trim.push_back(drv);
+		  }
+	    }
+	    for (size_t idx = 0 ; idx < ngates ; idx += 1) {
+		  if (indeg[idx] != 0 && !trimmed[idx])
+			packed[idx] = false;
+	    }
+
+	      /* Levelize again without the gates in loops. */
+	    std::fill(indeg.begin(), indeg.end(), 0);
+	    std::fill(level.begin(), level.end(), 0);
+	    for (size_t idx = 0 ; idx < ngates ; idx += 1) {
+		  if (! packed[idx]) continue;
+		  for (size_t sdx = succ_off[idx] ; sdx < succ_off[idx+1] ; sdx += 1) {
+			if (packed[succ[sdx]])
+			      indeg[succ[sdx]] += 1;
+		  }
+	    }
+	    queue.clear();
+	    for (size_t idx = 0 ; idx < ngates ; idx += 1) {
+		  if (packed[idx] && indeg[idx] == 0)
+			queue.push_back(idx);
+	    }
+	    for (size_t qdx = 0 ; qdx < queue.size() ; qdx += 1) {
+		  size_t cur = queue[qdx];
+		  for (size_t sdx = succ_off[cur] ; sdx < succ_off[cur+1] ; sdx += 1) {
+			size_t nxt = succ[sdx];
+			if (! packed[nxt]) continue;
+			level[nxt] = std::max(level[nxt], level[cur] + 1);
+			if (--indeg[nxt] == 0)
+			      queue.push_back(nxt);
+		  }
+	    }
+      }
+
+	/* The clusters are the connected components of the edges
+	   between packed gates. A gate with no such edges is left as
+	   it is. */
+      std::vector<size_t> parent (ngates);
+      std::vector<size_t> csize (ngates, 1);
+      for (size_t idx = 0 ; idx < ngates ; idx += 1)
+	    parent[idx] = idx;
+      for (size_t idx = 0 ; idx < ngates ; idx += 1) {
+	    if (! packed[idx]) continue;
+	    for (size_t sdx = succ_off[idx] ; sdx < succ_off[idx+1] ; sdx += 1) {
+		  if (! packed[succ[sdx]]) continue;
+		  size_t ra = find_root(parent, idx);
+		  size_t rb = find_root(parent, succ[sdx]);
+		  if (ra == rb) continue;
+		  if (csize[ra] < csize[rb])
+			std::swap(ra, rb);
+		  parent[rb] = ra;
+		  csize[ra] += csize[rb];
+	    }
+      }
+
+      std::vector<gate_order_s> order;
+      for (size_t idx = 0 ; idx < ngates ; idx += 1) {
+	    if (! packed[idx]) continue;
+	    size_t root = find_root(parent, idx);
+	    if (csize[root] < 2) {
+		  packed[idx] = false;
+		  continue;
+	    }
+	    gate_order_s cur;
+	    cur.root = root;
+	    cur.level = level[idx];
+	    cur.kind = gates[idx].kind;
+	    cur.invert = gates[idx].invert;
+	    cur.arity = gates[idx].arity;
+	    cur.gate = idx;
+	    order.push_back(cur);
+      }
+      std::sort(order.begin(), order.end());
+
+	/* Assign the gates of each cluster to packs. The output slot
+	   of a gate is its lane in the first word of its pack, and
+	   its inputs from outside the cluster are given four slots
+	   each after the pack words. */
+      std::vector<unsigned> out_slot (ngates, 0);
+      std::vector<unsigned> in_slot (ngates, 0);
+      std::vector<vvp_gate_cluster*> cluster_of (ngates, 0);
+
+      for (size_t odx = 0 ; odx < order.size() ; ) {
+	    size_t end = odx;
+	    while (end < order.size() && order[end].root == order[odx].root)
+		  end += 1;
+
+	    vvp_gate_cluster*cl = new vvp_gate_cluster;
+	    gate_clusters.push_back(cl);
+	    count_gate_clusters += 1;
+
+	    for (size_t idx = odx ; idx < end ; idx += 1) {
+		  const gate_order_s&cur = order[idx];
+		  bool fresh = cl->packs_.empty()
+			|| cl->packs_.back().kind != cur.kind
+			|| cl->packs_.back().invert != cur.invert
+			|| cl->packs_.back().arity != cur.arity
+			|| order[idx-1].level != cur.level
+			|| out_slot[order[idx-1].gate] % GATE_PACK_LANES == GATE_PACK_LANES-1;
+		  if (fresh) {
+			gate_pack_s pack;
+			pack.kind = cur.kind;
+			pack.invert = cur.invert;
+			pack.arity = gates[cur.gate].arity;
+			pack.src = 0;
+			cl->packs_.push_back(pack);
+			out_slot[cur.gate] = (cl->packs_.size()-1) * GATE_PACK_LANES;
+		  } else {
+			out_slot[cur.gate] = out_slot[order[idx-1].gate] + 1;
+		  }
+		  cluster_of[cur.gate] = cl;
+	    }
+
+	    size_t npacks = cl->packs_.size();
+	    size_t nslots = npacks*GATE_PACK_LANES + 4*(end-odx);
+	    size_t nwords = (nslots + GATE_PACK_LANES-1) / GATE_PACK_LANES;
+	    cl->zero_.assign(nwords, 0);
+	    cl->one_.assign(nwords, 0);
+	    cl->dirty_.assign(npacks, 0);
+	    cl->sent_.assign(npacks, 0);
+	    cl->forced_.assign(npacks, 0);
+	    cl->extern_.assign(npacks, 0);
+	    cl->pending_.assign((npacks+63) / 64, 0);
+	    cl->first_pending_ = npacks;
+	    cl->nets_.assign(npacks*GATE_PACK_LANES, 0);
+
+	    for (size_t pdx = 0 ; pdx < npacks ; pdx += 1) {
+		  cl->packs_[pdx].src = cl->src_.size();
+		  cl->src_.resize(cl->src_.size() + GATE_PACK_LANES*cl->packs_[pdx].arity, 0);
+	    }
+
+	      /* Connect the inputs, and count the consumers of each
+		 output. The unused lanes read slot 0, which is
+		 harmless as they are never evaluated. */
+	    std::vector<uint32_t> ncons (npacks*GATE_PACK_LANES, 0);
+	    for (size_t idx = odx ; idx < end ; idx += 1) {
+		  size_t gate = order[idx].gate;
+		  unsigned slot = out_slot[gate];
+		  const gate_pack_s&pack = cl->packs_[slot / GATE_PACK_LANES];
+		  in_slot[gate] = npacks*GATE_PACK_LANES + 4*(idx-odx);
+		  uint32_t*cur = &cl->src_[pack.src + (slot % GATE_PACK_LANES)*pack.arity];
+		  for (unsigned pin = 0 ; pin < pack.arity ; pin += 1) {
+			size_t drv = src[4*gate + pin];
+			if (drv != none && packed[drv]) {
+			      assert(cluster_of[drv] == cl);
+			      cur[pin] = out_slot[drv];
+			      ncons[out_slot[drv]] += 1;
+			} else {
+			      cur[pin] = in_slot[gate] + pin;
+			}
+		  }
+		  cl->nets_[slot] = gates[gate].net;
+	    }
+
+	    cl->cons_off_.assign(npacks*GATE_PACK_LANES + 1, 0);
+	    for (size_t idx = 0 ; idx < ncons.size() ; idx += 1)
+		  cl->cons_off_[idx+1] = cl->cons_off_[idx] + ncons[idx];
+	    cl->cons_.assign(cl->cons_off_.back(), 0);
+	    std::fill(ncons.begin(), ncons.end(), 0);
+	    for (size_t idx = odx ; idx < end ; idx += 1) {
+		  size_t gate = order[idx].gate;
+		  for (unsigned pin = 0 ; pin < gates[gate].arity ; pin += 1) {
+			size_t drv = src[4*gate + pin];
+			if (drv == none || !packed[drv])
+			      continue;
+			unsigned from = out_slot[drv];
+			cl->cons_[cl->cons_off_[from] + ncons[from]++] = out_slot[gate];
+		  }
+	    }
+
+	    count_gate_packs += npacks;
+	    count_gate_packed += end - odx;
+	    odx = end;
+      }
+
+	/* Take the edges between packed gates out of the fan-out
+	   lists, keeping the order of the rest, and replace the gate
+	   functors. */
+      std::vector<vvp_net_ptr_t> keep;
+      for (size_t idx = 0 ; idx < ngates ; idx += 1) {
+	    if (! packed[idx]) continue;
+	    vvp_net_t*net = gates[idx].net;
+	    vvp_gate_cluster*cl = cluster_of[idx];
+
+	    keep.clear();
+	    while (vvp_net_t*dst = net->fanout_head().ptr()) {
+		  vvp_net_ptr_t cur = net->fanout_head();
+		  size_t gdx = gate_index(gates, dst);
+		  net->unlink(cur);
+		  if (gdx != none && packed[gdx] && cur.port() < gates[gdx].arity)
+			continue;
+		  keep.push_back(cur);
+	    }
+	    for (size_t kdx = keep.size() ; kdx > 0 ; kdx -= 1)
+		  net->link(keep[kdx-1]);
+
+	    unsigned slot = out_slot[idx];
+	    if (net->fil || !keep.empty())
+		  cl->extern_[slot / GATE_PACK_LANES] |= 1ULL << (slot % GATE_PACK_LANES);
+
+	    net->fun = new vvp_fun_gate_pack(cl, slot, in_slot[idx],
+					     gates[idx].arity);
+      }
+}
+
+void gate_pack_edges(void (*fun)(vvp_net_t*, vvp_net_t*, void*), void*data)
+{
+      for (size_t cdx = 0 ; cdx < gate_clusters.size() ; cdx += 1) {
+	    vvp_gate_cluster*cl = gate_clusters[cdx];
+	    for (size_t slot = 0 ; slot < cl->nets_.size() ; slot += 1) {
+		  for (uint32_t idx = cl->cons_off_[slot]
+			     ; idx < cl->cons_off_[slot+1] ; idx += 1)
+			fun(cl->nets_[slot], cl->nets_[cl->cons_[idx]], data);
+	    }
+      }
+}
+
+#ifdef CHECK_WITH_VALGRIND
+void gate_pack_delete(void)
+{
+      for (size_t idx = 0 ; idx < gate_clusters.size() ; idx += 1)
+	    delete gate_clusters[idx];
+      gate_clusters.clear();
+}
+#endif
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2001-2015 Stephen Williams (steve@icarus.com)
+ * Copyright (c) 2001-2016 Stephen Williams (steve@icarus.com)
  *
  *    This source code is free software; you can redistribute it
  *    and/or modify it in source code form under the terms of the GNU
@@ -25,6 +25,7 @@
 # include  "schedule.h"
 # include  "vpi_priv.h"
 # include  "statistics.h"
+# include  "profile.h"
 # include  "vvp_cleanup.h"
 # include  "vvp_object.h"
 # include  <cstdio>
@@ -44,6 +45,12 @@
 # include  <getopt.h>
 #endif
 
+#if defined(HAVE_SYS_WAIT_H) && !defined(__MINGW32__)
+# include  <sys/types.h>
+# include  <sys/wait.h>
+# define BATCH_RUNS 1
+#endif
+
 #if defined(__MINGW32__)
 # include  <windows.h>
 #endif
@@ -58,6 +65,9 @@ extern "C" const char*optarg;
 
 bool verbose_flag = false;
 bool version_flag = false;
+static bool gate_pack_flag = false;
+static bool levelize_flag = false;
+static bool flow_layout_flag = false;
 static int vvp_return_value = 0;
 
 void vpip_set_return_value(int value)
@@ -65,6 +75,43 @@ void vpip_set_return_value(int value)
       vvp_return_value = value;
 }
 
+#ifdef BATCH_RUNS
+static bool fork_batch_runs(const char*runs_path, int&rc, unsigned&nruns);
+#endif
+
+/*
+ * The $checkpoint system task calls this to fork the runs in the
+ * runs file from the current state of the simulation, instead of from
+ * time 0 as the -R flag does. Each run continues the simulation in a
+ * child process, and the parent exits when all the runs are done.
+ */
+void vpip_checkpoint(const char*runs_path)
+{
+#ifdef BATCH_RUNS
+      int rc;
+      unsigned nruns;
+      if (fork_batch_runs(runs_path, rc, nruns))
+	    return;
+
+      if (nruns == 0) {
+	    vvp_return_value = rc;
+	    schedule_finish(0);
+	    return;
+      }
+
+	/* The runs share the files that were open at the checkpoint,
+	   such as the log files, and have already finished them.
+	   Exit directly, without the final blocks, the end of
+	   simulation callbacks or the atexit handlers, which would
+	   write to those files again. The output buffers were flushed
+	   before the runs were forked. */
+      _exit(rc);
+#else
+      vpi_mcd_printf(1, "Warning: $checkpoint(\"%s\") is not supported "
+		     "on this system.\n", runs_path);
+#endif
+}
+
 static char log_buffer[4096];
 
 #if defined(HAVE_SYS_RESOURCE_H)
@@ -226,6 +273,8 @@ static void final_cleanup()
       signal_pool_delete();
       vvp_net_pool_delete();
       ufunc_pool_delete();
+      vthread_pool_delete();
+      gate_pack_delete();
 #endif
 	/*
 	 * Unload the VPI modules. This is essential for MinGW, to ensure
@@ -244,6 +293,84 @@ static void final_cleanup()
 #endif
 }
 
+#ifdef BATCH_RUNS
+extern void vpi_set_vlog_info(int, char**);
+
+/*
+ * In batch mode (-R) the design is compiled and linked only once,
+ * then a child process is forked to simulate it for each line of the
+ * runs file. A line holds the extended arguments (plusargs) of one
+ * run. This returns true in the child processes, which go on to run
+ * the simulation. The parent waits for each child in turn, and
+ * returns false when all the runs are done, with rc set to the exit
+ * code of the first run that failed and nruns to the number of runs
+ * that were forked.
+ */
+static bool fork_batch_runs(const char*runs_path, int&rc, unsigned&nruns)
+{
+      s_vpi_vlog_info vlog_info;
+      vpi_get_vlog_info(&vlog_info);
+      const char*design_path = vlog_info.argv[0];
+
+      rc = 0;
+      nruns = 0;
+      FILE*fd = fopen(runs_path, "r");
+      if (fd == 0) {
+	    perror(runs_path);
+	    rc = 1;
+	    return false;
+      }
+
+	/* Read whole lines, however long, so that a long line is
+	   not split into several runs. */
+      char*line = 0;
+      size_t line_size = 0;
+      while (getline(&line, &line_size, fd) >= 0) {
+	    vector<const char*> args;
+	    args.push_back(design_path);
+	    for (char*cp = strtok(line, " \t\r\n") ; cp ; cp = strtok(0, " \t\r\n"))
+		  args.push_back(cp);
+
+	      /* Skip blank lines and comments. */
+	    if (args.size() == 1 || args[1][0] == '#')
+		  continue;
+
+	      /* Flush the buffered output, or the child will
+		 repeat it. */
+	    fflush(0);
+
+	    pid_t pid = fork();
+	    if (pid < 0) {
+		  perror("fork");
+		  rc = 1;
+		  break;
+	    }
+
+	    if (pid == 0) {
+		  fclose(fd);
+		  char**argv = new char*[args.size()+1];
+		  for (unsigned idx = 0 ;  idx < args.size() ;  idx += 1)
+			argv[idx] = strdup(args[idx]);
+		  argv[args.size()] = 0;
+		  free(line);
+		  vpi_set_vlog_info(args.size(), argv);
+		  return true;
+	    }
+
+	    nruns += 1;
+	    int status = 0;
+	    waitpid(pid, &status, 0);
+	    int run_rc = WIFEXITED(status)? WEXITSTATUS(status) : 1;
+	    if (rc == 0)
+		  rc = run_rc;
+      }
+
+      free(line);
+      fclose(fd);
+      return false;
+}
+#endif
+
 unsigned module_cnt = 0;
 const char*module_tab[64];
 
@@ -257,6 +384,7 @@ int main(int argc, char*argv[])
       const char*design_path = 0;
       struct rusage cycles[3];
       const char *logfile_name = 0x0;
+      const char *runs_path = 0x0;
       FILE *logfile = 0x0;
       extern void vpi_set_vlog_info(int, char**);
       extern bool stop_is_finish;
@@ -315,29 +443,44 @@ int main(int argc, char*argv[])
         /* For non-interactive runs we do not want to run the interactive
          * debugger, so make $stop just execute a $finish. */
       stop_is_finish = false;
-      while ((opt = getopt(argc, argv, "+hil:M:m:nNsvV")) != EOF) switch (opt) {
+      while ((opt = getopt(argc, argv, "+cghil:LM:m:nNp:R:svVw")) != EOF) switch (opt) {
          case 'h':
            fprintf(stderr,
                    "Usage: vvp [options] input-file [+plusargs...]\n"
                    "Options:\n"
+                   " -c             Levelized gate evaluation within each time step.\n"
+                   " -g             Pack scalar logic gates into bit planes.\n"
                    " -h             Print this help message.\n"
                    " -i             Interactive mode (unbuffered stdio).\n"
                    " -l file        Logfile, '-' for <stderr>\n"
+                   " -L             Lay out the net fan-out in data flow order.\n"
                    " -M path        VPI module directory\n"
 		   " -M -           Clear VPI module path\n"
                    " -m module      Load vpi module.\n"
 		   " -n             Non-interactive ($stop = $finish).\n"
                    " -N             Same as -n, but exit code is 1 instead of 0\n"
+                   " -p file        Write a runtime profile to file.\n"
+                   " -R file        Run once for each line of plusargs in file.\n"
 		   " -s             $stop right away.\n"
                    " -v             Verbose progress messages.\n"
-                   " -V             Print the version information.\n" );
+                   " -V             Print the version information.\n"
+                   " -w             Use the timing wheel event queue.\n" );
            exit(0);
+	  case 'c':
+	    levelize_flag = true;
+	    break;
+	  case 'g':
+	    gate_pack_flag = true;
+	    break;
 	  case 'i':
 	    setvbuf(stdout, 0, _IONBF, 0);
 	    break;
 	  case 'l':
 	    logfile_name = optarg;
 	    break;
+	  case 'L':
+	    flow_layout_flag = true;
+	    break;
 	  case 'M':
 	    if (strcmp(optarg,"-") == 0) {
 		  vpip_module_path_cnt = 0;
@@ -356,6 +499,18 @@ int main(int argc, char*argv[])
             stop_is_finish = true;
             stop_is_finish_exit_code = 1;
             break;
+	  case 'p':
+	    vvp_profile_open(optarg);
+	    break;
+	  case 'R':
+#ifdef BATCH_RUNS
+	    runs_path = optarg;
+#else
+	    fprintf(stderr, "%s: -R is not supported on this system.\n",
+		    argv[0]);
+	    flag_errors += 1;
+#endif
+	    break;
 	  case 's':
 	    schedule_stop(0);
 	    break;
@@ -365,6 +520,9 @@ int main(int argc, char*argv[])
 	  case 'V':
 	    version_flag = true;
 	    break;
+	  case 'w':
+	    schedule_use_timing_wheel(true);
+	    break;
 	  default:
 	    flag_errors += 1;
       }
@@ -466,6 +624,14 @@ int main(int argc, char*argv[])
 	    return compile_errors;
       }
 
+      if (gate_pack_flag)
+	    compile_gate_packs();
+
+      if (levelize_flag)
+	    compile_levelize();
+
+      vvp_net_flatten_fanout(flow_layout_flag);
+
       if (verbose_flag) {
 	    vpi_mcd_printf(1, " ... %8lu functors (net_fun pool=%zu bytes)\n",
 			   count_functors, vvp_net_fun_t::heap_total());
@@ -477,20 +643,43 @@ int main(int argc, char*argv[])
 			   count_filters, vvp_net_fil_t::heap_total());
 	    vpi_mcd_printf(1, " ... %8lu opcodes (%zu bytes)\n",
 	                   count_opcodes, size_opcodes);
+	    vpi_mcd_printf(1, "           %8lu fused\n", count_opcodes_fused);
 	    vpi_mcd_printf(1, " ... %8lu nets\n",     count_vpi_nets);
 	    vpi_mcd_printf(1, " ... %8lu vvp_nets (%zu bytes)\n",
 			   count_vvp_nets, size_vvp_nets);
+	    vpi_mcd_printf(1, "           %8lu fan-out arrays (%lu words)\n",
+			   count_fanout_arrays, count_fanout_array_words);
+	    if (gate_pack_flag)
+		  vpi_mcd_printf(1, "           %8lu packed gates (%lu packs in"
+				 " %lu clusters)\n", count_gate_packed,
+				 count_gate_packs, count_gate_clusters);
+	    if (levelize_flag)
+		  vpi_mcd_printf(1, "           %8lu levelized functors (%lu"
+				 " levels, %lu in loops)\n", count_levelized,
+				 count_levels, count_levelize_loops);
 	    vpi_mcd_printf(1, " ... %8lu arrays (%lu words)\n",
 			   count_net_arrays, count_net_array_words);
 	    vpi_mcd_printf(1, " ... %8lu memories\n",
 			   count_var_arrays+count_real_arrays);
-	    vpi_mcd_printf(1, "           %8lu logic (%lu words)\n",
-			   count_var_arrays, count_var_array_words);
+	    vpi_mcd_printf(1, "           %8lu logic (%lu words, %lu sparse)\n",
+			   count_var_arrays, count_var_array_words,
+			   count_var_array_sparse);
 	    vpi_mcd_printf(1, "           %8lu real (%lu words)\n",
 			   count_real_arrays, count_real_array_words);
 	    vpi_mcd_printf(1, " ... %8lu scopes\n",   count_vpi_scopes);
       }
 
+#ifdef BATCH_RUNS
+      if (runs_path) {
+	    int rc;
+	    unsigned nruns;
+	    if (! fork_batch_runs(runs_path, rc, nruns)) {
+		  final_cleanup();
+		  return rc;
+	    }
+      }
+#endif
+
       if (verbose_flag) {
 	    my_getrusage(cycles+1);
 	    print_rusage(cycles+1, cycles+0);
@@ -500,6 +689,8 @@ int main(int argc, char*argv[])
 
       schedule_simulate();
 
+      vvp_profile_report();
+
       if (verbose_flag) {
 	    my_getrusage(cycles+2);
 	    print_rusage(cycles+2, cycles+1);
@@ -507,6 +698,9 @@ int main(int argc, char*argv[])
 	    vpi_mcd_printf(1, "Event counts:\n");
 	    vpi_mcd_printf(1, "    %8lu time steps (pool=%lu)\n",
 			   count_time_events, count_time_pool());
+	    if (schedule_using_timing_wheel())
+		  vpi_mcd_printf(1, "             ...timing wheel overflow=%lu\n",
+				 count_time_far_events);
 	    vpi_mcd_printf(1, "    %8lu thread schedule events\n",
 		    count_thread_events);
 	    vpi_mcd_printf(1, "    %8lu assign events\n",
@@ -523,6 +717,10 @@ int main(int argc, char*argv[])
 			   count_assign_arword_pool());
 	    vpi_mcd_printf(1, "    %8lu other events (pool=%lu)\n",
 			   count_gen_events, count_gen_pool());
+	    vpi_mcd_printf(1, "    %8lu threads (pool=%lu)\n",
+			   count_vthreads, count_vthread_pool());
+	    vpi_mcd_printf(1, "    %8lu vec4 heap allocations\n",
+			   count_vector4_heap_allocs);
       }
 
       final_cleanup();
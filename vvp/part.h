@@ -1,7 +1,7 @@
 #ifndef IVL_part_H
 #define IVL_part_H
 /*
- * Copyright (c) 2005-2014 Stephen Williams (steve@icarus.com)
+ * Copyright (c) 2005-2016 Stephen Williams (steve@icarus.com)
  *
  *    This source code is free software; you can redistribute it
  *    and/or modify it in source code form under the terms of the GNU
@@ -56,6 +56,8 @@ class vvp_fun_part_sa  : public vvp_fun_part, public vvp_gen_event_s {
 			unsigned, unsigned, unsigned,
                         vvp_context_t);
 
+      vvp_gen_event_t levelize_event() { return this; }
+
     private:
       void run_run();
 
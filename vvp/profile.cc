@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2016 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "config.h"
+# include  "profile.h"
+# include  "compile.h"
+# include  "vpi_priv.h"
+# include  "vvp_net.h"
+# include  <cstdio>
+# include  <cstdlib>
+# include  <cstring>
+# include  <ctime>
+# include  <algorithm>
+# include  <map>
+# include  <string>
+# include  <typeinfo>
+# include  <vector>
+#ifdef __GNUC__
+# include  <cxxabi.h>
+#endif
+
+using namespace std;
+
+bool vvp_profile_enabled = false;
+
+struct profile_thread_s {
+      __vpiScope*scope;
+      const char*label;
+	/* Exclusive time in nanoseconds. */
+      unsigned long long ns;
+      unsigned long insns;
+      unsigned long runs;
+};
+
+static char*profile_path = 0;
+static unsigned long long profile_start_ns = 0;
+
+typedef pair<__vpiScope*,vvp_code_t> thread_key_t;
+static map<thread_key_t,profile_thread_s*> thread_recs;
+static map<vvp_code_t,const char*> thread_labels;
+
+struct type_less {
+      bool operator() (const type_info*a, const type_info*b) const
+      { return a->before(*b); }
+};
+static map<const type_info*,unsigned long,type_less> functor_counts;
+
+/*
+ * The stack of active thread runs. A thread can run another thread
+ * (a function call) to completion, and the time of the inner run is
+ * not counted against the outer thread.
+ */
+struct profile_run_s {
+      unsigned long long start;
+      unsigned long long nested;
+};
+static vector<profile_run_s> run_stack;
+static unsigned long long nested_ns = 0;
+
+static unsigned long long profile_now(void)
+{
+#if defined(CLOCK_MONOTONIC)
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+      return clock() * (1000000000ULL / CLOCKS_PER_SEC);
+#endif
+}
+
+void vvp_profile_open(const char*path)
+{
+      vvp_profile_enabled = true;
+      profile_path = strdup(path);
+      profile_start_ns = profile_now();
+}
+
+void vvp_profile_label(vvp_code_t pc, const char*label)
+{
+      thread_labels[pc] = strdup(label);
+}
+
+profile_thread_s* vvp_profile_thread(vvp_code_t pc, __vpiScope*scope)
+{
+      profile_thread_s*&rec = thread_recs[thread_key_t(scope, pc)];
+      if (rec == 0) {
+	    rec = new profile_thread_s;
+	    rec->scope = scope;
+	    map<vvp_code_t,const char*>::const_iterator cur
+		  = thread_labels.find(pc);
+	    rec->label = cur == thread_labels.end()? 0 : cur->second;
+	    rec->ns = 0;
+	    rec->insns = 0;
+	    rec->runs = 0;
+      }
+      return rec;
+}
+
+void vvp_profile_start(void)
+{
+      profile_run_s run;
+      run.start = profile_now();
+      run.nested = nested_ns;
+      run_stack.push_back(run);
+      nested_ns = 0;
+}
+
+void vvp_profile_stop(profile_thread_s*rec, unsigned long insns)
+{
+      profile_run_s run = run_stack.back();
+      run_stack.pop_back();
+
+      unsigned long long elapsed = profile_now() - run.start;
+      rec->ns += elapsed - nested_ns;
+      rec->insns += insns;
+      rec->runs += 1;
+      nested_ns = run.nested + elapsed;
+}
+
+void vvp_profile_recv(const vvp_net_fun_t*fun)
+{
+      functor_counts[&typeid(*fun)] += 1;
+}
+
+/*
+ * Make the hierarchical name of the scope, with the given separator
+ * between the levels.
+ */
+static string scope_path(__vpiScope*scope, char sep)
+{
+      if (scope == 0)
+	    return "";
+      string tmp = scope_path(scope->scope, sep);
+      if (! tmp.empty())
+	    tmp += sep;
+      return tmp + scope->scope_name();
+}
+
+static string thread_name(const profile_thread_s*rec)
+{
+      if (rec->label)
+	    return rec->label;
+      return "<fork>";
+}
+
+static string type_name(const type_info*type)
+{
+      string res = type->name();
+#ifdef __GNUC__
+      int status = 0;
+      char*tmp = abi::__cxa_demangle(type->name(), 0, 0, &status);
+      if (tmp) {
+	    res = tmp;
+	    free(tmp);
+      }
+#endif
+      return res;
+}
+
+static bool rec_more_time(const profile_thread_s*a, const profile_thread_s*b)
+{
+      return a->ns > b->ns;
+}
+
+struct scope_total_s {
+      unsigned long long ns;
+      unsigned long insns;
+};
+
+void vvp_profile_report(void)
+{
+      if (! vvp_profile_enabled)
+	    return;
+
+      unsigned long long total_ns = profile_now() - profile_start_ns;
+      unsigned long long thread_ns = 0;
+
+      vector<profile_thread_s*> recs;
+      map<__vpiScope*,scope_total_s> scope_totals;
+      for (map<thread_key_t,profile_thread_s*>::const_iterator cur
+		 = thread_recs.begin() ; cur != thread_recs.end() ; ++ cur) {
+	    profile_thread_s*rec = cur->second;
+	    if (rec->runs == 0)
+		  continue;
+	    recs.push_back(rec);
+	    thread_ns += rec->ns;
+	    scope_total_s&tot = scope_totals[rec->scope];
+	    tot.ns += rec->ns;
+	    tot.insns += rec->insns;
+      }
+      sort(recs.begin(), recs.end(), rec_more_time);
+
+      double total_us = total_ns / 1000.0;
+      if (total_us <= 0.0) total_us = 1.0;
+
+      FILE*fd = fopen(profile_path, "w");
+      if (fd == 0) {
+	    perror(profile_path);
+	    return;
+      }
+
+      fprintf(fd, "Profile of %.0f usec of simulation, %.0f usec in threads.\n",
+	      total_us, thread_ns / 1000.0);
+      fprintf(fd, "Thread time includes the net propagation that the "
+		  "thread causes directly.\n\n");
+
+      fprintf(fd, "Scopes:\n");
+      fprintf(fd, "%12s %6s %14s  %s\n", "usec", "%time", "instructions",
+	      "scope");
+      for (map<__vpiScope*,scope_total_s>::const_iterator cur
+		 = scope_totals.begin() ; cur != scope_totals.end() ; ++ cur) {
+	    __vpiScope*scope = cur->first;
+	    const char*file = scope->file_idx < file_names.size()
+		  ? file_names[scope->file_idx] : "N/A";
+	    fprintf(fd, "%12.0f %6.2f %14lu  %s (%s:%u)\n",
+		    cur->second.ns / 1000.0,
+		    100.0 * cur->second.ns / 1000.0 / total_us,
+		    cur->second.insns, scope_path(scope, '.').c_str(),
+		    file, scope->lineno);
+      }
+
+      fprintf(fd, "\nThreads:\n");
+      fprintf(fd, "%12s %6s %14s %10s  %s\n", "usec", "%time",
+	      "instructions", "runs", "thread");
+      for (size_t idx = 0 ; idx < recs.size() ; idx += 1) {
+	    profile_thread_s*rec = recs[idx];
+	    fprintf(fd, "%12.0f %6.2f %14lu %10lu  %s in %s\n",
+		    rec->ns / 1000.0, 100.0 * rec->ns / 1000.0 / total_us,
+		    rec->insns, rec->runs, thread_name(rec).c_str(),
+		    scope_path(rec->scope, '.').c_str());
+      }
+
+      fprintf(fd, "\nNet functor values received:\n");
+      for (map<const type_info*,unsigned long,type_less>::const_iterator cur
+		 = functor_counts.begin() ; cur != functor_counts.end() ; ++ cur) {
+	    fprintf(fd, "%14lu  %s\n", cur->second,
+		    type_name(cur->first).c_str());
+      }
+      fclose(fd);
+
+	/* The folded stack file has one line for each thread, with
+	   the scope path and the thread name separated by ';' and
+	   followed by the time in microseconds. Time not spent in
+	   threads is given to a <scheduler> frame. */
+      string folded_path = string(profile_path) + ".folded";
+      fd = fopen(folded_path.c_str(), "w");
+      if (fd == 0) {
+	    perror(folded_path.c_str());
+	    return;
+      }
+      for (size_t idx = 0 ; idx < recs.size() ; idx += 1) {
+	    profile_thread_s*rec = recs[idx];
+	    unsigned long long us = rec->ns / 1000;
+	    if (us == 0)
+		  continue;
+	    fprintf(fd, "%s;%s %llu\n", scope_path(rec->scope, ';').c_str(),
+		    thread_name(rec).c_str(), us);
+      }
+      if (total_ns > thread_ns)
+	    fprintf(fd, "<scheduler> %llu\n", (total_ns - thread_ns) / 1000);
+      fclose(fd);
+}
@@ -0,0 +1,74 @@
+#ifndef IVL_profile_H
+#define IVL_profile_H
+/*
+ * Copyright (c) 2016 Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * The runtime profiler is enabled with the -p flag. It attributes
+ * the time and the instructions executed by threads to the scope
+ * and the .thread statement that created them, and it counts the
+ * values delivered to each type of net functor. The report is
+ * written when the simulation finishes.
+ */
+
+class __vpiScope;
+class vvp_net_fun_t;
+struct vvp_code_s;
+
+struct profile_thread_s;
+
+extern bool vvp_profile_enabled;
+
+/*
+ * Enable profiling. The report is written to the path, and a folded
+ * stack file suitable for flame graph tools is written to the path
+ * with ".folded" appended.
+ */
+extern void vvp_profile_open(const char*path);
+
+/*
+ * Give a name to the thread code that starts at the given address.
+ * This is used for the .thread statements, which have a label.
+ */
+extern void vvp_profile_label(struct vvp_code_s*pc, const char*label);
+
+/*
+ * Get the record for threads that start at pc in the given scope.
+ */
+extern profile_thread_s* vvp_profile_thread(struct vvp_code_s*pc,
+					     __vpiScope*scope);
+
+/*
+ * Bracket a run of thread instructions. The time of nested runs
+ * (i.e. called functions) is only counted for the nested thread.
+ */
+extern void vvp_profile_start(void);
+extern void vvp_profile_stop(profile_thread_s*rec, unsigned long insns);
+
+/*
+ * Count a value delivered to a net functor.
+ */
+extern void vvp_profile_recv(const vvp_net_fun_t*fun);
+
+/*
+ * Write the report files. This does nothing if profiling is off.
+ */
+extern void vvp_profile_report(void);
+
+#endif /* IVL_profile_H */
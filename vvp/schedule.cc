@@ -30,6 +30,8 @@
 # include  <cstdlib>
 # include  <cassert>
 # include  <iostream>
+# include  <map>
+# include  <vector>
 #ifdef CHECK_WITH_VALGRIND
 # include  "vvp_cleanup.h"
 # include  "ivl_alloc.h"
@@ -82,7 +84,8 @@ struct event_time_s {
 	    del_thr = 0;
 	    next = NULL;
       }
-      vvp_time64_t delay;
+	/* The absolute simulation time of this time step. */
+      vvp_time64_t time;
 
       struct event_s*start;
       struct event_s*active;
@@ -91,6 +94,7 @@ struct event_time_s {
       struct event_s*rosync;
       struct event_s*del_thr;
 
+	/* Link to the next time step. Only the list queue uses this. */
       struct event_time_s*next;
 
       static void* operator new (size_t);
@@ -549,6 +553,34 @@ inline void event_time_s::operator delete(void*ptr, size_t)
 
 unsigned long count_time_pool(void) { return event_time_heap.pool; }
 
+static vvp_time64_t schedule_time;
+
+/*
+ * The pending time steps (event_time_s objects) are kept in one of
+ * two structures, selected by schedule_use_timing_wheel() before any
+ * events are scheduled:
+ *
+ * The list queue is a simple linked list of event_time_s objects
+ * sorted by time. This is fast when there are only a few distinct
+ * times pending, but inserting a new time step is linear in the
+ * number of pending time steps.
+ *
+ * The timing wheel is an array of WHEEL_SIZE slots, one per time
+ * unit, that covers the times [wheel_base, wheel_base+WHEEL_SIZE).
+ * Because each time in that window maps to its own slot, finding or
+ * creating a near time step is constant time. A bitmap of occupied
+ * slots makes finding the next time step a short scan. Time steps
+ * that are too far in the future to fit in the window are kept in
+ * an ordered map and moved into the wheel as the window advances.
+ *
+ * The wheel_base is always the current simulation time, so no event
+ * can be scheduled before it. It only moves when the scheduler moves
+ * to the next time step, and not when that step is only looked at:
+ * the final blocks may still schedule events at the current time
+ * after $finish stops the scheduler.
+ */
+static bool sched_use_wheel = false;
+
 /*
  * This is the head of the list of pending events. This includes all
  * the events that have not been executed yet, and reaches into the
@@ -556,6 +588,212 @@ unsigned long count_time_pool(void) { return event_time_heap.pool; }
  */
 static struct event_time_s* sched_list = 0;
 
+static const unsigned WHEEL_BITS = 14;
+static const unsigned WHEEL_SIZE = 1U << WHEEL_BITS;
+static const vvp_time64_t WHEEL_MASK = WHEEL_SIZE - 1;
+static const unsigned WHEEL_WBITS = 8 * sizeof(unsigned long);
+
+static struct event_time_s* wheel_slot[WHEEL_SIZE];
+static unsigned long wheel_used[WHEEL_SIZE / WHEEL_WBITS];
+static unsigned wheel_count = 0;
+static vvp_time64_t wheel_base = 0;
+static std::map<vvp_time64_t,struct event_time_s*> wheel_far;
+
+  // Count the time steps that did not fit in the wheel window.
+unsigned long count_time_far_events = 0;
+
+void schedule_use_timing_wheel(bool flag)
+{
+      assert(sched_list == 0 && wheel_count == 0 && wheel_far.empty());
+      sched_use_wheel = flag;
+}
+
+bool schedule_using_timing_wheel(void)
+{
+      return sched_use_wheel;
+}
+
+static inline void wheel_put_(struct event_time_s*ctim)
+{
+      unsigned idx = ctim->time & WHEEL_MASK;
+      assert(wheel_slot[idx] == 0);
+      wheel_slot[idx] = ctim;
+      wheel_used[idx / WHEEL_WBITS] |= 1UL << (idx % WHEEL_WBITS);
+      wheel_count += 1;
+}
+
+/*
+ * Move the wheel window to start at the given time. The caller
+ * guarantees that there are no time steps in the wheel before the
+ * new base, so the only work is pulling far time steps that now fit
+ * in the window into their slots.
+ */
+static void wheel_advance_(vvp_time64_t base)
+{
+      assert(base >= wheel_base);
+      wheel_base = base;
+
+      while (! wheel_far.empty()) {
+	    std::map<vvp_time64_t,struct event_time_s*>::iterator cur
+		  = wheel_far.begin();
+	    if ((cur->first - wheel_base) >= WHEEL_SIZE)
+		  break;
+
+	    wheel_put_(cur->second);
+	    wheel_far.erase(cur);
+      }
+}
+
+static inline bool sched_time_pending_(void)
+{
+      if (sched_use_wheel)
+	    return wheel_count > 0 || ! wheel_far.empty();
+      else
+	    return sched_list != 0;
+}
+
+/*
+ * Return the earliest pending time step, or nil if there are no
+ * events pending at all. This does not move the wheel window; call
+ * sched_time_advance_ when the simulation time moves to the step.
+ */
+static struct event_time_s* sched_time_first_(void)
+{
+      if (! sched_use_wheel)
+	    return sched_list;
+
+      if (wheel_count == 0) {
+	    if (wheel_far.empty())
+		  return 0;
+	    return wheel_far.begin()->second;
+      }
+
+      unsigned idx = wheel_base & WHEEL_MASK;
+      for (;;) {
+	    unsigned long bits = wheel_used[idx / WHEEL_WBITS] >> (idx % WHEEL_WBITS);
+	    if (bits) {
+		  while ((bits & 1UL) == 0) {
+			bits >>= 1;
+			idx += 1;
+		  }
+		  break;
+	    }
+	    idx = (idx / WHEEL_WBITS + 1) * WHEEL_WBITS;
+	    if (idx >= WHEEL_SIZE)
+		  idx = 0;
+      }
+
+      struct event_time_s*ctim = wheel_slot[idx];
+      assert(ctim);
+      return ctim;
+}
+
+/*
+ * The simulation time is moving to the time step that the most
+ * recent sched_time_first_ returned, so move the wheel window there.
+ */
+static inline void sched_time_advance_(struct event_time_s*ctim)
+{
+      if (sched_use_wheel)
+	    wheel_advance_(ctim->time);
+}
+
+/*
+ * Return the time step for the current simulation time, if there is
+ * one. This does not create a time step.
+ */
+static struct event_time_s* sched_time_current_(void)
+{
+      if (! sched_use_wheel) {
+	    if (sched_list && sched_list->time == schedule_time)
+		  return sched_list;
+	    return 0;
+      }
+
+      struct event_time_s*ctim = wheel_slot[schedule_time & WHEEL_MASK];
+      if (ctim && ctim->time == schedule_time)
+	    return ctim;
+      return 0;
+}
+
+/*
+ * Remove the earliest time step (the one returned by the most recent
+ * sched_time_first_) from the queue and delete it.
+ */
+static void sched_time_pop_(struct event_time_s*ctim)
+{
+      if (! sched_use_wheel) {
+	    assert(ctim == sched_list);
+	    sched_list = ctim->next;
+
+      } else {
+	    unsigned idx = ctim->time & WHEEL_MASK;
+	    assert(wheel_slot[idx] == ctim);
+	    wheel_slot[idx] = 0;
+	    wheel_used[idx / WHEEL_WBITS] &= ~(1UL << (idx % WHEEL_WBITS));
+	    wheel_count -= 1;
+      }
+
+      delete ctim;
+}
+
+/*
+ * Find the time step for the given absolute time, creating it if
+ * necessary.
+ */
+static struct event_time_s* sched_time_lookup_(vvp_time64_t time)
+{
+      if (sched_use_wheel) {
+	    assert(time >= wheel_base);
+	    if ((time - wheel_base) < WHEEL_SIZE) {
+		  struct event_time_s*ctim = wheel_slot[time & WHEEL_MASK];
+		  if (ctim) {
+			assert(ctim->time == time);
+			return ctim;
+		  }
+
+		  ctim = new struct event_time_s;
+		  ctim->time = time;
+		  wheel_put_(ctim);
+		  return ctim;
+	    }
+
+	    std::map<vvp_time64_t,struct event_time_s*>::iterator cur
+		  = wheel_far.lower_bound(time);
+	    if (cur != wheel_far.end() && cur->first == time)
+		  return cur->second;
+
+	    struct event_time_s*ctim = new struct event_time_s;
+	    ctim->time = time;
+	    wheel_far.insert(cur, std::make_pair(time, ctim));
+	    count_time_far_events += 1;
+	    return ctim;
+      }
+
+      if (sched_list == 0 || sched_list->time > time) {
+	      /* Am I looking for an event before the first event_time?
+		 If so, create a new event_time to go in front. */
+	    struct event_time_s*tmp = new struct event_time_s;
+	    tmp->time = time;
+	    tmp->next = sched_list;
+	    sched_list = tmp;
+	    return tmp;
+      }
+
+      struct event_time_s*ctim = sched_list;
+      while (ctim->next && (ctim->next->time <= time))
+	    ctim = ctim->next;
+
+      if (ctim->time == time)
+	    return ctim;
+
+      struct event_time_s*tmp = new struct event_time_s;
+      tmp->time = time;
+      tmp->next = ctim->next;
+      ctim->next = tmp;
+      return tmp;
+}
+
 /*
  * This is a list of initialization events. The setup puts
  * initializations in this list so that they happen before the
@@ -669,57 +907,7 @@ static void schedule_event_(struct event_s*cur, vvp_time64_t delay,
 {
       cur->next = cur;
 
-      struct event_time_s*ctim = sched_list;
-
-      if (sched_list == 0) {
-	      /* Is the event_time list completely empty? Create the
-		 first event_time object. */
-	    ctim = new struct event_time_s;
-	    ctim->delay = delay;
-	    ctim->next  = 0;
-	    sched_list = ctim;
-
-      } else if (sched_list->delay > delay) {
-
-	      /* Am I looking for an event before the first event_time?
-		 If so, create a new event_time to go in front. */
-	    struct event_time_s*tmp = new struct event_time_s;
-	    tmp->delay = delay;
-	    tmp->next = ctim;
-	    ctim->delay -= delay;
-	    ctim = tmp;
-	    sched_list = ctim;
-
-      } else {
-	    struct event_time_s*prev = 0;
-
-	    while (ctim->next && (ctim->delay < delay)) {
-		  delay -= ctim->delay;
-		  prev = ctim;
-		  ctim = ctim->next;
-	    }
-
-	    if (ctim->delay > delay) {
-		  struct event_time_s*tmp = new struct event_time_s;
-		  tmp->delay = delay;
-		  tmp->next  = prev->next;
-		  prev->next = tmp;
-
-		  tmp->next->delay -= delay;
-		  ctim = tmp;
-
-	    } else if (ctim->delay == delay) {
-
-	    } else {
-		  assert(ctim->next == 0);
-		  struct event_time_s*tmp = new struct event_time_s;
-		  tmp->delay = delay - ctim->delay;
-		  tmp->next = 0;
-		  ctim->next = tmp;
-
-		  ctim = tmp;
-	    }
-      }
+      struct event_time_s*ctim = sched_time_lookup_(schedule_time + delay);
 
 	/* By this point, ctim is the event_time structure that is to
 	   receive the event at hand. Put the event in to the
@@ -765,13 +953,12 @@ static void schedule_event_(struct event_s*cur, vvp_time64_t delay,
 
 static void schedule_event_push_(struct event_s*cur)
 {
-      if ((sched_list == 0) || (sched_list->delay > 0)) {
+      struct event_time_s*ctim = sched_time_current_();
+      if (ctim == 0) {
 	    schedule_event_(cur, 0, SEQ_ACTIVE);
 	    return;
       }
 
-      struct event_time_s*ctim = sched_list;
-
       if (ctim->active == 0) {
 	    cur->next = cur;
 	    ctim->active = cur;
@@ -971,8 +1158,61 @@ void schedule_generic(vvp_gen_event_t obj, vvp_time64_t delay,
 
 static bool sim_started;
 
+/*
+ * The level queues hold the functors that are waiting to run in the
+ * current time step, one first-in-first-out queue for each level. The
+ * level_low is at or below the lowest level that is not empty, and
+ * level_pending is the count of functors in all the queues.
+ */
+struct level_queue_s {
+      level_queue_s() : head(0) { }
+      std::vector<vvp_gen_event_t> list;
+      size_t head;
+};
+
+static struct level_queue_s*level_queue = 0;
+static unsigned level_count = 0;
+static unsigned level_low = 0;
+static unsigned long level_pending = 0;
+
+void schedule_levelize(unsigned max_level)
+{
+      assert(level_queue == 0);
+      level_count = max_level + 1;
+      level_queue = new struct level_queue_s[level_count];
+      level_low = level_count;
+}
+
+static vvp_gen_event_t level_pop_(void)
+{
+      while (level_queue[level_low].head == level_queue[level_low].list.size())
+	    level_low += 1;
+
+      struct level_queue_s*cur = level_queue + level_low;
+      vvp_gen_event_t obj = cur->list[cur->head];
+      cur->head += 1;
+      if (cur->head == cur->list.size()) {
+	    cur->list.clear();
+	    cur->head = 0;
+      }
+      level_pending -= 1;
+      return obj;
+}
+
 void schedule_functor(vvp_gen_event_t obj)
 {
+      if (sim_started && obj->sched_level) {
+	    assert(obj->sched_level < level_count);
+	      /* Make sure that there is a time step to run them in. */
+	    if (level_pending == 0)
+		  sched_time_lookup_(schedule_time);
+	    level_queue[obj->sched_level].list.push_back(obj);
+	    if (obj->sched_level < level_low)
+		  level_low = obj->sched_level;
+	    level_pending += 1;
+	    return;
+      }
+
       struct generic_event_s*cur = new generic_event_s;
 
       cur->obj = obj;
@@ -993,7 +1233,6 @@ void schedule_at_start_of_simtime(vvp_gen_event_t obj, vvp_time64_t delay)
       schedule_event_(cur, delay, SEQ_START);
 }
 
-static vvp_time64_t schedule_time;
 vvp_time64_t schedule_simtime(void)
 { return schedule_time; }
 
@@ -1099,7 +1338,7 @@ void schedule_simulate(void)
       // process events and when done run the final blocks.
       run_finals = schedule_runnable;
 
-      if (schedule_runnable) while (sched_list) {
+      if (schedule_runnable) while (sched_time_pending_()) {
 
 	    if (schedule_stopped_flag) {
 		  schedule_stopped_flag = false;
@@ -1109,22 +1348,22 @@ void schedule_simulate(void)
 		  continue;
 	    }
 
-	      /* ctim is the current time step. */
-	    struct event_time_s* ctim = sched_list;
+	    struct event_time_s* ctim = sched_time_first_();
 
-	      /* If the time is advancing, then first run the
-		 postponed sync events. Run them all. */
-	    if (ctim->delay > 0) {
+	      /* ctim is the current time step. If the time is
+		 advancing, then first run the postponed sync events.
+		 Run them all. */
+	    if (ctim->time > schedule_time) {
 
 		  if (!schedule_runnable) break;
-		  schedule_time += ctim->delay;
+		  schedule_time = ctim->time;
+		  sched_time_advance_(ctim);
 		    /* When the design is being traced (we are emitting
 		     * file/line information) also print any time changes. */
 		  if (show_file_line) {
 			cerr << "Advancing to simulation time: "
 			     << schedule_time << endl;
 		  }
-		  ctim->delay = 0;
 
 		  vpiNextSimTime();
 		    // Process the cbAtStartOfSimTime callbacks.
@@ -1141,6 +1380,20 @@ void schedule_simulate(void)
 	    }
 
 
+	      /* Levelized functors run before the other active events,
+		 lowest level first. */
+	    if (level_pending > 0) {
+		  vvp_gen_event_t obj = level_pop_();
+		  if (schedule_single_step_flag) {
+			obj->single_step_display();
+			schedule_stopped_flag = true;
+			schedule_single_step_flag = false;
+		  }
+		  count_gen_events += 1;
+		  obj->run_run();
+		  continue;
+	    }
+
 	      /* If there are no more active events, advance the event
 		 queues. If there are not events at all, then release
 		 the event_time object. */
@@ -1157,8 +1410,7 @@ void schedule_simulate(void)
 			     deletes threads as needed. */
 			if (ctim->active == 0) {
 			      run_rosync(ctim);
-			      sched_list = ctim->next;
-			      delete ctim;
+			      sched_time_pop_(ctim);
 			      continue;
 			}
 		  }
@@ -1222,5 +1474,7 @@ void schedule_delete(void)
       array_r_w_heap.delete_pool();
       generic_event_heap.delete_pool();
       event_time_heap.delete_pool();
+      delete[] level_queue;
+      level_queue = 0;
 }
 #endif
@@ -146,11 +146,25 @@ extern void schedule_del_thr(vthread_t thr);
 
 struct vvp_gen_event_s
 {
+      vvp_gen_event_s() : sched_level(0) { }
       virtual ~vvp_gen_event_s() =0;
       virtual void run_run() =0;
       virtual void single_step_display(void);
+
+	// The level that schedule_functor uses in levelized mode, or
+	// 0 to use the active queue.
+      unsigned sched_level;
 };
 
+/*
+ * Run the functors that schedule_functor is given in level order. The
+ * functors with a non-zero sched_level (at most max_level) go into a
+ * queue for their level instead of the active queue. Within a time
+ * step the scheduler runs the lowest pending level before any other
+ * active event. See compile_levelize.
+ */
+extern void schedule_levelize(unsigned max_level);
+
 /*
  * This runs the simulator. It runs until all the functors run out or
  * the simulation is otherwise finished.
@@ -158,12 +172,23 @@ struct vvp_gen_event_s
 extern void schedule_simulate(void);
 
 /*
- * Get the current absolute simulation time. This is not used
- * internally by the scheduler (which uses time differences instead)
- * but is used for printouts and stuff.
+ * Get the current absolute simulation time. The scheduler schedules
+ * events relative to this time, and it is also used for printouts
+ * and stuff.
  */
 extern vvp_time64_t schedule_simtime(void);
 
+/*
+ * Select the structure used to hold pending time steps. By default
+ * the scheduler uses a sorted list, which is fine when few distinct
+ * times are pending. The timing wheel has constant time insert for
+ * near future times and is much faster when there are many distinct
+ * pending times (e.g. gate level designs with annotated delays). This
+ * must be called before any events are scheduled.
+ */
+extern void schedule_use_timing_wheel(bool flag);
+extern bool schedule_using_timing_wheel(void);
+
 /*
  * Indicate that the simulator is running the rosync callbacks. This is
  * used to prevent the callbacks from performing any write operations
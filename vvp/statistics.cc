@@ -23,6 +23,7 @@
  * This is a count of the instruction opcodes that were created.
  */
 unsigned long count_opcodes = 0;
+unsigned long count_opcodes_fused = 0;
 
 unsigned long count_functors = 0;
 unsigned long count_functors_logic = 0;
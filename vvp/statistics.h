@@ -1,7 +1,7 @@
 #ifndef IVL_statistics_H
 #define IVL_statistics_H
 /*
- * Copyright (c) 2002-2014 Stephen Williams (steve@icarus.com)
+ * Copyright (c) 2002-2016 Stephen Williams (steve@icarus.com)
  *
  *    This source code is free software; you can redistribute it
  *    and/or modify it in source code form under the terms of the GNU
@@ -27,6 +27,7 @@
 #endif
 
 extern unsigned long count_opcodes;
+extern unsigned long count_opcodes_fused;
 extern unsigned long count_functors;
 extern unsigned long count_functors_logic;
 extern unsigned long count_functors_bufif;
@@ -34,18 +35,31 @@ extern unsigned long count_functors_resolv;
 extern unsigned long count_functors_sig;
 extern unsigned long count_filters;
 extern unsigned long count_vvp_nets;
+extern unsigned long count_fanout_arrays;
+extern unsigned long count_fanout_array_words;
+extern unsigned long count_vector4_heap_allocs;
 extern unsigned long count_vpi_nets;
 extern unsigned long count_vpi_scopes;
 
+extern unsigned long count_gate_clusters;
+extern unsigned long count_gate_packs;
+extern unsigned long count_gate_packed;
+
+extern unsigned long count_levelized;
+extern unsigned long count_levels;
+extern unsigned long count_levelize_loops;
+
 extern unsigned long count_net_arrays;
 extern unsigned long count_net_array_words;
 extern unsigned long count_var_arrays;
 extern unsigned long count_var_array_words;
+extern unsigned long count_var_array_sparse;
 extern unsigned long count_real_arrays;
 extern unsigned long count_real_array_words;
 
 
 extern unsigned long count_time_events;
+extern unsigned long count_time_far_events;
 extern unsigned long count_time_pool(void);
 
 extern unsigned long count_assign_events;
@@ -58,6 +72,9 @@ extern unsigned long count_assign_arword_pool(void);
 extern unsigned long count_gen_events;
 extern unsigned long count_gen_pool(void);
 
+extern unsigned long count_vthreads;
+extern unsigned long count_vthread_pool(void);
+
 extern size_t size_opcodes;
 extern size_t size_vvp_nets;
 extern size_t size_vvp_net_funs;
@@ -1,7 +1,7 @@
 #ifndef IVL_udp_H
 #define IVL_udp_H
 /*
- * Copyright (c) 2005-2014 Stephen Williams (steve@icarus.com)
+ * Copyright (c) 2005-2016 Stephen Williams (steve@icarus.com)
  *
  * (This is a rewrite of code that was ...
  * Copyright (c) 2001 Stephan Boettcher <stephan@nevis.columbia.edu>)
@@ -230,6 +230,9 @@ class vvp_udp_fun_core  : public vvp_wide_fun_core, private vvp_gen_event_s {
 
       void recv_vec4_from_inputs(unsigned);
 
+      vvp_gen_event_t levelize_event() { return this; }
+      bool is_sequential() const { return def_->is_sequential(); }
+
     private:
       void run_run();
 
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2001-2014 Stephen Williams (steve@icarus.com)
+ * Copyright (c) 2001-2016 Stephen Williams (steve@icarus.com)
  *
  *    This source code is free software; you can redistribute it
  *    and/or modify it in source code form under the terms of the GNU
@@ -91,6 +91,9 @@ value_callback::value_callback(p_cb_data data)
 	    cb_value.format = vpiSuppressVal;
       }
       cb_data.value = &cb_value;
+      sync_flag = data->reason == cbValueChangeReadOnlySynch;
+      sync_pending = false;
+      sync_next = 0;
 }
 
 /*
@@ -562,6 +565,7 @@ vpiHandle vpi_register_cb(p_cb_data data)
       switch (data->reason) {
 
 	  case cbValueChange:
+	  case cbValueChangeReadOnlySynch:
 	    obj = make_value_change(data);
 	    break;
 
@@ -612,10 +616,10 @@ PLI_INT32 vpi_remove_cb(vpiHandle ref)
       return 1;
 }
 
-void callback_execute(struct __vpiCallback*cur)
+void callback_execute(struct __vpiCallback*cur, vpi_mode_t mode)
 {
       const vpi_mode_t save_mode = vpi_mode_flag;
-      vpi_mode_flag = VPI_MODE_RWSYNC;
+      vpi_mode_flag = mode;
 
       assert(cur->cb_data.cb_rtn);
       switch (cur->cb_data.time->type) {
@@ -679,11 +683,67 @@ void vvp_vpi_callback::clear_all_callbacks()
 }
 #endif
 
+/*
+ * The cbValueChangeReadOnlySynch callbacks that are pending in this
+ * time step are kept in a list, most recently marked first, and a
+ * single read-only synch event runs them all. The value is fetched
+ * from the callback object when the callback is run.
+ */
+static value_callback*sync_value_list = 0;
+
+struct sync_value_cb : public vvp_gen_event_s {
+      bool scheduled;
+      virtual void run_run();
+};
+
+static sync_value_cb sync_value_event;
+
+void sync_value_cb::run_run()
+{
+      scheduled = false;
+
+      value_callback*list = sync_value_list;
+      sync_value_list = 0;
+
+      while (list) {
+	    value_callback*cur = list;
+	    list = cur->sync_next;
+	    cur->sync_pending = false;
+	    cur->sync_next = 0;
+
+	    if (cur->cb_data.cb_rtn == 0)
+		  continue;
+	    if (! cur->test_value_callback_ready())
+		  continue;
+
+	    if (cur->cb_data.value)
+		  vpi_get_value(cur->cb_data.obj, cur->cb_data.value);
+
+	    callback_execute(cur, VPI_MODE_ROSYNC);
+      }
+}
+
+void value_callback::mark_sync_change(void)
+{
+      if (sync_pending)
+	    return;
+
+      sync_pending = true;
+      sync_next = sync_value_list;
+      sync_value_list = this;
+
+      if (! sync_value_event.scheduled) {
+	    sync_value_event.scheduled = true;
+	    schedule_generic(&sync_value_event, 0, true, true);
+      }
+}
+
 /*
  * A vvp_fun_signal uses this method to run its callbacks whenever it
  * has a value change. If the cb_rtn is non-nil, then call the
  * callback function. If the cb_rtn pointer is nil, then the object
- * has been marked for deletion. Free it.
+ * has been marked for deletion. Free it, unless it is still in the
+ * pending list of a read-only synch value change.
  */
 void vvp_vpi_callback::run_vpi_callbacks()
 {
@@ -697,7 +757,9 @@ void vvp_vpi_callback::run_vpi_callbacks()
 	    next = dynamic_cast<value_callback*>(cur->next);
 
 	    if (cur->cb_data.cb_rtn != 0) {
-		  if (cur->test_value_callback_ready()) {
+		  if (cur->sync_flag) {
+			cur->mark_sync_change();
+		  } else if (cur->test_value_callback_ready()) {
 			if (cur->cb_data.value)
 			      get_value(cur->cb_data.value);
 
@@ -705,6 +767,9 @@ void vvp_vpi_callback::run_vpi_callbacks()
 		  }
 		  prev = cur;
 
+	    } else if (cur->sync_pending) {
+		  prev = cur;
+
 	    } else if (prev == 0) {
 
 		  vpi_callbacks_ = next;
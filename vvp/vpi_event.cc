@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2002-2012 Stephen Williams (steve@icarus.com)
+ * Copyright (c) 2002-2016 Stephen Williams (steve@icarus.com)
  *
  *    This source code is free software; you can redistribute it
  *    and/or modify it in source code form under the terms of the GNU
@@ -108,8 +108,16 @@ void __vpiNamedEvent::run_vpi_callbacks()
 	    struct __vpiCallback*cur = next;
 	    next = cur->next;
 
+	    value_callback*vcur = dynamic_cast<value_callback*>(cur);
+
 	    if (cur->cb_data.cb_rtn != 0) {
-		  callback_execute(cur);
+		  if (vcur && vcur->sync_flag)
+			vcur->mark_sync_change();
+		  else
+			callback_execute(cur);
+		  prev = cur;
+
+	    } else if (vcur && vcur->sync_pending) {
 		  prev = cur;
 
 	    } else if (prev == 0) {
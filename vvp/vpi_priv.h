@@ -1,7 +1,7 @@
 #ifndef IVL_vpi_priv_H
 #define IVL_vpi_priv_H
 /*
- * Copyright (c) 2001-2015 Stephen Williams (steve@icarus.com)
+ * Copyright (c) 2001-2016 Stephen Williams (steve@icarus.com)
  * Copyright (c) 2016 CERN Michele Castellana (michele.castellana@cern.ch)
  *
  *    This source code is free software; you can redistribute it
@@ -195,9 +195,17 @@ class value_callback : public __vpiCallback {
 	// user supplied callback data
       struct t_vpi_time cb_time;
       struct t_vpi_value cb_value;
+	// A cbValueChangeReadOnlySynch callback is only marked pending
+	// when the value changes, and is run from the pending list in
+	// the read-only synch region of the time step.
+      bool sync_flag;
+      bool sync_pending;
+      value_callback*sync_next;
+      void mark_sync_change(void);
 };
 
-extern void callback_execute(struct __vpiCallback*cur);
+extern void callback_execute(struct __vpiCallback*cur,
+			     vpi_mode_t mode =VPI_MODE_RWSYNC);
 
 struct __vpiSystemTime : public __vpiHandle {
       __vpiSystemTime();
@@ -272,8 +280,11 @@ class __vpiScope : public __vpiHandle {
       vvp_context_t live_contexts;
         /* Keep a list of freed contexts. */
       vvp_context_t free_contexts;
-	/* Keep a list of threads in the scope. */
-      std::set<vthread_t> threads;
+	/* Keep a list of threads in the scope. The list is linked
+	   through the threads themselves. */
+      vthread_t threads;
+	/* Keep a pool of stacks left by the threads of the scope. */
+      struct vthread_stacks_s*free_stacks;
       signed int time_units :8;
       signed int time_precision :8;
 
@@ -670,6 +681,9 @@ struct __vpiArray : public __vpiArrayBase, public __vpiHandle {
 	// If this is a var array, then these are used instead of nets.
       vvp_vector4array_t*vals4;
       vvp_darray        *vals;
+	// A sparse vals4 array also has its word handles made a page
+	// at a time, instead of all at once in vals_words.
+      struct __vpiArrayWord**vals_word_pages;
 
       vvp_fun_arrayport*ports_;
       struct __vpiCallback *vpi_callbacks;
@@ -677,6 +691,8 @@ struct __vpiArray : public __vpiArrayBase, public __vpiHandle {
       bool swap_addr;
 
 private:
+      vpiHandle vals_word_handle_(unsigned idx);
+
       unsigned array_count;
       __vpiScope*scope;
 
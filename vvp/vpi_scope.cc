@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2001-2015 Stephen Williams (steve@icarus.com)
+ * Copyright (c) 2001-2016 Stephen Williams (steve@icarus.com)
  *
  *    This source code is free software; you can redistribute it
  *    and/or modify it in source code form under the terms of the GNU
@@ -544,6 +544,8 @@ compile_scope_decl(char*label, char*type, char*name, char*tname,
       scope->nitem = 0;
       scope->live_contexts = 0;
       scope->free_contexts = 0;
+      scope->free_stacks = 0;
+      scope->threads = 0;
 
       if (is_cell) scope->is_cell = true;
       else scope->is_cell = false;
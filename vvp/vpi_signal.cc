@@ -486,6 +486,14 @@ static void format_vpiVectorVal(vvp_signal_value*sig, int base, unsigned wid,
                          need_result_buf(hwid * sizeof(s_vpi_vecval), RBUF_VAL);
       vp->value.vector = op;
 
+	/* The whole signal can be copied a word at a time. */
+      if (base == 0 && wid == sig->value_size()) {
+	    vvp_vector4_t tmp;
+	    sig->vec4_value(tmp);
+	    tmp.get_vecvals(op);
+	    return;
+      }
+
       op->aval = op->bval = 0;
       for (long idx = base ;  idx < end ;  idx += 1) {
 	    if (base >= 0 && base < (signed)sig->value_size()) {
@@ -28,12 +28,15 @@
 # include  "vvp_cobject.h"
 # include  "vvp_darray.h"
 # include  "class_type.h"
+# include  "profile.h"
+# include  "slab.h"
+# include  "statistics.h"
 #ifdef CHECK_WITH_VALGRIND
 # include  "vvp_cleanup.h"
 #endif
-# include  <set>
 # include  <typeinfo>
 # include  <vector>
+# include  <utility>
 # include  <cstdlib>
 # include  <climits>
 # include  <cstring>
@@ -59,25 +62,26 @@ using namespace std;
  * ** Notes On The Interactions of %fork/%join/%end:
  *
  * The %fork instruction creates a new thread and pushes that into a
- * set of children for the thread. This new thread, then, becomes a
+ * list of children for the thread. This new thread, then, becomes a
  * child of the current thread, and the current thread a parent of the
  * new thread. Any child can be reaped by a %join.
  *
  * Children that are detached with %join/detach need to have a different
  * parent/child relationship since the parent can still effect them if
  * it uses the %disable/fork or %wait/fork opcodes. The i_am_detached
- * flag and detached_children set are used for this relationship.
+ * flag and detached_children list are used for this relationship.
  *
  * Children placed into a task or function scope are given special
  * treatment, which is required to make task/function calls that they
- * represent work correctly. These task/function children are copied
- * into a task_func_children set to mark them for this handling. %join
+ * represent work correctly. These task/function children are marked
+ * with the i_am_task_func flag, and their parent counts them in
+ * task_func_children. %join
  * operations will guarantee that task/function threads are joined first,
  * before any non-task/function threads.
  *
  * It is a programming error for a thread that created threads to not
  * %join (or %join/detach) as many as it created before it %ends. The
- * children set will get messed up otherwise.
+ * children list will get messed up otherwise.
  *
  * the i_am_joining flag is a clue to children that the parent is
  * blocked in a %join and may need to be scheduled. The %end
@@ -94,9 +98,36 @@ using namespace std;
  * to reap the child immediately.
  */
 
+/*
+ * The children of a thread are kept in a doubly linked list that is
+ * threaded through the sib_prev/sib_next members of the children, so
+ * adding and removing a child does not allocate. A thread is in at
+ * most one such list: the children or the detached_children of its
+ * parent. New children go to the end of the list.
+ */
+class vthread_list_s {
+    public:
+      vthread_list_s() : head_(0), tail_(0), count_(0) { }
+
+      bool empty() const { return head_ == 0; }
+      size_t size() const { return count_; }
+      struct vthread_s*front() const { return head_; }
+
+      inline void insert(struct vthread_s*thr);
+      inline void erase(struct vthread_s*thr);
+
+    private:
+      struct vthread_s*head_;
+      struct vthread_s*tail_;
+      size_t count_;
+};
+
 struct vthread_s {
       vthread_s();
 
+      void* operator new(size_t size);
+      void operator delete(void*);
+
       void debug_dump(ostream&fd, const char*label_text);
 
 	/* This is the program counter. */
@@ -118,45 +149,86 @@ struct vthread_s {
       vector<unsigned> args_str;
       vector<unsigned> args_vec4;
 
+	/* The vec4 stack is stack_vec4_[0] through
+	   stack_vec4_[stack_vec4_top_-1]. Entries above the top are
+	   kept when popped, so that a later push of a value of the
+	   same width reuses their words instead of allocating. */
     private:
       vector<vvp_vector4_t>stack_vec4_;
+      size_t stack_vec4_top_;
     public:
       inline vvp_vector4_t pop_vec4(void)
       {
-	    assert(! stack_vec4_.empty());
-	    vvp_vector4_t val = stack_vec4_.back();
-	    stack_vec4_.pop_back();
-	    return val;
+	    assert(stack_vec4_top_ > 0);
+	    stack_vec4_top_ -= 1;
+#if __cplusplus >= 201103L
+	    return std::move(stack_vec4_[stack_vec4_top_]);
+#else
+	    return stack_vec4_[stack_vec4_top_];
+#endif
       }
       inline void push_vec4(const vvp_vector4_t&val)
       {
-	    stack_vec4_.push_back(val);
+	    if (stack_vec4_top_ < stack_vec4_.size())
+		  stack_vec4_[stack_vec4_top_] = val;
+	    else
+		  stack_vec4_.push_back(val);
+	    stack_vec4_top_ += 1;
+      }
+#if __cplusplus >= 201103L
+      inline void push_vec4(vvp_vector4_t&&val)
+      {
+	    if (stack_vec4_top_ < stack_vec4_.size())
+		  stack_vec4_[stack_vec4_top_] = std::move(val);
+	    else
+		  stack_vec4_.push_back(std::move(val));
+	    stack_vec4_top_ += 1;
       }
+#endif
       inline const vvp_vector4_t& peek_vec4(unsigned depth)
       {
-	    unsigned size = stack_vec4_.size();
-	    assert(depth < size);
-	    unsigned use_index = size-1-depth;
+	    assert(depth < stack_vec4_top_);
+	    size_t use_index = stack_vec4_top_-1-depth;
 	    return stack_vec4_[use_index];
       }
       inline vvp_vector4_t& peek_vec4(void)
       {
-	    unsigned use_index = stack_vec4_.size();
-	    assert(use_index >= 1);
-	    return stack_vec4_[use_index-1];
+	    assert(stack_vec4_top_ >= 1);
+	    return stack_vec4_[stack_vec4_top_-1];
+      }
+	// Push an item that the caller assigns through the returned
+	// reference. It may still hold the value of a popped item.
+      inline vvp_vector4_t& push_vec4_slot(void)
+      {
+	    if (stack_vec4_top_ == stack_vec4_.size())
+		  stack_vec4_.push_back(vvp_vector4_t());
+	    stack_vec4_top_ += 1;
+	    return stack_vec4_[stack_vec4_top_-1];
+      }
+	// Get a writable reference to the item at the given depth.
+      inline vvp_vector4_t& peek_vec4_mut(unsigned depth)
+      {
+	    assert(depth < stack_vec4_top_);
+	    return stack_vec4_[stack_vec4_top_-1-depth];
       }
       inline void poke_vec4(unsigned depth, const vvp_vector4_t&val)
       {
-	    assert(depth < stack_vec4_.size());
-	    unsigned use_index = stack_vec4_.size()-1-depth;
+	    assert(depth < stack_vec4_top_);
+	    size_t use_index = stack_vec4_top_-1-depth;
 	    stack_vec4_[use_index] = val;
       }
+#if __cplusplus >= 201103L
+      inline void poke_vec4(unsigned depth, vvp_vector4_t&&val)
+      {
+	    assert(depth < stack_vec4_top_);
+	    size_t use_index = stack_vec4_top_-1-depth;
+	    stack_vec4_[use_index] = std::move(val);
+      }
+#endif
       inline void pop_vec4(unsigned cnt)
       {
-	    while (cnt > 0) {
-		  stack_vec4_.pop_back();
-		  cnt -= 1;
-	    }
+	    assert(cnt <= stack_vec4_top_);
+	    stack_vec4_top_ -= cnt;
       }
 
 
@@ -195,42 +267,59 @@ struct vthread_s {
       }
 
 	/* Strings are operated on using a forth-like operator
-	   set. Items at the top of the stack (back()) are the objects
+	   set. Items at the top of the stack are the objects
 	   operated on except for special cases. New objects are
-	   pushed onto the top (back()) and pulled from the top
-	   (back()) only. */
+	   pushed onto the top and pulled from the top only. Like
+	   the vec4 stack, popped entries are kept above the top so
+	   that their buffers can be reused. */
     private:
       vector<string> stack_str_;
+      size_t stack_str_top_;
     public:
       inline string pop_str(void)
       {
-	    assert(! stack_str_.empty());
-	    string val = stack_str_.back();
-	    stack_str_.pop_back();
-	    return val;
+	    assert(stack_str_top_ > 0);
+	    stack_str_top_ -= 1;
+#if __cplusplus >= 201103L
+	    return std::move(stack_str_[stack_str_top_]);
+#else
+	    return stack_str_[stack_str_top_];
+#endif
       }
       inline void push_str(const string&val)
       {
-	    stack_str_.push_back(val);
+	    if (stack_str_top_ < stack_str_.size())
+		  stack_str_[stack_str_top_] = val;
+	    else
+		  stack_str_.push_back(val);
+	    stack_str_top_ += 1;
       }
+#if __cplusplus >= 201103L
+      inline void push_str(string&&val)
+      {
+	    if (stack_str_top_ < stack_str_.size())
+		  stack_str_[stack_str_top_] = std::move(val);
+	    else
+		  stack_str_.push_back(std::move(val));
+	    stack_str_top_ += 1;
+      }
+#endif
       inline string&peek_str(unsigned depth)
       {
-	    assert(depth<stack_str_.size());
-	    unsigned use_index = stack_str_.size()-1-depth;
+	    assert(depth < stack_str_top_);
+	    size_t use_index = stack_str_top_-1-depth;
 	    return stack_str_[use_index];
       }
       inline void poke_str(unsigned depth, const string&val)
       {
-	    assert(depth < stack_str_.size());
-	    unsigned use_index = stack_str_.size()-1-depth;
+	    assert(depth < stack_str_top_);
+	    size_t use_index = stack_str_top_-1-depth;
 	    stack_str_[use_index] = val;
       }
       inline void pop_str(unsigned cnt)
       {
-	    while (cnt > 0) {
-		  stack_str_.pop_back();
-		  cnt -= 1;
-	    }
+	    assert(cnt <= stack_str_top_);
+	    stack_str_top_ -= cnt;
       }
 
 	/* Objects are also operated on in a stack. */
@@ -279,16 +368,27 @@ struct vthread_s {
       unsigned waiting_for_event :1;
       unsigned is_scheduled      :1;
       unsigned delay_delete      :1;
+      unsigned i_am_task_func    :1; // True if a task/function child
+      unsigned i_pool_stacks     :1; // True if the stacks are pooled
 	/* This points to the children of the thread. */
-      set<struct vthread_s*>children;
+      vthread_list_s children;
 	/* This points to the detached children of the thread. */
-      set<struct vthread_s*>detached_children;
-	/* No more than 1 of the children are tasks or functions. */
-      set<vthread_s*>task_func_children;
+      vthread_list_s detached_children;
+	/* The number of children that are tasks or functions. No
+	   more than 1 of the children are tasks or functions. */
+      unsigned task_func_children;
+	/* These link me into the children list of my parent. */
+      struct vthread_s*sib_prev;
+      struct vthread_s*sib_next;
 	/* This points to my parent, if I have one. */
       struct vthread_s*parent;
-	/* This points to the containing scope. */
+	/* This points to the containing scope, and these link me
+	   into the list of threads of that scope. */
       __vpiScope*parent_scope;
+      struct vthread_s*scope_prev;
+      struct vthread_s*scope_next;
+	/* The profile record for this thread, if profiling. */
+      profile_thread_s*prof;
 	/* This is used for keeping wait queues. */
       struct vthread_s*wait_next;
 	/* These are used to access automatically allocated items. */
@@ -300,23 +400,135 @@ struct vthread_s {
       inline void cleanup()
       {
 	    if (i_was_disabled) {
-		  stack_vec4_.clear();
+		  stack_vec4_top_ = 0;
 		  stack_real_.clear();
-		  stack_str_.clear();
+		  stack_str_top_ = 0;
 		  pop_object(stack_obj_size_);
 	    }
-	    assert(stack_vec4_.empty());
+	    assert(stack_vec4_top_ == 0);
 	    assert(stack_real_.empty());
-	    assert(stack_str_.empty());
+	    assert(stack_str_top_ == 0);
 	    assert(stack_obj_size_ == 0);
       }
+
+	/* Take the stack storage from the pool of the scope, or hand
+	   it back to the pool once the thread is done with it. */
+      void take_stacks(__vpiScope*scope);
+      void give_stacks(__vpiScope*scope);
 };
 
 inline vthread_s::vthread_s()
 {
+      stack_vec4_top_ = 0;
+      stack_str_top_ = 0;
       stack_obj_size_ = 0;
 }
 
+/*
+ * Threads are allocated from a slab, since a testbench can fork and
+ * join a great many short lived threads.
+ */
+static const size_t VTHREAD_CHUNK_COUNT = 16;
+static slab_t<sizeof(vthread_s),VTHREAD_CHUNK_COUNT> vthread_heap;
+
+unsigned long count_vthreads = 0;
+
+unsigned long count_vthread_pool(void) { return vthread_heap.pool; }
+
+inline void* vthread_s::operator new(size_t size)
+{
+      assert(size == sizeof(vthread_s));
+      return vthread_heap.alloc_slab();
+}
+
+void vthread_s::operator delete(void*ptr)
+{
+      vthread_heap.free_slab(ptr);
+}
+
+inline void vthread_list_s::insert(vthread_t thr)
+{
+      thr->sib_prev = tail_;
+      thr->sib_next = 0;
+      if (tail_)
+	    tail_->sib_next = thr;
+      else
+	    head_ = thr;
+      tail_ = thr;
+      count_ += 1;
+}
+
+inline void vthread_list_s::erase(vthread_t thr)
+{
+      assert(count_ > 0);
+      if (thr->sib_prev) {
+	    assert(thr->sib_prev->sib_next == thr);
+	    thr->sib_prev->sib_next = thr->sib_next;
+      } else {
+	    assert(head_ == thr);
+	    head_ = thr->sib_next;
+      }
+      if (thr->sib_next)
+	    thr->sib_next->sib_prev = thr->sib_prev;
+      else
+	    tail_ = thr->sib_prev;
+      thr->sib_prev = 0;
+      thr->sib_next = 0;
+      count_ -= 1;
+}
+
+/*
+ * Threads that end give their stacks to the scope they ran in, and
+ * new threads of that scope take them back. The threads that a scope
+ * forks over and over thus get stacks that are already grown, with
+ * vec4 items that already have words of the widths the code uses.
+ * Only those threads use the pool: the stacks of a thread that runs
+ * once would never be taken back.
+ */
+struct vthread_stacks_s {
+      vector<vvp_vector4_t> vec4;
+      vector<double> real;
+      vector<string> str;
+	/* The next stacks in the pool, and the length of the pool
+	   starting with these stacks. */
+      struct vthread_stacks_s*next;
+      unsigned count;
+};
+
+  /* The pool of a scope keeps at most this many stacks. */
+static const unsigned STACKS_POOL_MAX = 32;
+
+void vthread_s::take_stacks(__vpiScope*scope)
+{
+      vthread_stacks_s*cur = scope->free_stacks;
+      if (cur == 0)
+	    return;
+
+      scope->free_stacks = cur->next;
+      stack_vec4_.swap(cur->vec4);
+      stack_real_.swap(cur->real);
+      stack_str_.swap(cur->str);
+      delete cur;
+}
+
+void vthread_s::give_stacks(__vpiScope*scope)
+{
+      if (! i_pool_stacks)
+	    return;
+
+      unsigned count = scope->free_stacks? scope->free_stacks->count : 0;
+      if (count >= STACKS_POOL_MAX || stack_vec4_.capacity() == 0)
+	    return;
+
+      vthread_stacks_s*cur = new vthread_stacks_s;
+      cur->vec4.swap(stack_vec4_);
+      cur->real.swap(stack_real_);
+      cur->str.swap(stack_str_);
+      cur->next = scope->free_stacks;
+      cur->count = count + 1;
+      scope->free_stacks = cur;
+}
+
 void vthread_s::debug_dump(ostream&fd, const char*label)
 {
       fd << "**** " << label << endl;
@@ -327,9 +539,9 @@ void vthread_s::debug_dump(ostream&fd, const char*label)
 	    fd << flags[idx];
       fd << endl;
       fd << "**** vec4 stack..." << endl;
-      for (size_t idx = stack_vec4_.size() ; idx > 0 ; idx -= 1)
-	    fd << "    " << (stack_vec4_.size()-idx) << ": " << stack_vec4_[idx-1] << endl;
-      fd << "**** str stack (" << stack_str_.size() << ")..." << endl;
+      for (size_t idx = stack_vec4_top_ ; idx > 0 ; idx -= 1)
+	    fd << "    " << (stack_vec4_top_-idx) << ": " << stack_vec4_[idx-1] << endl;
+      fd << "**** str stack (" << stack_str_top_ << ")..." << endl;
       fd << "**** obj stack (" << stack_obj_size_ << ")..." << endl;
       fd << "**** args_vec4 array (" << args_vec4.size() << ")..." << endl;
       for (size_t idx = 0 ; idx < args_vec4.size() ; idx += 1)
@@ -530,13 +742,18 @@ void contexts_delete(struct __vpiScope*scope)
 /*
  * Create a new thread with the given start address.
  */
-vthread_t vthread_new(vvp_code_t pc, __vpiScope*scope)
+vthread_t vthread_new(vvp_code_t pc, __vpiScope*scope, bool pool_stacks)
 {
       vthread_t thr = new struct vthread_s;
+      count_vthreads += 1;
       thr->pc     = pc;
 	//thr->bits4  = vvp_vector4_t(32);
       thr->parent = 0;
       thr->parent_scope = scope;
+      thr->i_pool_stacks = pool_stacks;
+      if (pool_stacks)
+	    thr->take_stacks(scope);
+      thr->prof = vvp_profile_enabled? vvp_profile_thread(pc, scope) : 0;
       thr->wait_next = 0;
       thr->wt_context = 0;
       thr->rd_context = 0;
@@ -549,9 +766,13 @@ vthread_t vthread_new(vvp_code_t pc, __vpiScope*scope)
       thr->i_have_ended  = 0;
       thr->i_was_disabled = 0;
       thr->delay_delete  = 0;
+      thr->i_am_task_func = 0;
       thr->waiting_for_event = 0;
       thr->event  = 0;
       thr->ecount = 0;
+      thr->task_func_children = 0;
+      thr->sib_prev = 0;
+      thr->sib_next = 0;
 
       thr->flags[0] = BIT4_0;
       thr->flags[1] = BIT4_1;
@@ -560,7 +781,11 @@ vthread_t vthread_new(vvp_code_t pc, __vpiScope*scope)
       for (int idx = 4 ; idx < 8 ; idx += 1)
 	    thr->flags[idx] = BIT4_X;
 
-      scope->threads .insert(thr);
+      thr->scope_prev = 0;
+      thr->scope_next = scope->threads;
+      if (scope->threads)
+	    scope->threads->scope_prev = thr;
+      scope->threads = thr;
       return thr;
 }
 
@@ -594,55 +819,75 @@ static void child_delete(vthread_t base)
 
 void vthreads_delete(struct __vpiScope*scope)
 {
-      for (std::set<vthread_t>::iterator cur = scope->threads.begin()
-		 ; cur != scope->threads.end() ; ++ cur ) {
-	    delete *cur;
+      while (vthread_t cur = scope->threads) {
+	    scope->threads = cur->scope_next;
+	    delete cur;
+      }
+
+      while (vthread_stacks_s*cur = scope->free_stacks) {
+	    scope->free_stacks = cur->next;
+	    delete cur;
       }
-      scope->threads.clear();
+}
+
+void vthread_pool_delete(void)
+{
+      vthread_heap.delete_pool();
 }
 #endif
 
+/*
+ * Take the thread out of the list of threads of its scope, if it is
+ * still in that list.
+ */
+static void scope_threads_erase(vthread_t thr)
+{
+      __vpiScope*scope = thr->parent_scope;
+      if (thr->scope_prev)
+	    thr->scope_prev->scope_next = thr->scope_next;
+      else if (scope->threads == thr)
+	    scope->threads = thr->scope_next;
+      else
+	    return;
+
+      if (thr->scope_next)
+	    thr->scope_next->scope_prev = thr->scope_prev;
+      thr->scope_prev = 0;
+      thr->scope_next = 0;
+}
+
 /*
  * Reaping pulls the thread out of the stack of threads. If I have a
  * child, then hand it over to my parent or fully detach it.
  */
 static void vthread_reap(vthread_t thr)
 {
-      if (! thr->children.empty()) {
-	    for (set<vthread_t>::iterator cur = thr->children.begin()
-		       ; cur != thr->children.end() ; ++cur) {
-		  vthread_t child = *cur;
-		  assert(child);
-		  assert(child->parent == thr);
-		  child->parent = thr->parent;
-	    }
+      for (vthread_t child = thr->children.front()
+		 ; child ; child = child->sib_next) {
+	    assert(child->parent == thr);
+	    child->parent = thr->parent;
       }
-      if (! thr->detached_children.empty()) {
-	    for (set<vthread_t>::iterator cur = thr->detached_children.begin()
-		       ; cur != thr->detached_children.end() ; ++cur) {
-		  vthread_t child = *cur;
-		  assert(child);
-		  assert(child->parent == thr);
-		  assert(child->i_am_detached);
-		  child->parent = 0;
-		  child->i_am_detached = 0;
-	    }
+      while (vthread_t child = thr->detached_children.front()) {
+	    assert(child->parent == thr);
+	    assert(child->i_am_detached);
+	    thr->detached_children.erase(child);
+	    child->parent = 0;
+	    child->i_am_detached = 0;
       }
       if (thr->parent) {
-	      /* assert that the given element was removed. */
-	    if (thr->i_am_detached) {
-		  size_t res = thr->parent->detached_children.erase(thr);
-		  assert(res == 1);
-	    } else {
-		  size_t res = thr->parent->children.erase(thr);
-		  assert(res == 1);
-	    }
+	    if (thr->i_am_detached)
+		  thr->parent->detached_children.erase(thr);
+	    else
+		  thr->parent->children.erase(thr);
+	    if (thr->i_am_task_func)
+		  thr->parent->task_func_children -= 1;
       }
 
       thr->parent = 0;
+      thr->i_am_task_func = 0;
 
 	// Remove myself from the containing scope if needed.
-      thr->parent_scope->threads.erase(thr);
+      scope_threads_erase(thr);
 
       thr->pc = codespace_null();
 
@@ -662,6 +907,7 @@ static void vthread_reap(vthread_t thr)
 void vthread_delete(vthread_t thr)
 {
       thr->cleanup();
+      thr->give_stacks(thr->parent_scope);
       delete thr;
 }
 
@@ -696,6 +942,21 @@ void vthread_run(vthread_t thr)
 
             running_thread = thr;
 
+	    if (profile_thread_s*prof = thr->prof) {
+		  unsigned long insns = 0;
+		  vvp_profile_start();
+		  for (;;) {
+			vvp_code_t cp = thr->pc;
+			thr->pc += 1;
+			insns += 1;
+			if (! (cp->opcode)(thr, cp))
+			      break;
+		  }
+		  vvp_profile_stop(prof, insns);
+		  thr = tmp;
+		  continue;
+	    }
+
 	    for (;;) {
 		  vvp_code_t cp = thr->pc;
 		  thr->pc += 1;
@@ -790,10 +1051,11 @@ bool of_ALLOC(vthread_t thr, vvp_code_t cp)
 
 bool of_AND(vthread_t thr, vvp_code_t)
 {
-      vvp_vector4_t valb = thr->pop_vec4();
-      vvp_vector4_t&vala = thr->peek_vec4();
+      const vvp_vector4_t&valb = thr->peek_vec4(0);
+      vvp_vector4_t&vala = thr->peek_vec4_mut(1);
       assert(vala.size() == valb.size());
       vala &= valb;
+      thr->pop_vec4(1);
       return true;
 }
 
@@ -859,13 +1121,14 @@ static void get_immediate_rval(vvp_code_t cp, vvp_vector4_t&val)
  */
 bool of_ADD(vthread_t thr, vvp_code_t)
 {
-      vvp_vector4_t r = thr->pop_vec4();
-	// Rather then pop l, use it directly from the stack. When we
-	// assign to 'l', that will edit the top of the stack, which
-	// replaces a pop and a pull.
-      vvp_vector4_t&l = thr->peek_vec4();
+	// Rather then pop l and r, use them directly from the
+	// stack. When we assign to 'l', that will edit the stack
+	// in place, and popping r leaves its words for reuse.
+      const vvp_vector4_t&r = thr->peek_vec4(0);
+      vvp_vector4_t&l = thr->peek_vec4_mut(1);
 
       l.add(r);
+      thr->pop_vec4(1);
 
       return true;
 }
@@ -1324,7 +1587,8 @@ static bool do_callf_void(vthread_t thr, vthread_t child)
         // Execute the function. This SHOULD run the function to completion,
         // but there are some exceptional situations where it won't.
       assert(child->parent_scope->get_type_code() == vpiFunction);
-      thr->task_func_children.insert(child);
+      thr->task_func_children += 1;
+      child->i_am_task_func = 1;
       child->is_scheduled = 1;
       child->i_am_in_function = 1;
       vthread_run(child);
@@ -2301,7 +2565,7 @@ static bool do_disable(vthread_t thr, vthread_t match)
       bool flag = false;
 
 	/* Pull the target thread out of its scope if needed. */
-      thr->parent_scope->threads.erase(thr);
+      scope_threads_erase(thr);
 
 	/* Turn the thread off by setting is program counter to
 	   zero and setting an OFF bit. */
@@ -2314,7 +2578,7 @@ static bool do_disable(vthread_t thr, vthread_t match)
 	   %forks that this thread has done. */
       while (! thr->children.empty()) {
 
-	    vthread_t tmp = *(thr->children.begin());
+	    vthread_t tmp = thr->children.front();
 	    assert(tmp);
 	    assert(tmp->parent == thr);
 	    thr->i_am_joining = 0;
@@ -2362,10 +2626,8 @@ bool of_DISABLE(vthread_t thr, vvp_code_t cp)
 
       bool disabled_myself_flag = false;
 
-      while (! scope->threads.empty()) {
-	    set<vthread_t>::iterator cur = scope->threads.begin();
-
-	    if (do_disable(*cur, thr))
+      while (vthread_t cur = scope->threads) {
+	    if (do_disable(cur, thr))
 		  disabled_myself_flag = true;
       }
 
@@ -2387,7 +2649,7 @@ bool of_DISABLE_FORK(vthread_t thr, vvp_code_t)
 
 	/* Disable any detached children. */
       while (! thr->detached_children.empty()) {
-	    vthread_t child = *(thr->detached_children.begin());
+	    vthread_t child = thr->detached_children.front();
 	    assert(child);
 	    assert(child->parent == thr);
 	      /* Disabling the children can never match the parent thread. */
@@ -2723,13 +2985,13 @@ bool of_END(vthread_t thr, vvp_code_t)
 
 	/* Fully detach any detached children. */
       while (! thr->detached_children.empty()) {
-	    vthread_t child = *(thr->detached_children.begin());
+	    vthread_t child = thr->detached_children.front();
 	    assert(child);
 	    assert(child->parent == thr);
 	    assert(child->i_am_detached);
+	    thr->detached_children.erase(child);
 	    child->parent = 0;
 	    child->i_am_detached = 0;
-	    thr->detached_children.erase(thr->detached_children.begin());
       }
 
 	/* It is an error to still have active children running at this
@@ -2761,8 +3023,7 @@ bool of_END(vthread_t thr, vvp_code_t)
       if (thr->i_am_detached) {
 	    vthread_t tmp = thr->parent;
 	    assert(tmp);
-	    size_t res = tmp->detached_children.erase(thr);
-	    assert(res == 1);
+	    tmp->detached_children.erase(thr);
 	      /* If the parent is waiting for the detached children to
 	       * finish then the last detached child needs to tell the
 	       * parent to wake up when it is finished. */
@@ -3066,7 +3327,8 @@ bool of_FORK(vthread_t thr, vvp_code_t cp)
 	      // NOT by the %fork instruction
 	    assert(0);
           case vpiTask:
-	    thr->task_func_children.insert(child);
+	    thr->task_func_children += 1;
+	    child->i_am_task_func = 1;
 	    break;
           default:
 	    break;
@@ -3394,8 +3656,7 @@ bool of_JMP1XZ(vthread_t thr, vvp_code_t cp)
 
 static bool test_joinable(vthread_t thr, vthread_t child)
 {
-      set<vthread_t>::iterator cur = thr->task_func_children.find(child);
-      if (! thr->task_func_children.empty() && cur == thr->task_func_children.end())
+      if (thr->task_func_children > 0 && ! child->i_am_task_func)
 	    return false;
 
       return true;
@@ -3405,9 +3666,6 @@ static void do_join(vthread_t thr, vthread_t child)
 {
       assert(child->parent == thr);
 
-	/* Remove the thread from the task/function set if needed. */
-      thr->task_func_children.erase(child);
-
         /* If the immediate child thread is in an automatic scope... */
       if (child->wt_context) {
               /* and is the top level task/function thread... */
@@ -3432,9 +3690,8 @@ static bool do_join_opcode(vthread_t thr)
 
 	// Are there any children that have already ended? If so, then
 	// join with that one.
-      for (set<vthread_t>::iterator cur = thr->children.begin()
-		 ; cur != thr->children.end() ; ++cur) {
-	    vthread_t curp = *cur;
+      for (vthread_t curp = thr->children.front()
+		 ; curp ; curp = curp->sib_next) {
 	    if (! curp->i_have_ended)
 		  continue;
 
@@ -3465,11 +3722,11 @@ bool of_JOIN_DETACH(vthread_t thr, vvp_code_t cp)
 {
       unsigned long count = cp->number;
 
-      assert(thr->task_func_children.empty());
+      assert(thr->task_func_children == 0);
       assert(count == thr->children.size());
 
       while (! thr->children.empty()) {
-	    vthread_t child = *thr->children.begin();
+	    vthread_t child = thr->children.front();
 	    assert(child->parent == thr);
 
 	      // We cannot detach automatic tasks/functions within an
@@ -3482,8 +3739,7 @@ bool of_JOIN_DETACH(vthread_t thr, vvp_code_t cp)
 		  vthread_reap(child);
 
 	    } else {
-		  size_t res = child->parent->children.erase(child);
-		  assert(res == 1);
+		  child->parent->children.erase(child);
 		  child->i_am_detached = 1;
 		  thr->detached_children.insert(child);
 	    }
@@ -3665,11 +3921,10 @@ bool of_LOAD_STRA(vthread_t thr, vvp_code_t cp)
  */
 bool of_LOAD_VEC4(vthread_t thr, vvp_code_t cp)
 {
-	// Push a placeholder onto the stack in order to reserve the
-	// stack space. Use a reference for the stack top as a target
-	// for the load.
-      thr->push_vec4(vvp_vector4_t());
-      vvp_vector4_t&sig_value = thr->peek_vec4();
+	// Reserve the stack space and use a reference for the stack
+	// top as a target for the load. If the slot still has words
+	// of the right size, the load copies into them.
+      vvp_vector4_t&sig_value = thr->push_vec4_slot();
 
       vvp_net_t*net = cp->net;
 
@@ -4084,8 +4339,6 @@ static bool of_PARTI_base(vthread_t thr, vvp_code_t cp, bool signed_flag)
 
       vvp_vector4_t&value = thr->peek_vec4();
 
-      vvp_vector4_t res (wid, BIT4_X);
-
 	// NOTE: This is treating the vector as signed. Is that correct?
       int32_t use_base = base;
       if (signed_flag && bwid < 32 && (base&(1<<(bwid-1)))) {
@@ -4093,15 +4346,24 @@ static bool of_PARTI_base(vthread_t thr, vvp_code_t cp, bool signed_flag)
       }
 
       if (use_base >= (int32_t)value.size()) {
-	    value = res;
+	    value = vvp_vector4_t(wid, BIT4_X);
 	    return true;
       }
 
       if ((use_base+(int32_t)wid) <= 0) {
-	    value = res;
+	    value = vvp_vector4_t(wid, BIT4_X);
 	    return true;
       }
 
+	// If the part starts at the bottom of the value and is all
+	// inside it, then the value can simply be cut down in place.
+      if (use_base == 0 && wid <= value.size()) {
+	    value.resize(wid);
+	    return true;
+      }
+
+      vvp_vector4_t res (wid, BIT4_X);
+
       long vbase = 0;
       if (use_base < 0) {
 	    vbase = -use_base;
@@ -4146,13 +4408,14 @@ bool of_MOV_WU(vthread_t thr, vvp_code_t cp)
  */
 bool of_MUL(vthread_t thr, vvp_code_t)
 {
-      vvp_vector4_t r = thr->pop_vec4();
-	// Rather then pop l, use it directly from the stack. When we
-	// assign to 'l', that will edit the top of the stack, which
-	// replaces a pop and a pull.
-      vvp_vector4_t&l = thr->peek_vec4();
+	// Rather then pop l and r, use them directly from the
+	// stack. When we assign to 'l', that will edit the stack
+	// in place, and popping r leaves its words for reuse.
+      const vvp_vector4_t&r = thr->peek_vec4(0);
+      vvp_vector4_t&l = thr->peek_vec4_mut(1);
 
       l.mul(r);
+      thr->pop_vec4(1);
       return true;
 }
 
@@ -4189,16 +4452,12 @@ bool of_MUL_WR(vthread_t thr, vvp_code_t)
 
 bool of_NAND(vthread_t thr, vvp_code_t)
 {
-      vvp_vector4_t valr = thr->pop_vec4();
-      vvp_vector4_t&vall = thr->peek_vec4();
+      const vvp_vector4_t&valr = thr->peek_vec4(0);
+      vvp_vector4_t&vall = thr->peek_vec4_mut(1);
       assert(vall.size() == valr.size());
-      unsigned wid = vall.size();
-
-      for (unsigned idx = 0 ; idx < wid ; idx += 1) {
-	    vvp_bit4_t lb = vall.value(idx);
-	    vvp_bit4_t rb = valr.value(idx);
-	    vall.set_bit(idx, ~(lb&rb));
-      }
+      vall &= valr;
+      vall.invert();
+      thr->pop_vec4(1);
 
       return true;
 }
@@ -4441,9 +4700,10 @@ bool of_XNORR(vthread_t thr, vvp_code_t)
  */
 bool of_OR(vthread_t thr, vvp_code_t)
 {
-      vvp_vector4_t valb = thr->pop_vec4();
-      vvp_vector4_t&vala = thr->peek_vec4();
+      const vvp_vector4_t&valb = thr->peek_vec4(0);
+      vvp_vector4_t&vala = thr->peek_vec4_mut(1);
       vala |= valb;
+      thr->pop_vec4(1);
       return true;
 }
 
@@ -4452,16 +4712,12 @@ bool of_OR(vthread_t thr, vvp_code_t)
  */
 bool of_NOR(vthread_t thr, vvp_code_t)
 {
-      vvp_vector4_t valr = thr->pop_vec4();
-      vvp_vector4_t&vall = thr->peek_vec4();
+      const vvp_vector4_t&valr = thr->peek_vec4(0);
+      vvp_vector4_t&vall = thr->peek_vec4_mut(1);
       assert(vall.size() == valr.size());
-      unsigned wid = vall.size();
-
-      for (unsigned idx = 0 ; idx < wid ; idx += 1) {
-	    vvp_bit4_t lb = vall.value(idx);
-	    vvp_bit4_t rb = valr.value(idx);
-	    vall.set_bit(idx, ~(lb|rb));
-      }
+      vall |= valr;
+      vall.invert();
+      thr->pop_vec4(1);
 
       return true;
 }
@@ -5834,10 +6090,11 @@ bool of_STORE_VEC4A(vthread_t thr, vvp_code_t cp)
  */
 bool of_SUB(vthread_t thr, vvp_code_t)
 {
-      vvp_vector4_t r = thr->pop_vec4();
-      vvp_vector4_t&l = thr->peek_vec4();
+      const vvp_vector4_t&r = thr->peek_vec4(0);
+      vvp_vector4_t&l = thr->peek_vec4_mut(1);
 
       l.sub(r);
+      thr->pop_vec4(1);
       return true;
 }
 
@@ -6080,17 +6337,12 @@ bool of_WAIT_FORK(vthread_t thr, vvp_code_t)
  */
 bool of_XNOR(vthread_t thr, vvp_code_t)
 {
-      vvp_vector4_t valr = thr->pop_vec4();
-      vvp_vector4_t&vall = thr->peek_vec4();
+      const vvp_vector4_t&valr = thr->peek_vec4(0);
+      vvp_vector4_t&vall = thr->peek_vec4_mut(1);
       assert(vall.size() == valr.size());
-      unsigned wid = vall.size();
-
-      for (unsigned idx = 0 ;  idx < wid ;  idx += 1) {
-
-	    vvp_bit4_t lb = vall.value(idx);
-	    vvp_bit4_t rb = valr.value(idx);
-	    vall.set_bit(idx, ~(lb ^ rb));
-      }
+      vall ^= valr;
+      vall.invert();
+      thr->pop_vec4(1);
 
       return true;
 }
@@ -6100,17 +6352,11 @@ bool of_XNOR(vthread_t thr, vvp_code_t)
  */
 bool of_XOR(vthread_t thr, vvp_code_t)
 {
-      vvp_vector4_t valr = thr->pop_vec4();
-      vvp_vector4_t&vall = thr->peek_vec4();
+      const vvp_vector4_t&valr = thr->peek_vec4(0);
+      vvp_vector4_t&vall = thr->peek_vec4_mut(1);
       assert(vall.size() == valr.size());
-      unsigned wid = vall.size();
-
-      for (unsigned idx = 0 ;  idx < wid ;  idx += 1) {
-
-	    vvp_bit4_t lb = vall.value(idx);
-	    vvp_bit4_t rb = valr.value(idx);
-	    vall.set_bit(idx, lb ^ rb);
-      }
+      vall ^= valr;
+      thr->pop_vec4(1);
 
       return true;
 }
@@ -6238,3 +6484,55 @@ bool of_REAP_UFUNC(vthread_t thr, vvp_code_t cp)
 
       return true;
 }
+
+/*
+ * The fused opcodes are not part of the assembly language. They are
+ * substituted by codespace_fuse_jumps() for an instruction that sets
+ * a flag and is followed by a conditional jump. The fused opcode runs
+ * both instructions in a single dispatch, and because both functions
+ * are known here the compiler can inline them.
+ */
+template <vvp_code_fun OP, vvp_code_fun JMP>
+static bool of_FUSED_JMP(vthread_t thr, vvp_code_t cp)
+{
+      (*OP)(thr, cp);
+
+	/* The jump instruction sets the pc only if it is taken. */
+      thr->pc = cp + 2;
+      return (*JMP)(thr, cp + 1);
+}
+
+# define FUSED_JMPS(OP) \
+      { &OP, &of_JMP0,   &of_FUSED_JMP<&OP,&of_JMP0> },   \
+      { &OP, &of_JMP0XZ, &of_FUSED_JMP<&OP,&of_JMP0XZ> }, \
+      { &OP, &of_JMP1,   &of_FUSED_JMP<&OP,&of_JMP1> },   \
+      { &OP, &of_JMP1XZ, &of_FUSED_JMP<&OP,&of_JMP1XZ> }
+
+static const struct fused_jump_s {
+      vvp_code_fun op;
+      vvp_code_fun jmp;
+      vvp_code_fun fused;
+} fused_jump_table[] = {
+      FUSED_JMPS(of_CMPE),
+      FUSED_JMPS(of_CMPIE),
+      FUSED_JMPS(of_CMPINE),
+      FUSED_JMPS(of_CMPIS),
+      FUSED_JMPS(of_CMPIU),
+      FUSED_JMPS(of_CMPNE),
+      FUSED_JMPS(of_CMPS),
+      FUSED_JMPS(of_CMPU),
+      FUSED_JMPS(of_FLAG_SET_VEC4),
+      { 0, 0, 0 }
+};
+
+# undef FUSED_JMPS
+
+vvp_code_fun vthread_fused_jump(vvp_code_fun op, vvp_code_fun jmp)
+{
+      for (const fused_jump_s*cur = fused_jump_table ;  cur->op ;  cur += 1) {
+	    if (cur->op == op && cur->jmp == jmp)
+		  return cur->fused;
+      }
+
+      return 0;
+}
@@ -41,9 +41,12 @@ class __vpiScope;
 /*
  * This creates a new simulation thread, with the given start
  * address. The generated thread is ready to run, but is not yet
- * scheduled.
+ * scheduled. The threads that a scope spawns again and again (forks,
+ * task and function calls) set pool_stacks, so that they reuse the
+ * stacks of the threads of the scope that ended before them.
  */
-extern vthread_t vthread_new(vvp_code_t sa, __vpiScope*scope);
+extern vthread_t vthread_new(vvp_code_t sa, __vpiScope*scope,
+			     bool pool_stacks =true);
 
 /*
  * This function marks the thread as scheduled. It is used only by the
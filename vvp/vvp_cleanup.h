@@ -1,7 +1,7 @@
 #ifndef IVL_vvp_cleanup_H
 #define IVL_vvp_cleanup_H
 /*
- * Copyright (c) 2009-2015 Cary R. (cygcary@yahoo.com)
+ * Copyright (c) 2009-2016 Cary R. (cygcary@yahoo.com)
  *
  *    This source code is free software; you can redistribute it
  *    and/or modify it in source code form under the terms of the GNU
@@ -41,6 +41,8 @@ extern void vpi_handle_delete(void);
 extern void vpi_stack_delete(void);
 extern void vvp_net_pool_delete(void);
 extern void ufunc_pool_delete(void);
+extern void vthread_pool_delete(void);
+extern void gate_pack_delete(void);
 
 extern void A_delete(class __vpiHandle *item);
 extern void APV_delete(class __vpiHandle *item);
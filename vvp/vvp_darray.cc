@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2012-2015 Stephen Williams (steve@icarus.com)
+ * Copyright (c) 2012-2016 Stephen Williams (steve@icarus.com)
  *
  *    This source code is free software; you can redistribute it
  *    and/or modify it in source code form under the terms of the GNU
@@ -85,14 +85,8 @@ template <class TYPE> void vvp_darray_atom<TYPE>::set_word(unsigned adr, const v
       array_[adr] = tmp;
 }
 
-template <class TYPE> void vvp_darray_atom<TYPE>::get_word(unsigned adr, vvp_vector4_t&value)
+template <class TYPE> static void atom_to_vector4(TYPE word, vvp_vector4_t&value)
 {
-      if (adr >= array_.size()) {
-	    value = vvp_vector4_t(8*sizeof(TYPE), BIT4_X);
-	    return;
-      }
-
-      TYPE word = array_[adr];
       vvp_vector4_t tmp (8*sizeof(TYPE), BIT4_0);
       for (unsigned idx = 0 ; idx < tmp.size() ; idx += 1) {
 	    if (word&1) tmp.set_bit(idx, BIT4_1);
@@ -101,6 +95,16 @@ template <class TYPE> void vvp_darray_atom<TYPE>::get_word(unsigned adr, vvp_vec
       value = tmp;
 }
 
+template <class TYPE> void vvp_darray_atom<TYPE>::get_word(unsigned adr, vvp_vector4_t&value)
+{
+      if (adr >= array_.size()) {
+	    value = vvp_vector4_t(8*sizeof(TYPE), BIT4_X);
+	    return;
+      }
+
+      atom_to_vector4(array_[adr], value);
+}
+
 template class vvp_darray_atom<uint8_t>;
 template class vvp_darray_atom<uint16_t>;
 template class vvp_darray_atom<uint32_t>;
@@ -110,6 +114,66 @@ template class vvp_darray_atom<int16_t>;
 template class vvp_darray_atom<int32_t>;
 template class vvp_darray_atom<int64_t>;
 
+template <class TYPE> vvp_darray_atom_sparse<TYPE>::vvp_darray_atom_sparse(size_t siz)
+: size_(siz)
+{
+      size_t npages = (size_ + PAGE_WORDS-1) / PAGE_WORDS;
+      pages_ = new TYPE*[npages];
+      for (size_t idx = 0 ; idx < npages ; idx += 1)
+	    pages_[idx] = 0;
+}
+
+template <class TYPE> vvp_darray_atom_sparse<TYPE>::~vvp_darray_atom_sparse()
+{
+      size_t npages = (size_ + PAGE_WORDS-1) / PAGE_WORDS;
+      for (size_t idx = 0 ; idx < npages ; idx += 1)
+	    delete[]pages_[idx];
+      delete[]pages_;
+}
+
+template <class TYPE> size_t vvp_darray_atom_sparse<TYPE>::get_size() const
+{
+      return size_;
+}
+
+template <class TYPE> void vvp_darray_atom_sparse<TYPE>::set_word(unsigned adr, const vvp_vector4_t&value)
+{
+      if (adr >= size_)
+	    return;
+
+      TYPE tmp;
+      vector4_to_value(value, tmp, true, false);
+
+      TYPE*&page = pages_[adr / PAGE_WORDS];
+      if (page == 0) {
+	      // Writing a 0 into a missing page changes nothing.
+	    if (tmp == 0)
+		  return;
+	    page = new TYPE[PAGE_WORDS]();
+      }
+      page[adr % PAGE_WORDS] = tmp;
+}
+
+template <class TYPE> void vvp_darray_atom_sparse<TYPE>::get_word(unsigned adr, vvp_vector4_t&value)
+{
+      if (adr >= size_) {
+	    value = vvp_vector4_t(8*sizeof(TYPE), BIT4_X);
+	    return;
+      }
+
+      const TYPE*page = pages_[adr / PAGE_WORDS];
+      atom_to_vector4(page? page[adr % PAGE_WORDS] : (TYPE)0, value);
+}
+
+template class vvp_darray_atom_sparse<uint8_t>;
+template class vvp_darray_atom_sparse<uint16_t>;
+template class vvp_darray_atom_sparse<uint32_t>;
+template class vvp_darray_atom_sparse<uint64_t>;
+template class vvp_darray_atom_sparse<int8_t>;
+template class vvp_darray_atom_sparse<int16_t>;
+template class vvp_darray_atom_sparse<int32_t>;
+template class vvp_darray_atom_sparse<int64_t>;
+
 vvp_darray_vec4::~vvp_darray_vec4()
 {
 }
@@ -305,13 +369,7 @@ void vvp_queue_string::set_word(unsigned adr, const string&value)
       if (adr >= array_.size())
 	    return;
 
-      list<string>::iterator cur = array_.begin();
-      while (adr > 0) {
-	    ++ cur;
-	    adr -= 1;
-      }
-
-      *cur = value;
+      array_[adr] = value;
 }
 
 void vvp_queue_string::get_word(unsigned adr, string&value)
@@ -321,13 +379,7 @@ void vvp_queue_string::get_word(unsigned adr, string&value)
 	    return;
       }
 
-      list<string>::const_iterator cur = array_.begin();
-      while (adr > 0) {
-	    ++ cur;
-	    adr -= 1;
-      }
-
-      value = *cur;
+      value = array_[adr];
 }
 
 void vvp_queue_string::pop_back(void)
@@ -354,13 +406,7 @@ void vvp_queue_vec4::set_word(unsigned adr, const vvp_vector4_t&value)
       if (adr >= array_.size())
 	    return;
 
-      list<vvp_vector4_t>::iterator cur = array_.begin();
-      while (adr > 0) {
-	    ++ cur;
-	    adr -= 1;
-      }
-
-      *cur = value;
+      array_[adr] = value;
 }
 
 void vvp_queue_vec4::get_word(unsigned adr, vvp_vector4_t&value)
@@ -370,13 +416,7 @@ void vvp_queue_vec4::get_word(unsigned adr, vvp_vector4_t&value)
 	    return;
       }
 
-      list<vvp_vector4_t>::const_iterator cur = array_.begin();
-      while (adr > 0) {
-	    ++ cur;
-	    adr -= 1;
-      }
-
-      value = *cur;
+      value = array_[adr];
 }
 
 void vvp_queue_vec4::push_back(const vvp_vector4_t&val)
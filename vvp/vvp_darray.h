@@ -1,7 +1,7 @@
 #ifndef IVL_vvp_darray_H
 #define IVL_vvp_darray_H
 /*
- * Copyright (c) 2012-2015 Stephen Williams (steve@icarus.com)
+ * Copyright (c) 2012-2016 Stephen Williams (steve@icarus.com)
  *
  *    This source code is free software; you can redistribute it
  *    and/or modify it in source code form under the terms of the GNU
@@ -21,7 +21,7 @@
 
 # include  "vvp_object.h"
 # include  "vvp_net.h"
-# include  <list>
+# include  <deque>
 # include  <string>
 # include  <vector>
 
@@ -60,6 +60,32 @@ template <class TYPE> class vvp_darray_atom : public vvp_darray {
       std::vector<TYPE> array_;
 };
 
+/*
+ * Statically allocated 2-state arrays that are very large keep their
+ * words in pages of PAGE_WORDS words. A page is allocated on the first
+ * write into it, and the words that were never written read as 0.
+ */
+template <class TYPE> class vvp_darray_atom_sparse : public vvp_darray {
+
+    public:
+      explicit vvp_darray_atom_sparse(size_t siz);
+      ~vvp_darray_atom_sparse();
+
+      size_t get_size(void) const;
+      void set_word(unsigned adr, const vvp_vector4_t&value);
+      void get_word(unsigned adr, vvp_vector4_t&value);
+
+      enum { PAGE_WORDS = 1024 };
+
+    private:
+      size_t size_;
+      TYPE**pages_;
+
+    private: // Not implemented
+      vvp_darray_atom_sparse(const vvp_darray_atom_sparse&);
+      vvp_darray_atom_sparse& operator= (const vvp_darray_atom_sparse&);
+};
+
 class vvp_darray_vec4 : public vvp_darray {
 
     public:
@@ -134,6 +160,13 @@ class vvp_darray_object : public vvp_darray {
       std::vector<vvp_object_t> array_;
 };
 
+/*
+ * The queues are kept in a std::deque, which gives constant time
+ * indexed access as well as push and pop at both ends. The elements
+ * are stored in chunks, and vvp_vector4_t words up to 128 bits wide
+ * keep their bits inline, so a queue of such words does not need a
+ * heap allocation for each element.
+ */
 class vvp_queue : public vvp_darray {
 
     public:
@@ -167,7 +200,7 @@ class vvp_queue_vec4 : public vvp_queue {
       void pop_front(void);
 
     private:
-      std::list<vvp_vector4_t> array_;
+      std::deque<vvp_vector4_t> array_;
 };
 
 
@@ -185,7 +218,7 @@ class vvp_queue_string : public vvp_queue {
       void pop_front(void);
 
     private:
-      std::list<std::string> array_;
+      std::deque<std::string> array_;
 };
 
 #endif /* IVL_vvp_darray_H */
@@ -25,6 +25,7 @@
 # include  "resolv.h"
 # include  "schedule.h"
 # include  "statistics.h"
+# include  "slab.h"
 # include  <cstdio>
 # include  <cstring>
 # include  <cstdlib>
@@ -33,6 +34,8 @@
 # include  <climits>
 # include  <cmath>
 # include  <cassert>
+# include  <vector>
+# include  <algorithm>
 #ifdef CHECK_WITH_VALGRIND
 # include  <valgrind/memcheck.h>
 # include  <map>
@@ -57,9 +60,12 @@ static vvp_net_t **vvp_net_pool = NULL;
 static unsigned vvp_net_pool_count = 0;
 #endif
 static size_t vvp_net_alloc_remaining = 0;
+// Keep all the chunks so that vvp_net_walk can find every net.
+static std::vector<vvp_net_t*> vvp_net_chunks;
 // For statistics, count the vvp_nets allocated and the bytes of alloc
 // chunks allocated.
 unsigned long count_vvp_nets = 0;
+unsigned long count_vector4_heap_allocs = 0;
 size_t size_vvp_nets = 0;
 
 void* vvp_net_t::operator new (size_t size)
@@ -69,6 +75,7 @@ void* vvp_net_t::operator new (size_t size)
 	    vvp_net_alloc_table = ::new vvp_net_t[VVP_NET_CHUNK];
 	    vvp_net_alloc_remaining = VVP_NET_CHUNK;
 	    size_vvp_nets += size*VVP_NET_CHUNK;
+	    vvp_net_chunks.push_back(vvp_net_alloc_table);
 #ifdef CHECK_WITH_VALGRIND
 	    VALGRIND_MAKE_MEM_NOACCESS(vvp_net_alloc_table, size*VVP_NET_CHUNK);
 	    VALGRIND_CREATE_MEMPOOL(vvp_net_alloc_table, 0, 0);
@@ -91,6 +98,153 @@ void* vvp_net_t::operator new (size_t size)
       return return_this;
 }
 
+void vvp_net_walk(void (*fun)(vvp_net_t*, void*), void*data)
+{
+      for (size_t idx = 0 ; idx < vvp_net_chunks.size() ; idx += 1) {
+	    size_t cnt = VVP_NET_CHUNK;
+	    if (idx+1 == vvp_net_chunks.size())
+		  cnt -= vvp_net_alloc_remaining;
+
+	    vvp_net_t*chunk = vvp_net_chunks[idx];
+	    for (size_t net = 0 ; net < cnt ; net += 1)
+		  fun(chunk+net, data);
+      }
+}
+
+/*
+ * The fan-out arrays of all the nets are in one table that is made
+ * once. A net whose fan-out changes later goes back to the chain, and
+ * its part of the table is not reused.
+ */
+static vvp_fanout_s*vvp_fanout_table = 0;
+unsigned long count_fanout_arrays = 0;
+unsigned long count_fanout_array_words = 0;
+
+static unsigned long fanout_size(vvp_net_t*net)
+{
+      unsigned long cnt = 0;
+      for (vvp_net_ptr_t cur = net->fanout_head() ; vvp_net_t*dst = cur.ptr()
+		 ; cur = dst->port[cur.port()])
+	    cnt += 1;
+      return cnt;
+}
+
+static void collect_fanout(vvp_net_t*net, void*data)
+{
+      unsigned long cnt = fanout_size(net);
+      if (cnt >= VVP_FANOUT_ARRAY_MIN) {
+	    static_cast<std::vector<vvp_net_t*>*>(data)->push_back(net);
+	    count_fanout_arrays += 1;
+	    count_fanout_array_words += cnt + 1;
+      }
+}
+
+static void collect_net(vvp_net_t*net, void*data)
+{
+      static_cast<std::vector<vvp_net_t*>*>(data)->push_back(net);
+}
+
+static size_t find_net(const std::vector<vvp_net_t*>&sorted, vvp_net_t*net)
+{
+      std::vector<vvp_net_t*>::const_iterator cur
+	    = std::lower_bound(sorted.begin(), sorted.end(), net);
+      assert(cur != sorted.end() && *cur == net);
+      return cur - sorted.begin();
+}
+
+/*
+ * Put the nets with fan-out arrays in the order that values flow
+ * through the design. The walk is breadth first from the nets that no
+ * other net drives, which are the variables, the clocks and the other
+ * inputs that the behavioral code writes. Nets that are only reached
+ * through a loop go at the end, in allocation order.
+ */
+static void flow_order_fanout(std::vector<vvp_net_t*>&list)
+{
+      std::vector<vvp_net_t*> nets;
+      vvp_net_walk(&collect_net, &nets);
+      std::vector<vvp_net_t*> sorted (nets);
+      std::sort(sorted.begin(), sorted.end());
+
+      std::vector<bool> driven (sorted.size(), false);
+      for (size_t idx = 0 ; idx < sorted.size() ; idx += 1) {
+	    for (vvp_net_ptr_t cur = sorted[idx]->fanout_head()
+		       ; vvp_net_t*dst = cur.ptr()
+		       ; cur = dst->port[cur.port()])
+		  driven[find_net(sorted, dst)] = true;
+      }
+
+      std::vector<bool> seen (sorted.size(), false);
+      std::vector<vvp_net_t*> order;
+      order.reserve(nets.size());
+      for (size_t idx = 0 ; idx < nets.size() ; idx += 1) {
+	    size_t pos = find_net(sorted, nets[idx]);
+	    if (driven[pos])
+		  continue;
+	    seen[pos] = true;
+	    order.push_back(nets[idx]);
+      }
+
+      for (size_t head = 0 ; head < order.size() ; head += 1) {
+	    vvp_net_ptr_t cur = order[head]->fanout_head();
+	    while (vvp_net_t*dst = cur.ptr()) {
+		  size_t pos = find_net(sorted, dst);
+		  if (! seen[pos]) {
+			seen[pos] = true;
+			order.push_back(dst);
+		  }
+		  cur = dst->port[cur.port()];
+	    }
+      }
+
+      for (size_t idx = 0 ; idx < nets.size() ; idx += 1) {
+	    if (! seen[find_net(sorted, nets[idx])])
+		  order.push_back(nets[idx]);
+      }
+
+      list.clear();
+      for (size_t idx = 0 ; idx < order.size() ; idx += 1) {
+	    if (fanout_size(order[idx]) >= VVP_FANOUT_ARRAY_MIN)
+		  list.push_back(order[idx]);
+      }
+}
+
+void vvp_net_flatten_fanout(bool flow_order)
+{
+      if (vvp_fanout_table != 0)
+	    return;
+
+      std::vector<vvp_net_t*> list;
+      count_fanout_arrays = 0;
+      count_fanout_array_words = 0;
+      vvp_net_walk(&collect_fanout, &list);
+      if (count_fanout_array_words == 0)
+	    return;
+
+      if (flow_order)
+	    flow_order_fanout(list);
+
+      vvp_fanout_table = new vvp_fanout_s[count_fanout_array_words];
+      vvp_fanout_s*fill = vvp_fanout_table;
+
+      for (size_t idx = 0 ; idx < list.size() ; idx += 1) {
+	    vvp_net_t*net = list[idx];
+	    net->fanout_ = fill;
+	    for (vvp_net_ptr_t cur = net->out_ ; vvp_net_t*dst = cur.ptr()
+		       ; cur = dst->port[cur.port()]) {
+		  if (dst->fun) {
+			fill->ptr = cur;
+			fill->fun = dst->fun;
+			fill += 1;
+		  }
+	    }
+	    fill->ptr = vvp_net_ptr_t(0,0);
+	    fill->fun = 0;
+	    fill += 1;
+      }
+      assert(fill <= vvp_fanout_table + count_fanout_array_words);
+}
+
 #ifdef CHECK_WITH_VALGRIND
 static map<vvp_net_t*, bool> vvp_net_map;
 static map<sfunc_core*, bool> sfunc_map;
@@ -172,6 +326,9 @@ void vvp_net_pool_delete()
 	                    count_vvp_nets);
       }
 
+      delete[] vvp_fanout_table;
+      vvp_fanout_table = 0;
+
       for (unsigned idx = 0; idx < vvp_net_pool_count; idx += 1) {
 	    VALGRIND_DESTROY_MEMPOOL(vvp_net_pool[idx]);
 	    ::delete [] vvp_net_pool[idx];
@@ -188,7 +345,7 @@ void vvp_net_t::operator delete(void*)
 }
 
 vvp_net_t::vvp_net_t()
-: out_(vvp_net_ptr_t(0,0))
+: out_(vvp_net_ptr_t(0,0)), fanout_(0)
 {
       fun = 0;
       fil = 0;
@@ -199,6 +356,7 @@ void vvp_net_t::link(vvp_net_ptr_t port_to_link)
       vvp_net_t*net = port_to_link.ptr();
       net->port[port_to_link.port()] = out_;
       out_ = port_to_link;
+      fanout_ = 0;
 }
 
 /*
@@ -212,6 +370,9 @@ void vvp_net_t::unlink(vvp_net_ptr_t dst_ptr)
       vvp_net_t*net = dst_ptr.ptr();
       unsigned net_port = dst_ptr.port();
 
+	/* The array stays allocated, as a send may be walking it. */
+      fanout_ = 0;
+
       if (out_ == dst_ptr) {
 	      /* If the drive fan-out list starts with this pointer,
 		 then the unlink is easy. Pull the list forward. */
@@ -563,8 +724,11 @@ void vvp_send_vec8(vvp_net_ptr_t ptr, const vvp_vector8_t&val)
       while (vvp_net_t*cur = ptr.ptr()) {
 	    vvp_net_ptr_t next = cur->port[ptr.port()];
 
-	    if (cur->fun)
+	    if (cur->fun) {
+		  if (vvp_profile_enabled)
+			vvp_profile_recv(cur->fun);
 		  cur->fun->recv_vec8(ptr, val);
+	    }
 
 	    ptr = next;
       }
@@ -575,8 +739,11 @@ void vvp_send_real(vvp_net_ptr_t ptr, double val, vvp_context_t context)
       while (vvp_net_t*cur = ptr.ptr()) {
 	    vvp_net_ptr_t next = cur->port[ptr.port()];
 
-	    if (cur->fun)
+	    if (cur->fun) {
+		  if (vvp_profile_enabled)
+			vvp_profile_recv(cur->fun);
 		  cur->fun->recv_real(ptr, val, context);
+	    }
 
 	    ptr = next;
       }
@@ -698,8 +865,7 @@ void vvp_vector4_t::copy_bits(const vvp_vector4_t&that)
 void vvp_vector4_t::copy_from_big_(const vvp_vector4_t&that)
 {
       unsigned words = (size_+BITS_PER_WORD-1) / BITS_PER_WORD;
-      abits_ptr_ = new unsigned long[2*words];
-      bbits_ptr_ = abits_ptr_ + words;
+      alloc_words_(words);
 
       for (unsigned idx = 0 ;  idx < words ;  idx += 1)
 	    abits_ptr_[idx] = that.abits_ptr_[idx];
@@ -717,8 +883,7 @@ void vvp_vector4_t::copy_inverted_from_(const vvp_vector4_t&that)
       size_ = that.size_;
       if (size_ > BITS_PER_WORD) {
 	    unsigned words = (size_+BITS_PER_WORD-1) / BITS_PER_WORD;
-	    abits_ptr_ = new unsigned long[2*words];
-	    bbits_ptr_ = abits_ptr_ + words;
+	    alloc_words_(words);
 
 	    unsigned remaining = size_;
 	    unsigned idx = 0;
@@ -742,13 +907,62 @@ void vvp_vector4_t::copy_inverted_from_(const vvp_vector4_t&that)
       }
 }
 
+/*
+ * Vectors of up to POOL_WORDS words take their words from a slab of
+ * chunks of exactly that size, so only the really wide vectors
+ * allocate their words from the heap. Each chunk holds the abits and
+ * bbits of one vector, like the heap arrays do.
+ */
+static const size_t VEC4_CHUNK_COUNT = 256;
+static slab_t<2*2*sizeof(unsigned long),VEC4_CHUNK_COUNT> vec4_words2_heap;
+static slab_t<2*3*sizeof(unsigned long),VEC4_CHUNK_COUNT> vec4_words3_heap;
+static slab_t<2*4*sizeof(unsigned long),VEC4_CHUNK_COUNT> vec4_words4_heap;
+
+void vvp_vector4_t::alloc_words_(unsigned cnt)
+{
+      assert(cnt > 1);
+      switch (cnt) {
+	  case 2:
+	    abits_ptr_ = static_cast<unsigned long*>(vec4_words2_heap.alloc_slab());
+	    break;
+	  case 3:
+	    abits_ptr_ = static_cast<unsigned long*>(vec4_words3_heap.alloc_slab());
+	    break;
+	  case 4:
+	    abits_ptr_ = static_cast<unsigned long*>(vec4_words4_heap.alloc_slab());
+	    break;
+	  default:
+	    abits_ptr_ = new unsigned long[2*cnt];
+	    count_vector4_heap_allocs += 1;
+	    break;
+      }
+      bbits_ptr_ = abits_ptr_ + cnt;
+}
+
+void vvp_vector4_t::release_words_(unsigned long*words, unsigned cnt)
+{
+      switch (cnt) {
+	  case 2:
+	    vec4_words2_heap.free_slab(words);
+	    break;
+	  case 3:
+	    vec4_words3_heap.free_slab(words);
+	    break;
+	  case 4:
+	    vec4_words4_heap.free_slab(words);
+	    break;
+	  default:
+	    delete[] words;
+	    break;
+      }
+}
+
 /* Make sure to set size_ before calling this routine. */
 void vvp_vector4_t::allocate_words_(unsigned long inita, unsigned long initb)
 {
       if (size_ > BITS_PER_WORD) {
 	    unsigned cnt = (size_ + BITS_PER_WORD - 1) / BITS_PER_WORD;
-	    abits_ptr_ = new unsigned long[2*cnt];
-	    bbits_ptr_ = abits_ptr_ + cnt;
+	    alloc_words_(cnt);
 	    for (unsigned idx = 0 ;  idx < cnt ;  idx += 1)
 		  abits_ptr_[idx] = inita;
 	    for (unsigned idx = 0 ;  idx < cnt ;  idx += 1)
@@ -997,7 +1211,12 @@ void vvp_vector4_t::resize(unsigned newsize, vvp_bit4_t pad_bit)
 		  return;
 	    }
 
-	    unsigned long*newbits = new unsigned long[2*newcnt];
+	    unsigned long*olda = abits_ptr_;
+	    unsigned long*oldb = bbits_ptr_;
+	    unsigned long oldvala = abits_val_;
+	    unsigned long oldvalb = bbits_val_;
+
+	    alloc_words_(newcnt);
 
 	    if (cnt > 1) {
 		  unsigned trans = cnt;
@@ -1005,39 +1224,37 @@ void vvp_vector4_t::resize(unsigned newsize, vvp_bit4_t pad_bit)
 			trans = newcnt;
 
 		  for (unsigned idx = 0 ;  idx < trans ;  idx += 1)
-			newbits[idx] = abits_ptr_[idx];
+			abits_ptr_[idx] = olda[idx];
 		  for (unsigned idx = 0 ;  idx < trans ;  idx += 1)
-			newbits[newcnt+idx] = bbits_ptr_[idx];
+			bbits_ptr_[idx] = oldb[idx];
 
-		  delete[]abits_ptr_;
+		  release_words_(olda, cnt);
 
 	    } else {
-		  newbits[0] = abits_val_;
-		  newbits[newcnt] = bbits_val_;
+		  abits_ptr_[0] = oldvala;
+		  bbits_ptr_[0] = oldvalb;
 	    }
 
 	    if (newsize > size_) {
 		  if (unsigned fill = size_ % BITS_PER_WORD) {
-			newbits[cnt-1] &= ~((-1UL) << fill);
-			newbits[cnt-1] |= word_pad_abits << fill;
-			newbits[newcnt+cnt-1] &= ~((-1UL) << fill);
-			newbits[newcnt+cnt-1] |= word_pad_bbits << fill;
+			abits_ptr_[cnt-1] &= ~((-1UL) << fill);
+			abits_ptr_[cnt-1] |= word_pad_abits << fill;
+			bbits_ptr_[cnt-1] &= ~((-1UL) << fill);
+			bbits_ptr_[cnt-1] |= word_pad_bbits << fill;
 		  }
 		  for (unsigned idx = cnt ;  idx < newcnt ;  idx += 1)
-			newbits[idx] = word_pad_abits;
+			abits_ptr_[idx] = word_pad_abits;
 		  for (unsigned idx = cnt ;  idx < newcnt ;  idx += 1)
-			newbits[newcnt+idx] = word_pad_bbits;
+			bbits_ptr_[idx] = word_pad_bbits;
 	    }
 
 	    size_ = newsize;
-	    abits_ptr_ = newbits;
-	    bbits_ptr_ = newbits + newcnt;
 
       } else {
 	    if (cnt > 1) {
 		  unsigned long newvala = abits_ptr_[0];
 		  unsigned long newvalb = bbits_ptr_[0];
-		  delete[]abits_ptr_;
+		  free_words_();
 		  abits_val_ = newvala;
 		  bbits_val_ = newvalb;
 	    }
@@ -1132,6 +1349,61 @@ unsigned long* vvp_vector4_t::subarray(unsigned adr, unsigned wid, bool xz_to_0)
       return 0;
 }
 
+void vvp_vector4_t::set_vecvals(const s_vpi_vecval*vals)
+{
+      unsigned long*abits = &abits_val_;
+      unsigned long*bbits = &bbits_val_;
+      if (size_ > BITS_PER_WORD) {
+	    abits = abits_ptr_;
+	    bbits = bbits_ptr_;
+      }
+
+      unsigned cnt = (size_ + BITS_PER_WORD-1) / BITS_PER_WORD;
+      for (unsigned idx = 0 ; idx < cnt ; idx += 1) {
+	    abits[idx] = 0;
+	    bbits[idx] = 0;
+      }
+
+      unsigned nvals = (size_ + 31) / 32;
+      for (unsigned idx = 0 ; idx < nvals ; idx += 1) {
+	    unsigned wdx = idx*32 / BITS_PER_WORD;
+	    unsigned off = idx*32 % BITS_PER_WORD;
+	    abits[wdx] |= (unsigned long)(PLI_UINT32)vals[idx].aval << off;
+	    bbits[wdx] |= (unsigned long)(PLI_UINT32)vals[idx].bval << off;
+      }
+
+	// Bits past the end of the vector are left 0.
+      if (unsigned top = size_ % BITS_PER_WORD) {
+	    unsigned long mask = (1UL << top) - 1UL;
+	    abits[cnt-1] &= mask;
+	    bbits[cnt-1] &= mask;
+      }
+}
+
+void vvp_vector4_t::get_vecvals(s_vpi_vecval*vals) const
+{
+      const unsigned long*abits = &abits_val_;
+      const unsigned long*bbits = &bbits_val_;
+      if (size_ > BITS_PER_WORD) {
+	    abits = abits_ptr_;
+	    bbits = bbits_ptr_;
+      }
+
+      unsigned nvals = (size_ + 31) / 32;
+      for (unsigned idx = 0 ; idx < nvals ; idx += 1) {
+	    unsigned wdx = idx*32 / BITS_PER_WORD;
+	    unsigned off = idx*32 % BITS_PER_WORD;
+	    vals[idx].aval = abits[wdx] >> off;
+	    vals[idx].bval = bbits[wdx] >> off;
+      }
+
+      if (unsigned top = size_ % 32) {
+	    PLI_INT32 mask = (1U << top) - 1U;
+	    vals[nvals-1].aval &= mask;
+	    vals[nvals-1].bval &= mask;
+      }
+}
+
 void vvp_vector4_t::setarray(unsigned adr, unsigned wid, const unsigned long*val)
 {
       assert(adr+wid <= size_);
@@ -1727,11 +1999,13 @@ bool vvp_vector4_t::eeq(const vvp_vector4_t&that) const
 		  && (bbits_val_ == that.bbits_val_);
       }
 
+	// Compare the full words in the a and b planes together, so
+	// that there is only one test per word.
       unsigned words = size_ / BITS_PER_WORD;
       for (unsigned idx = 0 ;  idx < words ;  idx += 1) {
-	    if (abits_ptr_[idx] != that.abits_ptr_[idx])
-		  return false;
-	    if (bbits_ptr_[idx] != that.bbits_ptr_[idx])
+	    unsigned long diff = (abits_ptr_[idx] ^ that.abits_ptr_[idx])
+		                | (bbits_ptr_[idx] ^ that.bbits_ptr_[idx]);
+	    if (diff)
 		  return false;
       }
 
@@ -1790,11 +2064,14 @@ bool vvp_vector4_t::has_xz() const
 	    return bbits_val_;
       }
 
+	// Most vectors have no XZ bits, so scan the whole b plane
+	// without branching and test the accumulated bits once.
       unsigned words = size_ / BITS_PER_WORD;
-      for (unsigned idx = 0 ; idx < words ; idx += 1) {
-	    if (bbits_ptr_[idx])
-		  return true;
-      }
+      unsigned long xz = 0;
+      for (unsigned idx = 0 ; idx < words ; idx += 1)
+	    xz |= bbits_ptr_[idx];
+      if (xz)
+	    return true;
 
       unsigned long mask = size_%BITS_PER_WORD;
       if (mask > 0) {
@@ -1948,6 +2225,31 @@ vvp_vector4_t& vvp_vector4_t::operator |= (const vvp_vector4_t&that)
       return *this;
 }
 
+vvp_vector4_t& vvp_vector4_t::operator ^= (const vvp_vector4_t&that)
+{
+	// The truth table is:
+	//     00 01 11 10
+	//  00 00 01 11 11
+	//  01 01 00 11 11
+	//  11 11 11 11 11
+	//  10 11 11 11 11
+      if (size_ <= BITS_PER_WORD) {
+	    unsigned long xz = bbits_val_ | that.bbits_val_;
+	    abits_val_ = (abits_val_ ^ that.abits_val_) | xz;
+	    bbits_val_ = xz;
+
+      } else {
+	    unsigned words = (size_ + BITS_PER_WORD - 1) / BITS_PER_WORD;
+	    for (unsigned idx = 0; idx < words ; idx += 1) {
+		  unsigned long xz = bbits_ptr_[idx] | that.bbits_ptr_[idx];
+		  abits_ptr_[idx] = (abits_ptr_[idx] ^ that.abits_ptr_[idx]) | xz;
+		  bbits_ptr_[idx] = xz;
+	    }
+      }
+
+      return *this;
+}
+
 /*
 * Add an integer to the vvp_vector4_t in place, bit by bit so that
 * there is no size limitations.
@@ -2248,6 +2550,84 @@ vvp_vector4_t vvp_vector4array_sa::get_word(unsigned index) const
       return get_word_(cell);
 }
 
+vvp_vector4array_sparse::vvp_vector4array_sparse(unsigned width__, unsigned words__)
+: vvp_vector4array_t(width__, words__)
+{
+      cnt_ = (width_ + vvp_vector4_t::BITS_PER_WORD-1)/vvp_vector4_t::BITS_PER_WORD;
+
+      unsigned npages = (words_ + PAGE_WORDS-1) / PAGE_WORDS;
+      pages_ = new unsigned long*[npages];
+      for (unsigned idx = 0 ; idx < npages ; idx += 1)
+	    pages_[idx] = 0;
+}
+
+vvp_vector4array_sparse::~vvp_vector4array_sparse()
+{
+      unsigned npages = (words_ + PAGE_WORDS-1) / PAGE_WORDS;
+      for (unsigned idx = 0 ; idx < npages ; idx += 1)
+	    delete[]pages_[idx];
+      delete[]pages_;
+}
+
+void vvp_vector4array_sparse::set_word(unsigned index, const vvp_vector4_t&that)
+{
+      assert(index < words_);
+      assert(that.size_ == width_);
+
+      unsigned long*&page = pages_[index / PAGE_WORDS];
+      if (page == 0) {
+	    unsigned plane = PAGE_WORDS * cnt_;
+	    page = new unsigned long[2*plane];
+	    for (unsigned idx = 0 ; idx < plane ; idx += 1) {
+		  page[idx] = vvp_vector4_t::WORD_X_ABITS;
+		  page[plane+idx] = vvp_vector4_t::WORD_X_BBITS;
+	    }
+      }
+
+      unsigned long*abits = page + (index % PAGE_WORDS) * cnt_;
+      unsigned long*bbits = abits + PAGE_WORDS * cnt_;
+
+      if (cnt_ == 1) {
+	    abits[0] = that.abits_val_;
+	    bbits[0] = that.bbits_val_;
+	    return;
+      }
+
+      for (unsigned idx = 0 ; idx < cnt_ ; idx += 1) {
+	    abits[idx] = that.abits_ptr_[idx];
+	    bbits[idx] = that.bbits_ptr_[idx];
+      }
+}
+
+vvp_vector4_t vvp_vector4array_sparse::get_word(unsigned index) const
+{
+      if (index >= words_)
+	    return vvp_vector4_t(width_, BIT4_X);
+
+      const unsigned long*page = pages_[index / PAGE_WORDS];
+      if (page == 0)
+	    return vvp_vector4_t(width_, BIT4_X);
+
+      const unsigned long*abits = page + (index % PAGE_WORDS) * cnt_;
+      const unsigned long*bbits = abits + PAGE_WORDS * cnt_;
+
+      if (cnt_ == 1) {
+	    vvp_vector4_t res;
+	    res.size_ = width_;
+	    res.abits_val_ = abits[0];
+	    res.bbits_val_ = bbits[0];
+	    return res;
+      }
+
+      vvp_vector4_t res (width_, BIT4_X);
+      for (unsigned idx = 0 ; idx < cnt_ ; idx += 1) {
+	    res.abits_ptr_[idx] = abits[idx];
+	    res.bbits_ptr_[idx] = bbits[idx];
+      }
+
+      return res;
+}
+
 vvp_vector4array_aa::vvp_vector4array_aa(unsigned width__, unsigned words__)
 : vvp_vector4array_t(width__, words__)
 {
@@ -3347,6 +3727,11 @@ void vvp_net_fun_t::force_flag(bool)
 {
 }
 
+vvp_gen_event_s* vvp_net_fun_t::levelize_event()
+{
+      return 0;
+}
+
 /* **** vvp_fun_drive methods **** */
 
 vvp_fun_drive::vvp_fun_drive(unsigned str0, unsigned str1)
@@ -24,6 +24,7 @@
 # include  "vvp_vpi_callback.h"
 # include  "permaheap.h"
 # include  "vvp_object.h"
+# include  "profile.h"
 # include  <cstddef>
 # include  <cstdlib>
 # include  <cstring>
@@ -247,6 +248,7 @@ class vvp_vector4_t {
       friend class vvp_vector4array_t;
       friend class vvp_vector4array_sa;
       friend class vvp_vector4array_aa;
+      friend class vvp_vector4array_sparse;
 
     public:
       static const vvp_vector4_t nil;
@@ -267,6 +269,12 @@ class vvp_vector4_t {
       vvp_vector4_t(const vvp_vector4_t&that);
       vvp_vector4_t(const vvp_vector4_t&that, bool invert_flag);
       vvp_vector4_t& operator= (const vvp_vector4_t&that);
+#if __cplusplus >= 201103L
+	// Moving a vector steals its heap words instead of copying
+	// them. The source is left empty if it had any.
+      vvp_vector4_t(vvp_vector4_t&&that) noexcept;
+      vvp_vector4_t& operator= (vvp_vector4_t&&that) noexcept;
+#endif
 
       ~vvp_vector4_t();
 
@@ -282,6 +290,10 @@ class vvp_vector4_t {
 	// in the array.
       unsigned long*subarray(unsigned idx, unsigned size, bool xz_to_0 =false) const;
       void setarray(unsigned idx, unsigned size, const unsigned long*val);
+	// Copy the whole vector from or to an array of VPI vecval
+	// words, which use the same a/b bit encoding as this vector.
+      void set_vecvals(const s_vpi_vecval*vals);
+      void get_vecvals(s_vpi_vecval*vals) const;
 
 	// Set a 4-value bit or subvector into the vector. Return true
 	// if any bits of the vector change as a result of this operation.
@@ -324,11 +336,15 @@ class vvp_vector4_t {
       void invert();
       vvp_vector4_t& operator &= (const vvp_vector4_t&that);
       vvp_vector4_t& operator |= (const vvp_vector4_t&that);
+      vvp_vector4_t& operator ^= (const vvp_vector4_t&that);
       vvp_vector4_t& operator += (int64_t);
 
     private:
 	// Number of vvp_bit4_t bits that can be shoved into a word.
       enum { BITS_PER_WORD = 8*sizeof(unsigned long) };
+	// Vectors that need no more than this many words take them
+	// from pools of fixed size chunks instead of the heap.
+      enum { POOL_WORDS = 4 };
 	// The double value constructor requires that WORD_0_BBITS
 	// and WORD_1_BBITS have the same value!
 #if SIZEOF_UNSIGNED_LONG == 8
@@ -354,8 +370,14 @@ class vvp_vector4_t {
       void copy_from_(const vvp_vector4_t&that);
       void copy_from_big_(const vvp_vector4_t&that);
       void copy_inverted_from_(const vvp_vector4_t&that);
+      void move_from_(vvp_vector4_t&that);
 
       void allocate_words_(unsigned long inita, unsigned long initb);
+	// Point abits_ptr_/bbits_ptr_ at storage for cnt words,
+	// either a pool chunk or a new heap array.
+      void alloc_words_(unsigned cnt);
+      void free_words_(void);
+      static void release_words_(unsigned long*words, unsigned cnt);
 
 	// Values in the vvp_vector4_t are stored split across two
 	// arrays. For each bit in the vector, there is an abit and a
@@ -384,6 +406,26 @@ inline vvp_vector4_t::vvp_vector4_t(const vvp_vector4_t&that)
       copy_from_(that);
 }
 
+#if __cplusplus >= 201103L
+inline vvp_vector4_t::vvp_vector4_t(vvp_vector4_t&&that) noexcept
+{
+      move_from_(that);
+}
+
+inline vvp_vector4_t& vvp_vector4_t::operator= (vvp_vector4_t&&that) noexcept
+{
+      if (this == &that)
+	    return *this;
+
+      if (size_ > BITS_PER_WORD)
+	    free_words_();
+
+      move_from_(that);
+
+      return *this;
+}
+#endif
+
 inline vvp_vector4_t::vvp_vector4_t(const vvp_vector4_t&that, bool invert_flag)
 {
       if (invert_flag)
@@ -410,13 +452,17 @@ inline vvp_vector4_t::vvp_vector4_t(unsigned size__, vvp_bit4_t val)
       allocate_words_(init_atable[val], init_btable[val]);
 }
 
+inline void vvp_vector4_t::free_words_(void)
+{
+	// bbits_ptr_ actually points half-way into a double-length
+	// array started at abits_ptr_, so only abits_ptr_ is released.
+      release_words_(abits_ptr_, (size_+BITS_PER_WORD-1) / BITS_PER_WORD);
+}
+
 inline vvp_vector4_t::~vvp_vector4_t()
 {
-      if (size_ > BITS_PER_WORD) {
-	    delete[] abits_ptr_;
-	      // bbits_ptr_ actually points half-way into a
-	      // double-length array started at abits_ptr_
-      }
+      if (size_ > BITS_PER_WORD)
+	    free_words_();
 }
 
 inline vvp_vector4_t& vvp_vector4_t::operator= (const vvp_vector4_t&that)
@@ -424,8 +470,22 @@ inline vvp_vector4_t& vvp_vector4_t::operator= (const vvp_vector4_t&that)
       if (this == &that)
 	    return *this;
 
+	// If this already has storage for the same number of words,
+	// copy the words into it instead of reallocating it.
+      if (size_ > BITS_PER_WORD && that.size_ > BITS_PER_WORD) {
+	    unsigned words = (size_+BITS_PER_WORD-1) / BITS_PER_WORD;
+	    if (words == (that.size_+BITS_PER_WORD-1) / BITS_PER_WORD) {
+		  size_ = that.size_;
+		  for (unsigned idx = 0 ;  idx < words ;  idx += 1)
+			abits_ptr_[idx] = that.abits_ptr_[idx];
+		  for (unsigned idx = 0 ;  idx < words ;  idx += 1)
+			bbits_ptr_[idx] = that.bbits_ptr_[idx];
+		  return *this;
+	    }
+      }
+
       if (size_ > BITS_PER_WORD)
-	    delete[] abits_ptr_;
+	    free_words_();
 
       copy_from_(that);
 
@@ -443,6 +503,26 @@ inline void vvp_vector4_t::copy_from_(const vvp_vector4_t&that)
       }
 }
 
+/*
+ * Take the value of that vector, and leave that vector empty. The
+ * words of a wide vector are simply handed over.
+ */
+inline void vvp_vector4_t::move_from_(vvp_vector4_t&that)
+{
+      size_ = that.size_;
+      if (size_ <= BITS_PER_WORD) {
+	    abits_val_ = that.abits_val_;
+	    bbits_val_ = that.bbits_val_;
+
+      } else {
+	    abits_ptr_ = that.abits_ptr_;
+	    bbits_ptr_ = that.bbits_ptr_;
+	    that.size_ = 0;
+	    that.abits_val_ = 0;
+	    that.bbits_val_ = 0;
+      }
+}
+
 inline vvp_bit4_t vvp_vector4_t::value(unsigned idx) const
 {
       if (idx >= size_)
@@ -621,6 +701,31 @@ class vvp_vector4array_sa : public vvp_vector4array_t {
       v4cell* array_;
 };
 
+/*
+ * Statically allocated vvp_vector4array_t for very large memories.
+ * The words are kept in pages of PAGE_WORDS words that are allocated
+ * on the first write into the page, so a memory that is only lightly
+ * used costs only the page table. A page holds the abits of all its
+ * words followed by the bbits, and words that were never written
+ * read as X.
+ */
+class vvp_vector4array_sparse : public vvp_vector4array_t {
+
+    public:
+      vvp_vector4array_sparse(unsigned width, unsigned words);
+      ~vvp_vector4array_sparse();
+
+      vvp_vector4_t get_word(unsigned idx) const;
+      void set_word(unsigned idx, const vvp_vector4_t&that);
+
+      enum { PAGE_WORDS = 1024 };
+
+    private:
+	// Number of unsigned longs in a plane of one word.
+      unsigned cnt_;
+      unsigned long**pages_;
+};
+
 /*
  * Automatically allocated vvp_vector4array_t
  */
@@ -1106,6 +1211,14 @@ template <class T> ostream& operator << (ostream&out, vvp_sub_pointer_t<T> val)
  * all the fan-out chain, delivering the specified value. The send_*()
  * methods of the vvp_net_t class are similar, but they follow the
  * output, possibly filtered, from the vvp_net_t.
+ *
+ * Walking the chain touches every receiver before the next one can be
+ * found, so after the design is linked the fan-out of the nets with
+ * many receivers is also copied into a nil terminated array (see
+ * vvp_net_flatten_fanout) that the send_*() methods walk instead. The
+ * array is in chain order, and is dropped if the fan-out changes. Each
+ * entry also carries the functor of the receiver, so delivering to it
+ * does not touch the receiving vvp_net_t at all.
  */
 class vvp_net_t {
     public:
@@ -1152,8 +1265,21 @@ class vvp_net_t {
     public: // Method to support $countdrivers
       void count_drivers(unsigned idx, unsigned counts[4]);
 
+    public: // Support for passes that walk the whole net graph.
+	// Get the first receiver of the output of this net. The rest
+	// of the fan-out list is threaded through the port[] of the
+	// receivers, so follow it with ptr()->port[port()].
+      vvp_net_ptr_t fanout_head() const { return out_; }
+
     private:
+      friend void vvp_net_flatten_fanout(bool flow_order);
+
       vvp_net_ptr_t out_;
+	// The fan-out as an array, or nil to use the chain.
+      struct vvp_fanout_s*fanout_;
+
+      void out_vec4_(const vvp_vector4_t&val, vvp_context_t context);
+      void out_vec8_(const vvp_vector8_t&val);
 
     public: // Need a better new for these objects.
       static void* operator new(std::size_t size);
@@ -1165,6 +1291,25 @@ class vvp_net_t {
 #endif
 };
 
+/*
+ * Call the fun for every vvp_net_t that has been allocated so far, in
+ * allocation order. This is for passes that need to see the whole net
+ * graph after the design is linked.
+ */
+extern void vvp_net_walk(void (*fun)(vvp_net_t*net, void*data), void*data);
+
+/*
+ * Make the fan-out arrays of the nets that have at least
+ * VVP_FANOUT_ARRAY_MIN receivers. This is called once the design is
+ * linked, and after any pass that rearranges the fan-out lists. The
+ * arrays are in one table, normally in allocation order. If the
+ * flow_order flag is set, they are instead laid out in the order that
+ * values flow through the nets, breadth first from the nets that no
+ * other net drives, so that a wave of events walks the table forward.
+ */
+# define VVP_FANOUT_ARRAY_MIN 4
+extern void vvp_net_flatten_fanout(bool flow_order);
+
 /*
  * Instances of this class represent the functionality of a
  * node. vvp_net_t objects hold pointers to the vvp_net_fun_t
@@ -1230,6 +1375,11 @@ class vvp_net_fun_t {
 	// do something about it.
       virtual void force_flag(bool run_now);
 
+	// A functor that runs as an event of its own (see
+	// schedule_functor) returns that event, so that the
+	// compile_levelize pass can give it a level.
+      virtual struct vvp_gen_event_s* levelize_event();
+
    protected:
       void recv_vec4_pv_(vvp_net_ptr_t p, const vvp_vector4_t&bit,
 			 unsigned base, unsigned wid, unsigned vwid,
@@ -1302,6 +1452,9 @@ class vvp_net_fil_t  : public vvp_vpi_callback {
 
       virtual unsigned filter_size() const =0;
 
+	// Test if the bit is currently forced.
+      bool is_forced(unsigned bit) const { return test_force_mask(bit); }
+
     public:
 	// Support for force methods. These are called by the
 	// vvp_net_t::force_* methods to set the force value and mask
@@ -1588,6 +1741,9 @@ class vvp_wide_fun_t : public vvp_net_fun_t {
 			unsigned base, unsigned wid, unsigned vwid,
                         vvp_context_t context);
 
+	// The net of the core, for passes that walk the net graph.
+      vvp_net_t*core_net() const { return core_->ptr_; }
+
     private:
       vvp_wide_fun_core*core_;
       unsigned port_base_;
@@ -1599,8 +1755,11 @@ inline void vvp_send_vec4(vvp_net_ptr_t ptr, const vvp_vector4_t&val, vvp_contex
       while (class vvp_net_t*cur = ptr.ptr()) {
 	    vvp_net_ptr_t next = cur->port[ptr.port()];
 
-	    if (cur->fun)
+	    if (cur->fun) {
+		  if (vvp_profile_enabled)
+			vvp_profile_recv(cur->fun);
 		  cur->fun->recv_vec4(ptr, val, context);
+	    }
 
 	    ptr = next;
       }
@@ -1613,6 +1772,63 @@ extern void vvp_send_long(vvp_net_ptr_t ptr, long val);
 extern void vvp_send_long_pv(vvp_net_ptr_t ptr, long val,
                              unsigned base, unsigned width);
 
+/*
+ * An entry of a fan-out array is the receiving port and the functor of
+ * the receiver. Receivers without a functor are left out, and the
+ * array ends with an entry with a nil functor.
+ */
+struct vvp_fanout_s {
+      vvp_net_ptr_t ptr;
+      vvp_net_fun_t*fun;
+};
+
+/*
+ * These versions deliver to a fan-out array. The next receiver is
+ * known before the current one is called, so its functor is fetched
+ * while the current one runs.
+ */
+
+static inline void vvp_fanout_prefetch(const vvp_fanout_s*cur)
+{
+#if defined(__GNUC__)
+      __builtin_prefetch(cur[1].fun);
+#else
+      (void)cur;
+#endif
+}
+
+inline void vvp_send_vec4(vvp_fanout_s*cur, const vvp_vector4_t&val,
+			  vvp_context_t context)
+{
+      for ( ; cur->fun ; cur += 1) {
+	    vvp_fanout_prefetch(cur);
+	    if (vvp_profile_enabled)
+		  vvp_profile_recv(cur->fun);
+	    cur->fun->recv_vec4(cur->ptr, val, context);
+      }
+}
+
+inline void vvp_send_vec8(vvp_fanout_s*cur, const vvp_vector8_t&val)
+{
+      for ( ; cur->fun ; cur += 1) {
+	    vvp_fanout_prefetch(cur);
+	    if (vvp_profile_enabled)
+		  vvp_profile_recv(cur->fun);
+	    cur->fun->recv_vec8(cur->ptr, val);
+      }
+}
+
+inline void vvp_send_real(vvp_fanout_s*cur, double val,
+			  vvp_context_t context)
+{
+      for ( ; cur->fun ; cur += 1) {
+	    vvp_fanout_prefetch(cur);
+	    if (vvp_profile_enabled)
+		  vvp_profile_recv(cur->fun);
+	    cur->fun->recv_real(cur->ptr, val, context);
+      }
+}
+
 inline void vvp_send_string(vvp_net_ptr_t ptr, const std::string&val, vvp_context_t context)
 {
       while (vvp_net_t*cur = ptr.ptr()) {
@@ -1663,8 +1879,11 @@ inline void vvp_send_vec4_pv(vvp_net_ptr_t ptr, const vvp_vector4_t&val,
       while (class vvp_net_t*cur = ptr.ptr()) {
 	    vvp_net_ptr_t next = cur->port[ptr.port()];
 
-	    if (cur->fun)
+	    if (cur->fun) {
+		  if (vvp_profile_enabled)
+			vvp_profile_recv(cur->fun);
 		  cur->fun->recv_vec4_pv(ptr, val, base, wid, vwid, context);
+	    }
 
 	    ptr = next;
       }
@@ -1676,17 +1895,36 @@ inline void vvp_send_vec8_pv(vvp_net_ptr_t ptr, const vvp_vector8_t&val,
       while (class vvp_net_t*cur = ptr.ptr()) {
 	    vvp_net_ptr_t next = cur->port[ptr.port()];
 
-	    if (cur->fun)
+	    if (cur->fun) {
+		  if (vvp_profile_enabled)
+			vvp_profile_recv(cur->fun);
 		  cur->fun->recv_vec8_pv(ptr, val, base, wid, vwid);
+	    }
 
 	    ptr = next;
       }
 }
 
+inline void vvp_net_t::out_vec4_(const vvp_vector4_t&val, vvp_context_t context)
+{
+      if (fanout_)
+	    vvp_send_vec4(fanout_, val, context);
+      else
+	    vvp_send_vec4(out_, val, context);
+}
+
+inline void vvp_net_t::out_vec8_(const vvp_vector8_t&val)
+{
+      if (fanout_)
+	    vvp_send_vec8(fanout_, val);
+      else
+	    vvp_send_vec8(out_, val);
+}
+
 inline void vvp_net_t::send_vec4(const vvp_vector4_t&val, vvp_context_t context)
 {
       if (fil == 0) {
-	    vvp_send_vec4(out_, val, context);
+	    out_vec4_(val, context);
 	    return;
       }
 
@@ -1695,10 +1933,10 @@ inline void vvp_net_t::send_vec4(const vvp_vector4_t&val, vvp_context_t context)
 	  case vvp_net_fil_t::STOP:
 	    break;
 	  case vvp_net_fil_t::PROP:
-	    vvp_send_vec4(out_, val, context);
+	    out_vec4_(val, context);
 	    break;
 	  case vvp_net_fil_t::REPL:
-	    vvp_send_vec4(out_, rep, context);
+	    out_vec4_(rep, context);
 	    break;
       }
 }
@@ -1729,7 +1967,7 @@ inline void vvp_net_t::send_vec4_pv(const vvp_vector4_t&val,
 inline void vvp_net_t::send_vec8(const vvp_vector8_t&val)
 {
       if (fil == 0) {
-	    vvp_send_vec8(out_, val);
+	    out_vec8_(val);
 	    return;
       }
 
@@ -1738,10 +1976,10 @@ inline void vvp_net_t::send_vec8(const vvp_vector8_t&val)
 	  case vvp_net_fil_t::STOP:
 	    break;
 	  case vvp_net_fil_t::PROP:
-	    vvp_send_vec8(out_, val);
+	    out_vec8_(val);
 	    break;
 	  case vvp_net_fil_t::REPL:
-	    vvp_send_vec8(out_, rep);
+	    out_vec8_(rep);
 	    break;
       }
 }
@@ -1773,7 +2011,10 @@ inline void vvp_net_t::send_real(double val, vvp_context_t context)
       if (fil && ! fil->filter_real(val))
 	    return;
 
-      vvp_send_real(out_, val, context);
+      if (fanout_)
+	    vvp_send_real(fanout_, val, context);
+      else
+	    vvp_send_real(out_, val, context);
 }
 
 